@@ -0,0 +1,197 @@
+/*******************************************************************************
+ *  @file Clone.c
+ *
+ *  @brief Token clone. The scheduler reads the master one CLONE_READ_LEN
+ *  transfer per step with the part's fastest read, straight into the ring of
+ *  a streamed image that the target sockets program from as a gang. Nothing
+ *  goes through the disk: reading the master overlaps programming the
+ *  targets, held back only when the slowest target is a whole ring behind.
+ *
+ *  Each sector's FNV-1a 64 digest is taken as it is read. The targets check
+ *  their sectors against it once written instead of comparing every page, so
+ *  a sector's data is let go as soon as every target has passed it. The
+ *  master's whole digest becomes the image's once the last sector is in.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <string.h>
+
+// Module Includes
+#include "Clone.h"
+
+// Utility Includes
+
+// Driver Includes
+#include "Timer.h"
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// End job with err, failing the image unless the master was read in full
+static void clone_finish(CLONE_Job_t* job, TOKEN_ErrCode_t err);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Clone_Start
+ *
+ * Start reading the master token in socket into a streamed image the size of
+ * the part, held in a ring of CLONE_RING_LEN (or the whole part if smaller).
+ *
+ * @param  > CLONE_Job_t* : job
+ *         > uint8_t : socket
+ *
+ * @return bool : false if the part is unknown or the ring couldn't be made
+ ******************************************************************************/
+bool Clone_Start(CLONE_Job_t* job, uint8_t socket)
+{
+    memset(job, 0, sizeof(CLONE_Job_t));
+    job->socket = socket;
+    job->startTick = Timer_GetTick();
+    job->digest = IMAGE_DIGEST_SEED;
+    job->sectorDigest = IMAGE_DIGEST_SEED;
+    Token_SelectSocket(socket);
+    job->device = TokenDevice_Get();
+    uint32_t len = job->device->size;
+    uint32_t window = MIN(CLONE_RING_LEN, (len + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN * TOKEN_FLASH_SECTOR_LEN);
+    job->image = (len > 0) ? Image_OpenStream(len, window) : NULL;
+    if(job->image == NULL)
+    {
+        printf("Error, unable to start clone of socket %u\n", socket);
+        job->isDone = true;
+        job->err = TOKEN_ERR_INVALID_INPUT;
+        return false;
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief Clone_Step
+ *
+ * Read the next transfer into the image's ring and publish it to the targets.
+ * A sector's digest is recorded before the data that completes it is made
+ * ready, so a target never checks against a digest still being taken.
+ *
+ * @param  > CLONE_Job_t* : job
+ *         > uint32_t : limit, the read may not end past it
+ *
+ * @return bool : true if a transfer was made
+ ******************************************************************************/
+bool Clone_Step(CLONE_Job_t* job, uint32_t limit)
+{
+    if(job->isDone)
+    {
+        return false;
+    }
+    uint32_t len = MIN(CLONE_READ_LEN, job->image->len - job->address);
+    if(job->address + len > limit)
+    {
+        return false;
+    }
+
+    uint8_t* buf = Image_GetData(job->image, job->address);
+    TOKEN_ErrCode_t err = TokenFlash_Read(job->address, buf, len);
+    if(err != TOKEN_ERR_OK)
+    {
+        printf("socket %u master read failed at 0x%08X\n", job->socket, job->address);
+        clone_finish(job, err);
+        return true;
+    }
+    job->digest = Image_Digest(job->digest, buf, len);
+    job->sectorDigest = Image_Digest(job->sectorDigest, buf, len);
+    job->address += len;
+    if((job->address % TOKEN_FLASH_SECTOR_LEN) == 0 || job->address == job->image->len)
+    {
+        job->image->sectorDigests[(job->address - 1) / TOKEN_FLASH_SECTOR_LEN] = job->sectorDigest;
+        job->sectorDigest = IMAGE_DIGEST_SEED;
+    }
+    if(job->address == job->image->len)
+    {
+        job->image->digest = job->digest;
+    }
+    Image_SetReady(job->image, job->address);
+    if(job->address == job->image->len)
+    {
+        printf("socket %u master read, digest %016llX\n", job->socket, (unsigned long long) job->digest);
+        clone_finish(job, TOKEN_ERR_OK);
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief Clone_Cancel
+ *
+ * Abandon job. Targets still waiting on the master's data fail.
+ *
+ * @param  > CLONE_Job_t* : job
+ *
+ * @return None
+ ******************************************************************************/
+void Clone_Cancel(CLONE_Job_t* job)
+{
+    if(!job->isDone)
+    {
+        clone_finish(job, TOKEN_ERR_ABORTED);
+    }
+}
+
+/*******************************************************************************
+ * @brief Clone_IsDone
+ *
+ * Determine if job has finished
+ *
+ * @param  > const CLONE_Job_t* : job
+ *
+ * @return bool
+ ******************************************************************************/
+bool Clone_IsDone(const CLONE_Job_t* job)
+{
+    return job->isDone;
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief clone_finish
+ *
+ * End job with err. Unless the master was read in full the image is failed,
+ * so targets waiting on the rest of it fail rather than wait forever. The
+ * targets hold their own references; the image goes with the last of them.
+ *
+ * @param  > CLONE_Job_t* : job
+ *         > TOKEN_ErrCode_t : result
+ *
+ * @return None
+ ******************************************************************************/
+static void clone_finish(CLONE_Job_t* job, TOKEN_ErrCode_t err)
+{
+    if(err != TOKEN_ERR_OK)
+    {
+        Image_SetFailed(job->image);
+    }
+    Image_Release(job->image);
+    job->image = NULL;
+    job->err = err;
+    job->isDone = true;
+}
+
+// EOF
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ *  @file Clone.h
+ *
+ *  @brief Token clone. Reads a master token into a streamed image that the
+ *         target sockets program from as it arrives, taking the digest of
+ *         every 64K sector for the targets to check theirs against.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _CLONE_H_
+#define _CLONE_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+#include "Token.h"
+#include "Image.h"
+#include "TokenFlash.h"
+#include "TokenDevice.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define CLONE_RING_LEN          0x200000    // master data held for the targets, whole sectors
+#define CLONE_READ_LEN          TOKEN_FLASH_SUBSECTOR_LEN   // one transfer, within spidev's default buffer
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+typedef struct
+{
+    uint8_t socket;
+    TOKEN_ErrCode_t err;
+    bool isDone;
+    uint32_t address;       // next transfer
+    uint32_t startTick;
+    const TOKEN_Device_t* device;
+    IMAGE_t* image;         // streamed to the targets, a reference is held until the job finishes
+    uint64_t digest;        // whole token so far
+    uint64_t sectorDigest;  // sector being read so far
+} CLONE_Job_t;
+
+// Start reading the master token in socket, just identified by
+// TokenDevice_Identify. Selects socket. False if the ring can't be made.
+bool Clone_Start(CLONE_Job_t* job, uint8_t socket);
+
+// Read the next transfer, unless it would end past limit: the targets still
+// need everything from CLONE_RING_LEN before it. Caller must have selected
+// job's socket. Returns true if a transfer was made.
+bool Clone_Step(CLONE_Job_t* job, uint32_t limit);
+
+// Abandon job (master removed, shutdown). Targets still waiting on the
+// master's data fail.
+void Clone_Cancel(CLONE_Job_t* job);
+
+// Determine if job has finished (master read, or failed)
+bool Clone_IsDone(const CLONE_Job_t* job);
+
+#endif /* _CLONE_H_ */
@@ -0,0 +1,1044 @@
+/*******************************************************************************
+ *  @file Control.c
+ *
+ *  @brief Control socket. One JSON object per line each way:
+ *
+ *      {"cmd":"status","id":1}
+ *      {"cmd":"program","socket":0}     also "verify" and "dump"
+ *      {"cmd":"dump","socket":0,"compress":true}
+ *      {"cmd":"clone","socket":0,"targets":[1,2]} no or [] targets = every other idle token
+ *      {"cmd":"select","image":"pluto"} "" or no image goes back to per token
+ *      {"cmd":"subscribe"}
+ *
+ *  Every command is answered with {"ok":true} or {"ok":false,"error":"..."},
+ *  carrying the request's "id" if it had one; status adds the sockets. Status
+ *  is answered at once and may overtake the answer to an earlier command.
+ *  Subscribers are then sent {"event":"state",...} whenever a socket's job or
+ *  token changes and {"event":"progress",...} as a job advances.
+ *
+ *  The socket is served by its own thread. Status and the event stream are
+ *  read from the status snapshot, so they never wait on, or hold up, the
+ *  programming loop. Commands that act on the programmer are queued to the
+ *  main loop (EVENT_CONTROL), which carries them out between scheduler passes
+ *  and queues the answers back. A client that stops reading is dropped rather
+ *  than let its output back up.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// Module Includes
+#include "Control.h"
+#include "Event.h"
+#include "Status.h"
+#include "Scheduler.h"
+#include "Library.h"
+#include "Token.h"
+#include "Timer.h"
+
+// Utility Includes
+
+// Driver Includes
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define CONTROL_LINE_LEN        512
+#define CONTROL_OUT_LEN         16384   // output queued per client before it is dropped
+#define CONTROL_REPLY_LEN       384
+#define CONTROL_STATUS_LEN      (256 + SOCKET_COUNT * CONTROL_REPLY_LEN)
+#define CONTROL_QUEUE_LEN       16
+#define CONTROL_LISTEN_INDEX    CONTROL_CLIENT_MAX          // epoll data of the listening socket
+#define CONTROL_WAKE_INDEX      (CONTROL_CLIENT_MAX + 1)    // and of the reply eventfd
+
+static int m_listenFd = -1;
+static int m_epollFd = -1;
+static int m_wakeFd = -1;
+
+
+/*******************************************************************************
+ * Data Types Declarations
+ ******************************************************************************/
+
+typedef enum
+{
+    CONTROL_CMD_PROGRAM,
+    CONTROL_CMD_VERIFY,
+    CONTROL_CMD_DUMP,
+    CONTROL_CMD_SELECT,
+    CONTROL_CMD_CLONE,
+    CONTROL_CMD_COUNT
+} CONTROL_Cmd_t;
+
+// A command for the main loop, and who to answer
+typedef struct
+{
+    CONTROL_Cmd_t cmd;
+    uint32_t client;
+    uint32_t serial;
+    bool hasId;
+    long id;
+    uint8_t socket;
+    bool isCompressed;      // dump
+    uint32_t targets;       // clone, a bit per socket, 0 = every other idle socket holding a token
+    char name[STATUS_NAME_LEN];
+} CONTROL_Request_t;
+
+typedef struct
+{
+    uint32_t client;
+    uint32_t serial;
+    char text[CONTROL_REPLY_LEN];
+} CONTROL_Reply_t;
+
+typedef struct
+{
+    int fd;                 // -1 = free
+    uint32_t serial;        // tells a reply's client from a later one in the same slot
+    bool isSubscribed;
+    char in[CONTROL_LINE_LEN];
+    uint32_t inLen;
+    char out[CONTROL_OUT_LEN];
+    uint32_t outLen;
+} CONTROL_Client_t;
+
+static const char* const m_cmdNames[CONTROL_CMD_COUNT] = { "program", "verify", "dump", "select", "clone" };
+
+static pthread_t m_thread;
+static CONTROL_Client_t m_clients[CONTROL_CLIENT_MAX];
+static uint32_t m_serial = 0;
+static STATUS_t m_streamed;         // status as last streamed to subscribers
+static uint32_t m_lastStream = 0;
+
+static pthread_mutex_t m_queueLock = PTHREAD_MUTEX_INITIALIZER;
+static CONTROL_Request_t m_requests[CONTROL_QUEUE_LEN];
+static uint32_t m_requestHead = 0;
+static uint32_t m_requestTail = 0;
+static CONTROL_Reply_t m_replies[CONTROL_QUEUE_LEN];
+static uint32_t m_replyHead = 0;
+static uint32_t m_replyTail = 0;
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Control thread: serve the socket
+static void* control_run(void* arg);
+
+// Accept a new client
+static void control_accept(void);
+
+// Read what client sent and handle each complete line
+static void control_read(uint32_t client);
+
+// Handle one request line from client
+static void control_handle(uint32_t client, const char* line);
+
+// Queue a command for the main loop
+static bool control_pushRequest(const CONTROL_Request_t* request);
+
+// Send the main loop's queued answers to their clients
+static void control_sendReplies(void);
+
+// Stream status changes to subscribers
+static void control_stream(bool isForced);
+
+// Append socket's status fields to buf as JSON members
+static uint32_t control_formatSocket(char* buf, uint32_t len, const STATUS_Socket_t* status, uint8_t socket);
+
+// Answer for request: ok, or error
+static void control_formatReply(char* buf, uint32_t len, bool hasId, long id, const char* error);
+
+// Queue text for client, dropping it if it has fallen too far behind
+static void control_send(uint32_t client, const char* text);
+
+// Write out as much of client's queued output as it will take
+static void control_flush(uint32_t client);
+
+// Close client's connection and free its slot
+static void control_close(uint32_t client);
+
+// Find "key": in line. Returns the value's first character, NULL if absent.
+static const char* control_findValue(const char* line, const char* key);
+
+// String value of key in line. False if absent or not a string.
+static bool control_getString(const char* line, const char* key, char* value, uint32_t len);
+
+// Number value of key in line. False if absent or not a number.
+static bool control_getNumber(const char* line, const char* key, long* value);
+
+// Boolean value of key in line. False if absent or not true.
+static bool control_getBool(const char* line, const char* key);
+
+// Array of socket numbers under key in line, as a bit per socket. False if
+// absent, not an array or a socket doesn't exist.
+static bool control_getSockets(const char* line, const char* key, uint32_t* sockets);
+
+// Clone request's socket onto its targets. Error text, NULL if started.
+static const char* control_clone(const CONTROL_Request_t* request);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Control_Init
+ *
+ * Open the control socket at CONTROL_PATH, replacing any left by an earlier
+ * run, and start the thread serving it. Must follow Event_Init so the thread
+ * inherits its signal mask.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+void Control_Init(void)
+{
+    for(uint32_t i = 0; i < CONTROL_CLIENT_MAX; i++)
+    {
+        m_clients[i].fd = -1;
+    }
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", CONTROL_PATH);
+    unlink(CONTROL_PATH);
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(m_listenFd < 0 || bind(m_listenFd, (struct sockaddr*) &address, sizeof(address)) != 0
+        || listen(m_listenFd, CONTROL_CLIENT_MAX) != 0)
+    {
+        printf("Error, unable to open control socket %s: %s\n", CONTROL_PATH, strerror(errno));
+        if(m_listenFd >= 0)
+        {
+            close(m_listenFd);
+            m_listenFd = -1;
+        }
+        return;
+    }
+    chmod(CONTROL_PATH, 0660);
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.u32 = CONTROL_LISTEN_INDEX;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &ev);
+    ev.data.u32 = CONTROL_WAKE_INDEX;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev);
+    if(pthread_create(&m_thread, NULL, control_run, NULL) != 0)
+    {
+        printf("Error, unable to start control thread\n");
+    }
+}
+
+/*******************************************************************************
+ * @brief Control_Service
+ *
+ * Carry out the commands clients have queued and queue their answers. A job
+ * is only started on a socket holding a token with nothing in flight.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+void Control_Service(void)
+{
+    while(true)
+    {
+        CONTROL_Request_t request;
+        pthread_mutex_lock(&m_queueLock);
+        bool isPending = (m_requestHead != m_requestTail);
+        if(isPending)
+        {
+            request = m_requests[m_requestTail];
+            m_requestTail = (m_requestTail + 1) % CONTROL_QUEUE_LEN;
+        }
+        pthread_mutex_unlock(&m_queueLock);
+        if(!isPending)
+        {
+            break;
+        }
+
+        const char* error = NULL;
+        if(request.cmd == CONTROL_CMD_SELECT)
+        {
+            error = Library_Select(request.name) ? NULL : "no such image";
+        }
+        else if(request.socket >= SOCKET_COUNT)
+        {
+            error = "no such socket";
+        }
+        else if(!Token_IsSocketInserted(request.socket))
+        {
+            error = "no token in socket";
+        }
+        else if(Scheduler_IsSocketBusy(request.socket))
+        {
+            error = "socket busy";
+        }
+        else if(request.cmd == CONTROL_CMD_PROGRAM)
+        {
+            Scheduler_Start(request.socket);
+        }
+        else if(request.cmd == CONTROL_CMD_VERIFY)
+        {
+            Scheduler_Verify(request.socket);
+        }
+        else if(request.cmd == CONTROL_CMD_CLONE)
+        {
+            error = control_clone(&request);
+        }
+        else
+        {
+            Scheduler_Dump(request.socket, request.isCompressed);
+        }
+        if(request.cmd == CONTROL_CMD_SELECT)
+        {
+            printf("control: select \"%s\", %s\n", request.name, (error != NULL) ? error : "ok");
+        }
+        else
+        {
+            printf("control: %s socket %u, %s\n", m_cmdNames[request.cmd], request.socket, (error != NULL) ? error : "ok");
+        }
+
+        pthread_mutex_lock(&m_queueLock);
+        uint32_t next = (m_replyHead + 1) % CONTROL_QUEUE_LEN;
+        if(next != m_replyTail)
+        {
+            CONTROL_Reply_t* reply = &m_replies[m_replyHead];
+            reply->client = request.client;
+            reply->serial = request.serial;
+            control_formatReply(reply->text, CONTROL_REPLY_LEN, request.hasId, request.id, error);
+            m_replyHead = next;
+        }
+        pthread_mutex_unlock(&m_queueLock);
+        uint64_t one = 1;
+        if(write(m_wakeFd, &one, sizeof(one)) < 0)
+        {
+            // Counter saturated: the control thread is already due to wake
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief control_run
+ *
+ * Control thread. Waits on the listening socket, the clients and the reply
+ * eventfd; while anyone is subscribed it also wakes every
+ * CONTROL_STREAM_PERIOD to stream status changes.
+ *
+ * @param  > void* : unused
+ *
+ * @return void* : NULL
+ ******************************************************************************/
+static void* control_run(void* arg)
+{
+    (void) arg;
+    struct epoll_event events[CONTROL_CLIENT_MAX + 2];
+    while(true)
+    {
+        bool isStreaming = false;
+        for(uint32_t i = 0; i < CONTROL_CLIENT_MAX; i++)
+        {
+            isStreaming |= (m_clients[i].fd >= 0) && m_clients[i].isSubscribed;
+        }
+        int count = epoll_wait(m_epollFd, events, CONTROL_CLIENT_MAX + 2, isStreaming ? CONTROL_STREAM_PERIOD : -1);
+        for(int i = 0; i < count; i++)
+        {
+            uint32_t index = events[i].data.u32;
+            if(index == CONTROL_LISTEN_INDEX)
+            {
+                control_accept();
+            }
+            else if(index == CONTROL_WAKE_INDEX)
+            {
+                uint64_t value = 0;
+                if(read(m_wakeFd, &value, sizeof(value)) == sizeof(value))
+                {
+                    control_sendReplies();
+                }
+            }
+            else if(index < CONTROL_CLIENT_MAX && m_clients[index].fd >= 0)
+            {
+                if(events[i].events & EPOLLOUT)
+                {
+                    control_flush(index);
+                }
+                if(m_clients[index].fd >= 0 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                {
+                    control_read(index);
+                }
+            }
+        }
+        if(isStreaming && Timer_TimeoutExpired(m_lastStream, CONTROL_STREAM_PERIOD))
+        {
+            control_stream(false);
+            m_lastStream = Timer_GetTick();
+        }
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+ * @brief control_accept
+ *
+ * Accept a new client into a free slot. With every slot taken it is turned
+ * away.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+static void control_accept(void)
+{
+    int fd = accept(m_listenFd, NULL, NULL);
+    if(fd < 0)
+    {
+        return;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    for(uint32_t i = 0; i < CONTROL_CLIENT_MAX; i++)
+    {
+        CONTROL_Client_t* client = &m_clients[i];
+        if(client->fd < 0)
+        {
+            client->fd = fd;
+            client->serial = ++m_serial;
+            client->isSubscribed = false;
+            client->inLen = 0;
+            client->outLen = 0;
+            struct epoll_event ev = {0};
+            ev.events = EPOLLIN;
+            ev.data.u32 = i;
+            epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+            return;
+        }
+    }
+    close(fd);
+}
+
+/*******************************************************************************
+ * @brief control_read
+ *
+ * Read what client sent and handle each complete line. A line too long for
+ * the buffer is answered with an error and discarded.
+ *
+ * @param  > uint32_t : client slot
+ *
+ * @return None
+ ******************************************************************************/
+static void control_read(uint32_t index)
+{
+    CONTROL_Client_t* client = &m_clients[index];
+    while(client->fd >= 0)
+    {
+        ssize_t len = recv(client->fd, client->in + client->inLen, CONTROL_LINE_LEN - 1 - client->inLen, 0);
+        if(len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR))
+        {
+            control_close(index);
+            return;
+        }
+        if(len < 0)
+        {
+            return;
+        }
+        client->inLen += (uint32_t) len;
+        client->in[client->inLen] = '\0';
+        char* line = client->in;
+        char* end = NULL;
+        while(client->fd >= 0 && (end = strchr(line, '\n')) != NULL)
+        {
+            *end = '\0';
+            control_handle(index, line);
+            line = end + 1;
+        }
+        if(client->fd < 0)
+        {
+            return;
+        }
+        client->inLen = (uint32_t) strlen(line);
+        memmove(client->in, line, client->inLen + 1);
+        if(client->inLen >= CONTROL_LINE_LEN - 1)
+        {
+            char reply[CONTROL_REPLY_LEN];
+            control_formatReply(reply, sizeof(reply), false, 0, "line too long");
+            control_send(index, reply);
+            client->inLen = 0;
+        }
+    }
+}
+
+/*******************************************************************************
+ * @brief control_handle
+ *
+ * Handle one request line. Status and subscribe are answered here from the
+ * status snapshot; everything else is queued for the main loop.
+ *
+ * @param  > uint32_t : client slot
+ *         > const char* : line, without its newline
+ *
+ * @return None
+ ******************************************************************************/
+static void control_handle(uint32_t index, const char* line)
+{
+    char cmd[STATUS_NAME_LEN] = "";
+    char reply[CONTROL_STATUS_LEN];
+    CONTROL_Request_t request;
+    memset(&request, 0, sizeof(request));
+    request.client = index;
+    request.serial = m_clients[index].serial;
+    request.hasId = control_getNumber(line, "id", &request.id);
+    if(line[strspn(line, " \t\r")] == '\0')
+    {
+        return;
+    }
+    if(!control_getString(line, "cmd", cmd, sizeof(cmd)))
+    {
+        control_formatReply(reply, sizeof(reply), request.hasId, request.id, "no cmd");
+        control_send(index, reply);
+        return;
+    }
+
+    if(strcmp(cmd, "status") == 0)
+    {
+        STATUS_t status;
+        Status_Read(&status);
+        control_formatReply(reply, sizeof(reply), request.hasId, request.id, NULL);
+        uint32_t len = (uint32_t) strlen(reply) - 2;    // reopen the object, drop "}\n"
+        len += (uint32_t) snprintf(reply + len, sizeof(reply) - len, ",\"selected\":\"%s\",\"sockets\":[", status.selected);
+        for(uint8_t socket = 0; socket < SOCKET_COUNT && len < sizeof(reply); socket++)
+        {
+            len += (uint32_t) snprintf(reply + len, sizeof(reply) - len, "%s{", (socket > 0) ? "," : "");
+            len += control_formatSocket(reply + len, sizeof(reply) - len, &status.sockets[socket], socket);
+            len += (uint32_t) snprintf(reply + len, sizeof(reply) - len, "}");
+        }
+        snprintf(reply + len, sizeof(reply) - MIN(len, sizeof(reply)), "]}\n");
+        control_send(index, reply);
+        return;
+    }
+    if(strcmp(cmd, "subscribe") == 0)
+    {
+        control_formatReply(reply, sizeof(reply), request.hasId, request.id, NULL);
+        control_send(index, reply);
+        m_clients[index].isSubscribed = true;
+        control_stream(true);
+        return;
+    }
+
+    long socket = 0;
+    request.cmd = CONTROL_CMD_COUNT;
+    for(uint32_t i = 0; i < CONTROL_CMD_COUNT; i++)
+    {
+        request.cmd = (strcmp(cmd, m_cmdNames[i]) == 0) ? (CONTROL_Cmd_t) i : request.cmd;
+    }
+    const char* error = NULL;
+    if(request.cmd == CONTROL_CMD_COUNT)
+    {
+        error = "unknown cmd";
+    }
+    else if(request.cmd == CONTROL_CMD_SELECT)
+    {
+        control_getString(line, "image", request.name, sizeof(request.name));
+    }
+    else if(!control_getNumber(line, "socket", &socket) || socket < 0 || socket >= SOCKET_COUNT)
+    {
+        error = "no such socket";
+    }
+    request.socket = (uint8_t) socket;
+    request.isCompressed = (request.cmd == CONTROL_CMD_DUMP) && control_getBool(line, "compress");
+    request.targets = 0;
+    if(error == NULL && request.cmd == CONTROL_CMD_CLONE && control_findValue(line, "targets") != NULL
+        && !control_getSockets(line, "targets", &request.targets))
+    {
+        error = "no such target socket";
+    }
+    if(error == NULL && !control_pushRequest(&request))
+    {
+        error = "too many commands queued";
+    }
+    if(error != NULL)
+    {
+        control_formatReply(reply, sizeof(reply), request.hasId, request.id, error);
+        control_send(index, reply);
+    }
+}
+
+/*******************************************************************************
+ * @brief control_pushRequest
+ *
+ * Queue a command for the main loop and wake it
+ *
+ * @param  > const CONTROL_Request_t* : request
+ *
+ * @return bool : false if the queue is full
+ ******************************************************************************/
+static bool control_pushRequest(const CONTROL_Request_t* request)
+{
+    pthread_mutex_lock(&m_queueLock);
+    uint32_t next = (m_requestHead + 1) % CONTROL_QUEUE_LEN;
+    bool isQueued = (next != m_requestTail);
+    if(isQueued)
+    {
+        m_requests[m_requestHead] = *request;
+        m_requestHead = next;
+    }
+    pthread_mutex_unlock(&m_queueLock);
+    if(isQueued)
+    {
+        Event_Post(EVENT_CONTROL, request->socket);
+    }
+    return isQueued;
+}
+
+/*******************************************************************************
+ * @brief control_sendReplies
+ *
+ * Send the main loop's queued answers to their clients. An answer whose
+ * client has gone, even if its slot has been reused, is dropped.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+static void control_sendReplies(void)
+{
+    while(true)
+    {
+        CONTROL_Reply_t reply;
+        pthread_mutex_lock(&m_queueLock);
+        bool isPending = (m_replyHead != m_replyTail);
+        if(isPending)
+        {
+            reply = m_replies[m_replyTail];
+            m_replyTail = (m_replyTail + 1) % CONTROL_QUEUE_LEN;
+        }
+        pthread_mutex_unlock(&m_queueLock);
+        if(!isPending)
+        {
+            return;
+        }
+        if(m_clients[reply.client].fd >= 0 && m_clients[reply.client].serial == reply.serial)
+        {
+            control_send(reply.client, reply.text);
+        }
+    }
+}
+
+/*******************************************************************************
+ * @brief control_stream
+ *
+ * Send subscribers a state event for each socket whose job, result or token
+ * changed since the last stream, and a progress event for each job that has
+ * moved on. Forced, every socket's state goes out: a new subscriber's
+ * starting point.
+ *
+ * @param  > bool : send every socket's state
+ *
+ * @return None
+ ******************************************************************************/
+static void control_stream(bool isForced)
+{
+    STATUS_t status;
+    Status_Read(&status);
+    for(uint8_t socket = 0; socket < SOCKET_COUNT; socket++)
+    {
+        const STATUS_Socket_t* now = &status.sockets[socket];
+        const STATUS_Socket_t* was = &m_streamed.sockets[socket];
+        char event[CONTROL_REPLY_LEN];
+        if(isForced || now->jobCount != was->jobCount || now->state != was->state || now->isInserted != was->isInserted)
+        {
+            uint32_t len = (uint32_t) snprintf(event, sizeof(event), "{\"event\":\"state\",");
+            len += control_formatSocket(event + len, sizeof(event) - len, now, socket);
+            snprintf(event + len, sizeof(event) - MIN(len, sizeof(event)), "}\n");
+        }
+        else if(now->bytesDone != was->bytesDone || now->phase != was->phase)
+        {
+            snprintf(event, sizeof(event), "{\"event\":\"progress\",\"socket\":%u,\"phase\":\"%s\",\"done\":%u,"
+                "\"total\":%u,\"ms\":%u,\"rate\":%u,\"retries\":%u}\n", socket, Status_GetPhaseName(now->phase),
+                now->bytesDone, now->bytesTotal, now->elapsedMs, now->bytesPerSec, now->retries);
+        }
+        else
+        {
+            continue;
+        }
+        for(uint32_t i = 0; i < CONTROL_CLIENT_MAX; i++)
+        {
+            if(m_clients[i].fd >= 0 && m_clients[i].isSubscribed)
+            {
+                control_send(i, event);
+            }
+        }
+    }
+    m_streamed = status;
+}
+
+/*******************************************************************************
+ * @brief control_formatSocket
+ *
+ * Socket's status as JSON members, without braces
+ *
+ * @param  > char* : buffer
+ *         > uint32_t : buffer length
+ *         > const STATUS_Socket_t* : status
+ *         > uint8_t : socket
+ *
+ * @return uint32_t : characters written, at most len - 1
+ ******************************************************************************/
+static uint32_t control_formatSocket(char* buf, uint32_t len, const STATUS_Socket_t* status, uint8_t socket)
+{
+    int written = snprintf(buf, len, "\"socket\":%u,\"token\":%s,\"job\":\"%s\",\"state\":\"%s\",\"phase\":\"%s\","
+        "\"image\":\"%s\",\"done\":%u,\"total\":%u,\"ms\":%u,\"rate\":%u,\"retries\":%u,\"err\":%d,\"jobs\":%u",
+        socket, status->isInserted ? "true" : "false", Status_GetJobName(status->job), Status_GetStateName(status->state),
+        Status_GetPhaseName(status->phase), status->image, status->bytesDone, status->bytesTotal, status->elapsedMs,
+        status->bytesPerSec, status->retries, status->err, status->jobCount);
+    return (written < 0) ? 0 : MIN((uint32_t) written, len - 1);
+}
+
+/*******************************************************************************
+ * @brief control_formatReply
+ *
+ * Answer for a request: {"id":n,"ok":true} or {"id":n,"ok":false,"error":...}
+ * and a newline, id only if the request had one
+ *
+ * @param  > char* : buffer
+ *         > uint32_t : buffer length
+ *         > bool : request had an id
+ *         > long : its id
+ *         > const char* : error, NULL if ok
+ *
+ * @return None
+ ******************************************************************************/
+static void control_formatReply(char* buf, uint32_t len, bool hasId, long id, const char* error)
+{
+    char idText[32] = "";
+    if(hasId)
+    {
+        snprintf(idText, sizeof(idText), "\"id\":%ld,", id);
+    }
+    if(error == NULL)
+    {
+        snprintf(buf, len, "{%s\"ok\":true}\n", idText);
+    }
+    else
+    {
+        snprintf(buf, len, "{%s\"ok\":false,\"error\":\"%s\"}\n", idText, error);
+    }
+}
+
+/*******************************************************************************
+ * @brief control_send
+ *
+ * Queue text for client and write out what it will take now. A client whose
+ * queue would overflow isn't reading and is dropped.
+ *
+ * @param  > uint32_t : client slot
+ *         > const char* : text
+ *
+ * @return None
+ ******************************************************************************/
+static void control_send(uint32_t index, const char* text)
+{
+    CONTROL_Client_t* client = &m_clients[index];
+    uint32_t len = (uint32_t) strlen(text);
+    if(client->outLen + len > CONTROL_OUT_LEN)
+    {
+        printf("control: client not reading, dropped\n");
+        control_close(index);
+        return;
+    }
+    memcpy(client->out + client->outLen, text, len);
+    client->outLen += len;
+    control_flush(index);
+}
+
+/*******************************************************************************
+ * @brief control_flush
+ *
+ * Write out as much of client's queued output as the socket will take. While
+ * any is left, epoll reports when it can take more.
+ *
+ * @param  > uint32_t : client slot
+ *
+ * @return None
+ ******************************************************************************/
+static void control_flush(uint32_t index)
+{
+    CONTROL_Client_t* client = &m_clients[index];
+    bool wasPending = (client->outLen > 0);
+    while(client->outLen > 0)
+    {
+        ssize_t len = send(client->fd, client->out, client->outLen, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(len < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            break;
+        }
+        if(len <= 0)
+        {
+            control_close(index);
+            return;
+        }
+        client->outLen -= (uint32_t) len;
+        memmove(client->out, client->out + len, client->outLen);
+    }
+    if(wasPending)
+    {
+        struct epoll_event ev = {0};
+        ev.events = EPOLLIN | ((client->outLen > 0) ? EPOLLOUT : 0);
+        ev.data.u32 = index;
+        epoll_ctl(m_epollFd, EPOLL_CTL_MOD, client->fd, &ev);
+    }
+}
+
+/*******************************************************************************
+ * @brief control_close
+ *
+ * Close client's connection and free its slot. Answers still queued for it
+ * are dropped when they arrive.
+ *
+ * @param  > uint32_t : client slot
+ *
+ * @return None
+ ******************************************************************************/
+static void control_close(uint32_t index)
+{
+    CONTROL_Client_t* client = &m_clients[index];
+    if(client->fd >= 0)
+    {
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+        close(client->fd);
+    }
+    client->fd = -1;
+    client->isSubscribed = false;
+    client->inLen = 0;
+    client->outLen = 0;
+}
+
+/*******************************************************************************
+ * @brief control_findValue
+ *
+ * Find "key": in a flat JSON object
+ *
+ * @param  > const char* : line
+ *         > const char* : key
+ *
+ * @return const char* : first character of the value, NULL if absent
+ ******************************************************************************/
+static const char* control_findValue(const char* line, const char* key)
+{
+    char quoted[STATUS_NAME_LEN + 2];
+    snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+    const char* found = strstr(line, quoted);
+    if(found == NULL)
+    {
+        return NULL;
+    }
+    found += strlen(quoted);
+    found += strspn(found, " \t");
+    if(*found != ':')
+    {
+        return NULL;
+    }
+    found++;
+    return found + strspn(found, " \t");
+}
+
+/*******************************************************************************
+ * @brief control_getString
+ *
+ * String value of key. Escaped characters are taken literally.
+ *
+ * @param  > const char* : line
+ *         > const char* : key
+ *         > char* : value buffer
+ *         > uint32_t : value buffer length
+ *
+ * @return bool : false if absent, not a string or too long
+ ******************************************************************************/
+static bool control_getString(const char* line, const char* key, char* value, uint32_t len)
+{
+    const char* found = control_findValue(line, key);
+    if(found == NULL || *found != '"')
+    {
+        return false;
+    }
+    uint32_t count = 0;
+    for(found++; *found != '\0' && *found != '"'; found++)
+    {
+        if(*found == '\\' && found[1] != '\0')
+        {
+            found++;
+        }
+        if(count + 1 >= len)
+        {
+            return false;
+        }
+        value[count++] = *found;
+    }
+    value[count] = '\0';
+    return (*found == '"');
+}
+
+/*******************************************************************************
+ * @brief control_getNumber
+ *
+ * Number value of key
+ *
+ * @param  > const char* : line
+ *         > const char* : key
+ *         > long* : value
+ *
+ * @return bool : false if absent or not a number
+ ******************************************************************************/
+static bool control_getNumber(const char* line, const char* key, long* value)
+{
+    const char* found = control_findValue(line, key);
+    char* end = NULL;
+    if(found == NULL)
+    {
+        return false;
+    }
+    *value = strtol(found, &end, 10);
+    return (end != found);
+}
+
+/*******************************************************************************
+ * @brief control_getBool
+ *
+ * Boolean value of key
+ *
+ * @param  > const char* : line
+ *         > const char* : key
+ *
+ * @return bool : true only if key is present and true
+ ******************************************************************************/
+static bool control_getBool(const char* line, const char* key)
+{
+    const char* found = control_findValue(line, key);
+    return (found != NULL) && (strncmp(found, "true", 4) == 0);
+}
+
+/*******************************************************************************
+ * @brief control_getSockets
+ *
+ * Array of socket numbers under key, e.g. [1, 2], as a bit per socket
+ *
+ * @param  > const char* : line
+ *         > const char* : key
+ *         > uint32_t* : sockets
+ *
+ * @return bool : false if absent, not an array or a socket doesn't exist
+ ******************************************************************************/
+static bool control_getSockets(const char* line, const char* key, uint32_t* sockets)
+{
+    const char* found = control_findValue(line, key);
+    if(found == NULL || *found != '[')
+    {
+        return false;
+    }
+    *sockets = 0;
+    for(found++; ; found++)
+    {
+        found += strspn(found, " \t");
+        if(*found == ']')
+        {
+            return true;
+        }
+        char* end = NULL;
+        long socket = strtol(found, &end, 10);
+        if(end == found || socket < 0 || socket >= SOCKET_COUNT)
+        {
+            return false;
+        }
+        *sockets |= 1u << socket;
+        found = end + strspn(end, " \t");
+        if(*found == ']')
+        {
+            return true;
+        }
+        if(*found != ',')
+        {
+            return false;
+        }
+    }
+}
+
+/*******************************************************************************
+ * @brief control_clone
+ *
+ * Clone request's socket onto its targets, by default every other socket
+ * holding a token with no job in flight. The master has already been checked.
+ *
+ * @param  > const CONTROL_Request_t* : request
+ *
+ * @return const char* : error text, NULL if the clone started
+ ******************************************************************************/
+static const char* control_clone(const CONTROL_Request_t* request)
+{
+    uint32_t targets = request->targets;
+    for(uint8_t socket = 0; socket < SOCKET_COUNT && request->targets == 0; socket++)
+    {
+        if(socket != request->socket && Token_IsSocketInserted(socket) && !Scheduler_IsSocketBusy(socket))
+        {
+            targets |= 1u << socket;
+        }
+    }
+    if(targets == 0)
+    {
+        return "no target tokens";
+    }
+    for(uint8_t socket = 0; socket < SOCKET_COUNT; socket++)
+    {
+        if((targets & (1u << socket)) == 0)
+        {
+            continue;
+        }
+        if(socket == request->socket)
+        {
+            return "master can't be a target";
+        }
+        if(!Token_IsSocketInserted(socket))
+        {
+            return "no token in target socket";
+        }
+        if(Scheduler_IsSocketBusy(socket))
+        {
+            return "target socket busy";
+        }
+    }
+    Scheduler_Clone(request->socket, targets);
+    return NULL;
+}
+
+// EOF
@@ -0,0 +1,43 @@
+/*******************************************************************************
+ *  @file Control.h
+ *
+ *  @brief Control socket. Clients on the Unix domain socket CONTROL_PATH
+ *         submit jobs, select images, read status and subscribe to progress
+ *         with line-delimited JSON.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _CONTROL_H_
+#define _CONTROL_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define CONTROL_CLIENT_MAX      8
+#define CONTROL_STREAM_PERIOD   TIMER_100MS     // progress is streamed to subscribers this often at most
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+// Open the control socket and start serving it. Call once @ startup after
+// Event_Init. The programmer runs without it if the socket can't be opened.
+void Control_Init(void);
+
+// Carry out the commands clients have queued (EVENT_CONTROL). Main thread.
+void Control_Service(void);
+
+#endif /* _CONTROL_H_ */
@@ -1,27 +1,70 @@
-#include <semaphore.h>
 #include "TypeDefs.h"
 #include <wiringPi.h>
 #include "Timer.h"
 #include <stdio.h>
 #include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <linux/gpio.h>
+#include "Token.h"
+#include "Event.h"
+#include "Socket.h"
 
-extern sem_t g_tokenSem;
-extern bool m_isInserted;
-extern bool m_isStatusChanged;
+#define DEBOUNCE_GPIOCHIP       "/dev/gpiochip0"
+#define DEBOUNCE_CONSUMER       "tok-lofo"
+#define DEBOUNCE_SETTLE_NS      ((uint64_t) TIMER_5MS * 1000000ULL) // line must be quiet this long after its last edge
+#define DEBOUNCE_EVENT_BURST    16
+#define DEBOUNCE_NS_PER_SEC     1000000000ULL
+#define DEBOUNCE_EPOLL_TIMER    0x100   // epoll tag: timer fd, low byte is socket
+#define DEBOUNCE_POLL_MS        TIMER_50MS  // LOFO without line events is sampled this often instead
+#define DEBOUNCE_DEBUG          0       // 1 reports how long each LOFO change took to settle
 
-#define DEBOUNCE_TIME_MS TIMER_50MS
-#define DEBOUNCE_TIMEOUT TIMER_200MS
+static int m_lineFd[SOCKET_COUNT];
+static int m_timerFd[SOCKET_COUNT];
+static uint64_t m_firstEdgeNs[SOCKET_COUNT];
+static uint64_t m_lastEdgeNs[SOCKET_COUNT];
+static uint32_t m_edgeCount[SOCKET_COUNT];
+static bool m_isPolled[SOCKET_COUNT];       // no line events: LOFO sampled with wiringPi
+static int m_polledLevel[SOCKET_COUNT];     // last sample, latched once the next agrees
 
-// Writes new status register
-static void debounce_inserting(void);
+// Request socket's LOFO as an edge-event line from the gpiochip character device
+static bool debounce_openLine(uint8_t socket);
 
-// Handles debounce if token is being removed
-static void debounce_removing(void);
+// Drain pending edges and re-arm the settle timer from the newest timestamp
+static void debounce_handleEdges(uint8_t socket);
+
+// Line has been quiet for the settle window. Latch the new state.
+static void debounce_settled(uint8_t socket);
+
+// Read current level of socket's LOFO from the kernel line handle
+static int debounce_readLevel(uint8_t socket);
+
+// Sample a LOFO that has no line events. Latch it once two samples agree.
+static void debounce_poll(uint8_t socket);
+
+// Now, on the same clock the kernel used to timestamp edge
+static uint64_t debounce_nowNs(uint64_t edgeNs);
+
+// Token seated, LOFO pulled low
+static void debounce_inserting(uint8_t socket);
+
+// Token pulled, LOFO released high
+static void debounce_removing(uint8_t socket);
 
 /*******************************************************************************
  * @brief Debounce_Main
  *
- * Run Debounce thread
+ * Run Debounce thread. Blocks in epoll until any socket's LOFO produces an
+ * edge, then waits for that line to stay quiet for DEBOUNCE_SETTLE_NS (measured
+ * from the kernel edge timestamp) before latching the new state. No CPU is
+ * used while idle. A socket whose line events can't be requested (no gpiochip
+ * character device, line claimed elsewhere) falls back to sampling its LOFO
+ * every DEBOUNCE_POLL_MS.
  *
  * @param  > None
  *
@@ -31,98 +74,278 @@ static void debounce_removing(void);
 void* Debounce_Main(void* a)
 {
     printf("Entering Debounce_Main\n");
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    bool isPolling = false;
+    for(uint8_t socket = 0; socket < SOCKET_COUNT; socket++)
+    {
+        if(!debounce_openLine(socket))
+        {
+            printf("socket %u LOFO falls back to polling every %u ms\n", socket, DEBOUNCE_POLL_MS);
+            m_isPolled[socket] = true;
+            m_polledLevel[socket] = -1;
+            isPolling = true;
+            continue;
+        }
+        struct epoll_event ev = {0};
+        ev.events = EPOLLIN;
+        ev.data.u32 = socket;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, m_lineFd[socket], &ev);
+        ev.data.u32 = DEBOUNCE_EPOLL_TIMER | socket;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, m_timerFd[socket], &ev);
+
+        // recognize if token is inserted @ startup
+        if(debounce_readLevel(socket) == 0)
+        {
+            debounce_inserting(socket);
+        }
+    }
+
+    uint32_t pollTick = Timer_GetTick();
     while(1)
     {
-        if(!digitalRead(LOFO) && !m_isInserted)
+        struct epoll_event events[2 * SOCKET_COUNT];
+        int n = epoll_wait(epollFd, events, 2 * SOCKET_COUNT, isPolling ? DEBOUNCE_POLL_MS : -1);
+        for(int i = 0; i < n; i++)
         {
-            debounce_inserting();
+            uint8_t socket = (uint8_t) (events[i].data.u32 & 0xFF);
+            if(events[i].data.u32 & DEBOUNCE_EPOLL_TIMER)
+            {
+                uint64_t expirations;
+                read(m_timerFd[socket], &expirations, sizeof(expirations));
+                debounce_settled(socket);
+            }
+            else
+            {
+                debounce_handleEdges(socket);
+            }
         }
-        else if(digitalRead(LOFO) && m_isInserted)
+        if(isPolling && Timer_TimeoutExpired(pollTick, DEBOUNCE_POLL_MS))
         {
-            debounce_removing();
+            pollTick = Timer_GetTick();
+            for(uint8_t socket = 0; socket < SOCKET_COUNT; socket++)
+            {
+                if(m_isPolled[socket])
+                {
+                    debounce_poll(socket);
+                }
+            }
         }
-        Timer_Sleep(50);
     }
     return 0;
 }
 
 /*******************************************************************************
- * @brief debounce_inserting
+ * @brief debounce_openLine
  *
- * Writes new status register
+ * Request socket's LOFO as an edge-event line from the gpiochip character device
  *
- * @param  > None
+ * @param  > uint8_t: socket
  *
- * @return None
+ * @return bool: true if line and settle timer are ready
  *
  ******************************************************************************/
-static void debounce_inserting(void)
+static bool debounce_openLine(uint8_t socket)
 {
-    printf("inserting\n");
-    uint32_t startTime = Timer_GetTick();
-    for(uint32_t i = 0; i < DEBOUNCE_TIME_MS; i++)
+    bool opened = false;
+    int chipFd = open(DEBOUNCE_GPIOCHIP, O_RDONLY | O_CLOEXEC);
+    if(chipFd >= 0)
     {
-        if(digitalRead(LOFO))
-        {
-            i = 0; // restart debounce
-        }
-        if(Timer_TimeoutExpired(startTime, DEBOUNCE_TIMEOUT))
+        struct gpioevent_request req;
+        memset(&req, 0, sizeof(req));
+        req.lineoffset = (uint32_t) Socket_GetLofoPin(socket);
+        req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+        req.eventflags = GPIOEVENT_REQUEST_BOTH_EDGES;
+        strncpy(req.consumer_label, DEBOUNCE_CONSUMER, sizeof(req.consumer_label) - 1);
+        if(ioctl(chipFd, GPIO_GET_LINEEVENT_IOCTL, &req) == 0)
         {
-            break;
+            m_lineFd[socket] = req.fd;
+            m_timerFd[socket] = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+            opened = (m_timerFd[socket] >= 0);
+            if(!opened)
+            {
+                close(req.fd);
+            }
         }
-        Timer_Sleep(TIMER_1MS);
+        close(chipFd);
+    }
+    if(!opened)
+    {
+        printf("Error, unable to request socket %u LOFO line events from %s\n", socket, DEBOUNCE_GPIOCHIP);
     }
-    if(!Timer_TimeoutExpired(startTime, DEBOUNCE_TIMEOUT) && !digitalRead(LOFO))
+    return opened;
+}
+
+/*******************************************************************************
+ * @brief debounce_handleEdges
+ *
+ * Drain pending edges and re-arm the settle timer from the newest timestamp.
+ * Every bounce pushes the deadline out; nothing is latched until it expires.
+ *
+ * @param  > uint8_t: socket
+ *
+ * @return None
+ *
+ ******************************************************************************/
+static void debounce_handleEdges(uint8_t socket)
+{
+    struct gpioevent_data events[DEBOUNCE_EVENT_BURST];
+    ssize_t len = read(m_lineFd[socket], events, sizeof(events));
+    uint32_t count = (len > 0) ? (uint32_t) (len / sizeof(events[0])) : 0;
+    if(count == 0)
     {
-	    printf("inserted\n");
-        sem_wait(&g_tokenSem);
-        m_isInserted = true;
-        m_isStatusChanged = true;
-        sem_post(&g_tokenSem);
-        digitalWrite(LED_TOKEN, 1);
+        return;
     }
-    else
+    if(m_edgeCount[socket] == 0)
     {
-        printf("insert failed\n");
+        m_firstEdgeNs[socket] = events[0].timestamp;
     }
+    m_edgeCount[socket] += count;
+    m_lastEdgeNs[socket] = events[count - 1].timestamp;
+
+    uint64_t quietNs = debounce_nowNs(m_lastEdgeNs[socket]) - m_lastEdgeNs[socket];
+    uint64_t remainingNs = (quietNs < DEBOUNCE_SETTLE_NS) ? (DEBOUNCE_SETTLE_NS - quietNs) : 1;
+    struct itimerspec its = {0};
+    its.it_value.tv_sec = (time_t) (remainingNs / DEBOUNCE_NS_PER_SEC);
+    its.it_value.tv_nsec = (long) (remainingNs % DEBOUNCE_NS_PER_SEC);
+    timerfd_settime(m_timerFd[socket], 0, &its, NULL);
 }
 
 /*******************************************************************************
- * @brief debounce_removing
+ * @brief debounce_settled
  *
- * Handles debounce if token is being removed
+ * Line has been quiet for the settle window. Latch the level the kernel reports
+ * now; the edges only tell us when to look.
  *
- * @param  > None
+ * @param  > uint8_t: socket
  *
  * @return None
  *
  ******************************************************************************/
-static void debounce_removing(void)
+static void debounce_settled(uint8_t socket)
 {
-    printf("removing\n");
-    uint32_t startTime = Timer_GetTick();
-    for(uint32_t i = 0; i < DEBOUNCE_TIME_MS; i++)
+    int level = debounce_readLevel(socket);
+    if(DEBOUNCE_DEBUG)
     {
-        if(!digitalRead(LOFO))
-        {
-            i = 0; // restart debounce
-        }
-        if(Timer_TimeoutExpired(startTime, DEBOUNCE_TIMEOUT))
-        {
-            break;
-        }
-        Timer_Sleep(1);
+        printf("socket %u LOFO settled %llu us after first edge (%u edges)\n", socket,
+            (unsigned long long) ((m_lastEdgeNs[socket] - m_firstEdgeNs[socket] + DEBOUNCE_SETTLE_NS) / 1000), m_edgeCount[socket]);
+    }
+    m_edgeCount[socket] = 0;
+    if(level == 0 && !Token_IsSocketInserted(socket))
+    {
+        debounce_inserting(socket);
+    }
+    else if(level == 1 && Token_IsSocketInserted(socket))
+    {
+        debounce_removing(socket);
+    }
+}
+
+/*******************************************************************************
+ * @brief debounce_readLevel
+ *
+ * Read current level of socket's LOFO from the kernel line handle
+ *
+ * @param  > uint8_t: socket
+ *
+ * @return int: 0 (token present) or 1 (no token). -1 on error
+ *
+ ******************************************************************************/
+static int debounce_readLevel(uint8_t socket)
+{
+    struct gpiohandle_data data;
+    memset(&data, 0, sizeof(data));
+    int level = -1;
+    if(ioctl(m_lineFd[socket], GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) == 0)
+    {
+        level = data.values[0] ? 1 : 0;
+    }
+    return level;
+}
+
+/*******************************************************************************
+ * @brief debounce_poll
+ *
+ * Sample a LOFO that has no line events, as tok did before them. A new level
+ * is latched once the next sample, DEBOUNCE_POLL_MS later, agrees with it.
+ *
+ * @param  > uint8_t: socket
+ *
+ * @return None
+ *
+ ******************************************************************************/
+static void debounce_poll(uint8_t socket)
+{
+    int level = digitalRead(Socket_GetLofoPin(socket)) ? 1 : 0;
+    if(level != m_polledLevel[socket])
+    {
+        m_polledLevel[socket] = level;
     }
-    if(!Timer_TimeoutExpired(startTime, DEBOUNCE_TIMEOUT) && digitalRead(LOFO))
+    else if(level == 0 && !Token_IsSocketInserted(socket))
     {
-        sem_wait(&g_tokenSem);
-        m_isInserted = false;
-        sem_post(&g_tokenSem);
-    	digitalWrite(LED_TOKEN, 0);
-        printf("removed\n");
+        debounce_inserting(socket);
     }
-    else
+    else if(level == 1 && Token_IsSocketInserted(socket))
     {
-        printf("remove failed\n");
+        debounce_removing(socket);
     }
 }
+
+/*******************************************************************************
+ * @brief debounce_nowNs
+ *
+ * Now, on the same clock the kernel used to timestamp edge. Kernels before 5.7
+ * stamp line events with CLOCK_REALTIME, later ones with CLOCK_MONOTONIC; pick
+ * whichever the edge is closest to.
+ *
+ * @param  > uint64_t: edge timestamp (ns)
+ *
+ * @return uint64_t: current time (ns)
+ *
+ ******************************************************************************/
+static uint64_t debounce_nowNs(uint64_t edgeNs)
+{
+    struct timespec mono;
+    struct timespec real;
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+    uint64_t monoNs = (uint64_t) mono.tv_sec * DEBOUNCE_NS_PER_SEC + (uint64_t) mono.tv_nsec;
+    uint64_t realNs = (uint64_t) real.tv_sec * DEBOUNCE_NS_PER_SEC + (uint64_t) real.tv_nsec;
+    uint64_t now = (realNs - edgeNs < monoNs - edgeNs) ? realNs : monoNs;
+    return (now > edgeNs) ? now : edgeNs;
+}
+
+/*******************************************************************************
+ * @brief debounce_inserting
+ *
+ * Token seated, LOFO pulled low
+ *
+ * @param  > uint8_t: socket
+ *
+ * @return None
+ *
+ ******************************************************************************/
+static void debounce_inserting(uint8_t socket)
+{
+    printf("socket %u inserted\n", socket);
+    Token_SetInserted(socket, true);
+    Socket_SetTokenLed(socket, true);
+    Event_Post(EVENT_TOKEN_INSERTED, socket);
+}
+
+/*******************************************************************************
+ * @brief debounce_removing
+ *
+ * Token pulled, LOFO released high
+ *
+ * @param  > uint8_t: socket
+ *
+ * @return None
+ *
+ ******************************************************************************/
+static void debounce_removing(uint8_t socket)
+{
+    Token_SetInserted(socket, false);
+    Socket_SetTokenLed(socket, false);
+    printf("socket %u removed\n", socket);
+    Event_Post(EVENT_TOKEN_REMOVED, socket);
+}
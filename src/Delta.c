@@ -0,0 +1,344 @@
+/*******************************************************************************
+ *  @file Delta.c
+ *
+ *  @brief Delta plans between image versions. The digest of every 64K sector
+ *  of each image loaded is kept in DELTA_PATH, one file per version. A token
+ *  whose journal records the version it holds can then be upgraded by
+ *  rewriting only the sectors whose digests differ, with no readback of the
+ *  rest. Plans are built once per version pair and cached.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Module Includes
+#include "Delta.h"
+
+// Utility Includes
+
+// Driver Includes
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define DELTA_MAGIC             0x44544B54  // "TKTD"
+#define DELTA_PATH_LEN          128
+#define DELTA_SECTOR_UNKNOWN    0           // sector digest of a hole: never written, content unknown
+
+
+/*******************************************************************************
+ * Data Types Declarations
+ ******************************************************************************/
+
+// Sector digests of one image version, as kept on disk
+typedef struct
+{
+    uint32_t magic;
+    uint32_t len;
+    uint64_t digest;
+    uint64_t sectors[TOKEN_FLASH_SECTOR_COUNT];
+} DELTA_Digests_t;
+
+static DELTA_Digests_t m_current;   // image last added
+static DELTA_Digests_t m_from;      // version being planned from
+static DELTA_Plan_t m_plans[DELTA_CACHE_SIZE];
+static uint32_t m_uses = 0;
+static uint32_t m_hits = 0;
+static uint32_t m_misses = 0;
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Build the digest file path for version digest
+static void delta_getPath(char* path, uint64_t digest, const char* suffix);
+
+// Load the sector digests of version digest. False if never recorded.
+static bool delta_load(uint64_t digest, DELTA_Digests_t* digests);
+
+// Sector digests of image, reusing from's for sectors changed doesn't flag
+static void delta_digest(const IMAGE_t* image, const DELTA_Digests_t* from, const uint8_t* changed,
+    DELTA_Digests_t* digests);
+
+// Persist digests. Temp file and rename, like the journal.
+static void delta_save(const DELTA_Digests_t* digests);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Delta_AddImage
+ *
+ * Record image's sector digests so tokens holding it can later be upgraded by
+ * delta. Versions already on disk are read back rather than hashed again.
+ *
+ * @param  > const IMAGE_t* : image
+ *
+ * @return None
+ ******************************************************************************/
+void Delta_AddImage(const IMAGE_t* image)
+{
+    if(m_current.magic == DELTA_MAGIC && m_current.digest == image->digest && m_current.len == image->len)
+    {
+        return;
+    }
+    if(!delta_load(image->digest, &m_current) || m_current.len != image->len)
+    {
+        delta_digest(image, NULL, NULL, &m_current);
+        delta_save(&m_current);
+    }
+}
+
+/*******************************************************************************
+ * @brief Delta_Prepare
+ *
+ * Write image's sector digests ahead of its first use, so the hashing is done
+ * before the image goes live. A hint from the file sync names the sectors
+ * that changed since a version already recorded; the others take that
+ * version's digests unhashed. Touches no module state, so it's safe off the
+ * main thread.
+ *
+ * @param  > const IMAGE_t* : image, complete
+ *         > const DELTA_Hint_t* : changed sectors, NULL to hash them all
+ *
+ * @return None
+ ******************************************************************************/
+void Delta_Prepare(const IMAGE_t* image, const DELTA_Hint_t* hint)
+{
+    char path[DELTA_PATH_LEN];
+    delta_getPath(path, image->digest, "");
+    DELTA_Digests_t* digests = malloc(2 * sizeof(DELTA_Digests_t));
+    if(digests != NULL && access(path, F_OK) != 0)
+    {
+        DELTA_Digests_t* from = &digests[1];
+        bool isHinted = (hint != NULL) && delta_load(hint->fromDigest, from) && (from->len == hint->fromLen);
+        delta_digest(image, isHinted ? from : NULL, isHinted ? hint->changed : NULL, digests);
+        delta_save(digests);
+    }
+    free(digests);
+}
+
+/*******************************************************************************
+ * @brief Delta_GetPlan
+ *
+ * Plan taking a token holding version fromDigest to image. A sector is
+ * rewritten if its digest differs or the old image didn't reach it or left it
+ * unwritten; every other sector already holds the new image and is left
+ * alone, as are the new image's holes. Pages are counted in the part's own
+ * page size, so plans are cached per page size too.
+ *
+ * @param  > uint64_t : digest of the version on the token
+ *         > uint32_t : length of that version
+ *         > const IMAGE_t* : image to upgrade to
+ *         > uint32_t : page length of the part
+ *
+ * @return const DELTA_Plan_t* : plan, NULL if the old version is unknown. Valid
+ *         until the next call.
+ ******************************************************************************/
+const DELTA_Plan_t* Delta_GetPlan(uint64_t fromDigest, uint32_t fromLen, const IMAGE_t* image, uint32_t pageLen)
+{
+    DELTA_Plan_t* plan = &m_plans[0];
+    for(uint32_t i = 0; i < DELTA_CACHE_SIZE; i++)
+    {
+        if(m_plans[i].fromDigest == fromDigest && m_plans[i].toDigest == image->digest && m_plans[i].pageLen == pageLen
+            && m_plans[i].sectorCount > 0)
+        {
+            m_hits++;
+            m_plans[i].lastUse = ++m_uses;
+            return &m_plans[i];
+        }
+        if(m_plans[i].lastUse < plan->lastUse)
+        {
+            plan = &m_plans[i];
+        }
+    }
+
+    m_misses++;
+    Delta_AddImage(image);
+    if(!delta_load(fromDigest, &m_from) || m_from.len != fromLen)
+    {
+        return NULL;
+    }
+
+    memset(plan, 0, sizeof(DELTA_Plan_t));
+    plan->fromDigest = fromDigest;
+    plan->toDigest = image->digest;
+    plan->pageLen = pageLen;
+    plan->sectorCount = MIN((image->len + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN, TOKEN_FLASH_SECTOR_COUNT);
+    uint32_t fromCount = (fromLen + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN;
+    for(uint32_t sector = 0; sector < plan->sectorCount; sector++)
+    {
+        if((sector < fromCount && m_from.sectors[sector] == m_current.sectors[sector]
+            && m_from.sectors[sector] != DELTA_SECTOR_UNKNOWN) || m_current.sectors[sector] == DELTA_SECTOR_UNKNOWN)
+        {
+            continue;
+        }
+        plan->changed[sector / 8] |= (uint8_t) (1 << (sector % 8));
+        plan->changedCount++;
+        uint32_t end = MIN((sector + 1) * TOKEN_FLASH_SECTOR_LEN, image->len);
+        for(uint32_t address = sector * TOKEN_FLASH_SECTOR_LEN; address < end; address += pageLen)
+        {
+            plan->pageCount += Image_IsBlank(image->data + address, MIN(pageLen, end - address)) ? 0 : 1;
+        }
+    }
+    plan->lastUse = ++m_uses;
+    return plan;
+}
+
+/*******************************************************************************
+ * @brief Delta_GetStats
+ *
+ * Plan cache hits and misses since startup. A miss is any plan that had to be
+ * built, or couldn't be for want of the old version's digests.
+ *
+ * @param  > uint32_t* : hits
+ *         > uint32_t* : misses
+ *
+ * @return None
+ ******************************************************************************/
+void Delta_GetStats(uint32_t* hits, uint32_t* misses)
+{
+    *hits = m_hits;
+    *misses = m_misses;
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief delta_getPath
+ *
+ * Build the digest file path for version digest
+ *
+ * @param  > char* : path buffer of DELTA_PATH_LEN
+ *         > uint64_t : image digest
+ *         > const char* : suffix appended to the file name
+ *
+ * @return None
+ ******************************************************************************/
+static void delta_getPath(char* path, uint64_t digest, const char* suffix)
+{
+    snprintf(path, DELTA_PATH_LEN, "%s/%016llX.sec%s", DELTA_PATH, (unsigned long long) digest, suffix);
+}
+
+/*******************************************************************************
+ * @brief delta_digest
+ *
+ * Sector digests of image. A sector made only of holes is never written, so
+ * what a token holds there is unknown. Given an earlier version and the
+ * sectors that changed since, a sector the two share in full keeps its digest
+ * from that version instead of being hashed.
+ *
+ * @param  > const IMAGE_t* : image, complete
+ *         > const DELTA_Digests_t* : earlier version, NULL to hash every sector
+ *         > const uint8_t* : bitmap of sectors changed since from
+ *         > DELTA_Digests_t* : digests to populate
+ *
+ * @return None
+ ******************************************************************************/
+static void delta_digest(const IMAGE_t* image, const DELTA_Digests_t* from, const uint8_t* changed,
+    DELTA_Digests_t* digests)
+{
+    memset(digests, 0, sizeof(DELTA_Digests_t));
+    digests->magic = DELTA_MAGIC;
+    digests->len = image->len;
+    digests->digest = image->digest;
+    uint32_t sectorCount = (image->len + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN;
+    for(uint32_t sector = 0; sector < MIN(sectorCount, TOKEN_FLASH_SECTOR_COUNT); sector++)
+    {
+        uint32_t start = sector * TOKEN_FLASH_SECTOR_LEN;
+        uint32_t len = MIN(TOKEN_FLASH_SECTOR_LEN, image->len - start);
+        if(from != NULL && (changed[sector / 8] & (1 << (sector % 8))) == 0
+            && start + len <= from->len && (len == TOKEN_FLASH_SECTOR_LEN || start + len == from->len))
+        {
+            digests->sectors[sector] = from->sectors[sector];
+            continue;
+        }
+        digests->sectors[sector] = (Image_GetClass(image, start, len) == IMAGE_CLASS_HOLE) ? DELTA_SECTOR_UNKNOWN :
+            Image_Digest(IMAGE_DIGEST_SEED, image->data + start, len);
+    }
+}
+
+/*******************************************************************************
+ * @brief delta_load
+ *
+ * Load the sector digests of version digest
+ *
+ * @param  > uint64_t : image digest
+ *         > DELTA_Digests_t* : digests to populate
+ *
+ * @return bool : false if the version was never recorded
+ ******************************************************************************/
+static bool delta_load(uint64_t digest, DELTA_Digests_t* digests)
+{
+    bool isLoaded = false;
+    char path[DELTA_PATH_LEN];
+    delta_getPath(path, digest, "");
+    FILE* fp = fopen(path, "rb");
+    if(fp != NULL)
+    {
+        isLoaded = (fread(digests, sizeof(DELTA_Digests_t), 1, fp) == 1)
+            && (digests->magic == DELTA_MAGIC)
+            && (digests->digest == digest);
+        fclose(fp);
+    }
+    return isLoaded;
+}
+
+/*******************************************************************************
+ * @brief delta_save
+ *
+ * Persist digests. Written to a temp file and renamed so a power cut never
+ * leaves a torn file behind.
+ *
+ * @param  > const DELTA_Digests_t* : digests
+ *
+ * @return None
+ ******************************************************************************/
+static void delta_save(const DELTA_Digests_t* digests)
+{
+    char path[DELTA_PATH_LEN];
+    char tmpPath[DELTA_PATH_LEN];
+    delta_getPath(path, digests->digest, "");
+    delta_getPath(tmpPath, digests->digest, ".tmp");
+    mkdir(DELTA_PATH, 0755);
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd >= 0)
+    {
+        bool isWritten = (write(fd, digests, sizeof(DELTA_Digests_t)) == (ssize_t) sizeof(DELTA_Digests_t));
+        fsync(fd);
+        close(fd);
+        if(isWritten)
+        {
+            rename(tmpPath, path);
+        }
+    }
+    else
+    {
+        printf("Error, unable to write sector digests %s\n", tmpPath);
+    }
+}
+
+// EOF
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ *  @file Delta.h
+ *
+ *  @brief Delta plans between image versions. Every image loaded has its
+ *         sector digests kept on disk, so once a token's current version is
+ *         known the sectors an upgrade must rewrite are known without reading
+ *         the token. Plans are cached per version pair.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _DELTA_H_
+#define _DELTA_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+#include "TokenFlash.h"
+#include "Image.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define DELTA_CACHE_SIZE        8       // version pairs kept planned
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+// Sectors to rewrite taking a token from one image version to another
+typedef struct
+{
+    uint64_t fromDigest;
+    uint64_t toDigest;
+    uint32_t sectorCount;       // sectors in the new image
+    uint32_t changedCount;      // sectors to erase and program
+    uint32_t pageLen;           // page size pageCount counts in
+    uint32_t pageCount;         // pages to program, blank pages of changed sectors excluded
+    uint8_t  changed[TOKEN_FLASH_SECTOR_COUNT / 8];
+    uint32_t lastUse;           // cache age
+} DELTA_Plan_t;
+
+// Sectors a file sync found changed between the version a token may hold and
+// a raw image read from the same file. The rest are known to be identical.
+typedef struct
+{
+    uint64_t fromDigest;
+    uint32_t fromLen;
+    uint8_t  changed[TOKEN_FLASH_SECTOR_COUNT / 8];
+} DELTA_Hint_t;
+
+// Record image's sector digests so tokens holding it can later be upgraded by
+// delta. Call for every image loaded.
+void Delta_AddImage(const IMAGE_t* image);
+
+// Write image's sector digests ahead of its first use so planning from it
+// finds them on disk. With a hint only its changed sectors are hashed. Safe
+// off the main thread; image must be complete.
+void Delta_Prepare(const IMAGE_t* image, const DELTA_Hint_t* hint);
+
+// Plan taking a token holding version fromDigest (fromLen bytes) to image,
+// counting pages of pageLen. NULL if that version's sector digests are
+// unknown. Valid until the next call.
+const DELTA_Plan_t* Delta_GetPlan(uint64_t fromDigest, uint32_t fromLen, const IMAGE_t* image, uint32_t pageLen);
+
+// Plan cache hits and misses since startup
+void Delta_GetStats(uint32_t* hits, uint32_t* misses);
+
+#endif /* _DELTA_H_ */
@@ -0,0 +1,513 @@
+/*******************************************************************************
+ *  @file Dump.c
+ *
+ *  @brief Token dump. The scheduler reads the token one DUMP_READ_LEN
+ *  transfer per step with the part's fastest read, like any other job, into
+ *  a ring of DUMP_BUFFER_LEN buffers. A writer thread per dump takes each full
+ *  buffer, digests its sectors, compresses it if asked and writes it out in
+ *  one go, so the bus never waits on the disk or the compressor unless the
+ *  whole ring is full.
+ *
+ *  The dump is written to a temp file and renamed once complete, alongside
+ *  NAME.sectors: the part, its unique ID, the FNV-1a 64 digest of the whole
+ *  token and of each 64K sector (the digests DELTA_PATH keeps for images).
+ *  Compressed dumps are a single zstd frame recording its content size, so
+ *  they load as images as they are.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zstd.h>
+
+// Module Includes
+#include "Dump.h"
+#include "Image.h"
+
+// Utility Includes
+
+// Driver Includes
+#include "Timer.h"
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define DUMP_STAMP_LEN          16
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Writer thread: digest, compress and write each buffer as it fills
+static void* dump_write(void* arg);
+
+// Write len bytes of buf to fd, false on any error
+static bool dump_writeAll(int fd, const uint8_t* buf, uint32_t len);
+
+// Compress in into out, writing out to fd each time it fills. ZSTD_e_end
+// finishes the frame and writes what is left.
+static bool dump_compress(ZSTD_CCtx* cctx, ZSTD_inBuffer* in, ZSTD_outBuffer* out, ZSTD_EndDirective mode, int fd);
+
+// Write NAME.sectors. Temp file and rename.
+static bool dump_writeDigests(const DUMP_Job_t* job, uint64_t digest, const uint64_t* sectors, uint32_t sectorCount);
+
+// Build path of the file name + suffix in DUMP_PATH
+static void dump_getPath(char* path, const DUMP_Job_t* job, const char* suffix);
+
+// Stop the writer, release the buffers and end job with err
+static void dump_finish(DUMP_Job_t* job, TOKEN_ErrCode_t err);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Dump_Start
+ *
+ * Start dumping the token in socket to DUMP_PATH/SOCKET-YYYYMMDD-HHMMSS.bin
+ * (.bin.zst compressed). The writer thread is started here and waits for the
+ * first buffer.
+ *
+ * @param  > DUMP_Job_t* : job
+ *         > uint8_t : socket
+ *         > bool : compress with zstd
+ *
+ * @return bool : false if the buffers or the writer couldn't be made
+ ******************************************************************************/
+bool Dump_Start(DUMP_Job_t* job, uint8_t socket, bool isCompressed)
+{
+    memset(job, 0, sizeof(DUMP_Job_t));
+    job->socket = socket;
+    job->isCompressed = isCompressed;
+    job->startTick = Timer_GetTick();
+    Token_SelectSocket(socket);
+    job->device = TokenDevice_Get();
+    job->len = job->device->size;
+    job->hasUid = TokenFlash_ReadUniqueId(job->uid);
+    job->bufferCount = (job->len + DUMP_BUFFER_LEN - 1) / DUMP_BUFFER_LEN;
+
+    char stamp[DUMP_STAMP_LEN];
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+    snprintf(job->name, DUMP_NAME_LEN, "%u-%s.bin%s", socket, stamp, isCompressed ? ".zst" : "");
+
+    bool isOk = (job->len > 0);
+    for(uint32_t i = 0; isOk && i < DUMP_BUFFER_COUNT; i++)
+    {
+        job->buffers[i] = malloc(DUMP_BUFFER_LEN);
+        isOk = (job->buffers[i] != NULL);
+    }
+    if(isOk)
+    {
+        pthread_mutex_init(&job->lock, NULL);
+        pthread_cond_init(&job->isFilled, NULL);
+        isOk = (pthread_create(&job->writer, NULL, dump_write, job) == 0);
+        if(!isOk)
+        {
+            pthread_cond_destroy(&job->isFilled);
+            pthread_mutex_destroy(&job->lock);
+        }
+    }
+    if(!isOk)
+    {
+        printf("Error, unable to start dump of socket %u\n", socket);
+        for(uint32_t i = 0; i < DUMP_BUFFER_COUNT; i++)
+        {
+            free(job->buffers[i]);
+        }
+        job->isDone = true;
+        job->err = TOKEN_ERR_INVALID_INPUT;
+    }
+    return isOk;
+}
+
+/*******************************************************************************
+ * @brief Dump_Step
+ *
+ * Read the next transfer into the current buffer, handing the buffer to the
+ * writer once it is full. Once the last buffer is handed over the job ends
+ * when the writer does.
+ *
+ * @param  > DUMP_Job_t* : job
+ *
+ * @return bool : true if a transfer was made
+ ******************************************************************************/
+bool Dump_Step(DUMP_Job_t* job)
+{
+    if(job->isDone)
+    {
+        return false;
+    }
+    if(atomic_load(&job->isWriterDone))
+    {
+        dump_finish(job, job->isWritten ? TOKEN_ERR_OK : TOKEN_ERR_INVALID_INPUT);
+        return false;
+    }
+    uint32_t index = job->address / DUMP_BUFFER_LEN;
+    if(job->address >= job->len || index - atomic_load(&job->written) >= DUMP_BUFFER_COUNT)
+    {
+        return false;
+    }
+
+    uint8_t* buf = job->buffers[index % DUMP_BUFFER_COUNT] + (job->address % DUMP_BUFFER_LEN);
+    uint32_t len = MIN(DUMP_READ_LEN, job->len - job->address);
+    TOKEN_ErrCode_t err = TokenFlash_Read(job->address, buf, len);
+    if(err != TOKEN_ERR_OK)
+    {
+        printf("socket %u dump read failed at 0x%08X\n", job->socket, job->address);
+        dump_finish(job, err);
+        return true;
+    }
+    job->address += len;
+    if((job->address % DUMP_BUFFER_LEN) == 0 || job->address == job->len)
+    {
+        pthread_mutex_lock(&job->lock);
+        atomic_store(&job->filled, index + 1);
+        pthread_cond_signal(&job->isFilled);
+        pthread_mutex_unlock(&job->lock);
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief Dump_Cancel
+ *
+ * Abandon job. The writer removes the partial file.
+ *
+ * @param  > DUMP_Job_t* : job
+ *
+ * @return None
+ ******************************************************************************/
+void Dump_Cancel(DUMP_Job_t* job)
+{
+    if(!job->isDone)
+    {
+        dump_finish(job, TOKEN_ERR_ABORTED);
+    }
+}
+
+/*******************************************************************************
+ * @brief Dump_IsDone
+ *
+ * Determine if job has finished
+ *
+ * @param  > const DUMP_Job_t* : job
+ *
+ * @return bool
+ ******************************************************************************/
+bool Dump_IsDone(const DUMP_Job_t* job)
+{
+    return job->isDone;
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief dump_write
+ *
+ * Writer thread. Waits for each buffer in turn, digests its sectors, writes it
+ * (through zstd if asked) and gives it back. Once the last is written the
+ * file is synced, the digests written and both renamed into place. On a
+ * failure or cancel the temp file is removed and the rest are not waited for.
+ *
+ * @param  > void* : DUMP_Job_t*
+ *
+ * @return void* : NULL
+ ******************************************************************************/
+static void* dump_write(void* arg)
+{
+    DUMP_Job_t* job = arg;
+    char path[DUMP_PATH_LEN];
+    char tmpPath[DUMP_PATH_LEN];
+    dump_getPath(path, job, "");
+    dump_getPath(tmpPath, job, ".tmp");
+    mkdir(DUMP_PATH, 0755);
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    uint32_t sectorCount = (job->len + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN;
+    uint64_t* sectors = malloc(sectorCount * sizeof(uint64_t));
+    uint64_t digest = IMAGE_DIGEST_SEED;
+    ZSTD_CCtx* cctx = NULL;
+    ZSTD_outBuffer out = { NULL, DUMP_BUFFER_LEN, 0 };
+    if(job->isCompressed)
+    {
+        cctx = ZSTD_createCCtx();
+        out.dst = malloc(DUMP_BUFFER_LEN);
+        if(cctx != NULL)
+        {
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, DUMP_ZSTD_LEVEL);
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+            ZSTD_CCtx_setPledgedSrcSize(cctx, job->len);
+        }
+    }
+    bool isOk = (fd >= 0) && (sectors != NULL) && (!job->isCompressed || (cctx != NULL && out.dst != NULL));
+    if(!isOk)
+    {
+        printf("Error, unable to create dump %s\n", tmpPath);
+    }
+
+    for(uint32_t index = 0; isOk && index < job->bufferCount; index++)
+    {
+        pthread_mutex_lock(&job->lock);
+        while(atomic_load(&job->filled) <= index && !atomic_load(&job->isCancelled))
+        {
+            pthread_cond_wait(&job->isFilled, &job->lock);
+        }
+        pthread_mutex_unlock(&job->lock);
+        if(atomic_load(&job->isCancelled))
+        {
+            isOk = false;
+            break;
+        }
+
+        const uint8_t* buf = job->buffers[index % DUMP_BUFFER_COUNT];
+        uint32_t start = index * DUMP_BUFFER_LEN;
+        uint32_t len = MIN(DUMP_BUFFER_LEN, job->len - start);
+        for(uint32_t offset = 0; offset < len; offset += TOKEN_FLASH_SECTOR_LEN)
+        {
+            sectors[(start + offset) / TOKEN_FLASH_SECTOR_LEN] =
+                Image_Digest(IMAGE_DIGEST_SEED, buf + offset, MIN(TOKEN_FLASH_SECTOR_LEN, len - offset));
+        }
+        digest = Image_Digest(digest, buf, len);
+        if(job->isCompressed)
+        {
+            ZSTD_inBuffer in = { buf, len, 0 };
+            isOk = dump_compress(cctx, &in, &out, ZSTD_e_continue, fd);
+        }
+        else
+        {
+            isOk = dump_writeAll(fd, buf, len);
+        }
+        atomic_store(&job->written, index + 1);
+        if(!isOk)
+        {
+            printf("Error, unable to write dump %s\n", tmpPath);
+        }
+    }
+
+    if(isOk && job->isCompressed)
+    {
+        ZSTD_inBuffer in = { NULL, 0, 0 };
+        isOk = dump_compress(cctx, &in, &out, ZSTD_e_end, fd);
+    }
+    if(isOk)
+    {
+        isOk = (fdatasync(fd) == 0);
+    }
+    if(fd >= 0)
+    {
+        close(fd);
+    }
+    if(isOk)
+    {
+        isOk = dump_writeDigests(job, digest, sectors, sectorCount) && (rename(tmpPath, path) == 0);
+    }
+    if(!isOk)
+    {
+        unlink(tmpPath);
+    }
+
+    ZSTD_freeCCtx(cctx);
+    free(out.dst);
+    free(sectors);
+    job->isWritten = isOk;
+    atomic_store(&job->isWriterDone, true);
+    return NULL;
+}
+
+/*******************************************************************************
+ * @brief dump_writeAll
+ *
+ * Write len bytes of buf to fd, retrying short writes
+ *
+ * @param  > int : fd
+ *         > const uint8_t* : buffer
+ *         > uint32_t : length
+ *
+ * @return bool : false on any error
+ ******************************************************************************/
+static bool dump_writeAll(int fd, const uint8_t* buf, uint32_t len)
+{
+    while(len > 0)
+    {
+        ssize_t count = write(fd, buf, len);
+        if(count <= 0)
+        {
+            return false;
+        }
+        buf += count;
+        len -= (uint32_t) count;
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief dump_compress
+ *
+ * Feed in to the compressor. out is written to fd whenever it fills, so each
+ * write is a whole DUMP_BUFFER_LEN; ZSTD_e_end flushes the frame and writes
+ * the remainder.
+ *
+ * @param  > ZSTD_CCtx* : compressor
+ *         > ZSTD_inBuffer* : input
+ *         > ZSTD_outBuffer* : output buffer, carried between calls
+ *         > ZSTD_EndDirective : ZSTD_e_continue or ZSTD_e_end
+ *         > int : fd
+ *
+ * @return bool : false on a compressor or write error
+ ******************************************************************************/
+static bool dump_compress(ZSTD_CCtx* cctx, ZSTD_inBuffer* in, ZSTD_outBuffer* out, ZSTD_EndDirective mode, int fd)
+{
+    bool isOk = true;
+    size_t remaining = 1;
+    while(isOk && ((mode == ZSTD_e_end) ? (remaining > 0) : (in->pos < in->size)))
+    {
+        remaining = ZSTD_compressStream2(cctx, out, in, mode);
+        isOk = !ZSTD_isError(remaining);
+        if(isOk && out->pos == out->size)
+        {
+            isOk = dump_writeAll(fd, out->dst, (uint32_t) out->pos);
+            out->pos = 0;
+        }
+    }
+    if(isOk && mode == ZSTD_e_end && out->pos > 0)
+    {
+        isOk = dump_writeAll(fd, out->dst, (uint32_t) out->pos);
+        out->pos = 0;
+    }
+    return isOk;
+}
+
+/*******************************************************************************
+ * @brief dump_writeDigests
+ *
+ * Write NAME.sectors:
+ *
+ *      device Winbond W25Q64JV jedec EF4017 size 8388608 uid 0123456789ABCDEF
+ *      digest 1A2B3C4D5E6F7081
+ *      0 0123456789ABCDEF
+ *      1 ...
+ *
+ * uid is "-" for parts without one. Written to a temp file and renamed.
+ *
+ * @param  > const DUMP_Job_t* : job
+ *         > uint64_t : digest of the whole token
+ *         > const uint64_t* : sector digests
+ *         > uint32_t : sector count
+ *
+ * @return bool : false if it couldn't be written
+ ******************************************************************************/
+static bool dump_writeDigests(const DUMP_Job_t* job, uint64_t digest, const uint64_t* sectors, uint32_t sectorCount)
+{
+    char path[DUMP_PATH_LEN];
+    char tmpPath[DUMP_PATH_LEN];
+    dump_getPath(path, job, ".sectors");
+    dump_getPath(tmpPath, job, ".sectors.tmp");
+    FILE* fp = fopen(tmpPath, "w");
+    if(fp == NULL)
+    {
+        printf("Error, unable to write sector digests %s\n", tmpPath);
+        return false;
+    }
+    char uid[2 * TOKEN_FLASH_UNIQUE_ID_LEN + 1] = "-";
+    for(uint32_t i = 0; job->hasUid && i < TOKEN_FLASH_UNIQUE_ID_LEN; i++)
+    {
+        snprintf(uid + 2 * i, sizeof(uid) - 2 * i, "%02X", job->uid[i]);
+    }
+    fprintf(fp, "device %s jedec %06X size %u uid %s\n", job->device->name, job->device->jedecId, job->len, uid);
+    fprintf(fp, "digest %016llX\n", (unsigned long long) digest);
+    for(uint32_t sector = 0; sector < sectorCount; sector++)
+    {
+        fprintf(fp, "%u %016llX\n", sector, (unsigned long long) sectors[sector]);
+    }
+    bool isWritten = (fflush(fp) == 0) && (fsync(fileno(fp)) == 0);
+    isWritten &= (fclose(fp) == 0);
+    if(isWritten)
+    {
+        isWritten = (rename(tmpPath, path) == 0);
+    }
+    if(!isWritten)
+    {
+        unlink(tmpPath);
+    }
+    return isWritten;
+}
+
+/*******************************************************************************
+ * @brief dump_getPath
+ *
+ * Build DUMP_PATH/name + suffix
+ *
+ * @param  > char* : path buffer, DUMP_PATH_LEN long
+ *         > const DUMP_Job_t* : job
+ *         > const char* : suffix
+ *
+ * @return None
+ ******************************************************************************/
+static void dump_getPath(char* path, const DUMP_Job_t* job, const char* suffix)
+{
+    snprintf(path, DUMP_PATH_LEN, "%s/%s%s", DUMP_PATH, job->name, suffix);
+}
+
+/*******************************************************************************
+ * @brief dump_finish
+ *
+ * End job with err. A failed or abandoned dump cancels the writer, which
+ * removes its temp file; either way the writer is joined before the buffers
+ * it reads are freed. A dump the writer had already completed stands.
+ *
+ * @param  > DUMP_Job_t* : job
+ *         > TOKEN_ErrCode_t : result
+ *
+ * @return None
+ ******************************************************************************/
+static void dump_finish(DUMP_Job_t* job, TOKEN_ErrCode_t err)
+{
+    if(err != TOKEN_ERR_OK)
+    {
+        pthread_mutex_lock(&job->lock);
+        atomic_store(&job->isCancelled, true);
+        pthread_cond_signal(&job->isFilled);
+        pthread_mutex_unlock(&job->lock);
+    }
+    pthread_join(job->writer, NULL);
+    if(job->isWritten)
+    {
+        err = TOKEN_ERR_OK;
+    }
+    pthread_cond_destroy(&job->isFilled);
+    pthread_mutex_destroy(&job->lock);
+    for(uint32_t i = 0; i < DUMP_BUFFER_COUNT; i++)
+    {
+        free(job->buffers[i]);
+        job->buffers[i] = NULL;
+    }
+    job->err = err;
+    job->isDone = true;
+}
+
+// EOF
@@ -0,0 +1,84 @@
+/*******************************************************************************
+ *  @file Dump.h
+ *
+ *  @brief Token dump. Reads a whole token back to a file in DUMP_PATH, with
+ *         an optional zstd frame and a digest of every 64K sector, for
+ *         looking into field returns.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _DUMP_H_
+#define _DUMP_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include "Token.h"
+#include "TokenFlash.h"
+#include "TokenDevice.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define DUMP_BUFFER_LEN         0x100000    // handed to the writer at a time, whole sectors
+#define DUMP_BUFFER_COUNT       4           // buffers between the bus and the writer
+#define DUMP_READ_LEN           TOKEN_FLASH_SUBSECTOR_LEN   // one transfer, within spidev's default buffer
+#define DUMP_ZSTD_LEVEL         3
+#define DUMP_NAME_LEN           32
+#define DUMP_PATH_LEN           128
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+typedef struct
+{
+    uint8_t socket;
+    TOKEN_ErrCode_t err;
+    bool isDone;
+    bool isCompressed;
+    uint32_t len;           // bytes on the token
+    uint32_t address;       // next transfer
+    uint32_t startTick;
+    char name[DUMP_NAME_LEN];           // file name in DUMP_PATH
+    const TOKEN_Device_t* device;
+    uint8_t uid[TOKEN_FLASH_UNIQUE_ID_LEN];
+    bool hasUid;
+    uint8_t* buffers[DUMP_BUFFER_COUNT];
+    uint32_t bufferCount;   // buffers the whole token takes
+    atomic_uint filled;     // buffers handed to the writer
+    atomic_uint written;    // buffers the writer is done with
+    atomic_bool isCancelled;
+    atomic_bool isWriterDone;
+    bool isWritten;         // file in place, set by the writer before isWriterDone
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t isFilled;
+} DUMP_Job_t;
+
+// Start dumping the token in socket, just identified by TokenDevice_Identify,
+// to a new file. Selects socket. False if the file or buffers can't be made.
+bool Dump_Start(DUMP_Job_t* job, uint8_t socket, bool isCompressed);
+
+// Read the next transfer. Caller must have selected job's socket. Returns
+// false, without touching the bus, while the writer has every buffer.
+bool Dump_Step(DUMP_Job_t* job);
+
+// Abandon job (token removed, shutdown). The partial file is removed.
+void Dump_Cancel(DUMP_Job_t* job);
+
+// Determine if job has finished (file complete, or failed)
+bool Dump_IsDone(const DUMP_Job_t* job);
+
+#endif /* _DUMP_H_ */
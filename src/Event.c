@@ -0,0 +1,411 @@
+/*******************************************************************************
+ *  @file Event.c
+ *
+ *  @brief Main loop event queue. Producers (debounce thread, signals, inotify
+ *         on watched files) post events; the main thread blocks in epoll
+ *         until one arrives.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/inotify.h>
+
+// Module Includes
+#include "Event.h"
+
+// Utility Includes
+
+// Driver Includes
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define EVENT_QUEUE_LEN         32
+#define EVENT_WATCH_MAX         32
+#define EVENT_NAME_LEN          64
+#define EVENT_PATH_LEN          192
+#define EVENT_INOTIFY_MASK      (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE)
+
+static int m_epollFd = -1;
+static int m_eventFd = -1;
+static int m_signalFd = -1;
+static int m_inotifyFd = -1;
+
+
+/*******************************************************************************
+ * Data Types Declarations
+ ******************************************************************************/
+
+typedef struct
+{
+    EVENT_t event;
+    uint8_t socket;
+} EVENT_Msg_t;
+
+static pthread_mutex_t m_queueLock = PTHREAD_MUTEX_INITIALIZER;
+static EVENT_Msg_t m_queue[EVENT_QUEUE_LEN];
+static uint32_t m_head = 0;
+static uint32_t m_tail = 0;
+static uint32_t m_dropCount = 0;
+
+// Token changes are kept per socket rather than queued, so a bouncing or
+// repeatedly swapped token can't fill the queue: a removal still pending and
+// whether the latest state is inserted
+static bool m_isRemovePending[SOCKET_COUNT];
+static bool m_isInsertPending[SOCKET_COUNT];
+
+// A watched file: its name in the directory watch wd
+typedef struct
+{
+    int wd;
+    char name[EVENT_NAME_LEN];
+} EVENT_Watch_t;
+
+static EVENT_Watch_t m_watches[EVENT_WATCH_MAX];
+static uint32_t m_watchCount = 0;
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Pop the oldest queued event, EVENT_NONE if empty
+static EVENT_t event_pop(uint8_t* socket);
+
+// Pop a pending token change, EVENT_NONE if none. Call with the queue locked.
+static EVENT_t event_popToken(uint8_t* socket);
+
+// Translate a pending signal into an event
+static EVENT_t event_fromSignal(void);
+
+// Translate pending inotify events into an event
+static EVENT_t event_fromInotify(void);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Event_Init
+ *
+ * Create the event queue and route SIGINT/SIGTERM/SIGHUP and watched file
+ * changes into it. Signals are blocked here so every thread created
+ * afterwards inherits the mask and they are only ever delivered through the
+ * signalfd.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+void Event_Init(void)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    m_signalFd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    m_inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_eventFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_eventFd, &ev);
+    ev.data.fd = m_signalFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_signalFd, &ev);
+    ev.data.fd = m_inotifyFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_inotifyFd, &ev);
+}
+
+/*******************************************************************************
+ * @brief Event_WatchFile
+ *
+ * Post EVENT_IMAGE_UPDATED whenever the file at path is written and closed,
+ * renamed into place or deleted. The directory is watched rather than the
+ * file so a file replaced by rename, or not there yet, is still seen. Files
+ * already watched are ignored.
+ *
+ * @param  > const char* : path
+ *
+ * @return bool : false if its directory can't be watched
+ ******************************************************************************/
+bool Event_WatchFile(const char* path)
+{
+    char dir[EVENT_PATH_LEN];
+    const char* name = strrchr(path, '/');
+    if(name == NULL || (size_t) (name - path) >= sizeof(dir) || strlen(name + 1) >= EVENT_NAME_LEN)
+    {
+        return false;
+    }
+    snprintf(dir, sizeof(dir), "%.*s", (int) (name - path), path);
+    name++;
+    int wd = inotify_add_watch(m_inotifyFd, (dir[0] != '\0') ? dir : "/", EVENT_INOTIFY_MASK);
+    if(wd < 0)
+    {
+        return false;
+    }
+    for(uint32_t i = 0; i < m_watchCount; i++)
+    {
+        if(m_watches[i].wd == wd && strcmp(m_watches[i].name, name) == 0)
+        {
+            return true;
+        }
+    }
+    if(m_watchCount >= EVENT_WATCH_MAX)
+    {
+        return false;
+    }
+    m_watches[m_watchCount].wd = wd;
+    snprintf(m_watches[m_watchCount].name, EVENT_NAME_LEN, "%s", name);
+    m_watchCount++;
+    return true;
+}
+
+/*******************************************************************************
+ * @brief Event_Post
+ *
+ * Queue an event for socket and wake the main loop. Safe to call from any
+ * thread. Token insertions and removals are coalesced per socket: any number
+ * of changes since the main loop last looked make at most one
+ * EVENT_TOKEN_REMOVED followed by one EVENT_TOKEN_INSERTED if the token is in
+ * now. Other events are dropped, logged and counted if the queue is full.
+ *
+ * @param  > EVENT_t : event to post
+ *         > uint8_t : socket the event applies to
+ *
+ * @return None
+ ******************************************************************************/
+void Event_Post(EVENT_t event, uint8_t socket)
+{
+    bool queued = false;
+    uint32_t dropCount = 0;
+    pthread_mutex_lock(&m_queueLock);
+    if((event == EVENT_TOKEN_INSERTED || event == EVENT_TOKEN_REMOVED) && socket < SOCKET_COUNT)
+    {
+        if(event == EVENT_TOKEN_REMOVED)
+        {
+            m_isRemovePending[socket] = true;
+        }
+        m_isInsertPending[socket] = (event == EVENT_TOKEN_INSERTED);
+        queued = true;
+    }
+    else if((m_tail - m_head) < EVENT_QUEUE_LEN)
+    {
+        m_queue[m_tail % EVENT_QUEUE_LEN].event = event;
+        m_queue[m_tail % EVENT_QUEUE_LEN].socket = socket;
+        m_tail++;
+        queued = true;
+    }
+    else
+    {
+        dropCount = ++m_dropCount;
+    }
+    pthread_mutex_unlock(&m_queueLock);
+
+    if(queued)
+    {
+        uint64_t one = 1;
+        write(m_eventFd, &one, sizeof(one));
+    }
+    else
+    {
+        printf("Error, event queue full. Dropped event %d for socket %u (%u dropped)\n", event, socket, dropCount);
+    }
+}
+
+/*******************************************************************************
+ * @brief Event_Wait
+ *
+ * Block until an event is queued or timeoutMs expires
+ *
+ * @param  > int32_t : timeout (ms), EVENT_WAIT_FOREVER to block indefinitely
+ *         > uint8_t* : socket the event applies to
+ *
+ * @return EVENT_t : next event, EVENT_NONE on timeout
+ ******************************************************************************/
+EVENT_t Event_Wait(int32_t timeoutMs, uint8_t* socket)
+{
+    EVENT_t event = event_pop(socket);
+    while(event == EVENT_NONE)
+    {
+        struct epoll_event ev[3];
+        int n = epoll_wait(m_epollFd, ev, 3, timeoutMs);
+        if(n == 0)
+        {
+            break;
+        }
+        for(int i = 0; i < n; i++)
+        {
+            if(ev[i].data.fd == m_signalFd)
+            {
+                EVENT_t sigEvent = event_fromSignal();
+                if(sigEvent != EVENT_NONE)
+                {
+                    Event_Post(sigEvent, 0);
+                }
+            }
+            else if(ev[i].data.fd == m_inotifyFd)
+            {
+                if(event_fromInotify() != EVENT_NONE)
+                {
+                    Event_Post(EVENT_IMAGE_UPDATED, 0);
+                }
+            }
+            else
+            {
+                uint64_t count;
+                read(m_eventFd, &count, sizeof(count));
+            }
+        }
+        event = event_pop(socket);
+    }
+    return event;
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief event_pop
+ *
+ * Pop the oldest queued event, EVENT_NONE if empty
+ *
+ * @param  > uint8_t* : socket the event applies to
+ *
+ * @return EVENT_t
+ ******************************************************************************/
+static EVENT_t event_pop(uint8_t* socket)
+{
+    pthread_mutex_lock(&m_queueLock);
+    EVENT_t event = event_popToken(socket);
+    if(event == EVENT_NONE && m_head != m_tail)
+    {
+        event = m_queue[m_head % EVENT_QUEUE_LEN].event;
+        *socket = m_queue[m_head % EVENT_QUEUE_LEN].socket;
+        m_head++;
+    }
+    pthread_mutex_unlock(&m_queueLock);
+    return event;
+}
+
+/*******************************************************************************
+ * @brief event_popToken
+ *
+ * Pop a pending token change, EVENT_NONE if none. A removal goes first so a
+ * token swapped since the last look still stops the old job before the new
+ * one starts. Call with the queue locked.
+ *
+ * @param  > uint8_t* : socket the event applies to
+ *
+ * @return EVENT_t
+ ******************************************************************************/
+static EVENT_t event_popToken(uint8_t* socket)
+{
+    for(uint8_t i = 0; i < SOCKET_COUNT; i++)
+    {
+        if(m_isRemovePending[i])
+        {
+            m_isRemovePending[i] = false;
+            *socket = i;
+            return EVENT_TOKEN_REMOVED;
+        }
+        if(m_isInsertPending[i])
+        {
+            m_isInsertPending[i] = false;
+            *socket = i;
+            return EVENT_TOKEN_INSERTED;
+        }
+    }
+    return EVENT_NONE;
+}
+
+/*******************************************************************************
+ * @brief event_fromSignal
+ *
+ * Translate a pending signal into an event. SIGHUP forces the library to be
+ * reloaded; files the library uses are also watched directly.
+ *
+ * @param  > None
+ *
+ * @return EVENT_t
+ ******************************************************************************/
+static EVENT_t event_fromSignal(void)
+{
+    EVENT_t event = EVENT_NONE;
+    struct signalfd_siginfo info;
+    if(read(m_signalFd, &info, sizeof(info)) == sizeof(info))
+    {
+        if(info.ssi_signo == SIGHUP)
+        {
+            event = EVENT_IMAGE_UPDATED;
+        }
+        else
+        {
+            event = EVENT_SHUTDOWN;
+        }
+    }
+    return event;
+}
+
+/*******************************************************************************
+ * @brief event_fromInotify
+ *
+ * Translate pending inotify events into an event. Everything pending is read;
+ * any number of changes to watched files make one EVENT_IMAGE_UPDATED.
+ * Changes to other files in the same directories (temp files, journals) are
+ * ignored.
+ *
+ * @param  > None
+ *
+ * @return EVENT_t : EVENT_IMAGE_UPDATED or EVENT_NONE
+ ******************************************************************************/
+static EVENT_t event_fromInotify(void)
+{
+    EVENT_t event = EVENT_NONE;
+    uint8_t buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while((len = read(m_inotifyFd, buf, sizeof(buf))) > 0)
+    {
+        for(ssize_t pos = 0; pos < len; )
+        {
+            const struct inotify_event* info = (const struct inotify_event*) (buf + pos);
+            for(uint32_t i = 0; info->len > 0 && i < m_watchCount; i++)
+            {
+                if(m_watches[i].wd == info->wd && strcmp(m_watches[i].name, info->name) == 0)
+                {
+                    event = EVENT_IMAGE_UPDATED;
+                }
+            }
+            pos += (ssize_t) (sizeof(struct inotify_event) + info->len);
+        }
+    }
+    return event;
+}
+
+// EOF
@@ -0,0 +1,65 @@
+/*******************************************************************************
+ *  @file Event.h
+ *
+ *  @brief Main loop event queue. Producers (debounce thread, signals, the
+ *         control socket) post events; the main thread blocks in epoll until
+ *         one arrives.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _EVENT_H_
+#define _EVENT_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define EVENT_WAIT_FOREVER      (-1)
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+typedef enum
+{
+    EVENT_NONE,
+    EVENT_TOKEN_INSERTED,
+    EVENT_TOKEN_REMOVED,
+    EVENT_IMAGE_UPDATED,
+    EVENT_LIBRARY_STAGED,
+    EVENT_CONTROL,
+    EVENT_SHUTDOWN,
+    EVENT_COUNT
+} EVENT_t;
+
+// Create the event queue and route SIGINT/SIGTERM/SIGHUP into it. Call once
+// @ startup before any other thread is created.
+void Event_Init(void);
+
+// Post EVENT_IMAGE_UPDATED whenever the file at path is written and closed,
+// or renamed into place. Returns false if its directory can't be watched.
+bool Event_WatchFile(const char* path);
+
+// Queue an event for socket and wake the main loop. Safe to call from any
+// thread. socket is ignored by events that are not per-socket. Token
+// insertions and removals are coalesced per socket so they are never dropped;
+// other events are logged and counted if the queue is full.
+void Event_Post(EVENT_t event, uint8_t socket);
+
+// Block until an event is queued or timeoutMs expires (EVENT_WAIT_FOREVER to
+// block indefinitely, 0 to poll). Returns EVENT_NONE on timeout.
+EVENT_t Event_Wait(int32_t timeoutMs, uint8_t* socket);
+
+#endif /* _EVENT_H_ */
@@ -0,0 +1,971 @@
+/*******************************************************************************
+ *  @file Image.c
+ *
+ *  @brief Token image held in RAM for the programming engine
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zstd.h>
+#include <lz4frame.h>
+
+// Module Includes
+#include "Image.h"
+#include "Segment.h"
+
+// Utility Includes
+
+// Driver Includes
+#include "Timer.h"
+#include "TokenFlash.h"
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define IMAGE_FNV_PRIME         0x100000001B3ULL
+#define IMAGE_LZ4_FLG           4           // frame descriptor flag byte
+#define IMAGE_LZ4_FLG_CONTENT_SIZE 0x08     // frame records its content size
+#define IMAGE_LZ4_CONTENT_SIZE  6           // offset of the 8-byte content size
+#define IMAGE_LZ4_HEADER_LEN    14
+#define IMAGE_SPARSE_HEADER_LEN 16          // magic, version, header length, image length, chunk count
+#define IMAGE_SPARSE_CHUNK_LEN  12          // type, reserved, length, fill
+#define IMAGE_SPARSE_RAW        1           // length bytes follow
+#define IMAGE_SPARSE_FILL       2           // fill word repeated, least significant byte first
+#define IMAGE_SPARSE_HOLE       3           // don't care
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Read file at path, keeping a compressed file for the worker to decompress
+static IMAGE_ErrCode_t image_open(const char* path, IMAGE_t* image);
+
+// Size the image from its frame header and start the worker decompressing it
+static IMAGE_ErrCode_t image_startInflate(IMAGE_t* image);
+
+// Worker thread: decompress the image, publishing each chunk as it lands
+static void* image_inflate(void* arg);
+
+// Decompress zstd frames
+static bool image_inflateZstd(IMAGE_t* image);
+
+// Decompress an LZ4 frame
+static bool image_inflateLz4(IMAGE_t* image);
+
+// Build the image from a sparse container's chunks
+static IMAGE_ErrCode_t image_loadSparse(IMAGE_t* image, const uint8_t* file, uint32_t fileLen);
+
+// Little-endian field of a sparse container
+static uint32_t image_getLe(const uint8_t* buf, uint32_t len);
+
+// Build the image from an Intel HEX, S-record or ELF file's segments
+static IMAGE_ErrCode_t image_loadSegments(IMAGE_t* image, const uint8_t* file, uint32_t fileLen);
+
+// qsort order of chunks by offset
+static int image_compareChunks(const void* a, const void* b);
+
+// Demote the parts of holes that share an erase sector with data to BLANK
+static uint32_t image_alignHoles(IMAGE_t* image);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Image_Load
+ *
+ * Load file at path into RAM and compute its digest. A compressed file is
+ * decompressed in full before returning.
+ *
+ * @param  > const char* : path to image
+ *         > IMAGE_t* : image to populate
+ *
+ * @return IMAGE_ErrCode_t
+ ******************************************************************************/
+IMAGE_ErrCode_t Image_Load(const char* path, IMAGE_t* image)
+{
+    IMAGE_ErrCode_t err = image_open(path, image);
+    if(err == IMAGE_ERR_OK && image->hasWorker)
+    {
+        pthread_join(image->worker, NULL);
+        image->hasWorker = false;
+        if(Image_IsFailed(image))
+        {
+            err = IMAGE_ERR_FORMAT;
+            printf("Error %d loading image %s\n", err, path);
+            Image_Free(image);
+        }
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief Image_Free
+ *
+ * Release memory held by image. A decompression still running is stopped.
+ *
+ * @param  > IMAGE_t* : image
+ *
+ * @return None
+ ******************************************************************************/
+void Image_Free(IMAGE_t* image)
+{
+    if(image->hasWorker)
+    {
+        atomic_store(&image->isCancelled, true);
+        pthread_join(image->worker, NULL);
+        image->hasWorker = false;
+    }
+    free(image->packed);
+    image->packed = NULL;
+    free(image->chunks);
+    image->chunks = NULL;
+    image->chunkCount = 0;
+    free(image->sectorDigests);
+    image->sectorDigests = NULL;
+    free(image->data);
+    image->data = NULL;
+    image->len = 0;
+}
+
+/*******************************************************************************
+ * @brief Image_Open
+ *
+ * Load file at path into a shared, reference counted image (refCount = 1). A
+ * compressed file returns once its frame header is read; jobs program from
+ * the front of the image while the rest decompresses.
+ *
+ * @param  > const char* : path to image
+ *
+ * @return IMAGE_t* : image, NULL on failure
+ ******************************************************************************/
+IMAGE_t* Image_Open(const char* path)
+{
+    IMAGE_t* image = malloc(sizeof(IMAGE_t));
+    if(image != NULL)
+    {
+        if(image_open(path, image) == IMAGE_ERR_OK)
+        {
+            image->refCount = 1;
+        }
+        else
+        {
+            free(image);
+            image = NULL;
+        }
+    }
+    return image;
+}
+
+/*******************************************************************************
+ * @brief Image_OpenStream
+ *
+ * Shared image (refCount = 1) of len bytes that the caller streams in from
+ * the front, e.g. a master token being read for a clone. Only the last window
+ * bytes are held, in a ring; the caller must not write more than window bytes
+ * past the lowest address any job still needs. The digest is unknown until
+ * the caller sets it; the sector digests are filled in as it goes.
+ *
+ * @param  > uint32_t : len of the image
+ *         > uint32_t : window, a multiple of TOKEN_FLASH_SECTOR_LEN
+ *
+ * @return IMAGE_t* : image, NULL if out of memory
+ ******************************************************************************/
+IMAGE_t* Image_OpenStream(uint32_t len, uint32_t window)
+{
+    IMAGE_t* image = calloc(1, sizeof(IMAGE_t));
+    if(image != NULL)
+    {
+        image->len = len;
+        image->window = window;
+        image->refCount = 1;
+        image->data = malloc(window);
+        image->sectorDigests = calloc((len + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN, sizeof(uint64_t));
+        if(image->data == NULL || image->sectorDigests == NULL)
+        {
+            Image_Free(image);
+            free(image);
+            image = NULL;
+        }
+    }
+    return image;
+}
+
+/*******************************************************************************
+ * @brief Image_GetReady
+ *
+ * Bytes of data from the start that are ready to program
+ *
+ * @param  > IMAGE_t* : image
+ *
+ * @return uint32_t : len once complete
+ ******************************************************************************/
+uint32_t Image_GetReady(IMAGE_t* image)
+{
+    return atomic_load_explicit(&image->ready, memory_order_acquire);
+}
+
+/*******************************************************************************
+ * @brief Image_SetReady
+ *
+ * Streamed image: bytes from the start written so far. Published after the
+ * data itself, as the decompression worker does.
+ *
+ * @param  > IMAGE_t* : image
+ *         > uint32_t : ready
+ *
+ * @return None
+ ******************************************************************************/
+void Image_SetReady(IMAGE_t* image, uint32_t ready)
+{
+    atomic_store_explicit(&image->ready, ready, memory_order_release);
+}
+
+/*******************************************************************************
+ * @brief Image_SetFailed
+ *
+ * Streamed image: the rest of the data never comes. Jobs waiting on it fail.
+ *
+ * @param  > IMAGE_t* : image
+ *
+ * @return None
+ ******************************************************************************/
+void Image_SetFailed(IMAGE_t* image)
+{
+    atomic_store(&image->isFailed, true);
+}
+
+/*******************************************************************************
+ * @brief Image_GetData
+ *
+ * Image data at address. A streamed image holds only the last window bytes
+ * before Image_GetReady; whole sectors never wrap in its ring.
+ *
+ * @param  > const IMAGE_t* : image
+ *         > uint32_t : address
+ *
+ * @return uint8_t* : data
+ ******************************************************************************/
+uint8_t* Image_GetData(const IMAGE_t* image, uint32_t address)
+{
+    return image->data + ((image->window > 0) ? (address % image->window) : address);
+}
+
+/*******************************************************************************
+ * @brief Image_IsFailed
+ *
+ * Determine if decompression failed. Data beyond Image_GetReady never comes.
+ *
+ * @param  > IMAGE_t* : image
+ *
+ * @return bool
+ ******************************************************************************/
+bool Image_IsFailed(IMAGE_t* image)
+{
+    return atomic_load(&image->isFailed);
+}
+
+/*******************************************************************************
+ * @brief Image_Wait
+ *
+ * Block until image is fully decompressed. Joins the worker, so only for an
+ * image that no job holds yet; used to validate an image before it goes live.
+ *
+ * @param  > IMAGE_t* : image
+ *
+ * @return bool : false if decompression failed
+ ******************************************************************************/
+bool Image_Wait(IMAGE_t* image)
+{
+    if(image->hasWorker)
+    {
+        pthread_join(image->worker, NULL);
+        image->hasWorker = false;
+    }
+    return !Image_IsFailed(image);
+}
+
+/*******************************************************************************
+ * @brief Image_Acquire
+ *
+ * Take another reference to a shared image
+ *
+ * @param  > IMAGE_t* : image
+ *
+ * @return IMAGE_t* : image
+ ******************************************************************************/
+IMAGE_t* Image_Acquire(IMAGE_t* image)
+{
+    if(image != NULL)
+    {
+        image->refCount++;
+    }
+    return image;
+}
+
+/*******************************************************************************
+ * @brief Image_Release
+ *
+ * Drop a reference to a shared image, freeing it with the last one
+ *
+ * @param  > IMAGE_t* : image
+ *
+ * @return None
+ ******************************************************************************/
+void Image_Release(IMAGE_t* image)
+{
+    if(image != NULL && --image->refCount == 0)
+    {
+        Image_Free(image);
+        free(image);
+    }
+}
+
+/*******************************************************************************
+ * @brief Image_Digest
+ *
+ * FNV-1a 64 digest of buf, continuing from seed
+ *
+ * @param  > uint64_t : seed, IMAGE_DIGEST_SEED to start a new digest
+ *         > const uint8_t* : buffer
+ *         > uint32_t : length of buffer
+ *
+ * @return uint64_t : digest
+ ******************************************************************************/
+uint64_t Image_Digest(uint64_t seed, const uint8_t* buf, uint32_t len)
+{
+    uint64_t hash = seed;
+    for(uint32_t i = 0; i < len; i++)
+    {
+        hash ^= buf[i];
+        hash *= IMAGE_FNV_PRIME;
+    }
+    return hash;
+}
+
+/*******************************************************************************
+ * @brief Image_IsBlank
+ *
+ * Determine if len bytes of buf are all erased (0xFF)
+ *
+ * @param  > const uint8_t* : buffer
+ *         > uint32_t : length of buffer
+ *
+ * @return bool
+ ******************************************************************************/
+bool Image_IsBlank(const uint8_t* buf, uint32_t len)
+{
+    for(uint32_t i = 0; i < len; i++)
+    {
+        if(buf[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief Image_GetClass
+ *
+ * What [address, address + len) holds. A range of holes is a HOLE; holes and
+ * 0xFF fill is BLANK; anything else is DATA. Raw and compressed images are
+ * all DATA.
+ *
+ * @param  > const IMAGE_t* : image
+ *         > uint32_t : address
+ *         > uint32_t : len
+ *
+ * @return IMAGE_Class_t
+ ******************************************************************************/
+IMAGE_Class_t Image_GetClass(const IMAGE_t* image, uint32_t address, uint32_t len)
+{
+    if(image->chunks == NULL)
+    {
+        return IMAGE_CLASS_DATA;
+    }
+    uint32_t low = 0;
+    uint32_t high = image->chunkCount;
+    while(low < high)
+    {
+        uint32_t mid = (low + high) / 2;
+        if(image->chunks[mid].offset + image->chunks[mid].len <= address)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    IMAGE_Class_t type = IMAGE_CLASS_HOLE;
+    for(uint32_t i = low; i < image->chunkCount && image->chunks[i].offset < address + len; i++)
+    {
+        if(image->chunks[i].type == IMAGE_CLASS_DATA)
+        {
+            return IMAGE_CLASS_DATA;
+        }
+        if(image->chunks[i].type == IMAGE_CLASS_BLANK)
+        {
+            type = IMAGE_CLASS_BLANK;
+        }
+    }
+    return type;
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief image_open
+ *
+ * Read file at path and compute its digest. A raw file is the image. A sparse
+ * container is expanded at once; its fills cost no more reading. Intel HEX,
+ * S-record and ELF files are placed at their segments' addresses with the
+ * gaps between left as holes. A zstd or
+ * LZ4 framed file is kept as read and decompressed by a worker thread; jobs
+ * never wait on it, they hold off pages that aren't ready and let the bus
+ * serve other sockets. The card read is timed so the saving of a compressed
+ * file shows.
+ *
+ * @param  > const char* : path to image
+ *         > IMAGE_t* : image to populate
+ *
+ * @return IMAGE_ErrCode_t
+ ******************************************************************************/
+static IMAGE_ErrCode_t image_open(const char* path, IMAGE_t* image)
+{
+    IMAGE_ErrCode_t err = IMAGE_ERR_OPEN;
+    memset(image, 0, sizeof(IMAGE_t));
+    image->digest = IMAGE_DIGEST_SEED;
+    uint8_t* file = NULL;
+    uint32_t fileLen = 0;
+    uint32_t readTime = 0;
+    FILE* fp = fopen(path, "rb");
+    if(fp != NULL)
+    {
+        fseek(fp, 0, SEEK_END);
+        long len = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        err = IMAGE_ERR_NO_MEMORY;
+        file = (len > 0) ? malloc((size_t) len) : NULL;
+        if(file != NULL)
+        {
+            err = IMAGE_ERR_READ;
+            uint32_t start = Timer_GetTick();
+            if(fread(file, 1, (size_t) len, fp) == (size_t) len)
+            {
+                err = IMAGE_ERR_OK;
+                fileLen = (uint32_t) len;
+                readTime = Timer_GetTick() - start;
+                image->digest = Image_Digest(IMAGE_DIGEST_SEED, file, fileLen);
+            }
+        }
+        fclose(fp);
+    }
+
+    uint32_t magic = (fileLen >= 4) ? (file[0] | (file[1] << 8) | (file[2] << 16) | ((uint32_t) file[3] << 24)) : 0;
+    if(err == IMAGE_ERR_OK && magic == IMAGE_SPARSE_MAGIC)
+    {
+        err = image_loadSparse(image, file, fileLen);
+        free(file);
+        if(err == IMAGE_ERR_OK)
+        {
+            printf("image %s: read %u bytes in %u ms for the %u byte image\n", path, fileLen, readTime, image->len);
+        }
+    }
+    else if(err == IMAGE_ERR_OK && (magic == IMAGE_ZSTD_MAGIC || magic == IMAGE_LZ4_MAGIC))
+    {
+        image->magic = magic;
+        image->packed = file;
+        image->packedLen = fileLen;
+        err = image_startInflate(image);
+        if(err == IMAGE_ERR_OK)
+        {
+            printf("image %s: read %u bytes in %u ms, %u%% less than the %u byte image\n", path, fileLen, readTime,
+                (uint32_t) (100 - (100ULL * fileLen) / image->len), image->len);
+        }
+    }
+    else if(err == IMAGE_ERR_OK && Segment_GetFormat(file, fileLen) != SEGMENT_FORMAT_NONE)
+    {
+        err = image_loadSegments(image, file, fileLen);
+        free(file);
+        if(err == IMAGE_ERR_OK)
+        {
+            printf("image %s: read %u bytes in %u ms for the %u byte image\n", path, fileLen, readTime, image->len);
+        }
+    }
+    else if(err == IMAGE_ERR_OK)
+    {
+        image->data = file;
+        image->len = fileLen;
+        atomic_store(&image->ready, fileLen);
+        printf("image %s: read %u bytes in %u ms\n", path, fileLen, readTime);
+    }
+    else
+    {
+        free(file);
+    }
+    if(err != IMAGE_ERR_OK)
+    {
+        printf("Error %d loading image %s\n", err, path);
+        Image_Free(image);
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief image_startInflate
+ *
+ * Size the image from its frame header and start the worker decompressing it.
+ * The frame must record its content size: zstd does by default, lz4 needs
+ * --content-size.
+ *
+ * @param  > IMAGE_t* : image, packed set
+ *
+ * @return IMAGE_ErrCode_t
+ ******************************************************************************/
+static IMAGE_ErrCode_t image_startInflate(IMAGE_t* image)
+{
+    uint64_t len = 0;
+    if(image->magic == IMAGE_ZSTD_MAGIC)
+    {
+        unsigned long long size = ZSTD_getFrameContentSize(image->packed, image->packedLen);
+        len = (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) ? 0 : size;
+    }
+    else if(image->packedLen >= IMAGE_LZ4_HEADER_LEN && (image->packed[IMAGE_LZ4_FLG] & IMAGE_LZ4_FLG_CONTENT_SIZE))
+    {
+        for(uint32_t i = 0; i < 8; i++)
+        {
+            len |= (uint64_t) image->packed[IMAGE_LZ4_CONTENT_SIZE + i] << (8 * i);
+        }
+    }
+    if(len == 0 || len > TOKEN_FLASH_MAX_MEM_SIZE)
+    {
+        printf("Error, compressed image must record a content size of at most %u bytes\n", TOKEN_FLASH_MAX_MEM_SIZE);
+        return IMAGE_ERR_FORMAT;
+    }
+
+    image->len = (uint32_t) len;
+    image->data = malloc(image->len);
+    if(image->data == NULL)
+    {
+        return IMAGE_ERR_NO_MEMORY;
+    }
+    image->hasWorker = (pthread_create(&image->worker, NULL, image_inflate, image) == 0);
+    return image->hasWorker ? IMAGE_ERR_OK : IMAGE_ERR_NO_MEMORY;
+}
+
+/*******************************************************************************
+ * @brief image_inflate
+ *
+ * Worker thread: decompress the image, publishing each chunk as it lands. The
+ * compressed copy is dropped once done.
+ *
+ * @param  > void* : IMAGE_t*
+ *
+ * @return void* : NULL
+ ******************************************************************************/
+static void* image_inflate(void* arg)
+{
+    IMAGE_t* image = (IMAGE_t*) arg;
+    uint32_t start = Timer_GetTick();
+    bool isDone = (image->magic == IMAGE_ZSTD_MAGIC) ? image_inflateZstd(image) : image_inflateLz4(image);
+    if(isDone)
+    {
+        printf("image decompressed, %u bytes in %u ms\n", image->len, Timer_GetTick() - start);
+    }
+    else if(!atomic_load(&image->isCancelled))
+    {
+        printf("Error, compressed image is corrupt or short after %u of %u bytes\n", Image_GetReady(image), image->len);
+        atomic_store(&image->isFailed, true);
+    }
+    free(image->packed);
+    image->packed = NULL;
+    return NULL;
+}
+
+/*******************************************************************************
+ * @brief image_inflateZstd
+ *
+ * Decompress zstd frames, IMAGE_INFLATE_CHUNK bytes at a time
+ *
+ * @param  > IMAGE_t* : image
+ *
+ * @return bool : true if exactly len bytes came out
+ ******************************************************************************/
+static bool image_inflateZstd(IMAGE_t* image)
+{
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    ZSTD_inBuffer in = { image->packed, image->packedLen, 0 };
+    ZSTD_outBuffer out = { image->data, 0, 0 };
+    bool isOk = (stream != NULL) && !ZSTD_isError(ZSTD_initDStream(stream));
+    while(isOk && out.pos < image->len && !atomic_load(&image->isCancelled))
+    {
+        size_t inPos = in.pos;
+        size_t outPos = out.pos;
+        out.size = MIN(out.pos + IMAGE_INFLATE_CHUNK, image->len);
+        isOk = !ZSTD_isError(ZSTD_decompressStream(stream, &out, &in)) && (in.pos != inPos || out.pos != outPos);
+        atomic_store_explicit(&image->ready, (uint32_t) out.pos, memory_order_release);
+    }
+    ZSTD_freeDStream(stream);
+    return isOk && out.pos == image->len;
+}
+
+/*******************************************************************************
+ * @brief image_inflateLz4
+ *
+ * Decompress an LZ4 frame, IMAGE_INFLATE_CHUNK bytes at a time
+ *
+ * @param  > IMAGE_t* : image
+ *
+ * @return bool : true if exactly len bytes came out
+ ******************************************************************************/
+static bool image_inflateLz4(IMAGE_t* image)
+{
+    LZ4F_dctx* ctx = NULL;
+    uint32_t inPos = 0;
+    uint32_t outPos = 0;
+    bool isOk = !LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION));
+    while(isOk && outPos < image->len && !atomic_load(&image->isCancelled))
+    {
+        size_t inLen = image->packedLen - inPos;
+        size_t outLen = MIN(IMAGE_INFLATE_CHUNK, image->len - outPos);
+        isOk = !LZ4F_isError(LZ4F_decompress(ctx, image->data + outPos, &outLen, image->packed + inPos, &inLen, NULL))
+            && (inLen > 0 || outLen > 0);
+        inPos += (uint32_t) inLen;
+        outPos += (uint32_t) outLen;
+        atomic_store_explicit(&image->ready, outPos, memory_order_release);
+    }
+    LZ4F_freeDecompressionContext(ctx);
+    return isOk && outPos == image->len;
+}
+
+/*******************************************************************************
+ * @brief image_loadSparse
+ *
+ * Build the image from a sparse container (all fields little-endian):
+ *
+ *     header: magic "TKSP", u16 version, u16 header length, u32 image length,
+ *             u32 chunk count
+ *     chunk:  u16 type, u16 reserved, u32 length, u32 fill, then for RAW
+ *             length bytes
+ *
+ * Chunks tile the image in address order. FILL repeats its fill word from the
+ * start of the chunk, so a byte fill has the byte in all four places. HOLE
+ * reads as 0xFF but is never programmed. A hole is only kept in the whole
+ * sectors it covers; the rest of it is erased with its sector's data, so it is
+ * BLANK. Fills are generated here; only RAW chunks came off the card.
+ *
+ * @param  > IMAGE_t* : image to populate
+ *         > const uint8_t* : container
+ *         > uint32_t : container length
+ *
+ * @return IMAGE_ErrCode_t
+ ******************************************************************************/
+static IMAGE_ErrCode_t image_loadSparse(IMAGE_t* image, const uint8_t* file, uint32_t fileLen)
+{
+    if(fileLen < IMAGE_SPARSE_HEADER_LEN || image_getLe(file + 4, 2) != IMAGE_SPARSE_VERSION)
+    {
+        return IMAGE_ERR_FORMAT;
+    }
+    uint32_t pos = image_getLe(file + 6, 2);
+    uint32_t len = image_getLe(file + 8, 4);
+    uint32_t count = image_getLe(file + 12, 4);
+    if(pos < IMAGE_SPARSE_HEADER_LEN || len == 0 || len > TOKEN_FLASH_MAX_MEM_SIZE || count == 0 || count > len)
+    {
+        return IMAGE_ERR_FORMAT;
+    }
+    image->data = malloc(len);
+    image->chunks = calloc(count, sizeof(IMAGE_Chunk_t));
+    if(image->data == NULL || image->chunks == NULL)
+    {
+        return IMAGE_ERR_NO_MEMORY;
+    }
+    image->len = len;
+    image->chunkCount = count;
+
+    uint32_t offset = 0;
+    uint32_t totals[IMAGE_CLASS_COUNT] = {0};
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(pos > fileLen || fileLen - pos < IMAGE_SPARSE_CHUNK_LEN)
+        {
+            return IMAGE_ERR_FORMAT;
+        }
+        uint32_t type = image_getLe(file + pos, 2);
+        uint32_t chunkLen = image_getLe(file + pos + 4, 4);
+        uint32_t fill = image_getLe(file + pos + 8, 4);
+        pos += IMAGE_SPARSE_CHUNK_LEN;
+        if(chunkLen == 0 || chunkLen > len - offset)
+        {
+            return IMAGE_ERR_FORMAT;
+        }
+        IMAGE_Chunk_t* chunk = &image->chunks[i];
+        chunk->offset = offset;
+        chunk->len = chunkLen;
+        chunk->type = IMAGE_CLASS_DATA;
+        if(type == IMAGE_SPARSE_RAW && chunkLen <= fileLen - pos)
+        {
+            memcpy(image->data + offset, file + pos, chunkLen);
+            pos += chunkLen;
+        }
+        else if(type == IMAGE_SPARSE_FILL && fill == ((fill & 0xFF) * 0x01010101u))
+        {
+            memset(image->data + offset, (int) (fill & 0xFF), chunkLen);
+            chunk->type = (fill == 0xFFFFFFFF) ? IMAGE_CLASS_BLANK : IMAGE_CLASS_DATA;
+        }
+        else if(type == IMAGE_SPARSE_FILL)
+        {
+            for(uint32_t j = 0; j < chunkLen; j++)
+            {
+                image->data[offset + j] = (uint8_t) (fill >> (8 * (j % 4)));
+            }
+        }
+        else if(type == IMAGE_SPARSE_HOLE)
+        {
+            memset(image->data + offset, 0xFF, chunkLen);
+            chunk->type = IMAGE_CLASS_HOLE;
+            image->hasHoles = true;
+        }
+        else
+        {
+            return IMAGE_ERR_FORMAT;
+        }
+        totals[chunk->type] += chunkLen;
+        offset += chunkLen;
+    }
+    if(offset != len)
+    {
+        return IMAGE_ERR_FORMAT;
+    }
+    uint32_t demoted = image_alignHoles(image);
+    if(demoted == UINT32_MAX)
+    {
+        return IMAGE_ERR_NO_MEMORY;
+    }
+    totals[IMAGE_CLASS_HOLE] -= demoted;
+    totals[IMAGE_CLASS_BLANK] += demoted;
+    atomic_store(&image->ready, len);
+    printf("sparse image: %u chunks, %u bytes to program, %u blank, %u don't care\n", count,
+        totals[IMAGE_CLASS_DATA], totals[IMAGE_CLASS_BLANK], totals[IMAGE_CLASS_HOLE]);
+    return IMAGE_ERR_OK;
+}
+
+/*******************************************************************************
+ * @brief image_getLe
+ *
+ * Little-endian field of a sparse container
+ *
+ * @param  > const uint8_t* : field
+ *         > uint32_t : field length, up to 4
+ *
+ * @return uint32_t
+ ******************************************************************************/
+static uint32_t image_getLe(const uint8_t* buf, uint32_t len)
+{
+    uint32_t value = 0;
+    for(uint32_t i = 0; i < len; i++)
+    {
+        value |= (uint32_t) buf[i] << (8 * i);
+    }
+    return value;
+}
+
+/*******************************************************************************
+ * @brief image_loadSegments
+ *
+ * Build the image from an Intel HEX, S-record or ELF file's segments. Each
+ * segment is widened to whole pages and overlapping pages merged into DATA
+ * chunks; everything between is a HOLE, so sectors no segment touches are
+ * never erased and pages none touches are never programmed. Pages are
+ * TOKEN_FLASH_MAX_PAGE_LEN: the part isn't known yet, and every smaller page
+ * divides it. A gap within a sector holding data is erased with it, so it is
+ * BLANK rather than a HOLE. Bytes of a page that no segment covers are 0xFF.
+ * The image ends with the last page holding data.
+ *
+ * @param  > IMAGE_t* : image to populate
+ *         > const uint8_t* : file
+ *         > uint32_t : file length
+ *
+ * @return IMAGE_ErrCode_t
+ ******************************************************************************/
+static IMAGE_ErrCode_t image_loadSegments(IMAGE_t* image, const uint8_t* file, uint32_t fileLen)
+{
+    static const char* formatNames[SEGMENT_FORMAT_COUNT] = { "", "Intel HEX", "S-record", "ELF" };
+    SEGMENT_List_t list;
+    if(!Segment_Parse(file, fileLen, &list))
+    {
+        Segment_Free(&list);
+        return IMAGE_ERR_FORMAT;
+    }
+    uint64_t len = ((uint64_t) list.end + TOKEN_FLASH_MAX_PAGE_LEN - 1) / TOKEN_FLASH_MAX_PAGE_LEN * TOKEN_FLASH_MAX_PAGE_LEN;
+    if(len > TOKEN_FLASH_MAX_MEM_SIZE)
+    {
+        printf("Error, %s image reaches 0x%X, beyond the largest token\n", formatNames[list.format], list.end);
+        Segment_Free(&list);
+        return IMAGE_ERR_FORMAT;
+    }
+
+    IMAGE_Chunk_t* pages = malloc(list.count * sizeof(IMAGE_Chunk_t));
+    image->chunks = malloc((2 * list.count + 1) * sizeof(IMAGE_Chunk_t));
+    image->data = malloc((size_t) len);
+    if(pages == NULL || image->chunks == NULL || image->data == NULL)
+    {
+        free(pages);
+        Segment_Free(&list);
+        return IMAGE_ERR_NO_MEMORY;
+    }
+    image->len = (uint32_t) len;
+    memset(image->data, 0xFF, image->len);
+    for(uint32_t i = 0; i < list.count; i++)
+    {
+        const SEGMENT_t* segment = &list.segments[i];
+        memcpy(image->data + segment->address, segment->data, segment->len);
+        pages[i].offset = segment->address / TOKEN_FLASH_MAX_PAGE_LEN * TOKEN_FLASH_MAX_PAGE_LEN;
+        pages[i].len = (uint32_t) (((uint64_t) segment->address + segment->len + TOKEN_FLASH_MAX_PAGE_LEN - 1)
+            / TOKEN_FLASH_MAX_PAGE_LEN * TOKEN_FLASH_MAX_PAGE_LEN) - pages[i].offset;
+        pages[i].type = IMAGE_CLASS_DATA;
+    }
+    qsort(pages, list.count, sizeof(IMAGE_Chunk_t), image_compareChunks);
+
+    uint32_t offset = 0;
+    uint32_t populated = 0;
+    for(uint32_t i = 0; i < list.count; i++)
+    {
+        uint32_t start = pages[i].offset;
+        uint32_t end = start + pages[i].len;
+        if(image->chunkCount > 0 && start <= offset)
+        {
+            // Overlaps or abuts the last DATA chunk
+            if(end > offset)
+            {
+                image->chunks[image->chunkCount - 1].len = end - image->chunks[image->chunkCount - 1].offset;
+                populated += end - offset;
+                offset = end;
+            }
+            continue;
+        }
+        if(start > offset)
+        {
+            image->chunks[image->chunkCount++] = (IMAGE_Chunk_t) { offset, start - offset, IMAGE_CLASS_HOLE };
+            image->hasHoles = true;
+        }
+        image->chunks[image->chunkCount++] = (IMAGE_Chunk_t) { start, end - start, IMAGE_CLASS_DATA };
+        populated += end - start;
+        offset = end;
+    }
+    if(image_alignHoles(image) == UINT32_MAX)
+    {
+        free(pages);
+        Segment_Free(&list);
+        return IMAGE_ERR_NO_MEMORY;
+    }
+    atomic_store(&image->ready, image->len);
+    printf("%s image: %u segments, %u of %u bytes to program\n", formatNames[list.format], list.count, populated, image->len);
+    free(pages);
+    Segment_Free(&list);
+    return IMAGE_ERR_OK;
+}
+
+/*******************************************************************************
+ * @brief image_compareChunks
+ *
+ * qsort order of chunks by offset
+ *
+ * @param  > const void* : IMAGE_Chunk_t*
+ *         > const void* : IMAGE_Chunk_t*
+ *
+ * @return int
+ ******************************************************************************/
+static int image_compareChunks(const void* a, const void* b)
+{
+    uint32_t offsetA = ((const IMAGE_Chunk_t*) a)->offset;
+    uint32_t offsetB = ((const IMAGE_Chunk_t*) b)->offset;
+    return (offsetA > offsetB) - (offsetA < offsetB);
+}
+
+/*******************************************************************************
+ * @brief image_alignHoles
+ *
+ * Erase works a sector at a time, so a hole is only left untouched where it
+ * covers whole sectors (or runs to the end of the image). The rest of each
+ * hole goes with its sector's data and becomes BLANK, programmed as 0xFF and
+ * verified as such. Splitting a hole may take up to three chunks.
+ *
+ * @param  > IMAGE_t* : image, chunks built
+ *
+ * @return uint32_t : hole bytes made BLANK, UINT32_MAX if out of memory
+ ******************************************************************************/
+static uint32_t image_alignHoles(IMAGE_t* image)
+{
+    if(!image->hasHoles)
+    {
+        return 0;
+    }
+    IMAGE_Chunk_t* chunks = malloc(3 * image->chunkCount * sizeof(IMAGE_Chunk_t));
+    if(chunks == NULL)
+    {
+        return UINT32_MAX;
+    }
+    uint32_t count = 0;
+    uint32_t demoted = 0;
+    image->hasHoles = false;
+    for(uint32_t i = 0; i < image->chunkCount; i++)
+    {
+        IMAGE_Chunk_t chunk = image->chunks[i];
+        if(chunk.type != IMAGE_CLASS_HOLE)
+        {
+            chunks[count++] = chunk;
+            continue;
+        }
+        uint32_t end = chunk.offset + chunk.len;
+        uint32_t holeStart = (chunk.offset + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN * TOKEN_FLASH_SECTOR_LEN;
+        uint32_t holeEnd = (end == image->len) ? end : end / TOKEN_FLASH_SECTOR_LEN * TOKEN_FLASH_SECTOR_LEN;
+        if(holeStart >= holeEnd)
+        {
+            chunks[count++] = (IMAGE_Chunk_t) { chunk.offset, chunk.len, IMAGE_CLASS_BLANK };
+            demoted += chunk.len;
+            continue;
+        }
+        if(holeStart > chunk.offset)
+        {
+            chunks[count++] = (IMAGE_Chunk_t) { chunk.offset, holeStart - chunk.offset, IMAGE_CLASS_BLANK };
+        }
+        chunks[count++] = (IMAGE_Chunk_t) { holeStart, holeEnd - holeStart, IMAGE_CLASS_HOLE };
+        if(end > holeEnd)
+        {
+            chunks[count++] = (IMAGE_Chunk_t) { holeEnd, end - holeEnd, IMAGE_CLASS_BLANK };
+        }
+        demoted += chunk.len - (holeEnd - holeStart);
+        image->hasHoles = true;
+    }
+    free(image->chunks);
+    image->chunks = chunks;
+    image->chunkCount = count;
+    if(demoted > 0)
+    {
+        printf("%u bytes of holes share an erase sector with data, erased as blank\n", demoted);
+    }
+    return demoted;
+}
+
+// EOF
@@ -0,0 +1,143 @@
+/*******************************************************************************
+ *  @file Image.h
+ *
+ *  @brief Token image held in RAM for the programming engine. zstd and LZ4
+ *         framed images are decompressed by a worker thread while tokens
+ *         are already being programmed from the part that is ready. Sparse
+ *         images describe fills and don't-care holes instead of storing them;
+ *         Intel HEX, S-record and ELF images leave holes between segments.
+ *         A clone's image is streamed off a master token through a ring.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+#include <stdatomic.h>
+#include <pthread.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define IMAGE_DIGEST_SEED       0xCBF29CE484222325ULL
+#define IMAGE_ZSTD_MAGIC        0xFD2FB528  // first 4 bytes of a zstd frame, little-endian
+#define IMAGE_LZ4_MAGIC         0x184D2204  // first 4 bytes of an LZ4 frame, little-endian
+#define IMAGE_INFLATE_CHUNK     0x10000     // decompressed bytes published to jobs at a time
+#define IMAGE_SPARSE_MAGIC      0x50534B54  // "TKSP", sparse container (binToSparse.py)
+#define IMAGE_SPARSE_VERSION    1
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+typedef enum
+{
+    IMAGE_ERR_OK = 0,
+    IMAGE_ERR_OPEN,
+    IMAGE_ERR_READ,
+    IMAGE_ERR_NO_MEMORY,
+    IMAGE_ERR_FORMAT,
+    IMAGE_ERR_COUNT
+} IMAGE_ErrCode_t;
+
+// What a range of the image holds, from a sparse container's chunks
+typedef enum
+{
+    IMAGE_CLASS_DATA,       // bytes to program (raw images are all data)
+    IMAGE_CLASS_BLANK,      // 0xFF fill (and holes): already right once erased
+    IMAGE_CLASS_HOLE,       // don't care, whole sectors: never erased, programmed or verified
+    IMAGE_CLASS_COUNT
+} IMAGE_Class_t;
+
+typedef struct
+{
+    uint32_t offset;
+    uint32_t len;
+    IMAGE_Class_t type;
+} IMAGE_Chunk_t;
+
+typedef struct
+{
+    uint8_t* data;
+    uint32_t len;
+    uint64_t digest;     // FNV-1a 64 of the file (compressed or not), identifies the image version
+    uint32_t refCount;   // jobs (plus the owner) holding an Image_Open image
+    atomic_uint ready;   // bytes of data decompressed so far, len once complete
+    atomic_bool isFailed;    // compressed frame was corrupt or short
+    atomic_bool isCancelled; // stop the worker, image is being freed
+    uint32_t magic;      // frame format of a compressed file, 0 if raw
+    uint8_t* packed;     // compressed file, freed once decompressed
+    uint32_t packedLen;
+    pthread_t worker;
+    bool hasWorker;
+    IMAGE_Chunk_t* chunks;  // sparse container's chunks in address order, NULL if not sparse
+    uint32_t chunkCount;
+    bool hasHoles;
+    uint32_t window;        // streamed image: data is a ring of this many bytes (whole sectors), 0 = all held
+    uint64_t* sectorDigests;    // streamed image: FNV-1a 64 of each 64K sector, valid up to ready
+} IMAGE_t;
+
+// Load file at path into RAM and compute its digest. Compressed files are
+// decompressed in full before returning.
+IMAGE_ErrCode_t Image_Load(const char* path, IMAGE_t* image);
+
+// Release memory held by image
+void Image_Free(IMAGE_t* image);
+
+// Load file at path into a shared, reference counted image (refCount = 1).
+// Compressed files return at once and decompress in the background; see
+// Image_GetReady. NULL on failure.
+IMAGE_t* Image_Open(const char* path);
+
+// Shared image (refCount = 1) of len bytes the caller streams in from the
+// front through a ring of window bytes, with Image_GetData and Image_SetReady.
+// Data more than window behind the front is gone. NULL if out of memory.
+IMAGE_t* Image_OpenStream(uint32_t len, uint32_t window);
+
+// Bytes of data from the start that are ready to program. len once complete.
+uint32_t Image_GetReady(IMAGE_t* image);
+
+// Streamed image: bytes from the start written so far
+void Image_SetReady(IMAGE_t* image, uint32_t ready);
+
+// Streamed image: the rest of the data never comes
+void Image_SetFailed(IMAGE_t* image);
+
+// Image data at address. A streamed image's ring holds only the last window bytes.
+uint8_t* Image_GetData(const IMAGE_t* image, uint32_t address);
+
+// Determine if decompression failed. Data beyond Image_GetReady never comes.
+bool Image_IsFailed(IMAGE_t* image);
+
+// Block until image is fully decompressed. Only for an image no job holds yet.
+// False if decompression failed.
+bool Image_Wait(IMAGE_t* image);
+
+// What [address, address + len) holds. DATA unless the image is sparse.
+IMAGE_Class_t Image_GetClass(const IMAGE_t* image, uint32_t address, uint32_t len);
+
+// Take another reference to a shared image
+IMAGE_t* Image_Acquire(IMAGE_t* image);
+
+// Drop a reference to a shared image, freeing it with the last one
+void Image_Release(IMAGE_t* image);
+
+// FNV-1a 64 digest of buf, continuing from seed (IMAGE_DIGEST_SEED to start)
+uint64_t Image_Digest(uint64_t seed, const uint8_t* buf, uint32_t len);
+
+// Determine if len bytes of buf are all erased (0xFF)
+bool Image_IsBlank(const uint8_t* buf, uint32_t len);
+
+#endif /* _IMAGE_H_ */
@@ -0,0 +1,306 @@
+/*******************************************************************************
+ *  @file Journal.c
+ *
+ *  @brief Per-token programming progress journal. Records which sectors of an
+ *         image have been verified on a token (keyed by its unique ID) so an
+ *         interrupted job can resume instead of starting over. Once a job
+ *         passes, the journal records which image the token holds.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Module Includes
+#include "Journal.h"
+
+// Utility Includes
+
+// Driver Includes
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define JOURNAL_MAGIC           0x4A4B4F54  // "TOKJ"
+#define JOURNAL_VERSION         2
+#define JOURNAL_PATH_LEN        128
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Build journal file path from token unique ID
+static void journal_getPath(char* path, const uint8_t* uid, const char* suffix);
+
+// Persist journal. Written to a temp file and renamed so a power cut never
+// leaves a torn journal behind.
+static void journal_save(const JOURNAL_t* journal);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Journal_Open
+ *
+ * Open the journal for token uid programming image. Resumes a matching journal
+ * left by an interrupted job, otherwise starts a fresh one.
+ *
+ * @param  > JOURNAL_t* : journal to populate
+ *         > const uint8_t* : token unique ID
+ *         > const IMAGE_t* : image being programmed
+ *
+ * @return bool: true if progress was resumed
+ ******************************************************************************/
+bool Journal_Open(JOURNAL_t* journal, const uint8_t* uid, const IMAGE_t* image)
+{
+    bool isResumed = false;
+    char path[JOURNAL_PATH_LEN];
+    journal_getPath(path, uid, "");
+    mkdir(JOURNAL_PATH, 0755);
+
+    FILE* fp = fopen(path, "rb");
+    if(fp != NULL)
+    {
+        isResumed = (fread(journal, sizeof(JOURNAL_t), 1, fp) == 1)
+            && (journal->magic == JOURNAL_MAGIC)
+            && (journal->version == JOURNAL_VERSION)
+            && (memcmp(journal->uid, uid, TOKEN_FLASH_UNIQUE_ID_LEN) == 0)
+            && (journal->imageDigest == image->digest)
+            && (journal->imageLen == image->len)
+            && (journal->flags & (JOURNAL_FLAG_ERASED | JOURNAL_FLAG_SECTOR_ERASE))
+            && !(journal->flags & JOURNAL_FLAG_COMPLETE);
+        fclose(fp);
+    }
+    if(!isResumed)
+    {
+        memset(journal, 0, sizeof(JOURNAL_t));
+        journal->magic = JOURNAL_MAGIC;
+        journal->version = JOURNAL_VERSION;
+        memcpy(journal->uid, uid, TOKEN_FLASH_UNIQUE_ID_LEN);
+        journal->imageDigest = image->digest;
+        journal->imageLen = image->len;
+    }
+    return isResumed;
+}
+
+/*******************************************************************************
+ * @brief Journal_MarkErased
+ *
+ * Record that the chip erase for this job completed
+ *
+ * @param  > JOURNAL_t* : journal
+ *
+ * @return None
+ ******************************************************************************/
+void Journal_MarkErased(JOURNAL_t* journal)
+{
+    journal->flags |= JOURNAL_FLAG_ERASED;
+    journal_save(journal);
+}
+
+/*******************************************************************************
+ * @brief Journal_MarkSectorErase
+ *
+ * Record that this job erases each sector as it reaches it instead of erasing
+ * the chip up front. Its progress can be resumed without a chip erase.
+ *
+ * @param  > JOURNAL_t* : journal
+ *
+ * @return None
+ ******************************************************************************/
+void Journal_MarkSectorErase(JOURNAL_t* journal)
+{
+    journal->flags |= JOURNAL_FLAG_SECTOR_ERASE;
+    journal_save(journal);
+}
+
+/*******************************************************************************
+ * @brief Journal_MarkVerified
+ *
+ * Record that sector has been written and verified
+ *
+ * @param  > JOURNAL_t* : journal
+ *         > uint32_t : sector index
+ *
+ * @return None
+ ******************************************************************************/
+void Journal_MarkVerified(JOURNAL_t* journal, uint32_t sector)
+{
+    if(sector < TOKEN_FLASH_SECTOR_COUNT)
+    {
+        journal->verified[sector / 8] |= (uint8_t) (1 << (sector % 8));
+        journal_save(journal);
+    }
+}
+
+/*******************************************************************************
+ * @brief Journal_IsVerified
+ *
+ * Determine if sector was verified by this or an earlier attempt
+ *
+ * @param  > const JOURNAL_t* : journal
+ *         > uint32_t : sector index
+ *
+ * @return bool
+ ******************************************************************************/
+bool Journal_IsVerified(const JOURNAL_t* journal, uint32_t sector)
+{
+    return (sector < TOKEN_FLASH_SECTOR_COUNT) && (journal->verified[sector / 8] & (1 << (sector % 8)));
+}
+
+/*******************************************************************************
+ * @brief Journal_MarkUnchanged
+ *
+ * Record that sectors below sectorCount not set in the changed bitmap already
+ * hold the image, as a delta upgrade found them. The job erases only the
+ * sectors it rewrites. Saved once for the lot.
+ *
+ * @param  > JOURNAL_t* : journal
+ *         > const uint8_t* : changed sectors, one bit each
+ *         > uint32_t : sectors in the image
+ *
+ * @return None
+ ******************************************************************************/
+void Journal_MarkUnchanged(JOURNAL_t* journal, const uint8_t* changed, uint32_t sectorCount)
+{
+    for(uint32_t sector = 0; sector < MIN(sectorCount, TOKEN_FLASH_SECTOR_COUNT); sector++)
+    {
+        if(!(changed[sector / 8] & (1 << (sector % 8))))
+        {
+            journal->verified[sector / 8] |= (uint8_t) (1 << (sector % 8));
+        }
+    }
+    journal->flags |= JOURNAL_FLAG_SECTOR_ERASE;
+    journal_save(journal);
+}
+
+/*******************************************************************************
+ * @brief Journal_Complete
+ *
+ * Job passed. Its progress is dropped; the journal is kept, flagged complete,
+ * as the record of the image the token now holds.
+ *
+ * @param  > JOURNAL_t* : journal
+ *
+ * @return None
+ ******************************************************************************/
+void Journal_Complete(JOURNAL_t* journal)
+{
+    journal->flags = JOURNAL_FLAG_COMPLETE;
+    memset(journal->verified, 0, sizeof(journal->verified));
+    journal_save(journal);
+}
+
+/*******************************************************************************
+ * @brief Journal_GetCompleted
+ *
+ * Image last programmed onto token uid by a job that passed
+ *
+ * @param  > const uint8_t* : token unique ID
+ *         > uint64_t* : image digest
+ *         > uint32_t* : image length
+ *
+ * @return bool : false if there is no record
+ ******************************************************************************/
+bool Journal_GetCompleted(const uint8_t* uid, uint64_t* digest, uint32_t* len)
+{
+    JOURNAL_t journal;
+    bool isFound = false;
+    char path[JOURNAL_PATH_LEN];
+    journal_getPath(path, uid, "");
+    FILE* fp = fopen(path, "rb");
+    if(fp != NULL)
+    {
+        isFound = (fread(&journal, sizeof(JOURNAL_t), 1, fp) == 1)
+            && (journal.magic == JOURNAL_MAGIC)
+            && (journal.version == JOURNAL_VERSION)
+            && (memcmp(journal.uid, uid, TOKEN_FLASH_UNIQUE_ID_LEN) == 0)
+            && (journal.flags & JOURNAL_FLAG_COMPLETE);
+        fclose(fp);
+    }
+    if(isFound)
+    {
+        *digest = journal.imageDigest;
+        *len = journal.imageLen;
+    }
+    return isFound;
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief journal_getPath
+ *
+ * Build journal file path from token unique ID
+ *
+ * @param  > char* : path buffer of JOURNAL_PATH_LEN
+ *         > const uint8_t* : token unique ID
+ *         > const char* : suffix appended to the file name
+ *
+ * @return None
+ ******************************************************************************/
+static void journal_getPath(char* path, const uint8_t* uid, const char* suffix)
+{
+    int len = snprintf(path, JOURNAL_PATH_LEN, "%s/", JOURNAL_PATH);
+    for(uint32_t i = 0; i < TOKEN_FLASH_UNIQUE_ID_LEN; i++)
+    {
+        len += snprintf(path + len, JOURNAL_PATH_LEN - len, "%02X", uid[i]);
+    }
+    snprintf(path + len, JOURNAL_PATH_LEN - len, ".jnl%s", suffix);
+}
+
+/*******************************************************************************
+ * @brief journal_save
+ *
+ * Persist journal. Written to a temp file and renamed so a power cut never
+ * leaves a torn journal behind.
+ *
+ * @param  > const JOURNAL_t* : journal
+ *
+ * @return None
+ ******************************************************************************/
+static void journal_save(const JOURNAL_t* journal)
+{
+    char path[JOURNAL_PATH_LEN];
+    char tmpPath[JOURNAL_PATH_LEN];
+    journal_getPath(path, journal->uid, "");
+    journal_getPath(tmpPath, journal->uid, ".tmp");
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd >= 0)
+    {
+        bool isWritten = (write(fd, journal, sizeof(JOURNAL_t)) == (ssize_t) sizeof(JOURNAL_t));
+        fsync(fd);
+        close(fd);
+        if(isWritten)
+        {
+            rename(tmpPath, path);
+        }
+    }
+    else
+    {
+        printf("Error, unable to write journal %s\n", tmpPath);
+    }
+}
+
+// EOF
@@ -0,0 +1,80 @@
+/*******************************************************************************
+ *  @file Journal.h
+ *
+ *  @brief Per-token programming progress journal. Records which sectors of an
+ *         image have been verified on a token (keyed by its unique ID) so an
+ *         interrupted job can resume instead of starting over.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+#include "TokenFlash.h"
+#include "Image.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define JOURNAL_FLAG_ERASED         0x01    // chip erase completed for this job
+#define JOURNAL_FLAG_SECTOR_ERASE   0x02    // job erases each sector as it reaches it, no chip erase
+#define JOURNAL_FLAG_COMPLETE       0x04    // job passed; the token holds imageDigest
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint8_t  uid[TOKEN_FLASH_UNIQUE_ID_LEN];
+    uint64_t imageDigest;
+    uint32_t imageLen;
+    uint32_t flags;
+    uint8_t  verified[TOKEN_FLASH_SECTOR_COUNT / 8];
+} JOURNAL_t;
+
+// Open the journal for token uid programming image. Resumes a matching journal
+// left by an interrupted job, otherwise starts a fresh one. Returns true if
+// progress was resumed.
+bool Journal_Open(JOURNAL_t* journal, const uint8_t* uid, const IMAGE_t* image);
+
+// Record that the chip erase for this job completed
+void Journal_MarkErased(JOURNAL_t* journal);
+
+// Record that this job erases each sector as it reaches it instead of erasing
+// the chip up front. Its progress can be resumed without a chip erase.
+void Journal_MarkSectorErase(JOURNAL_t* journal);
+
+// Record that sector has been written and verified
+void Journal_MarkVerified(JOURNAL_t* journal, uint32_t sector);
+
+// Determine if sector was verified by this or an earlier attempt
+bool Journal_IsVerified(const JOURNAL_t* journal, uint32_t sector);
+
+// Record that sectors below sectorCount not set in the changed bitmap already
+// hold the image (delta upgrade). Marks the job sector erase.
+void Journal_MarkUnchanged(JOURNAL_t* journal, const uint8_t* changed, uint32_t sectorCount);
+
+// Job passed. Its progress is dropped; the journal is kept as the record of
+// the image the token now holds.
+void Journal_Complete(JOURNAL_t* journal);
+
+// Image last programmed onto token uid by a job that passed. False if there is
+// no record.
+bool Journal_GetCompleted(const uint8_t* uid, uint64_t* digest, uint32_t* len);
+
+#endif /* _JOURNAL_H_ */
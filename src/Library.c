@@ -0,0 +1,876 @@
+/*******************************************************************************
+ *  @file Library.c
+ *
+ *  @brief Image library. LIBRARY_PATH/manifest lists the images, one per line:
+ *
+ *      # name    file                   jedec   size   strap
+ *      pluto     Pluto_FULL_TOKEN.bin   EF4017  *      *
+ *      pluto16   Pluto16.hex            *       16M    *
+ *      titan     Titan.elf              *       *      2
+ *      service   Service.bin
+ *      default pluto
+ *
+ *  A token gets the image whose criteria it meets, JEDEC ID (hex), size (K/M
+ *  suffix) and fixture strap, with '*' or a missing column matching anything.
+ *  Where several match, the one naming the most criteria wins, then the first
+ *  listed. No match falls back to the default; an image naming no criteria
+ *  is only programmed as the default or by control command. The control
+ *  command is Library_Select, or the name written to LIBRARY_PATH/select; it
+ *  overrides everything until cleared. File names are relative to
+ *  LIBRARY_PATH.
+ *
+ *  Every image is opened when the manifest loads and its data locked in RAM
+ *  (mlock), so selecting one costs no disk I/O and none of it is paged out
+ *  while other products run.
+ *
+ *  The manifest, select file and images are watched (inotify). When one
+ *  changes the next library is staged on a worker thread: new and changed
+ *  images are read, fully decompressed and checked, and their sector digests
+ *  written, while the live library keeps programming tokens. Only a complete,
+ *  valid library is swapped in, between job starts; jobs in flight keep the
+ *  images they started with. A bad update is rejected and the live library
+ *  stays as it was. Images should still be replaced by rename so a stage never
+ *  reads a half written file.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <wiringPi.h>
+
+// Module Includes
+#include "Library.h"
+#include "Delta.h"
+#include "Event.h"
+#include "Timer.h"
+#include "Status.h"
+
+// Utility Includes
+
+// Driver Includes
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define LIBRARY_MANIFEST        "manifest"
+#define LIBRARY_SELECT          "select"
+#define LIBRARY_DEFAULT_NAME    "default"   // the one entry when there's no manifest
+#define LIBRARY_LINE_LEN        256
+#define LIBRARY_FILE_LEN        128
+#define LIBRARY_PATH_LEN        192
+#define LIBRARY_ANY             "*"
+#define LIBRARY_DELTA_SUFFIX    ".delta"    // changed blocks left by checkForImageUpdate.py
+
+
+/*******************************************************************************
+ * Data Types Declarations
+ ******************************************************************************/
+
+typedef struct
+{
+    char name[LIBRARY_NAME_LEN];
+    char path[LIBRARY_PATH_LEN];
+    uint32_t jedecId;           // 0 = any part
+    uint32_t size;              // bytes, 0 = any size
+    int32_t strap;              // -1 = any strap
+    IMAGE_t* image;             // NULL if it failed to load
+    off_t fileLen;              // file as loaded, to spot a changed file
+    struct timespec fileTime;
+    bool isLocked;
+    bool isRecorded;            // sector digests given to Delta
+    uint64_t digest;            // image's, 0 if none
+    bool hasHint;               // file was synced from the version hint names
+    DELTA_Hint_t hint;
+    int32_t reuse;              // live entry whose unchanged image this takes over at swap, -1 = none
+} LIBRARY_Entry_t;
+
+// One whole library. The live one serves tokens while the next is staged.
+typedef struct
+{
+    LIBRARY_Entry_t entries[LIBRARY_IMAGE_MAX];
+    uint32_t count;
+    int32_t defaultIndex;
+    char selectName[LIBRARY_NAME_LEN];  // control command found in LIBRARY_PATH/select
+    bool isValid;
+} LIBRARY_t;
+
+static const int m_strapPins[] = LIBRARY_STRAP_PINS;
+static LIBRARY_t m_libraries[2];
+static LIBRARY_t* m_live = &m_libraries[0];
+static LIBRARY_t* m_staged = &m_libraries[1];
+static LIBRARY_Entry_t m_snapshot[LIBRARY_IMAGE_MAX];   // live entries when staging began; images never touched
+static uint32_t m_snapshotCount = 0;
+static int32_t m_selected = -1;     // control command override, -1 = per token
+static pthread_t m_stager;
+static bool m_isStaging = false;
+static bool m_isRestage = false;    // files changed again while staging
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Worker thread: build and validate the staged library
+static void* library_stage(void* arg);
+
+// Parse the manifest and open every image it lists into library
+static void library_build(LIBRARY_t* library, bool isValidated);
+
+// Parse the manifest and select file into library. False if malformed.
+static bool library_parseManifest(LIBRARY_t* library);
+
+// Parse one manifest line into entries. False if malformed.
+static bool library_parseLine(char* line, LIBRARY_Entry_t* entries, uint32_t* count, char* defaultName);
+
+// Parse a manifest criterion. False if malformed.
+static bool library_parseCriterion(const char* text, int base, uint32_t* value);
+
+// Open entry's image, or note the live one it can take over if its file is unchanged
+static void library_open(LIBRARY_Entry_t* entry, bool isValidated);
+
+// Read the sync's changed sector list for entry's freshly opened image
+static bool library_readHint(LIBRARY_Entry_t* entry);
+
+// Make the staged library live
+static void library_swap(void);
+
+// Release every image library holds
+static void library_release(LIBRARY_t* library);
+
+// Unlock and release entry's image
+static void library_drop(LIBRARY_Entry_t* entry);
+
+// Index of the entry named name, -1 if none
+static int32_t library_find(const LIBRARY_Entry_t* entries, uint32_t count, const char* name);
+
+// Fixture strap, bit n set when strap pin n is jumpered to ground
+static uint32_t library_getStrap(void);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Library_Init
+ *
+ * Configure the strap pins as inputs with pull-ups; a jumper to ground sets
+ * the bit
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+void Library_Init(void)
+{
+    for(uint32_t i = 0; i < sizeof(m_strapPins) / sizeof(m_strapPins[0]); i++)
+    {
+        pinMode(m_strapPins[i], INPUT);
+        pullUpDnControl(m_strapPins[i], PUD_UP);
+    }
+}
+
+/*******************************************************************************
+ * @brief Library_Load
+ *
+ * Load the manifest and the images it lists, here and now. Used for the first
+ * token; after that updates are staged. Compressed images go live at once and
+ * decompress while the first tokens program. A malformed manifest leaves the
+ * library empty rather than program tokens with the wrong product.
+ *
+ * @param  > None
+ *
+ * @return bool : false if the manifest is malformed
+ ******************************************************************************/
+bool Library_Load(void)
+{
+    if(m_isStaging)
+    {
+        pthread_join(m_stager, NULL);
+        m_isStaging = false;
+        m_isRestage = false;
+        library_release(m_staged);
+    }
+    memcpy(m_snapshot, m_live->entries, m_live->count * sizeof(LIBRARY_Entry_t));
+    m_snapshotCount = m_live->count;
+    library_build(m_staged, false);
+    bool isValid = m_staged->isValid;
+    library_swap();
+    return isValid;
+}
+
+/*******************************************************************************
+ * @brief Library_Stage
+ *
+ * Build the next library in the background from the files as they are now.
+ * Each new or changed image is read, fully decompressed, checked and its
+ * sector digests written for delta planning; unchanged images are shared with
+ * the live library. EVENT_LIBRARY_STAGED is posted when done. Changes arriving
+ * while a stage is running are picked up by staging again once it finishes.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+void Library_Stage(void)
+{
+    if(m_isStaging)
+    {
+        m_isRestage = true;
+        return;
+    }
+    memcpy(m_snapshot, m_live->entries, m_live->count * sizeof(LIBRARY_Entry_t));
+    m_snapshotCount = m_live->count;
+    m_isStaging = (pthread_create(&m_stager, NULL, library_stage, NULL) == 0);
+    if(!m_isStaging)
+    {
+        printf("Error, unable to start staging the library\n");
+    }
+}
+
+/*******************************************************************************
+ * @brief Library_Swap
+ *
+ * The stage finished (EVENT_LIBRARY_STAGED). Make it live if it is valid and
+ * still current. The swap is a pointer flip done between job starts: jobs in
+ * flight hold their own image references and finish undisturbed, and the
+ * next token gets the new library with no disk I/O. A rejected stage leaves
+ * the live library as it was.
+ *
+ * @param  > None
+ *
+ * @return bool : true if a new library went live
+ ******************************************************************************/
+bool Library_Swap(void)
+{
+    if(!m_isStaging)
+    {
+        return false;
+    }
+    pthread_join(m_stager, NULL);
+    m_isStaging = false;
+    if(m_isRestage)
+    {
+        m_isRestage = false;
+        library_release(m_staged);
+        Library_Stage();
+        return false;
+    }
+    if(!m_staged->isValid)
+    {
+        printf("Error, library update rejected, keeping the current library\n");
+        library_release(m_staged);
+        return false;
+    }
+    library_swap();
+    return true;
+}
+
+/*******************************************************************************
+ * @brief Library_GetImage
+ *
+ * Image for the token just identified as device: the control command's if
+ * one is set, else the entry with the most criteria the token meets, else the
+ * default. An image that failed to load or decompress is opened again. Once
+ * complete its sector digests are recorded for delta upgrades.
+ *
+ * @param  > const TOKEN_Device_t* : token's part
+ *         > const char** : set to the image's manifest name
+ *
+ * @return IMAGE_t* : image, NULL if none applies or it can't be loaded
+ ******************************************************************************/
+IMAGE_t* Library_GetImage(const TOKEN_Device_t* device, const char** name)
+{
+    int32_t index = m_selected;
+    if(index < 0)
+    {
+        uint32_t strap = library_getStrap();
+        uint32_t best = 0;
+        for(uint32_t i = 0; i < m_live->count; i++)
+        {
+            const LIBRARY_Entry_t* entry = &m_live->entries[i];
+            if((entry->jedecId != 0 && entry->jedecId != device->jedecId)
+                || (entry->size != 0 && entry->size != device->size)
+                || (entry->strap >= 0 && (uint32_t) entry->strap != strap))
+            {
+                continue;
+            }
+            uint32_t criteria = (entry->jedecId != 0) + (entry->size != 0) + (entry->strap >= 0);
+            if(criteria > best)
+            {
+                best = criteria;
+                index = (int32_t) i;
+            }
+        }
+    }
+    if(index < 0)
+    {
+        index = m_live->defaultIndex;
+    }
+    if(index < 0)
+    {
+        return NULL;
+    }
+
+    LIBRARY_Entry_t* entry = &m_live->entries[index];
+    if(entry->image == NULL || Image_IsFailed(entry->image))
+    {
+        library_drop(entry);
+        library_open(entry, false);
+    }
+    if(entry->image != NULL && !entry->isRecorded && Image_GetReady(entry->image) == entry->image->len)
+    {
+        Delta_AddImage(entry->image);
+        entry->isRecorded = true;
+    }
+    *name = entry->name;
+    return entry->image;
+}
+
+/*******************************************************************************
+ * @brief Library_Select
+ *
+ * Control command: program every token with the named image regardless of
+ * part or strap. NULL or "" goes back to selecting per token.
+ *
+ * @param  > const char* : manifest name
+ *
+ * @return bool : false if no image has that name; the selection is unchanged
+ ******************************************************************************/
+bool Library_Select(const char* name)
+{
+    if(name == NULL || name[0] == '\0')
+    {
+        m_selected = -1;
+        Status_PublishSelected(NULL);
+        return true;
+    }
+    int32_t index = library_find(m_live->entries, m_live->count, name);
+    if(index < 0)
+    {
+        printf("Error, no image named %s in the library\n", name);
+        return false;
+    }
+    m_selected = index;
+    Status_PublishSelected(m_live->entries[index].name);
+    printf("library: every token gets %s\n", m_live->entries[index].name);
+    return true;
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief library_stage
+ *
+ * Worker thread: build and validate the staged library, then wake the main
+ * loop to swap it in
+ *
+ * @param  > void* : unused
+ *
+ * @return void* : NULL
+ ******************************************************************************/
+static void* library_stage(void* arg)
+{
+    (void) arg;
+    uint32_t start = Timer_GetTick();
+    library_build(m_staged, true);
+    printf("library staged in %u ms%s\n", Timer_GetTick() - start, m_staged->isValid ? "" : ", rejected");
+    Event_Post(EVENT_LIBRARY_STAGED, 0);
+    return NULL;
+}
+
+/*******************************************************************************
+ * @brief library_build
+ *
+ * Parse the manifest and open every image it lists into library. A validated
+ * build also requires every image to load and decompress; anything less and
+ * the whole library is invalid.
+ *
+ * @param  > LIBRARY_t* : library to populate
+ *         > bool : validate (staging), else images may load later
+ *
+ * @return None
+ ******************************************************************************/
+static void library_build(LIBRARY_t* library, bool isValidated)
+{
+    library->isValid = library_parseManifest(library);
+    if(!library->isValid)
+    {
+        library->count = 0;
+        library->defaultIndex = -1;
+    }
+    for(uint32_t i = 0; i < library->count; i++)
+    {
+        LIBRARY_Entry_t* entry = &library->entries[i];
+        library_open(entry, isValidated);
+        if(isValidated && entry->image == NULL && entry->reuse < 0)
+        {
+            printf("Error, library image %s (%s) failed to load\n", entry->name, entry->path);
+            library->isValid = false;
+        }
+    }
+}
+
+/*******************************************************************************
+ * @brief library_parseManifest
+ *
+ * Parse the manifest and select file into library. With no manifest the
+ * library is FILE_PATH alone, as before the library.
+ *
+ * @param  > LIBRARY_t* : library to populate
+ *
+ * @return bool : false if malformed
+ ******************************************************************************/
+static bool library_parseManifest(LIBRARY_t* library)
+{
+    char defaultName[LIBRARY_NAME_LEN] = "";
+    bool isValid = true;
+    char path[LIBRARY_PATH_LEN];
+    library->count = 0;
+    library->defaultIndex = -1;
+    library->selectName[0] = '\0';
+    snprintf(path, sizeof(path), "%s/%s", LIBRARY_PATH, LIBRARY_MANIFEST);
+    FILE* fp = fopen(path, "r");
+    if(fp == NULL)
+    {
+        memset(&library->entries[0], 0, sizeof(LIBRARY_Entry_t));
+        snprintf(library->entries[0].name, LIBRARY_NAME_LEN, "%s", LIBRARY_DEFAULT_NAME);
+        snprintf(library->entries[0].path, LIBRARY_PATH_LEN, "%s", FILE_PATH);
+        library->entries[0].strap = -1;
+        library->count = 1;
+        library->defaultIndex = 0;
+        return true;
+    }
+
+    char line[LIBRARY_LINE_LEN];
+    uint32_t lineNumber = 0;
+    while(isValid && fgets(line, sizeof(line), fp) != NULL)
+    {
+        lineNumber++;
+        if(!library_parseLine(line, library->entries, &library->count, defaultName))
+        {
+            printf("Error, library manifest %s line %u is malformed\n", path, lineNumber);
+            isValid = false;
+        }
+    }
+    fclose(fp);
+    if(isValid && defaultName[0] != '\0')
+    {
+        library->defaultIndex = library_find(library->entries, library->count, defaultName);
+        if(library->defaultIndex < 0)
+        {
+            printf("Error, library default %s is not in the manifest\n", defaultName);
+            isValid = false;
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", LIBRARY_PATH, LIBRARY_SELECT);
+    fp = fopen(path, "r");
+    if(fp != NULL)
+    {
+        if(fscanf(fp, "%31s", library->selectName) != 1)
+        {
+            library->selectName[0] = '\0';
+        }
+        fclose(fp);
+    }
+    return isValid;
+}
+
+/*******************************************************************************
+ * @brief library_parseLine
+ *
+ * Parse one manifest line: "name file [jedec [size [strap]]]" or
+ * "default name". Blank lines and # comments are skipped.
+ *
+ * @param  > char* : line
+ *         > LIBRARY_Entry_t* : entries
+ *         > uint32_t* : entry count
+ *         > char* : default name buffer of LIBRARY_NAME_LEN
+ *
+ * @return bool : false if malformed
+ ******************************************************************************/
+static bool library_parseLine(char* line, LIBRARY_Entry_t* entries, uint32_t* count, char* defaultName)
+{
+    char name[LIBRARY_NAME_LEN];
+    char file[LIBRARY_FILE_LEN];
+    char jedec[LIBRARY_NAME_LEN] = LIBRARY_ANY;
+    char size[LIBRARY_NAME_LEN] = LIBRARY_ANY;
+    char strap[LIBRARY_NAME_LEN] = LIBRARY_ANY;
+    line[strcspn(line, "\r\n")] = '\0';
+    int fields = sscanf(line, "%31s %127s %31s %31s %31s", name, file, jedec, size, strap);
+    if(fields <= 0 || name[0] == '#')
+    {
+        return true;
+    }
+    if(fields < 2)
+    {
+        return false;
+    }
+    if(strcmp(name, "default") == 0)
+    {
+        snprintf(defaultName, LIBRARY_NAME_LEN, "%.*s", LIBRARY_NAME_LEN - 1, file);
+        return true;
+    }
+    if(*count >= LIBRARY_IMAGE_MAX || library_find(entries, *count, name) >= 0)
+    {
+        return false;
+    }
+
+    LIBRARY_Entry_t* entry = &entries[*count];
+    memset(entry, 0, sizeof(LIBRARY_Entry_t));
+    snprintf(entry->name, LIBRARY_NAME_LEN, "%s", name);
+    if(file[0] == '/')
+    {
+        snprintf(entry->path, LIBRARY_PATH_LEN, "%s", file);
+    }
+    else
+    {
+        snprintf(entry->path, LIBRARY_PATH_LEN, "%s/%s", LIBRARY_PATH, file);
+    }
+    uint32_t strapValue = 0;
+    bool isAnyStrap = (strcmp(strap, LIBRARY_ANY) == 0);
+    if(!library_parseCriterion(jedec, 16, &entry->jedecId) || !library_parseCriterion(size, 0, &entry->size)
+        || !library_parseCriterion(strap, 0, &strapValue)
+        || strapValue >= (1u << (sizeof(m_strapPins) / sizeof(m_strapPins[0]))))
+    {
+        return false;
+    }
+    entry->strap = isAnyStrap ? -1 : (int32_t) strapValue;
+    (*count)++;
+    return true;
+}
+
+/*******************************************************************************
+ * @brief library_parseCriterion
+ *
+ * Parse a manifest criterion: '*' for any, else a number in base with an
+ * optional K or M suffix
+ *
+ * @param  > const char* : text
+ *         > int : base, 0 for C notation
+ *         > uint32_t* : value, 0 for any
+ *
+ * @return bool : false if malformed
+ ******************************************************************************/
+static bool library_parseCriterion(const char* text, int base, uint32_t* value)
+{
+    *value = 0;
+    if(strcmp(text, LIBRARY_ANY) == 0)
+    {
+        return true;
+    }
+    char* end = NULL;
+    unsigned long number = strtoul(text, &end, base);
+    if(end == text)
+    {
+        return false;
+    }
+    if(*end == 'K' || *end == 'k')
+    {
+        number <<= 10;
+        end++;
+    }
+    else if(*end == 'M' || *end == 'm')
+    {
+        number <<= 20;
+        end++;
+    }
+    *value = (uint32_t) number;
+    return (*end == '\0');
+}
+
+/*******************************************************************************
+ * @brief library_open
+ *
+ * Open entry's image and lock its data in RAM. If the live library already
+ * holds the same file, unchanged since it was loaded, that image is noted for
+ * taking over at the swap instead, so reloading the manifest doesn't read
+ * every image again. A validated open waits for decompression to finish and
+ * writes the sector digests for delta planning before the image goes live,
+ * hashing only the sectors the file sync changed when it left a hint.
+ *
+ * @param  > LIBRARY_Entry_t* : entry, path set
+ *         > bool : validate, on the staging thread
+ *
+ * @return None
+ ******************************************************************************/
+static void library_open(LIBRARY_Entry_t* entry, bool isValidated)
+{
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    stat(entry->path, &st);
+    entry->fileLen = st.st_size;
+    entry->fileTime = st.st_mtim;
+    entry->image = NULL;
+    entry->isLocked = false;
+    entry->isRecorded = false;
+    entry->digest = 0;
+    entry->hasHint = false;
+    entry->reuse = -1;
+    for(uint32_t i = 0; isValidated && i < m_snapshotCount; i++)
+    {
+        const LIBRARY_Entry_t* old = &m_snapshot[i];
+        if(old->image != NULL && strcmp(old->path, entry->path) == 0 && old->fileLen == entry->fileLen
+            && old->fileTime.tv_sec == entry->fileTime.tv_sec && old->fileTime.tv_nsec == entry->fileTime.tv_nsec)
+        {
+            entry->reuse = (int32_t) i;
+            return;
+        }
+    }
+
+    entry->image = Image_Open(entry->path);
+    if(entry->image != NULL && isValidated)
+    {
+        if(Image_Wait(entry->image))
+        {
+            entry->hasHint = library_readHint(entry);
+            Delta_Prepare(entry->image, entry->hasHint ? &entry->hint : NULL);
+            entry->isRecorded = true;
+        }
+        else
+        {
+            Image_Release(entry->image);
+            entry->image = NULL;
+        }
+    }
+    if(entry->image != NULL)
+    {
+        entry->digest = entry->image->digest;
+        entry->isLocked = (mlock(entry->image->data, entry->image->len) == 0);
+        if(!entry->isLocked)
+        {
+            printf("Warning, image %s not locked in RAM: %s\n", entry->name, strerror(errno));
+        }
+    }
+}
+
+/*******************************************************************************
+ * @brief library_readHint
+ *
+ * Read the changed sector list checkForImageUpdate.py left beside entry's
+ * file. It only applies to a raw image, where file blocks are flash sectors,
+ * when it describes this exact file and the version it was synced from is the
+ * one the live library holds.
+ *
+ * @param  > LIBRARY_Entry_t* : entry, image just opened
+ *
+ * @return bool : true if entry->hint was filled in
+ ******************************************************************************/
+static bool library_readHint(LIBRARY_Entry_t* entry)
+{
+    char path[LIBRARY_PATH_LEN + sizeof(LIBRARY_DELTA_SUFFIX)];
+    snprintf(path, sizeof(path), "%s%s", entry->path, LIBRARY_DELTA_SUFFIX);
+    if(entry->image->magic != 0 || entry->image->chunks != NULL)
+    {
+        return false;
+    }
+    FILE* fp = fopen(path, "r");
+    if(fp == NULL)
+    {
+        return false;
+    }
+
+    uint32_t block = 0;
+    unsigned long long fromLen = 0;
+    unsigned long long fromTime = 0;
+    unsigned long long toLen = 0;
+    unsigned long long toTime = 0;
+    bool isValid = (fscanf(fp, " block %u from %llu %llu to %llu %llu changed", &block, &fromLen, &fromTime, &toLen,
+        &toTime) == 5) && (block == TOKEN_FLASH_SECTOR_LEN) && (toLen == (unsigned long long) entry->fileLen)
+        && (toTime == (unsigned long long) entry->fileTime.tv_sec * 1000000000ULL + entry->fileTime.tv_nsec);
+    const LIBRARY_Entry_t* old = NULL;
+    for(uint32_t i = 0; isValid && old == NULL && i < m_snapshotCount; i++)
+    {
+        const LIBRARY_Entry_t* candidate = &m_snapshot[i];
+        if(candidate->digest != 0 && strcmp(candidate->path, entry->path) == 0
+            && (unsigned long long) candidate->fileLen == fromLen
+            && (unsigned long long) candidate->fileTime.tv_sec * 1000000000ULL + candidate->fileTime.tv_nsec == fromTime)
+        {
+            old = candidate;
+        }
+    }
+    if(old != NULL)
+    {
+        memset(&entry->hint, 0, sizeof(DELTA_Hint_t));
+        entry->hint.fromDigest = old->digest;
+        entry->hint.fromLen = (uint32_t) fromLen;
+        uint32_t sector = 0;
+        while(fscanf(fp, "%u", &sector) == 1)
+        {
+            if(sector < TOKEN_FLASH_SECTOR_COUNT)
+            {
+                entry->hint.changed[sector / 8] |= (uint8_t) (1 << (sector % 8));
+            }
+        }
+    }
+    fclose(fp);
+    return (old != NULL);
+}
+
+/*******************************************************************************
+ * @brief library_swap
+ *
+ * Make the staged library live. Unchanged images move across from the live
+ * library, then whatever it still holds is released and the two swap roles.
+ * Images the file sync delivered as a delta have their upgrade plan from the
+ * previous version cached before the first token asks. The select file's
+ * control command is applied and every file the library now uses is watched
+ * for the next update.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+static void library_swap(void)
+{
+    uint64_t locked = 0;
+    for(uint32_t i = 0; i < m_staged->count; i++)
+    {
+        LIBRARY_Entry_t* entry = &m_staged->entries[i];
+        LIBRARY_Entry_t* old = (entry->reuse >= 0 && (uint32_t) entry->reuse < m_live->count) ?
+            &m_live->entries[entry->reuse] : NULL;
+        if(old != NULL && old->image != NULL && strcmp(old->path, entry->path) == 0 && !Image_IsFailed(old->image))
+        {
+            entry->image = old->image;
+            entry->isLocked = old->isLocked;
+            entry->isRecorded = old->isRecorded;
+            entry->digest = old->digest;
+            old->image = NULL;
+        }
+        entry->reuse = -1;
+        if(entry->hasHint && entry->image != NULL)
+        {
+            // Warms the cache for the usual page size; only the sector counts are reported here
+            const DELTA_Plan_t* plan = Delta_GetPlan(entry->hint.fromDigest, entry->hint.fromLen, entry->image, TOKEN_FLASH_PAGE_LEN);
+            if(plan != NULL)
+            {
+                printf("library: %s upgrades from its last version in %u of %u sectors\n", entry->name,
+                    plan->changedCount, plan->sectorCount);
+            }
+        }
+        locked += entry->isLocked ? entry->image->len : 0;
+    }
+    library_release(m_live);
+    LIBRARY_t* live = m_staged;
+    m_staged = m_live;
+    m_live = live;
+
+    m_selected = -1;
+    Library_Select(m_live->selectName);
+    char path[LIBRARY_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/%s", LIBRARY_PATH, LIBRARY_MANIFEST);
+    Event_WatchFile(path);
+    snprintf(path, sizeof(path), "%s/%s", LIBRARY_PATH, LIBRARY_SELECT);
+    Event_WatchFile(path);
+    for(uint32_t i = 0; i < m_live->count; i++)
+    {
+        Event_WatchFile(m_live->entries[i].path);
+    }
+    printf("library: %u images, %llu KB locked in RAM, default %s\n", m_live->count,
+        (unsigned long long) (locked >> 10), (m_live->defaultIndex >= 0) ? m_live->entries[m_live->defaultIndex].name : "none");
+}
+
+/*******************************************************************************
+ * @brief library_release
+ *
+ * Release every image library holds and empty it
+ *
+ * @param  > LIBRARY_t* : library
+ *
+ * @return None
+ ******************************************************************************/
+static void library_release(LIBRARY_t* library)
+{
+    for(uint32_t i = 0; i < library->count; i++)
+    {
+        library_drop(&library->entries[i]);
+    }
+    library->count = 0;
+    library->defaultIndex = -1;
+}
+
+/*******************************************************************************
+ * @brief library_drop
+ *
+ * Unlock and release entry's image. Jobs still programming it keep their own
+ * reference.
+ *
+ * @param  > LIBRARY_Entry_t* : entry
+ *
+ * @return None
+ ******************************************************************************/
+static void library_drop(LIBRARY_Entry_t* entry)
+{
+    if(entry->image != NULL && entry->isLocked)
+    {
+        munlock(entry->image->data, entry->image->len);
+    }
+    Image_Release(entry->image);
+    entry->image = NULL;
+    entry->isLocked = false;
+}
+
+/*******************************************************************************
+ * @brief library_find
+ *
+ * Index of the entry named name
+ *
+ * @param  > const LIBRARY_Entry_t* : entries
+ *         > uint32_t : entry count
+ *         > const char* : name
+ *
+ * @return int32_t : index, -1 if none
+ ******************************************************************************/
+static int32_t library_find(const LIBRARY_Entry_t* entries, uint32_t count, const char* name)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(strcmp(entries[i].name, name) == 0)
+        {
+            return (int32_t) i;
+        }
+    }
+    return -1;
+}
+
+/*******************************************************************************
+ * @brief library_getStrap
+ *
+ * Fixture strap, bit n set when strap pin n is jumpered to ground
+ *
+ * @param  > None
+ *
+ * @return uint32_t
+ ******************************************************************************/
+static uint32_t library_getStrap(void)
+{
+    uint32_t strap = 0;
+    for(uint32_t i = 0; i < sizeof(m_strapPins) / sizeof(m_strapPins[0]); i++)
+    {
+        strap |= (digitalRead(m_strapPins[i]) == 0) ? (1u << i) : 0;
+    }
+    return strap;
+}
+
+// EOF
@@ -0,0 +1,64 @@
+/*******************************************************************************
+ *  @file Library.h
+ *
+ *  @brief Image library. A manifest in LIBRARY_PATH lists every product's
+ *         image and which tokens get it: by JEDEC ID and size, by the fixture
+ *         strap, or by control command. All of them are kept loaded and
+ *         locked in RAM so consecutive tokens can switch product for free.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _LIBRARY_H_
+#define _LIBRARY_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+#include "TokenDevice.h"
+#include "Image.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define LIBRARY_IMAGE_MAX       16
+#define LIBRARY_NAME_LEN        32
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+// Configure the strap pins. Call once @ startup.
+void Library_Init(void);
+
+// Load the manifest and the images it lists now, for the first token. With no
+// manifest the library is FILE_PATH alone. Returns false if the manifest is
+// malformed; no token is programmed until a good one loads.
+bool Library_Load(void);
+
+// Stage the next library on a worker thread: changed images are loaded,
+// decompressed and checked, unchanged ones shared. Posts EVENT_LIBRARY_STAGED.
+void Library_Stage(void);
+
+// Swap the staged library in if it is valid, between job starts. Returns true
+// if a new library went live; a bad update leaves the current one.
+bool Library_Swap(void);
+
+// Image for the token just identified as device, NULL if none applies. name
+// is set to its manifest name.
+IMAGE_t* Library_GetImage(const TOKEN_Device_t* device, const char** name);
+
+// Control command: program every token with the named image regardless of
+// part or strap. NULL or "" goes back to selecting per token. False if no
+// image has that name.
+bool Library_Select(const char* name);
+
+#endif /* _LIBRARY_H_ */
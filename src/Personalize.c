@@ -0,0 +1,598 @@
+/*******************************************************************************
+ *  @file Personalize.c
+ *
+ *  @brief Per-unit personalization. The field map is a text file, one field
+ *  per line:
+ *
+ *      # name     offset    len  source   argument
+ *      serial     0x2FF000  4    counter  100000
+ *      label      0x2FF004  16   text     PLUTO-{serial}
+ *      mfgDate    0x2FF014  8    text     {date}
+ *      cal        0x2FF020  32   csv      /home/pi/cal.csv 2
+ *      mode repersonalize
+ *
+ *  counter writes the unit serial number little-endian; its argument is the
+ *  first serial to hand out. text writes its template with {serial} and
+ *  {date} (YYYYMMDD) filled in, zero padded. csv writes the hex bytes in the
+ *  given column of the next row of the file, one row per unit. The next serial
+ *  and row are kept in PERSONALIZE_STATE_PATH.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Module Includes
+#include "Personalize.h"
+
+// Utility Includes
+
+// Driver Includes
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define PERSONALIZE_LINE_LEN        256
+#define PERSONALIZE_NAME_LEN        32
+#define PERSONALIZE_ARG_LEN         128
+#define PERSONALIZE_PATH_LEN        160
+#define PERSONALIZE_DATE_LEN        9   // YYYYMMDD
+#define PERSONALIZE_FIRST_SERIAL    1
+
+
+/*******************************************************************************
+ * Data Types Declarations
+ ******************************************************************************/
+
+typedef enum
+{
+    PERSONALIZE_SOURCE_COUNTER,
+    PERSONALIZE_SOURCE_TEXT,
+    PERSONALIZE_SOURCE_CSV,
+} PERSONALIZE_Source_t;
+
+typedef struct
+{
+    char name[PERSONALIZE_NAME_LEN];
+    uint32_t offset;
+    uint32_t len;
+    PERSONALIZE_Source_t source;
+    char arg[PERSONALIZE_ARG_LEN];  // text template, or csv file
+    uint32_t column;                // csv column, 0 first
+} PERSONALIZE_Field_t;
+
+static PERSONALIZE_Field_t m_fields[PERSONALIZE_FIELD_MAX];
+static uint32_t m_fieldCount = 0;
+static bool m_isValid = true;
+static bool m_isRework = false;
+static uint64_t m_nextSerial = PERSONALIZE_FIRST_SERIAL;
+static uint32_t m_nextRow = 0;
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Parse one map line into m_fields. False if malformed.
+static bool personalize_parseLine(char* line);
+
+// Load next serial and CSV row, never going back below firstSerial
+static void personalize_loadState(uint64_t firstSerial);
+
+// Persist next serial and CSV row. Temp file and rename, like the journal.
+static void personalize_saveState(void);
+
+// Fill value with field's bytes for serial
+static bool personalize_render(const PERSONALIZE_Field_t* field, uint64_t serial, PERSONALIZE_Value_t* value);
+
+// Decode the hex in column of row of field's CSV file into value
+static bool personalize_readCsv(const PERSONALIZE_Field_t* field, uint32_t row, PERSONALIZE_Value_t* value);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Personalize_Load
+ *
+ * Load the field map at path, replacing any loaded before. No map file means
+ * no personalization. A malformed map blocks programming rather than ship
+ * tokens with missing or misplaced fields.
+ *
+ * @param  > const char* : path
+ *
+ * @return bool : false if the map is malformed
+ ******************************************************************************/
+bool Personalize_Load(const char* path)
+{
+    m_fieldCount = 0;
+    m_isRework = false;
+    m_isValid = true;
+    FILE* fp = fopen(path, "r");
+    if(fp == NULL)
+    {
+        return true;
+    }
+
+    char line[PERSONALIZE_LINE_LEN];
+    uint32_t lineNumber = 0;
+    uint64_t firstSerial = PERSONALIZE_FIRST_SERIAL;
+    while(m_isValid && fgets(line, sizeof(line), fp) != NULL)
+    {
+        lineNumber++;
+        uint32_t count = m_fieldCount;
+        if(!personalize_parseLine(line))
+        {
+            printf("Error, personalization map %s line %u is malformed\n", path, lineNumber);
+            m_isValid = false;
+        }
+        else if(m_fieldCount > count && m_fields[count].source == PERSONALIZE_SOURCE_COUNTER && m_fields[count].arg[0] != '\0')
+        {
+            firstSerial = strtoull(m_fields[count].arg, NULL, 0);
+        }
+    }
+    fclose(fp);
+    for(uint32_t i = 0; m_isValid && i < m_fieldCount; i++)
+    {
+        for(uint32_t j = i + 1; j < m_fieldCount; j++)
+        {
+            if(m_fields[i].offset < m_fields[j].offset + m_fields[j].len &&
+               m_fields[j].offset < m_fields[i].offset + m_fields[i].len)
+            {
+                printf("Error, personalization fields %s and %s overlap\n", m_fields[i].name, m_fields[j].name);
+                m_isValid = false;
+            }
+        }
+    }
+    if(m_isValid)
+    {
+        personalize_loadState(firstSerial);
+        printf("personalization: %u fields, next serial %llu%s\n", m_fieldCount,
+            (unsigned long long) m_nextSerial, m_isRework ? ", re-personalizing" : "");
+    }
+    return m_isValid;
+}
+
+/*******************************************************************************
+ * @brief Personalize_IsRework
+ *
+ * Determine if the map asks for re-personalization (mode repersonalize):
+ * tokens already hold the common image and only the sectors holding fields
+ * are rewritten
+ *
+ * @param  > None
+ *
+ * @return bool
+ ******************************************************************************/
+bool Personalize_IsRework(void)
+{
+    return m_isRework && (m_fieldCount > 0);
+}
+
+/*******************************************************************************
+ * @brief Personalize_NextUnit
+ *
+ * Make the values for the next unit. Its serial number and CSV row are claimed
+ * and persisted before the token is touched, so a token that fails or is
+ * pulled part way burns them rather than risk two tokens sharing one.
+ *
+ * @param  > PERSONALIZE_Unit_t* : unit, count is 0 if nothing is personalized
+ *
+ * @return bool : false if the map is malformed or a source ran dry
+ ******************************************************************************/
+bool Personalize_NextUnit(PERSONALIZE_Unit_t* unit)
+{
+    memset(unit, 0, sizeof(PERSONALIZE_Unit_t));
+    if(!m_isValid || m_fieldCount == 0)
+    {
+        return m_isValid;
+    }
+
+    bool isMade = true;
+    bool usesCsv = false;
+    unit->serial = m_nextSerial;
+    for(uint32_t i = 0; isMade && i < m_fieldCount; i++)
+    {
+        PERSONALIZE_Value_t* value = &unit->values[i];
+        value->offset = m_fields[i].offset;
+        value->len = m_fields[i].len;
+        if(m_fields[i].source == PERSONALIZE_SOURCE_CSV)
+        {
+            usesCsv = true;
+            isMade = personalize_readCsv(&m_fields[i], m_nextRow, value);
+        }
+        else
+        {
+            isMade = personalize_render(&m_fields[i], unit->serial, value);
+        }
+    }
+    if(isMade)
+    {
+        unit->count = m_fieldCount;
+        m_nextSerial++;
+        m_nextRow += usesCsv ? 1 : 0;
+        personalize_saveState();
+    }
+    return isMade;
+}
+
+/*******************************************************************************
+ * @brief Personalize_GetFields
+ *
+ * Where every field lies, values zeroed, without claiming a serial number.
+ * For checking a token against the image while ignoring its own unit's bytes.
+ *
+ * @param  > PERSONALIZE_Unit_t* : unit to populate, count is 0 if nothing is
+ *           personalized
+ *
+ * @return None
+ ******************************************************************************/
+void Personalize_GetFields(PERSONALIZE_Unit_t* unit)
+{
+    memset(unit, 0, sizeof(PERSONALIZE_Unit_t));
+    if(!m_isValid)
+    {
+        return;
+    }
+    for(uint32_t i = 0; i < m_fieldCount; i++)
+    {
+        unit->values[i].offset = m_fields[i].offset;
+        unit->values[i].len = m_fields[i].len;
+    }
+    unit->count = m_fieldCount;
+}
+
+/*******************************************************************************
+ * @brief Personalize_Overlaps
+ *
+ * Determine if any of unit's fields fall in [address, address + len)
+ *
+ * @param  > const PERSONALIZE_Unit_t* : unit
+ *         > uint32_t : address
+ *         > uint32_t : len
+ *
+ * @return bool
+ ******************************************************************************/
+bool Personalize_Overlaps(const PERSONALIZE_Unit_t* unit, uint32_t address, uint32_t len)
+{
+    for(uint32_t i = 0; i < unit->count; i++)
+    {
+        if(unit->values[i].offset < address + len && address < unit->values[i].offset + unit->values[i].len)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * @brief Personalize_IsSameLayout
+ *
+ * Determine if unit and other have their fields in the same places. Their
+ * values may differ.
+ *
+ * @param  > const PERSONALIZE_Unit_t* : unit
+ *         > const PERSONALIZE_Unit_t* : other
+ *
+ * @return bool
+ ******************************************************************************/
+bool Personalize_IsSameLayout(const PERSONALIZE_Unit_t* unit, const PERSONALIZE_Unit_t* other)
+{
+    if(unit->count != other->count)
+    {
+        return false;
+    }
+    for(uint32_t i = 0; i < unit->count; i++)
+    {
+        if(unit->values[i].offset != other->values[i].offset || unit->values[i].len != other->values[i].len)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief Personalize_Apply
+ *
+ * Overwrite the parts of buf covered by unit's fields
+ *
+ * @param  > const PERSONALIZE_Unit_t* : unit
+ *         > uint32_t : address buf[0] is at
+ *         > uint8_t* : buf
+ *         > uint32_t : len
+ *
+ * @return None
+ ******************************************************************************/
+void Personalize_Apply(const PERSONALIZE_Unit_t* unit, uint32_t address, uint8_t* buf, uint32_t len)
+{
+    for(uint32_t i = 0; i < unit->count; i++)
+    {
+        const PERSONALIZE_Value_t* value = &unit->values[i];
+        uint32_t start = (value->offset > address) ? value->offset : address;
+        uint32_t end = MIN(value->offset + value->len, address + len);
+        if(start < end)
+        {
+            memcpy(buf + (start - address), value->data + (start - value->offset), end - start);
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief personalize_parseLine
+ *
+ * Parse one map line: "name offset len source argument", "mode program" or
+ * "mode repersonalize". Blank lines and # comments are skipped.
+ *
+ * @param  > char* : line
+ *
+ * @return bool : false if malformed
+ ******************************************************************************/
+static bool personalize_parseLine(char* line)
+{
+    char name[PERSONALIZE_NAME_LEN];
+    char offset[PERSONALIZE_NAME_LEN];
+    char len[PERSONALIZE_NAME_LEN];
+    char source[PERSONALIZE_NAME_LEN];
+    int argStart = 0;
+    line[strcspn(line, "\r\n")] = '\0';
+    int count = sscanf(line, "%31s %31s %31s %31s %n", name, offset, len, source, &argStart);
+    if(count <= 0 || name[0] == '#')
+    {
+        return true;
+    }
+    if(strcmp(name, "mode") == 0)
+    {
+        m_isRework = (count >= 2) && (strcmp(offset, "repersonalize") == 0);
+        return (count >= 2) && (m_isRework || strcmp(offset, "program") == 0);
+    }
+    if(count < 4 || m_fieldCount >= PERSONALIZE_FIELD_MAX)
+    {
+        return false;
+    }
+
+    PERSONALIZE_Field_t* field = &m_fields[m_fieldCount];
+    memset(field, 0, sizeof(PERSONALIZE_Field_t));
+    snprintf(field->name, sizeof(field->name), "%s", name);
+    field->offset = (uint32_t) strtoul(offset, NULL, 0);
+    field->len = (uint32_t) strtoul(len, NULL, 0);
+    snprintf(field->arg, sizeof(field->arg), "%s", line + argStart);
+    if(field->len == 0 || field->len > PERSONALIZE_FIELD_LEN_MAX)
+    {
+        return false;
+    }
+    if(strcmp(source, "counter") == 0)
+    {
+        field->source = PERSONALIZE_SOURCE_COUNTER;
+    }
+    else if(strcmp(source, "text") == 0 && field->arg[0] != '\0')
+    {
+        field->source = PERSONALIZE_SOURCE_TEXT;
+    }
+    else if(strcmp(source, "csv") == 0)
+    {
+        char* column = strrchr(field->arg, ' ');
+        if(column == NULL)
+        {
+            return false;
+        }
+        *column = '\0';
+        field->column = (uint32_t) strtoul(column + 1, NULL, 0);
+        field->source = PERSONALIZE_SOURCE_CSV;
+    }
+    else
+    {
+        return false;
+    }
+    m_fieldCount++;
+    return true;
+}
+
+/*******************************************************************************
+ * @brief personalize_loadState
+ *
+ * Load next serial and CSV row. A map whose counter starts above the saved
+ * serial moves it up; it never moves back down.
+ *
+ * @param  > uint64_t : first serial the map hands out
+ *
+ * @return None
+ ******************************************************************************/
+static void personalize_loadState(uint64_t firstSerial)
+{
+    unsigned long long serial = 0;
+    unsigned int row = 0;
+    FILE* fp = fopen(PERSONALIZE_STATE_PATH, "r");
+    if(fp != NULL)
+    {
+        if(fscanf(fp, "serial %llu row %u", &serial, &row) != 2)
+        {
+            printf("Error, personalization state %s is unreadable\n", PERSONALIZE_STATE_PATH);
+        }
+        fclose(fp);
+    }
+    m_nextSerial = (serial > firstSerial) ? serial : firstSerial;
+    m_nextRow = row;
+}
+
+/*******************************************************************************
+ * @brief personalize_saveState
+ *
+ * Persist next serial and CSV row
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+static void personalize_saveState(void)
+{
+    char tmpPath[PERSONALIZE_PATH_LEN];
+    char state[PERSONALIZE_LINE_LEN];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", PERSONALIZE_STATE_PATH);
+    int len = snprintf(state, sizeof(state), "serial %llu\nrow %u\n", (unsigned long long) m_nextSerial, m_nextRow);
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd >= 0)
+    {
+        bool isWritten = (write(fd, state, (size_t) len) == (ssize_t) len);
+        fsync(fd);
+        close(fd);
+        if(isWritten)
+        {
+            rename(tmpPath, PERSONALIZE_STATE_PATH);
+        }
+    }
+    else
+    {
+        printf("Error, unable to write personalization state %s\n", tmpPath);
+    }
+}
+
+/*******************************************************************************
+ * @brief personalize_render
+ *
+ * Fill value with a counter or text field's bytes for serial
+ *
+ * @param  > const PERSONALIZE_Field_t* : field
+ *         > uint64_t : serial
+ *         > PERSONALIZE_Value_t* : value, offset and len already set
+ *
+ * @return bool
+ ******************************************************************************/
+static bool personalize_render(const PERSONALIZE_Field_t* field, uint64_t serial, PERSONALIZE_Value_t* value)
+{
+    if(field->source == PERSONALIZE_SOURCE_COUNTER)
+    {
+        for(uint32_t i = 0; i < value->len && i < sizeof(serial); i++)
+        {
+            value->data[i] = (uint8_t) (serial >> (8 * i));
+        }
+        return true;
+    }
+
+    char date[PERSONALIZE_DATE_LEN];
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(date, sizeof(date), "%Y%m%d", &local);
+
+    uint32_t len = 0;
+    for(const char* t = field->arg; *t != '\0' && len < value->len; )
+    {
+        char expansion[PERSONALIZE_NAME_LEN] = "";
+        if(strncmp(t, "{serial}", 8) == 0)
+        {
+            snprintf(expansion, sizeof(expansion), "%llu", (unsigned long long) serial);
+            t += 8;
+        }
+        else if(strncmp(t, "{date}", 6) == 0)
+        {
+            snprintf(expansion, sizeof(expansion), "%s", date);
+            t += 6;
+        }
+        else
+        {
+            expansion[0] = *t++;
+            expansion[1] = '\0';
+        }
+        for(const char* e = expansion; *e != '\0' && len < value->len; e++)
+        {
+            value->data[len++] = (uint8_t) *e;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief personalize_readCsv
+ *
+ * Decode the hex in field's column of row of its CSV file. Blank lines and #
+ * comments don't count as rows. Short values are zero padded.
+ *
+ * @param  > const PERSONALIZE_Field_t* : field
+ *         > uint32_t : row, 0 first
+ *         > PERSONALIZE_Value_t* : value, offset and len already set
+ *
+ * @return bool : false if the file has run out of rows or the cell isn't hex
+ *         that fits
+ ******************************************************************************/
+static bool personalize_readCsv(const PERSONALIZE_Field_t* field, uint32_t row, PERSONALIZE_Value_t* value)
+{
+    FILE* fp = fopen(field->arg, "r");
+    if(fp == NULL)
+    {
+        printf("Error, unable to open %s for field %s\n", field->arg, field->name);
+        return false;
+    }
+
+    char line[PERSONALIZE_LINE_LEN];
+    char* cell = NULL;
+    uint32_t current = 0;
+    while(cell == NULL && fgets(line, sizeof(line), fp) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if(line[0] == '\0' || line[0] == '#' || current++ != row)
+        {
+            continue;
+        }
+        cell = line;
+        for(uint32_t column = 0; cell != NULL && column < field->column; column++)
+        {
+            cell = strchr(cell, ',');
+            cell = (cell != NULL) ? cell + 1 : NULL;
+        }
+        if(cell == NULL)
+        {
+            break;
+        }
+        cell[strcspn(cell, ",")] = '\0';
+    }
+    fclose(fp);
+    if(cell == NULL)
+    {
+        printf("Error, %s has no row %u column %u for field %s\n", field->arg, row, field->column, field->name);
+        return false;
+    }
+
+    uint32_t len = 0;
+    for(; *cell != '\0'; cell++)
+    {
+        if(isspace((unsigned char) *cell))
+        {
+            continue;
+        }
+        if(!isxdigit((unsigned char) cell[0]) || !isxdigit((unsigned char) cell[1]) || len >= value->len)
+        {
+            printf("Error, %s row %u field %s is not %u hex bytes\n", field->arg, row, field->name, value->len);
+            return false;
+        }
+        char byte[3] = { cell[0], cell[1], '\0' };
+        value->data[len++] = (uint8_t) strtoul(byte, NULL, 16);
+        cell++;
+    }
+    return true;
+}
+
+// EOF
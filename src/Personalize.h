@@ -0,0 +1,78 @@
+/*******************************************************************************
+ *  @file Personalize.h
+ *
+ *  @brief Per-unit personalization. A field map names byte ranges of the
+ *         common image (serial number, manufacturing date, calibration) and
+ *         where each unit's values come from. Values are merged into the page
+ *         stream as the token is programmed.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _PERSONALIZE_H_
+#define _PERSONALIZE_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define PERSONALIZE_FIELD_MAX       16
+#define PERSONALIZE_FIELD_LEN_MAX   64
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+// One field's bytes for one unit
+typedef struct
+{
+    uint32_t offset;
+    uint32_t len;
+    uint8_t data[PERSONALIZE_FIELD_LEN_MAX];
+} PERSONALIZE_Value_t;
+
+// Everything that differs between this unit and the common image
+typedef struct
+{
+    uint64_t serial;
+    uint32_t count;         // 0 = not personalized
+    PERSONALIZE_Value_t values[PERSONALIZE_FIELD_MAX];
+} PERSONALIZE_Unit_t;
+
+// Load the field map at path. No map file means no personalization. Returns
+// false if the map is malformed; units can't be made until a good map loads.
+bool Personalize_Load(const char* path);
+
+// Determine if the map asks for re-personalization of tokens that already hold
+// the common image instead of full programming
+bool Personalize_IsRework(void);
+
+// Make the values for the next unit. Its serial number (and CSV row) is
+// claimed and persisted at once so no two tokens ever share one.
+bool Personalize_NextUnit(PERSONALIZE_Unit_t* unit);
+
+// Where every field lies, values zeroed, without claiming a serial number
+void Personalize_GetFields(PERSONALIZE_Unit_t* unit);
+
+// Determine if any of unit's fields fall in [address, address + len)
+bool Personalize_Overlaps(const PERSONALIZE_Unit_t* unit, uint32_t address, uint32_t len);
+
+// Determine if unit and other have their fields in the same places
+bool Personalize_IsSameLayout(const PERSONALIZE_Unit_t* unit, const PERSONALIZE_Unit_t* other);
+
+// Overwrite the parts of buf, which holds [address, address + len), covered
+// by unit's fields
+void Personalize_Apply(const PERSONALIZE_Unit_t* unit, uint32_t address, uint8_t* buf, uint32_t len);
+
+#endif /* _PERSONALIZE_H_ */
@@ -0,0 +1,1439 @@
+/*******************************************************************************
+ *  @file Program.c
+ *
+ *  @brief Token programming engine. A job erases, writes and verifies an image
+ *         onto the token in one socket, resuming interrupted jobs from their
+ *         journal. Jobs never wait on the token; each Program_Step issues at
+ *         most one command so the scheduler can interleave sockets.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <string.h>
+
+// Module Includes
+#include "Program.h"
+#include "TokenFlash.h"
+#include "Delta.h"
+
+// Utility Includes
+
+// Driver Includes
+#include "Timer.h"
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define PROGRAM_RETRY_COUNT     5
+
+static uint8_t m_readBuf[TOKEN_FLASH_MAX_PAGE_LEN];
+static uint8_t m_checkBuf[TOKEN_FLASH_SUBSECTOR_LEN];   // sector being read back against its digest
+static uint8_t m_blockBuf[SOCKET_COUNT][TOKEN_FLASH_SECTOR_LEN]; // block being re-personalized, per socket
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Token accepted the current state's command. Wait for it to go ready.
+static void program_setBusy(PROGRAM_Job_t* job, uint32_t timeout, uint32_t holdoff);
+
+// Token finished the current state's command. Move to the next state.
+static void program_complete(PROGRAM_Job_t* job);
+
+// Issue the current state's command
+static bool program_issue(PROGRAM_Job_t* job);
+
+// Read back and compare the page just written
+static void program_verify(PROGRAM_Job_t* job);
+
+// Read back the next part of the sector just written. Check its digest once
+// all of it is in.
+static void program_checkSector(PROGRAM_Job_t* job);
+
+// Bytes to write to the current page: the image with the unit's fields applied
+static uint8_t* program_pageData(PROGRAM_Job_t* job);
+
+// Read the next part of the block about to be re-personalized. Apply the
+// unit's fields once all of it is in.
+static TOKEN_ErrCode_t program_readBlock(PROGRAM_Job_t* job);
+
+// Claim this token's personalization, or keep the one it holds. False if it
+// can't be made, read back or won't fit.
+static bool program_personalize(PROGRAM_Job_t* job, bool isKept);
+
+// Plan an upgrade from the version the token's journal says it holds. False
+// if there is none to plan from.
+static bool program_planDelta(PROGRAM_Job_t* job, const uint8_t* uid);
+
+// Determine if the page about to be written already holds the image
+static bool program_isPageMatched(PROGRAM_Job_t* job);
+
+// Determine if the page about to be written needs no programming at all
+static bool program_isPageSkipped(PROGRAM_Job_t* job);
+
+// Page passed. Move on to the next page or sector.
+static void program_pageDone(PROGRAM_Job_t* job);
+
+// Device flagged the command just completed as failed. Report where and end job.
+static void program_flagFailed(PROGRAM_Job_t* job, TOKEN_ErrCode_t err, uint32_t sector);
+
+// Move on to the next sector that still needs programming, or erasing past the image
+static void program_nextSector(PROGRAM_Job_t* job, uint32_t sector);
+
+// Erase the sectors past the image up to end too, as chip erase would have
+static void program_eraseTail(PROGRAM_Job_t* job, uint32_t end);
+
+// Sector being erased is done: write it, or move on past the image
+static void program_sectorErased(PROGRAM_Job_t* job);
+
+// First sector from sector that still needs programming
+static uint32_t program_findSector(const PROGRAM_Job_t* job, uint32_t sector);
+
+// Run the background erase of the next sector around the job's own commands
+static bool program_serviceErase(PROGRAM_Job_t* job);
+
+// Pages to write and verify each time the background erase is suspended
+static uint32_t program_suspendPages(PROGRAM_Job_t* job);
+
+// Suspend the background erase so the job's command can go out
+static void program_suspendErase(PROGRAM_Job_t* job);
+
+// Determine if the image data the next command needs has been decompressed
+static bool program_isDataReady(PROGRAM_Job_t* job);
+
+// Write or verify failed. Rewrite the page (a clone's sector) unless out of retries.
+static void program_retry(PROGRAM_Job_t* job, TOKEN_ErrCode_t err);
+
+// End job with err
+static void program_finish(PROGRAM_Job_t* job, TOKEN_ErrCode_t err);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Program_Start
+ *
+ * Start a job programming image onto the token in socket, which the caller
+ * has just identified (TokenDevice_Identify). Tokens are keyed by their
+ * unique ID; if a previous attempt on this token with this image was
+ * interrupted, the chip erase and every verified sector are skipped and only
+ * the first unverified sector, which may have been mid-program, is re-erased.
+ * A token that last passed with a known older image is upgraded by delta:
+ * only the sectors that differ are erased and rewritten. A token that passed
+ * before keeps the personalization it holds; only a fresh token claims a new
+ * unit. A job erasing sector by sector instead of the whole chip also erases
+ * the sectors past the image that an earlier image may have written, once the
+ * image is in.
+ * Parts without a unique ID are always programmed from scratch. EEPROM tokens
+ * skip erase and the journal; their pages are written in place. When the map
+ * asks for re-personalization the token already holds the image, so only the
+ * blocks holding fields are read, erased and rewritten, 4K at a time on parts
+ * with subsector erase.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *         > uint8_t : socket
+ *         > IMAGE_t* : image, a reference is held until the job finishes
+ *
+ * @return None
+ ******************************************************************************/
+void Program_Start(PROGRAM_Job_t* job, uint8_t socket, IMAGE_t* image)
+{
+    memset(job, 0, sizeof(PROGRAM_Job_t));
+    job->socket = socket;
+    job->image = Image_Acquire(image);
+    job->startTick = Timer_GetTick();
+    job->blockLen = TOKEN_FLASH_SECTOR_LEN;
+    job->sectorCount = (image->len + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN;
+    job->eraseSector = UINT32_MAX;
+    job->erasedSector = UINT32_MAX;
+    Token_SelectSocket(socket);
+    job->device = TokenDevice_Get();
+    job->canSuspend = PROGRAM_ERASE_SUSPEND && TokenDevice_Has(job->device, TOKEN_DEVICE_FLAG_ERASE_SUSPEND);
+    job->isSectorErase = job->canSuspend || image->hasHoles; // chip erase would wipe the holes
+    job->isFlagVerified = (PROGRAM_VERIFY_POLICY == PROGRAM_VERIFY_FLAGS) && TokenFlash_HasFailFlags();
+    if(image->len > job->device->size)
+    {
+        printf("socket %u image is %u bytes, token holds %u\n", socket, image->len, job->device->size);
+        program_finish(job, TOKEN_ERR_INVALID_INPUT);
+        return;
+    }
+
+    job->isInPlace = TokenDevice_Has(job->device, TOKEN_DEVICE_FLAG_NO_ERASE);
+    job->isRework = Personalize_IsRework();
+    uint8_t uid[TOKEN_FLASH_UNIQUE_ID_LEN];
+    uint64_t fromDigest = 0;
+    uint32_t fromLen = 0;
+    job->hasJournal = !job->isRework && !job->isInPlace && TokenFlash_ReadUniqueId(uid);
+    // A token that passed before keeps its unit; only a fresh one claims a serial
+    if(!program_personalize(job, job->hasJournal && Journal_GetCompleted(uid, &fromDigest, &fromLen)))
+    {
+        program_finish(job, TOKEN_ERR_INVALID_INPUT);
+        return;
+    }
+
+    if(job->isRework)
+    {
+        // Token already holds the image: no journal, no chip erase
+        bool hasSubsector = job->isInPlace || TokenDevice_Has(job->device, TOKEN_DEVICE_FLAG_4K_ERASE);
+        job->blockLen = hasSubsector ? TOKEN_FLASH_SUBSECTOR_LEN : TOKEN_FLASH_SECTOR_LEN;
+        job->sectorCount = (image->len + job->blockLen - 1) / job->blockLen;
+        job->canSuspend = false;
+        job->isSectorErase = !job->isInPlace;
+        program_nextSector(job, 0);
+        return;
+    }
+    if(job->isInPlace)
+    {
+        // EEPROM: nothing to erase, and no unique ID to journal against
+        program_nextSector(job, 0);
+        return;
+    }
+
+    bool isResumed = job->hasJournal && Journal_Open(&job->journal, uid, image);
+    if(!job->hasJournal)
+    {
+        printf("socket %u token has no unique ID, progress will not be journaled\n", socket);
+    }
+    if(isResumed)
+    {
+        job->isResumed = true;
+        job->isSectorErase |= !(job->journal.flags & JOURNAL_FLAG_ERASED);
+        program_eraseTail(job, (job->journal.flags & JOURNAL_FLAG_ERASED) ? 0 : job->device->size);
+        program_nextSector(job, 0);
+        if(!Program_IsDone(job))
+        {
+            printf("socket %u resuming at sector %u, re-erasing it\n", socket, job->sector);
+            job->state = PROGRAM_STATE_ERASE_SECTOR;
+        }
+    }
+    else if(job->hasJournal && program_planDelta(job, uid))
+    {
+        job->isSectorErase = true;
+        program_nextSector(job, 0);
+    }
+    else if(job->isSectorErase)
+    {
+        if(job->hasJournal)
+        {
+            Journal_MarkSectorErase(&job->journal);
+        }
+        program_eraseTail(job, job->device->size);
+        program_nextSector(job, 0);
+    }
+    else
+    {
+        job->state = PROGRAM_STATE_ERASE_ALL;
+    }
+}
+
+/*******************************************************************************
+ * @brief Program_StartVerify
+ *
+ * Start a job reading the token in socket back against image, page by page,
+ * without erasing or writing anything. The bytes the personalization map puts
+ * in each unit differ from token to token and are left out of the compare, as
+ * are the image's holes. The first mismatch fails the job.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *         > uint8_t : socket
+ *         > IMAGE_t* : image, a reference is held until the job finishes
+ *
+ * @return None
+ ******************************************************************************/
+void Program_StartVerify(PROGRAM_Job_t* job, uint8_t socket, IMAGE_t* image)
+{
+    memset(job, 0, sizeof(PROGRAM_Job_t));
+    job->socket = socket;
+    job->image = Image_Acquire(image);
+    job->startTick = Timer_GetTick();
+    job->blockLen = TOKEN_FLASH_SECTOR_LEN;
+    job->sectorCount = (image->len + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN;
+    job->eraseSector = UINT32_MAX;
+    job->erasedSector = UINT32_MAX;
+    job->isVerifyOnly = true;
+    Token_SelectSocket(socket);
+    job->device = TokenDevice_Get();
+    if(image->len > job->device->size)
+    {
+        printf("socket %u image is %u bytes, token holds %u\n", socket, image->len, job->device->size);
+        program_finish(job, TOKEN_ERR_INVALID_INPUT);
+        return;
+    }
+    Personalize_GetFields(&job->unit);
+    program_nextSector(job, 0);
+}
+
+/*******************************************************************************
+ * @brief Program_StartClone
+ *
+ * Start a job copying image onto the token in socket while image is still
+ * being read off a master token. The copy is exact: the personalization map
+ * is not applied. Nothing is journaled, as the master's digest isn't known
+ * until all of it has been read, so an interrupted clone starts over. Pages
+ * are not read back one by one; each sector, once written, is read back whole
+ * and its digest checked against the one taken as the master was read, so the
+ * master's data need only be held until every target has written the sector.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *         > uint8_t : socket
+ *         > IMAGE_t* : streamed image, a reference is held until the job finishes
+ *
+ * @return None
+ ******************************************************************************/
+void Program_StartClone(PROGRAM_Job_t* job, uint8_t socket, IMAGE_t* image)
+{
+    memset(job, 0, sizeof(PROGRAM_Job_t));
+    job->socket = socket;
+    job->image = Image_Acquire(image);
+    job->startTick = Timer_GetTick();
+    job->blockLen = TOKEN_FLASH_SECTOR_LEN;
+    job->sectorCount = (image->len + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN;
+    job->eraseSector = UINT32_MAX;
+    job->erasedSector = UINT32_MAX;
+    job->isDigestVerified = true;
+    Token_SelectSocket(socket);
+    job->device = TokenDevice_Get();
+    job->canSuspend = PROGRAM_ERASE_SUSPEND && TokenDevice_Has(job->device, TOKEN_DEVICE_FLAG_ERASE_SUSPEND);
+    job->isSectorErase = job->canSuspend;
+    job->isInPlace = TokenDevice_Has(job->device, TOKEN_DEVICE_FLAG_NO_ERASE);
+    if(image->len > job->device->size)
+    {
+        printf("socket %u master holds %u bytes, token holds %u\n", socket, image->len, job->device->size);
+        program_finish(job, TOKEN_ERR_INVALID_INPUT);
+        return;
+    }
+    if(job->isInPlace || job->isSectorErase)
+    {
+        program_nextSector(job, 0);
+    }
+    else
+    {
+        job->state = PROGRAM_STATE_ERASE_ALL;
+    }
+}
+
+/*******************************************************************************
+ * @brief Program_Step
+ *
+ * Advance job by at most one command. If the previous command is still running
+ * only its status is polled. A running background erase is suspended first;
+ * the command goes out on a later step, once the suspend has taken.
+ *
+ * @param  > PROGRAM_Job_t* : job, its socket must be selected
+ *
+ * @return bool : true if a command was issued, false if the token was busy
+ ******************************************************************************/
+bool Program_Step(PROGRAM_Job_t* job)
+{
+    bool isIssued = false;
+    job->isWaiting = false; // being stepped, not held back
+    if(Program_Poll(job))
+    {
+        if(job->erase == PROGRAM_ERASE_RUNNING)
+        {
+            program_suspendErase(job);
+        }
+        else
+        {
+            isIssued = program_issue(job);
+        }
+    }
+    job->isWaiting = false;
+    return isIssued;
+}
+
+/*******************************************************************************
+ * @brief Program_Poll
+ *
+ * Poll job's busy token without issuing anything. A token that has gone ready
+ * moves its job on to the next state. A job whose next page is still being
+ * decompressed isn't ready either.
+ *
+ * @param  > PROGRAM_Job_t* : job, its socket must be selected
+ *
+ * @return bool : true if job is ready for its next command
+ ******************************************************************************/
+bool Program_Poll(PROGRAM_Job_t* job)
+{
+    if(Program_IsDone(job))
+    {
+        return false;
+    }
+    if(Token_IsAborted())
+    {
+        program_finish(job, TOKEN_ERR_ABORTED);
+        return false;
+    }
+    if(job->isBusy)
+    {
+        if((job->busyHoldoff > 0) && !Timer_TimeoutExpired(job->busyStart, job->busyHoldoff))
+        {
+            return false;
+        }
+        if(Token_IsBusy())
+        {
+            if(Timer_TimeoutExpired(job->busyStart, job->busyTimeout))
+            {
+                program_finish(job, TOKEN_ERR_TIMEOUT);
+            }
+            return false;
+        }
+        job->isBusy = false;
+        TOKEN_ErrCode_t err = TokenFlash_CheckFailFlags();
+        if(err != TOKEN_ERR_OK)
+        {
+            program_flagFailed(job, err, (job->state == PROGRAM_STATE_ERASE_ALL) ? UINT32_MAX : job->sector);
+            return false;
+        }
+        program_complete(job);
+    }
+    if(job->canSuspend && !Program_IsDone(job) && !program_serviceErase(job))
+    {
+        job->isWaiting = false;
+        return false;
+    }
+    job->isWaiting = !Program_IsDone(job) && program_isDataReady(job);
+    return job->isWaiting;
+}
+
+/*******************************************************************************
+ * @brief Program_StepBroadcast
+ *
+ * Issue the next command of every job in jobs with one broadcast transfer. The
+ * first job leads: its command goes out with every job's chip select asserted
+ * and the others take on its busy state. If the leader's command failed the
+ * others are left ready and will issue it themselves. Background erases still
+ * running are suspended instead, and the command goes out on the next step.
+ *
+ * @param  > PROGRAM_Job_t** : jobs, all ready, same image, same position
+ *         > uint8_t : number of jobs
+ *
+ * @return None
+ ******************************************************************************/
+void Program_StepBroadcast(PROGRAM_Job_t** jobs, uint8_t count)
+{
+    PROGRAM_Job_t* leader = jobs[0];
+    uint32_t mask = 0;
+    bool isSuspending = false;
+    for(uint8_t i = 0; i < count; i++)
+    {
+        mask |= 1u << jobs[i]->socket;
+        jobs[i]->isWaiting = false;
+        if(jobs[i]->erase == PROGRAM_ERASE_RUNNING)
+        {
+            Token_SelectSocket(jobs[i]->socket);
+            program_suspendErase(jobs[i]);
+            isSuspending = true;
+        }
+    }
+    Token_SelectSocket(leader->socket);
+    if(isSuspending)
+    {
+        // Background erases are suspended first, the command goes out next step
+        return;
+    }
+    Token_SelectSockets(mask);
+    program_issue(leader);
+    Token_SelectSocket(leader->socket);
+    if(!leader->isBusy)
+    {
+        return;
+    }
+    for(uint8_t i = 1; i < count; i++)
+    {
+        jobs[i]->pageLen = leader->pageLen;
+        program_setBusy(jobs[i], leader->busyTimeout, leader->busyHoldoff);
+    }
+}
+
+/*******************************************************************************
+ * @brief Program_IsBroadcastable
+ *
+ * Determine if job's next command is write-only (erase or page program) and can
+ * be broadcast. Verify reads back and always runs per token, as do pages
+ * holding the token's own personalization and re-personalization as a whole.
+ *
+ * @param  > const PROGRAM_Job_t* : job
+ *
+ * @return bool
+ ******************************************************************************/
+bool Program_IsBroadcastable(const PROGRAM_Job_t* job)
+{
+    if(job->isBusy || job->isRework)
+    {
+        return false;
+    }
+    if(job->state == PROGRAM_STATE_WRITE)
+    {
+        uint32_t pageLen = job->device->pageLen - (job->address % job->device->pageLen);
+        return !Personalize_Overlaps(&job->unit, job->address, pageLen);
+    }
+    return (job->state == PROGRAM_STATE_ERASE_ALL) || (job->state == PROGRAM_STATE_ERASE_SECTOR);
+}
+
+/*******************************************************************************
+ * @brief Program_CanGang
+ *
+ * Determine if job and other can be ganged. Both must program the same image
+ * onto the same part from the start with the same plan: neither resumed from
+ * its journal, upgraded by delta or re-personalized, the same erase and the
+ * same personalization layout. Anything else starts at a different position
+ * or issues different commands, and runs alone.
+ *
+ * @param  > const PROGRAM_Job_t* : job
+ *         > const PROGRAM_Job_t* : other
+ *
+ * @return bool
+ ******************************************************************************/
+bool Program_CanGang(const PROGRAM_Job_t* job, const PROGRAM_Job_t* other)
+{
+    if(job->isResumed || job->isDelta || job->isRework || other->isResumed || other->isDelta || other->isRework)
+    {
+        return false;
+    }
+    return (job->image == other->image) && (job->device == other->device)
+        && (job->isSectorErase == other->isSectorErase) && (job->eraseCount == other->eraseCount)
+        && (job->isDigestVerified == other->isDigestVerified)
+        && Personalize_IsSameLayout(&job->unit, &other->unit);
+}
+
+/*******************************************************************************
+ * @brief Program_GetPosition
+ *
+ * Position of job in the erase/write/verify sequence. Chip erase comes first,
+ * then each page is read (first page of a re-personalized block only), erased
+ * (first page of a sector only), written and verified in address order. A
+ * clone's sector check comes after the sector's last page.
+ *
+ * @param  > const PROGRAM_Job_t* : job
+ *
+ * @return uint32_t : position, lower is earlier
+ ******************************************************************************/
+uint32_t Program_GetPosition(const PROGRAM_Job_t* job)
+{
+    uint32_t position = 0;
+    switch(job->state)
+    {
+        case PROGRAM_STATE_READ_BLOCK:
+            position = job->address * 4;
+            break;
+        case PROGRAM_STATE_ERASE_SECTOR:
+            position = job->address * 4 + 1;
+            break;
+        case PROGRAM_STATE_WRITE:
+            position = job->address * 4 + 2;
+            break;
+        case PROGRAM_STATE_VERIFY:
+            position = job->address * 4 + 3;
+            break;
+        case PROGRAM_STATE_CHECK_SECTOR:
+            position = MIN((job->sector + 1) * job->blockLen, job->image->len) * 4;
+            break;
+        default:
+            break;
+    }
+    return position;
+}
+
+/*******************************************************************************
+ * @brief Program_Cancel
+ *
+ * Abandon job (token removed, shutdown). Journal is kept for resume.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return None
+ ******************************************************************************/
+void Program_Cancel(PROGRAM_Job_t* job)
+{
+    if(!Program_IsDone(job) && job->state != PROGRAM_STATE_IDLE)
+    {
+        program_finish(job, TOKEN_ERR_ABORTED);
+    }
+}
+
+/*******************************************************************************
+ * @brief Program_IsDone
+ *
+ * Determine if job has finished (passed or failed)
+ *
+ * @param  > const PROGRAM_Job_t* : job
+ *
+ * @return bool
+ ******************************************************************************/
+bool Program_IsDone(const PROGRAM_Job_t* job)
+{
+    return (job->state == PROGRAM_STATE_PASSED) || (job->state == PROGRAM_STATE_FAILED);
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief program_setBusy
+ *
+ * Token accepted the current state's command. Wait for it to go ready.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *         > uint32_t : timeout (ms)
+ *         > uint32_t : holdoff before first status poll (ms)
+ *
+ * @return None
+ ******************************************************************************/
+static void program_setBusy(PROGRAM_Job_t* job, uint32_t timeout, uint32_t holdoff)
+{
+    job->isBusy = true;
+    job->busyStart = Timer_GetTick();
+    job->busyTimeout = timeout;
+    job->busyHoldoff = holdoff;
+}
+
+/*******************************************************************************
+ * @brief program_complete
+ *
+ * Token finished the current state's command. Move to the next state.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return None
+ ******************************************************************************/
+static void program_complete(PROGRAM_Job_t* job)
+{
+    switch(job->state)
+    {
+        case PROGRAM_STATE_ERASE_ALL:
+            if(job->hasJournal)
+            {
+                Journal_MarkErased(&job->journal);
+            }
+            program_nextSector(job, 0);
+            break;
+        case PROGRAM_STATE_ERASE_SECTOR:
+            program_sectorErased(job);
+            break;
+        case PROGRAM_STATE_WRITE:
+            if(job->isFlagVerified || job->isDigestVerified)
+            {
+                program_pageDone(job);
+            }
+            else
+            {
+                job->state = PROGRAM_STATE_VERIFY;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*******************************************************************************
+ * @brief program_issue
+ *
+ * Issue the current state's command
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return bool : true if a command was issued
+ ******************************************************************************/
+static bool program_issue(PROGRAM_Job_t* job)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_OK;
+    uint32_t end = 0;
+    switch(job->state)
+    {
+        case PROGRAM_STATE_ERASE_ALL:
+            err = TokenFlash_EraseAll();
+            program_setBusy(job, job->device->timing.chipErase, job->device->timing.chipEraseHoldoff);
+            break;
+        case PROGRAM_STATE_READ_BLOCK:
+            err = program_readBlock(job);
+            break;
+        case PROGRAM_STATE_ERASE_SECTOR:
+            if(job->blockLen == TOKEN_FLASH_SUBSECTOR_LEN)
+            {
+                err = TokenFlash_StartEraseSubsector(job->sector * job->blockLen);
+            }
+            else
+            {
+                err = TokenFlash_StartEraseSector(job->sector * job->blockLen);
+            }
+            program_setBusy(job, job->device->timing.sectorErase, 0);
+            break;
+        case PROGRAM_STATE_WRITE:
+            end = MIN((job->sector + 1) * job->blockLen, job->image->len);
+            job->pageLen = MIN(job->device->pageLen - (job->address % job->device->pageLen), end - job->address);
+            if(job->isInPlace && !Token_IsBroadcast() && program_isPageMatched(job))
+            {
+                job->pagesMatched++;
+                program_pageDone(job);
+                break;
+            }
+            if(program_isPageSkipped(job))
+            {
+                program_pageDone(job);
+                break;
+            }
+            err = TokenFlash_StartWritePage(job->address, program_pageData(job), job->pageLen);
+            if(err != TOKEN_ERR_OK)
+            {
+                program_retry(job, err);
+                return true;
+            }
+            program_setBusy(job, job->device->timing.pageProgram, 0);
+            break;
+        case PROGRAM_STATE_VERIFY:
+            if(job->isVerifyOnly)
+            {
+                end = MIN((job->sector + 1) * job->blockLen, job->image->len);
+                job->pageLen = MIN(job->device->pageLen - (job->address % job->device->pageLen), end - job->address);
+                if(Image_GetClass(job->image, job->address, job->pageLen) == IMAGE_CLASS_HOLE)
+                {
+                    program_pageDone(job);
+                    break;
+                }
+            }
+            program_verify(job);
+            break;
+        case PROGRAM_STATE_CHECK_SECTOR:
+            program_checkSector(job);
+            break;
+        default:
+            return false;
+    }
+    if(err != TOKEN_ERR_OK)
+    {
+        program_finish(job, err);
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief program_verify
+ *
+ * Read back and compare the page just written. A verify-only job compares
+ * the page as it stands, with the unit's fields blanked out on both sides.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return None
+ ******************************************************************************/
+static void program_verify(PROGRAM_Job_t* job)
+{
+    TOKEN_ErrCode_t err = TokenFlash_Read(job->address, m_readBuf, job->pageLen);
+    if(job->isVerifyOnly)
+    {
+        Personalize_Apply(&job->unit, job->address, m_readBuf, job->pageLen);
+    }
+    if(err == TOKEN_ERR_OK && memcmp(program_pageData(job), m_readBuf, job->pageLen) != 0)
+    {
+        printf("socket %u verify failed at 0x%08X\n", job->socket, job->address);
+        err = TOKEN_ERR_TIMEOUT;
+    }
+    if(err != TOKEN_ERR_OK)
+    {
+        program_retry(job, err);
+        return;
+    }
+    program_pageDone(job);
+}
+
+/*******************************************************************************
+ * @brief program_checkSector
+ *
+ * Read back the next subsector of the sector a clone just wrote, keeping each
+ * transfer within spidev's default buffer, and digest it. Once the whole
+ * sector is in its digest must match the master's; a mismatch rewrites the
+ * sector.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return None
+ ******************************************************************************/
+static void program_checkSector(PROGRAM_Job_t* job)
+{
+    uint32_t end = MIN((job->sector + 1) * job->blockLen, job->image->len);
+    uint32_t len = MIN(TOKEN_FLASH_SUBSECTOR_LEN, end - job->address);
+    TOKEN_ErrCode_t err = TokenFlash_Read(job->address, m_checkBuf, len);
+    if(err != TOKEN_ERR_OK)
+    {
+        program_retry(job, err);
+        return;
+    }
+    job->checkDigest = Image_Digest(job->checkDigest, m_checkBuf, len);
+    job->address += len;
+    if(job->address < end)
+    {
+        return;
+    }
+    if(job->checkDigest != job->image->sectorDigests[job->sector])
+    {
+        printf("socket %u sector %u does not match the master\n", job->socket, job->sector);
+        job->address = job->sector * job->blockLen;
+        program_retry(job, TOKEN_ERR_TIMEOUT);
+        return;
+    }
+    job->retries = 0;
+    program_nextSector(job, job->sector + 1);
+}
+
+/*******************************************************************************
+ * @brief program_isPageMatched
+ *
+ * Determine if the page about to be written already holds the image. An
+ * EEPROM page is rewritten in place, so a token re-programmed with much the
+ * same image skips the ~5 ms write cycle (and the wear) of every page that
+ * hasn't changed for the cost of one page read. A failed read just means the
+ * page is written.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return bool
+ ******************************************************************************/
+static bool program_isPageMatched(PROGRAM_Job_t* job)
+{
+    return (TokenFlash_Read(job->address, m_readBuf, job->pageLen) == TOKEN_ERR_OK) &&
+        (memcmp(program_pageData(job), m_readBuf, job->pageLen) == 0);
+}
+
+/*******************************************************************************
+ * @brief program_isPageSkipped
+ *
+ * Determine if the page about to be written needs no programming at all: it
+ * is a don't-care hole, or it is blank and its sector was just erased. Sparse
+ * images mark their blank fills; a delta upgrade checks the bytes. Pages
+ * holding the unit's fields are always written.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return bool
+ ******************************************************************************/
+static bool program_isPageSkipped(PROGRAM_Job_t* job)
+{
+    if(job->isRework || Personalize_Overlaps(&job->unit, job->address, job->pageLen))
+    {
+        return false;
+    }
+    IMAGE_Class_t type = Image_GetClass(job->image, job->address, job->pageLen);
+    bool isErased = !job->isInPlace;
+    return (type == IMAGE_CLASS_HOLE) || (isErased && (type == IMAGE_CLASS_BLANK ||
+        (job->isDelta && Image_IsBlank(Image_GetData(job->image, job->address), job->pageLen))));
+}
+
+/*******************************************************************************
+ * @brief program_pageData
+ *
+ * Bytes to write to the current page. Pages clear of the unit's fields come
+ * straight from the image; the rest are copied and have the fields applied. A
+ * re-personalized block comes from what was read off the token.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return uint8_t* : job->pageLen bytes
+ ******************************************************************************/
+static uint8_t* program_pageData(PROGRAM_Job_t* job)
+{
+    if(job->isRework)
+    {
+        return m_blockBuf[job->socket] + (job->address - job->sector * job->blockLen);
+    }
+    if(!Personalize_Overlaps(&job->unit, job->address, job->pageLen))
+    {
+        return Image_GetData(job->image, job->address);
+    }
+    memcpy(job->pageBuf, Image_GetData(job->image, job->address), job->pageLen);
+    Personalize_Apply(&job->unit, job->address, job->pageBuf, job->pageLen);
+    return job->pageBuf;
+}
+
+/*******************************************************************************
+ * @brief program_readBlock
+ *
+ * Read the next subsector of the block about to be re-personalized, keeping
+ * each transfer within spidev's default buffer. Once the whole block is in,
+ * the unit's fields are applied to it; everything else in the block is
+ * written back as the token held it.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t program_readBlock(PROGRAM_Job_t* job)
+{
+    uint8_t* block = m_blockBuf[job->socket];
+    uint32_t start = job->sector * job->blockLen;
+    uint32_t end = MIN(start + job->blockLen, job->image->len);
+    uint32_t len = MIN(TOKEN_FLASH_SUBSECTOR_LEN, end - job->address);
+    TOKEN_ErrCode_t err = TokenFlash_Read(job->address, block + (job->address - start), len);
+    job->address += len;
+    if(err == TOKEN_ERR_OK && job->address >= end)
+    {
+        Personalize_Apply(&job->unit, start, block, end - start);
+        job->address = start;
+        job->state = job->isSectorErase ? PROGRAM_STATE_ERASE_SECTOR : PROGRAM_STATE_WRITE;
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief program_personalize
+ *
+ * Claim this token's personalization. Every field must land inside the image,
+ * which is the only part of the token that gets written. A token that already
+ * passed with an earlier image keeps its unit: its fields are read back from
+ * the token and written again as they are, and no serial is claimed.
+ *
+ * @param  > PROGRAM_Job_t* : job, its socket must be selected
+ *         > bool : isKept, keep the unit the token holds
+ *
+ * @return bool : false if it can't be made, read back or won't fit
+ ******************************************************************************/
+static bool program_personalize(PROGRAM_Job_t* job, bool isKept)
+{
+    if(isKept)
+    {
+        Personalize_GetFields(&job->unit);
+    }
+    else if(!Personalize_NextUnit(&job->unit))
+    {
+        printf("socket %u unable to personalize token\n", job->socket);
+        return false;
+    }
+    for(uint32_t i = 0; i < job->unit.count; i++)
+    {
+        if(job->unit.values[i].offset + job->unit.values[i].len > job->image->len)
+        {
+            printf("socket %u personalization at 0x%08X is outside the image\n", job->socket, job->unit.values[i].offset);
+            return false;
+        }
+        if(isKept && TokenFlash_Read(job->unit.values[i].offset, job->unit.values[i].data, job->unit.values[i].len) != TOKEN_ERR_OK)
+        {
+            printf("socket %u unable to read back its personalization\n", job->socket);
+            return false;
+        }
+    }
+    job->isUnitKept = isKept && (job->unit.count > 0);
+    return true;
+}
+
+/*******************************************************************************
+ * @brief program_pageDone
+ *
+ * Page passed, by readback or by the device's fail flags. A sector is journaled
+ * once its last page passes. A clone's pages are only written here; the
+ * sector is read back against its digest once the last is, and its retries
+ * count for the whole sector, since a mismatch rewrites all of it.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return None
+ ******************************************************************************/
+static void program_pageDone(PROGRAM_Job_t* job)
+{
+    job->retries = job->isDigestVerified ? job->retries : 0;
+    job->suspendPages++;
+    job->bytesDone += job->pageLen;
+    job->address += job->pageLen;
+    if(job->address >= MIN((job->sector + 1) * job->blockLen, job->image->len))
+    {
+        if(job->isDigestVerified)
+        {
+            job->state = PROGRAM_STATE_CHECK_SECTOR;
+            job->address = job->sector * job->blockLen;
+            job->checkDigest = IMAGE_DIGEST_SEED;
+            return;
+        }
+        if(job->hasJournal)
+        {
+            Journal_MarkVerified(&job->journal, job->sector);
+        }
+        program_nextSector(job, job->sector + 1);
+    }
+    else
+    {
+        job->state = job->isVerifyOnly ? PROGRAM_STATE_VERIFY : PROGRAM_STATE_WRITE;
+    }
+}
+
+/*******************************************************************************
+ * @brief program_planDelta
+ *
+ * Plan an upgrade from the version the token's journal says it last passed
+ * with. Sectors the plan leaves alone are journaled as verified up front, so
+ * the job erases and writes only the rest. A token already holding this image
+ * is programmed in full: it is being reprogrammed for a reason. So is any
+ * token started while the image is still being decompressed.
+ *
+ * @param  > PROGRAM_Job_t* : job, journal freshly opened
+ *         > const uint8_t* : token unique ID
+ *
+ * @return bool : false if there is nothing to plan from
+ ******************************************************************************/
+static bool program_planDelta(PROGRAM_Job_t* job, const uint8_t* uid)
+{
+    uint64_t fromDigest = 0;
+    uint32_t fromLen = 0;
+    if(Image_GetReady(job->image) < job->image->len || !Journal_GetCompleted(uid, &fromDigest, &fromLen)
+        || fromDigest == job->image->digest)
+    {
+        return false;
+    }
+    const DELTA_Plan_t* plan = Delta_GetPlan(fromDigest, fromLen, job->image, job->device->pageLen);
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    Delta_GetStats(&hits, &misses);
+    if(plan == NULL)
+    {
+        printf("socket %u holds unknown image %016llX, programming in full (plans %u hit, %u missed)\n",
+            job->socket, (unsigned long long) fromDigest, hits, misses);
+        return false;
+    }
+    printf("socket %u upgrading from image %016llX: %u of %u sectors, %u pages (plans %u hit, %u missed)\n",
+        job->socket, (unsigned long long) fromDigest, plan->changedCount, plan->sectorCount, plan->pageCount, hits, misses);
+    Journal_MarkUnchanged(&job->journal, plan->changed, job->sectorCount);
+    program_eraseTail(job, fromLen); // the old image left nothing past its own end
+    job->isDelta = true;
+    return true;
+}
+
+/*******************************************************************************
+ * @brief program_nextSector
+ *
+ * Move on to the next sector from sector that still needs programming. Sectors
+ * verified by an earlier attempt are skipped. One that is reprogrammed anyway
+ * for the unit's fields is erased first. Past the image, sectors up to
+ * eraseCount are only erased. Passes the job once none remain.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *         > uint32_t : first candidate sector
+ *
+ * @return None
+ ******************************************************************************/
+static void program_nextSector(PROGRAM_Job_t* job, uint32_t sector)
+{
+    uint32_t next = program_findSector(job, sector);
+    for(; sector < next; sector++)
+    {
+        job->bytesDone += MIN(job->blockLen, job->image->len - sector * job->blockLen);
+    }
+    if(sector < job->sectorCount)
+    {
+        job->sector = sector;
+        job->address = sector * job->blockLen;
+        if(job->isVerifyOnly)
+        {
+            job->state = PROGRAM_STATE_VERIFY;
+        }
+        else if(job->isRework)
+        {
+            job->state = PROGRAM_STATE_READ_BLOCK;
+        }
+        else if(job->isSectorErase || (job->hasJournal && Journal_IsVerified(&job->journal, sector)))
+        {
+            job->state = PROGRAM_STATE_ERASE_SECTOR;
+        }
+        else
+        {
+            job->state = PROGRAM_STATE_WRITE;
+        }
+    }
+    else if(sector < job->eraseCount)
+    {
+        job->sector = sector;
+        job->address = sector * job->blockLen;
+        job->state = PROGRAM_STATE_ERASE_SECTOR;
+    }
+    else
+    {
+        program_finish(job, TOKEN_ERR_OK);
+    }
+}
+
+/*******************************************************************************
+ * @brief program_eraseTail
+ *
+ * Erase the sectors past the image up to end as well, which chip erase would
+ * have cleared of whatever an earlier image left there. An image with holes
+ * leaves the rest of the token alone, as it does its holes.
+ *
+ * @param  > PROGRAM_Job_t* : job, erasing sector by sector
+ *         > uint32_t : end of what may be stale, 0 for nothing
+ *
+ * @return None
+ ******************************************************************************/
+static void program_eraseTail(PROGRAM_Job_t* job, uint32_t end)
+{
+    end = MIN(end, job->device->size);
+    if(!job->image->hasHoles && end > job->image->len)
+    {
+        job->eraseCount = (end + TOKEN_FLASH_SECTOR_LEN - 1) / TOKEN_FLASH_SECTOR_LEN;
+    }
+}
+
+/*******************************************************************************
+ * @brief program_sectorErased
+ *
+ * The sector being erased is done. An image sector is written next; a sector
+ * past the image was only erased, so the job moves on.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return None
+ ******************************************************************************/
+static void program_sectorErased(PROGRAM_Job_t* job)
+{
+    if(job->sector < job->sectorCount)
+    {
+        job->state = PROGRAM_STATE_WRITE;
+    }
+    else
+    {
+        program_nextSector(job, job->sector + 1);
+    }
+}
+
+/*******************************************************************************
+ * @brief program_findSector
+ *
+ * First sector from sector that still needs programming. A verified sector
+ * still needs it if it holds fields: they were written with another unit's
+ * values. A sparse image's sectors of holes are never touched.
+ * Re-personalization only needs the blocks holding fields.
+ *
+ * @param  > const PROGRAM_Job_t* : job
+ *         > uint32_t : first candidate sector
+ *
+ * @return uint32_t : sector, sectorCount if none remain
+ ******************************************************************************/
+static uint32_t program_findSector(const PROGRAM_Job_t* job, uint32_t sector)
+{
+    for(; sector < job->sectorCount; sector++)
+    {
+        uint32_t start = sector * job->blockLen;
+        bool hasFields = Personalize_Overlaps(&job->unit, start, job->blockLen);
+        bool isHole = Image_GetClass(job->image, start, MIN(job->blockLen, job->image->len - start)) == IMAGE_CLASS_HOLE;
+        bool isDone = job->isRework ? !hasFields :
+            (((job->hasJournal && Journal_IsVerified(&job->journal, sector)) || isHole) && !hasFields);
+        if(!isDone)
+        {
+            break;
+        }
+    }
+    return MIN(sector, job->sectorCount);
+}
+
+/*******************************************************************************
+ * @brief program_serviceErase
+ *
+ * Run the background erase of the next sector around the job's own commands.
+ * While a sector is being written and verified the next one is erased. The
+ * erase is only suspended once it has run PROGRAM_ERASE_RUN_MIN and the job's
+ * command is actually going out, then stays suspended for a batch of pages.
+ * It is resumed as soon as the job waits on the image or is held back behind
+ * other sockets. Each resume restarts part of the erase, so once the part's
+ * eraseSuspendMax suspends are used up the erase runs to the end and the job
+ * waits for it.
+ *
+ * @param  > PROGRAM_Job_t* : job, its socket must be selected
+ *
+ * @return bool : true if the job's own command may be issued now, once a
+ *                running erase is suspended (Program_Step)
+ ******************************************************************************/
+static bool program_serviceErase(PROGRAM_Job_t* job)
+{
+    // A foreground erase waits for the background one, whichever sector it is on
+    bool isNeeded = (job->state == PROGRAM_STATE_ERASE_SECTOR);
+    TOKEN_ErrCode_t err = TOKEN_ERR_OK;
+    switch(job->erase)
+    {
+        case PROGRAM_ERASE_NONE:
+            if((job->state == PROGRAM_STATE_ERASE_SECTOR) && (job->sector == job->erasedSector))
+            {
+                program_sectorErased(job);
+                return program_serviceErase(job);
+            }
+            else if((job->state == PROGRAM_STATE_WRITE) || (job->state == PROGRAM_STATE_VERIFY)
+                || (job->state == PROGRAM_STATE_CHECK_SECTOR))
+            {
+                uint32_t next = program_findSector(job, job->sector + 1);
+                if((next < job->sectorCount || next < job->eraseCount) && next != job->erasedSector)
+                {
+                    err = TokenFlash_StartEraseSector(next * TOKEN_FLASH_SECTOR_LEN);
+                    job->erase = PROGRAM_ERASE_RUNNING;
+                    job->eraseSector = next;
+                    job->eraseStart = Timer_GetTick();
+                    job->eraseRunTime = 0;
+                    job->eraseSuspends = 0;
+                    break;
+                }
+            }
+            return true;
+        case PROGRAM_ERASE_RUNNING:
+            if(!Token_IsBusy())
+            {
+                err = TokenFlash_CheckFailFlags();
+                if(err != TOKEN_ERR_OK)
+                {
+                    program_flagFailed(job, err, job->eraseSector);
+                    return false;
+                }
+                job->erase = PROGRAM_ERASE_NONE;
+                job->erasedSector = job->eraseSector;
+                job->eraseSector = UINT32_MAX;
+                return program_serviceErase(job);
+            }
+            if(Timer_TimeoutExpired(job->eraseStart, job->device->timing.sectorErase - MIN(job->eraseRunTime, job->device->timing.sectorErase)))
+            {
+                err = TOKEN_ERR_TIMEOUT;
+            }
+            else if(!isNeeded && (job->eraseSuspends < job->device->timing.eraseSuspendMax)
+                && Timer_TimeoutExpired(job->eraseStart, PROGRAM_ERASE_RUN_MIN))
+            {
+                // Suspended by Program_Step once the job's command actually goes out
+                return true;
+            }
+            break;
+        case PROGRAM_ERASE_SUSPENDING:
+            if(!Token_IsBusy())
+            {
+                job->erase = PROGRAM_ERASE_SUSPENDED;
+                return true;
+            }
+            if(Timer_TimeoutExpired(job->eraseStart, TOKEN_FLASH_ERASE_SUSPEND_TIME))
+            {
+                err = TOKEN_ERR_TIMEOUT;
+            }
+            break;
+        case PROGRAM_ERASE_SUSPENDED:
+            // Held back behind other sockets, the erase runs while suspends are left
+            if(!isNeeded && (job->suspendPages < program_suspendPages(job)) && program_isDataReady(job)
+                && (!job->isWaiting || (job->eraseSuspends >= job->device->timing.eraseSuspendMax)))
+            {
+                return true;
+            }
+            if(Program_IsDone(job))
+            {
+                return false;
+            }
+            err = TokenFlash_ResumeErase();
+            job->erase = PROGRAM_ERASE_RUNNING;
+            job->eraseStart = Timer_GetTick();
+            break;
+        default:
+            break;
+    }
+    if(err != TOKEN_ERR_OK)
+    {
+        program_finish(job, err);
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * @brief program_suspendPages
+ *
+ * Pages to write and verify each time the background erase is suspended,
+ * spreading a sector's pages over the suspends the part allows.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return uint32_t : pages per suspend
+ ******************************************************************************/
+static uint32_t program_suspendPages(PROGRAM_Job_t* job)
+{
+    uint32_t pages = job->blockLen / job->device->pageLen;
+    uint32_t suspends = job->device->timing.eraseSuspendMax;
+    return (suspends > 0) ? (pages + suspends - 1) / suspends : pages;
+}
+
+/*******************************************************************************
+ * @brief program_suspendErase
+ *
+ * Suspend the background erase so the job's command can go out. The command
+ * is issued on a later step, once the suspend has taken.
+ *
+ * @param  > PROGRAM_Job_t* : job, its socket must be selected
+ *
+ * @return None
+ ******************************************************************************/
+static void program_suspendErase(PROGRAM_Job_t* job)
+{
+    TOKEN_ErrCode_t err = TokenFlash_SuspendErase();
+    job->erase = PROGRAM_ERASE_SUSPENDING;
+    job->eraseSuspends++;
+    job->suspendPages = 0;
+    job->eraseRunTime += Timer_GetTick() - job->eraseStart;
+    job->eraseStart = Timer_GetTick();
+    if(err != TOKEN_ERR_OK)
+    {
+        program_finish(job, err);
+    }
+}
+
+/*******************************************************************************
+ * @brief program_isDataReady
+ *
+ * Determine if the image data the next command needs has been decompressed,
+ * or read off a clone's master. Only writes and verifies read the image; a
+ * sector check needs the sector's digest. A job held here just yields the
+ * bus to the other sockets. If decompression failed, or the master was
+ * removed, the data never comes, so the job fails.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *
+ * @return bool
+ ******************************************************************************/
+static bool program_isDataReady(PROGRAM_Job_t* job)
+{
+    uint32_t needed = 0;
+    if(job->state == PROGRAM_STATE_WRITE || job->state == PROGRAM_STATE_VERIFY)
+    {
+        needed = MIN(job->address + job->device->pageLen, job->image->len);
+    }
+    else if(job->state == PROGRAM_STATE_CHECK_SECTOR)
+    {
+        needed = MIN((job->sector + 1) * job->blockLen, job->image->len);
+    }
+    if(Image_GetReady(job->image) >= needed)
+    {
+        return true;
+    }
+    if(Image_IsFailed(job->image))
+    {
+        program_finish(job, TOKEN_ERR_INVALID_INPUT);
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * @brief program_flagFailed
+ *
+ * Device flagged the command just completed as failed. A flagged page or
+ * sector won't come good on a retry, so report exactly where and end the job
+ * without reading anything back.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *         > TOKEN_ErrCode_t : err from TokenFlash_CheckFailFlags
+ *         > uint32_t : sector the erase was on, UINT32_MAX for chip erase
+ *
+ * @return None
+ ******************************************************************************/
+static void program_flagFailed(PROGRAM_Job_t* job, TOKEN_ErrCode_t err, uint32_t sector)
+{
+    if(err == TOKEN_ERR_PROGRAM_FAILED)
+    {
+        printf("socket %u program failed at page 0x%08X\n", job->socket, job->address);
+    }
+    else if(err == TOKEN_ERR_ERASE_FAILED && sector == UINT32_MAX)
+    {
+        printf("socket %u chip erase failed\n", job->socket);
+    }
+    else if(err == TOKEN_ERR_ERASE_FAILED)
+    {
+        printf("socket %u erase failed at sector %u (0x%08X)\n", job->socket, sector, sector * job->blockLen);
+    }
+    program_finish(job, err);
+}
+
+/*******************************************************************************
+ * @brief program_retry
+ *
+ * Write or verify failed. Rewrite the page unless out of retries. A
+ * verify-only job has nothing to rewrite and fails at once. A clone sector
+ * that failed its check is erased again and rewritten from its first page,
+ * since a page program can't set the bits that came out wrong (EEPROM is
+ * rewritten in place); the master's data for it is held until it passes.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *         > TOKEN_ErrCode_t : error that caused the retry
+ *
+ * @return None
+ ******************************************************************************/
+static void program_retry(PROGRAM_Job_t* job, TOKEN_ErrCode_t err)
+{
+    if(err == TOKEN_ERR_ABORTED || Token_IsAborted())
+    {
+        program_finish(job, TOKEN_ERR_ABORTED);
+    }
+    else if(job->isVerifyOnly || ++job->retries >= PROGRAM_RETRY_COUNT)
+    {
+        program_finish(job, err);
+    }
+    else
+    {
+        job->retryCount++;
+        if(job->state == PROGRAM_STATE_CHECK_SECTOR)
+        {
+            job->address = job->sector * job->blockLen;
+            job->bytesDone -= MIN(job->blockLen, job->image->len - job->address);
+            if(!job->isInPlace)
+            {
+                job->erasedSector = (job->erasedSector == job->sector) ? UINT32_MAX : job->erasedSector;
+                job->state = PROGRAM_STATE_ERASE_SECTOR;
+                return;
+            }
+        }
+        job->state = PROGRAM_STATE_WRITE;
+    }
+}
+
+/*******************************************************************************
+ * @brief program_finish
+ *
+ * End job with err. A passed job's journal is kept, flagged complete, as the
+ * record of the image the token now holds (later upgrades plan their delta
+ * from it); any other outcome keeps its progress so the next insertion can
+ * resume.
+ *
+ * @param  > PROGRAM_Job_t* : job
+ *         > TOKEN_ErrCode_t : result
+ *
+ * @return None
+ ******************************************************************************/
+static void program_finish(PROGRAM_Job_t* job, TOKEN_ErrCode_t err)
+{
+    if(err != TOKEN_ERR_ABORTED && (job->erase == PROGRAM_ERASE_SUSPENDING || job->erase == PROGRAM_ERASE_SUSPENDED))
+    {
+        TokenFlash_ResumeErase();
+    }
+    job->erase = PROGRAM_ERASE_NONE;
+    job->err = err;
+    job->isBusy = false;
+    job->state = (err == TOKEN_ERR_OK) ? PROGRAM_STATE_PASSED : PROGRAM_STATE_FAILED;
+    if(err == TOKEN_ERR_OK && job->hasJournal)
+    {
+        Journal_Complete(&job->journal);
+    }
+    if(err == TOKEN_ERR_OK && job->pagesMatched > 0)
+    {
+        printf("socket %u %u pages already held the image and were not rewritten\n", job->socket, job->pagesMatched);
+    }
+    if(err == TOKEN_ERR_OK && job->isUnitKept)
+    {
+        printf("socket %u kept the personalization it held\n", job->socket);
+    }
+    else if(err == TOKEN_ERR_OK && job->unit.count > 0 && !job->isVerifyOnly)
+    {
+        printf("socket %u personalized as serial %llu\n", job->socket, (unsigned long long) job->unit.serial);
+    }
+    Image_Release(job->image);
+    job->image = NULL;
+}
+
+// EOF
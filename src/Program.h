@@ -0,0 +1,159 @@
+/*******************************************************************************
+ *  @file Program.h
+ *
+ *  @brief Token programming engine. A job erases, writes and verifies an image
+ *         onto the token in one socket, resuming interrupted jobs from their
+ *         journal. Jobs never wait on the token; each Program_Step issues at
+ *         most one command so the scheduler can interleave sockets.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _PROGRAM_H_
+#define _PROGRAM_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+#include "Token.h"
+#include "Image.h"
+#include "Journal.h"
+#include "TokenDevice.h"
+#include "TokenFlash.h"
+#include "Personalize.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define PROGRAM_ERASE_SUSPEND   1           // erase the next sector behind page programs on parts that can suspend it, 0 disables
+#define PROGRAM_ERASE_RUN_MIN   TIMER_10MS  // let a resumed erase run this long before suspending it again
+
+#define PROGRAM_VERIFY_READBACK 0           // read back and compare every page
+#define PROGRAM_VERIFY_FLAGS    1           // a clean fail-flag check passes the page on parts that have them
+#define PROGRAM_VERIFY_POLICY   PROGRAM_VERIFY_READBACK
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+typedef enum
+{
+    PROGRAM_STATE_IDLE,
+    PROGRAM_STATE_ERASE_ALL,
+    PROGRAM_STATE_READ_BLOCK,
+    PROGRAM_STATE_ERASE_SECTOR,
+    PROGRAM_STATE_WRITE,
+    PROGRAM_STATE_VERIFY,
+    PROGRAM_STATE_CHECK_SECTOR,
+    PROGRAM_STATE_PASSED,
+    PROGRAM_STATE_FAILED,
+    PROGRAM_STATE_COUNT
+} PROGRAM_State_t;
+
+typedef enum
+{
+    PROGRAM_ERASE_NONE,
+    PROGRAM_ERASE_RUNNING,
+    PROGRAM_ERASE_SUSPENDING,
+    PROGRAM_ERASE_SUSPENDED,
+    PROGRAM_ERASE_COUNT
+} PROGRAM_Erase_t;
+
+typedef struct
+{
+    uint8_t socket;
+    PROGRAM_State_t state;
+    TOKEN_ErrCode_t err;
+    IMAGE_t* image;
+    JOURNAL_t journal;
+    bool hasJournal;
+    bool isBusy;            // current state's command issued, token not ready yet
+    uint32_t busyStart;
+    uint32_t busyTimeout;
+    uint32_t busyHoldoff;   // don't poll status before this has elapsed
+    uint32_t sectorCount;
+    uint32_t eraseCount;    // sectors erased through, past the image's to clear what an earlier image left; 0 for none
+    uint32_t sector;        // sector (or re-personalized block) being programmed
+    uint32_t blockLen;      // TOKEN_FLASH_SECTOR_LEN, or the erase unit re-personalized blocks use
+    uint32_t address;       // page being written/verified
+    uint32_t pageLen;
+    uint8_t retries;
+    uint32_t retryCount;    // page rewrites over the whole job
+    uint32_t bytesDone;
+    uint32_t startTick;
+    const TOKEN_Device_t* device;
+    bool isSectorErase;     // erase each sector as it is reached instead of the whole chip
+    bool canSuspend;        // erase the next sector in the background, suspending it for batches of pages
+    PROGRAM_Erase_t erase;  // background erase
+    uint32_t eraseSector;   // sector being erased in the background
+    uint32_t erasedSector;  // last sector the background erase finished, UINT32_MAX if none
+    uint32_t eraseStart;    // background erase last resumed (or suspend issued)
+    uint32_t eraseRunTime;  // time background erase ran before its last suspend
+    uint32_t eraseSuspends; // times the background erase has been suspended
+    uint32_t suspendPages;  // pages passed since the erase was last suspended
+    bool isWaiting;         // polled ready but not yet stepped, e.g. held back behind other sockets
+    bool isFlagVerified;    // pages pass on the device's fail flags, no readback
+    bool isInPlace;         // EEPROM: no erase, pages already holding the image aren't rewritten
+    uint32_t pagesMatched;  // pages skipped because they already held the image
+    PERSONALIZE_Unit_t unit;    // this token's personalization, merged into the pages it covers
+    bool isUnitKept;        // unit read back from a token that passed before, no serial claimed
+    bool isRework;          // re-personalize: read-modify-write only the blocks holding fields
+    bool isDelta;           // upgrade from a known image: unchanged sectors skipped, blank pages not programmed
+    bool isResumed;         // picked up where the journal says an interrupted attempt stopped
+    bool isVerifyOnly;      // compare the token against the image, nothing erased or written
+    bool isDigestVerified;  // clone: each written sector is read back against the image's sector digest
+    uint64_t checkDigest;   // sector being read back so far
+    uint8_t pageBuf[TOKEN_FLASH_MAX_PAGE_LEN]; // image page with the unit's fields applied
+} PROGRAM_Job_t;
+
+// Start a job programming image onto the token in socket, just identified by
+// TokenDevice_Identify. Selects socket.
+void Program_Start(PROGRAM_Job_t* job, uint8_t socket, IMAGE_t* image);
+
+// Start a job comparing the token in socket, just identified, against image.
+// Nothing is written; personalization fields are not compared. Selects socket.
+void Program_StartVerify(PROGRAM_Job_t* job, uint8_t socket, IMAGE_t* image);
+
+// Start a job copying image, streamed off a master token, onto the token in
+// socket, just identified. An exact copy: no personalization or journal, and
+// each sector is checked against the master's digest. Selects socket.
+void Program_StartClone(PROGRAM_Job_t* job, uint8_t socket, IMAGE_t* image);
+
+// Advance job by at most one command. Caller must have selected job's socket.
+// Returns true if a command was issued, false if the token was busy.
+bool Program_Step(PROGRAM_Job_t* job);
+
+// Poll job's busy token without issuing anything. Caller must have selected
+// job's socket. Returns true if job is ready for its next command.
+bool Program_Poll(PROGRAM_Job_t* job);
+
+// Issue the next command of every job in jobs with one broadcast transfer.
+// All jobs must be ready, share an image and be at the same position.
+void Program_StepBroadcast(PROGRAM_Job_t** jobs, uint8_t count);
+
+// Determine if job's next command is write-only and can be broadcast
+bool Program_IsBroadcastable(const PROGRAM_Job_t* job);
+
+// Determine if job and other, both just started, can be ganged: the same image
+// and part, written from the start with the same plan and field layout
+bool Program_CanGang(const PROGRAM_Job_t* job, const PROGRAM_Job_t* other);
+
+// Position of job in the erase/write/verify sequence. Jobs programming the same
+// image at the same position issue identical commands.
+uint32_t Program_GetPosition(const PROGRAM_Job_t* job);
+
+// Abandon job (token removed, shutdown). Journal is kept for resume.
+void Program_Cancel(PROGRAM_Job_t* job);
+
+// Determine if job has finished (passed or failed)
+bool Program_IsDone(const PROGRAM_Job_t* job);
+
+#endif /* _PROGRAM_H_ */
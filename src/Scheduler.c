@@ -0,0 +1,835 @@
+/*******************************************************************************
+ *  @file Scheduler.c
+ *
+ *  @brief Socket scheduler. Drives one programming job per socket on the shared
+ *         SPI bus, issuing commands to whichever tokens are ready while the
+ *         others are busy programming or erasing.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+
+// Module Includes
+#include "Scheduler.h"
+#include "Program.h"
+#include "Dump.h"
+#include "Clone.h"
+#include "Image.h"
+#include "Socket.h"
+#include "Personalize.h"
+#include "Library.h"
+#include "Token.h"
+#include "TokenDevice.h"
+#include "Event.h"
+#include "Status.h"
+
+// Utility Includes
+
+// Driver Includes
+#include "Timer.h"
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+static PROGRAM_Job_t m_jobs[SOCKET_COUNT];
+static DUMP_Job_t m_dumps[SOCKET_COUNT];    // socket's job when its status job is STATUS_JOB_DUMP
+static bool m_isCompressed[SOCKET_COUNT];   // next dump of socket is compressed
+static CLONE_Job_t m_clones[SOCKET_COUNT];  // socket's job when it is a clone's master
+static uint8_t m_master[SOCKET_COUNT];      // master of socket's STATUS_JOB_CLONE, socket itself for the master
+static bool m_isActive[SOCKET_COUNT];
+static uint32_t m_lastReport[SOCKET_COUNT];
+static uint8_t m_next = 0;
+
+static uint32_t m_gang[SOCKET_COUNT];
+static uint32_t m_gangId = 0;
+static uint32_t m_gangStart = 0;
+
+static bool m_isLoaded = false;     // library and personalization map are usable
+
+static STATUS_Socket_t m_status[SOCKET_COUNT];  // as last published
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Start a job of type job on the token in socket
+static void scheduler_start(uint8_t socket, STATUS_Job_t job);
+
+// Library image for the token in socket, the library reloaded first if it changed
+static IMAGE_t* scheduler_getImage(uint8_t socket, STATUS_Job_t job);
+
+// Gang for the job just started in socket
+static uint32_t scheduler_joinGang(uint8_t socket);
+
+// Poll every member of gang, then issue commands to those at its rearmost position
+static void scheduler_serviceGang(uint32_t gang, bool* isServed);
+
+// Read the next transfer of socket's dump
+static void scheduler_serviceDump(uint8_t socket);
+
+// Read the next transfer of the master in socket, if its targets have room
+static void scheduler_serviceClone(uint8_t socket);
+
+// Determine if socket is reading a clone's master
+static bool scheduler_isMaster(uint8_t socket);
+
+// Print progress of socket's job
+static void scheduler_report(uint8_t socket);
+
+// Job in socket finished. Show result and free the socket.
+static void scheduler_finish(uint8_t socket);
+
+// Publish socket's status
+static void scheduler_publish(uint8_t socket);
+
+// Published phase of job's state
+static STATUS_Phase_t scheduler_getPhase(const PROGRAM_Job_t* job);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Scheduler_Start
+ *
+ * Start programming the token just inserted in socket
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return None
+ ******************************************************************************/
+void Scheduler_Start(uint8_t socket)
+{
+    scheduler_start(socket, STATUS_JOB_PROGRAM);
+}
+
+/*******************************************************************************
+ * @brief Scheduler_Verify
+ *
+ * Check the token in socket against its library image without writing it
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return None
+ ******************************************************************************/
+void Scheduler_Verify(uint8_t socket)
+{
+    scheduler_start(socket, STATUS_JOB_VERIFY);
+}
+
+/*******************************************************************************
+ * @brief Scheduler_Dump
+ *
+ * Read the token in socket back to a file in DUMP_PATH
+ *
+ * @param  > uint8_t : socket
+ *         > bool : compress with zstd
+ *
+ * @return None
+ ******************************************************************************/
+void Scheduler_Dump(uint8_t socket, bool isCompressed)
+{
+    if(socket < SOCKET_COUNT)
+    {
+        m_isCompressed[socket] = isCompressed;
+        scheduler_start(socket, STATUS_JOB_DUMP);
+    }
+}
+
+/*******************************************************************************
+ * @brief Scheduler_Clone
+ *
+ * Copy the token in socket onto the tokens in the target sockets. The master
+ * is read once, straight into a ring the targets program from as a gang; no
+ * file is made. Targets are started after the master, so none runs without it.
+ *
+ * @param  > uint8_t : master socket
+ *         > uint32_t : target sockets, a bit per socket
+ *
+ * @return None
+ ******************************************************************************/
+void Scheduler_Clone(uint8_t socket, uint32_t targets)
+{
+    if(socket >= SOCKET_COUNT)
+    {
+        return;
+    }
+    Scheduler_Stop(socket);
+    m_master[socket] = socket;
+    scheduler_start(socket, STATUS_JOB_CLONE);
+    for(uint8_t target = 0; target < SOCKET_COUNT; target++)
+    {
+        if(target != socket && (targets & (1u << target)) != 0)
+        {
+            Scheduler_Stop(target);
+            m_master[target] = socket;
+            scheduler_start(target, STATUS_JOB_CLONE);
+        }
+    }
+}
+
+/*******************************************************************************
+ * @brief Scheduler_Stop
+ *
+ * Stop the job in socket (token removed). Its journal is kept for resume.
+ * The socket's status is published either way, the token may have gone.
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return None
+ ******************************************************************************/
+void Scheduler_Stop(uint8_t socket)
+{
+    if(socket < SOCKET_COUNT && m_isActive[socket])
+    {
+        if(m_status[socket].job == STATUS_JOB_DUMP)
+        {
+            Dump_Cancel(&m_dumps[socket]);
+        }
+        else if(scheduler_isMaster(socket))
+        {
+            Clone_Cancel(&m_clones[socket]);
+        }
+        else
+        {
+            Program_Cancel(&m_jobs[socket]);
+        }
+        scheduler_finish(socket);
+    }
+    else if(socket < SOCKET_COUNT)
+    {
+        scheduler_publish(socket);
+    }
+}
+
+/*******************************************************************************
+ * @brief Scheduler_ImageUpdated
+ *
+ * A file the library uses changed. The next library is staged in the
+ * background; jobs keep starting with the current one until it is swapped in.
+ * Before the first token there is nothing to stage, the load happens then.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+void Scheduler_ImageUpdated(void)
+{
+    if(m_isLoaded)
+    {
+        Library_Stage();
+    }
+}
+
+/*******************************************************************************
+ * @brief Scheduler_LibraryStaged
+ *
+ * The staged library is ready. Swap it in along with the personalization map;
+ * jobs started from now on use them.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+void Scheduler_LibraryStaged(void)
+{
+    if(Library_Swap())
+    {
+        m_isLoaded = Personalize_Load(PERSONALIZE_MAP_PATH);
+    }
+}
+
+/*******************************************************************************
+ * @brief Scheduler_IsSocketBusy
+ *
+ * Determine if socket has a job in flight
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return bool
+ ******************************************************************************/
+bool Scheduler_IsSocketBusy(uint8_t socket)
+{
+    return (socket < SOCKET_COUNT) && m_isActive[socket];
+}
+
+/*******************************************************************************
+ * @brief Scheduler_IsBusy
+ *
+ * Determine if any socket has a job in flight
+ *
+ * @param  > None
+ *
+ * @return bool
+ ******************************************************************************/
+bool Scheduler_IsBusy(void)
+{
+    bool isBusy = false;
+    for(uint8_t socket = 0; socket < SOCKET_COUNT; socket++)
+    {
+        isBusy |= m_isActive[socket];
+    }
+    return isBusy;
+}
+
+/*******************************************************************************
+ * @brief Scheduler_Service
+ *
+ * One round-robin pass over all sockets with a job in flight. The pass starts
+ * one socket further along each time so no socket is always served first.
+ * A socket programming on its own is a gang of one; a dump or a clone's master
+ * is served alone.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+void Scheduler_Service(void)
+{
+    bool isServed[SOCKET_COUNT] = {false};
+    for(uint8_t i = 0; i < SOCKET_COUNT; i++)
+    {
+        uint8_t socket = (uint8_t) ((m_next + i) % SOCKET_COUNT);
+        if(m_isActive[socket] && m_status[socket].job == STATUS_JOB_DUMP)
+        {
+            scheduler_serviceDump(socket);
+        }
+        else if(m_isActive[socket] && scheduler_isMaster(socket))
+        {
+            scheduler_serviceClone(socket);
+        }
+        else if(m_isActive[socket] && !isServed[socket])
+        {
+            scheduler_serviceGang(m_gang[socket], isServed);
+        }
+    }
+    m_next = (uint8_t) ((m_next + 1) % SOCKET_COUNT);
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief scheduler_start
+ *
+ * Start a job on the token in socket, replacing any in flight. A verify job
+ * runs in a gang of its own: it never writes, so it has nothing to share. A
+ * dump needs no image and is never in a gang, nor is a clone's master, whose
+ * image the clone's targets (m_master set) program as a gang.
+ *
+ * @param  > uint8_t : socket
+ *         > STATUS_Job_t : STATUS_JOB_PROGRAM, STATUS_JOB_VERIFY, STATUS_JOB_DUMP or STATUS_JOB_CLONE
+ *
+ * @return None
+ ******************************************************************************/
+static void scheduler_start(uint8_t socket, STATUS_Job_t job)
+{
+    if(socket >= SOCKET_COUNT)
+    {
+        return;
+    }
+    Scheduler_Stop(socket);
+    STATUS_Socket_t* status = &m_status[socket];
+    status->jobCount++;
+    status->job = job;
+    status->err = TOKEN_ERR_OK;
+    status->phase = STATUS_PHASE_NONE;
+    status->bytesDone = 0;
+    status->bytesTotal = 0;
+    status->elapsedMs = 0;
+    status->bytesPerSec = 0;
+    status->retries = 0;
+    status->image[0] = '\0';
+    IMAGE_t* image = NULL;
+    bool isStarted = false;
+    if(job == STATUS_JOB_DUMP)
+    {
+        Token_SelectSocket(socket);
+        TokenDevice_Identify();
+        isStarted = Dump_Start(&m_dumps[socket], socket, m_isCompressed[socket]);
+        if(isStarted)
+        {
+            printf("socket %u: dumping token to %s/%s\n", socket, DUMP_PATH, m_dumps[socket].name);
+            snprintf(status->image, STATUS_NAME_LEN, "%s", m_dumps[socket].name);
+        }
+    }
+    else if(job == STATUS_JOB_CLONE && m_master[socket] == socket)
+    {
+        Token_SelectSocket(socket);
+        TokenDevice_Identify();
+        isStarted = Clone_Start(&m_clones[socket], socket);
+        image = isStarted ? m_clones[socket].image : NULL;
+        if(isStarted)
+        {
+            printf("socket %u: reading master token\n", socket);
+            snprintf(status->image, STATUS_NAME_LEN, "master");
+        }
+    }
+    else if(job == STATUS_JOB_CLONE)
+    {
+        uint8_t master = m_master[socket];
+        image = scheduler_isMaster(master) ? m_clones[master].image : NULL;
+        isStarted = (image != NULL);
+        Token_SelectSocket(socket);
+        TokenDevice_Identify();
+        if(isStarted)
+        {
+            printf("socket %u: cloning the master in socket %u\n", socket, master);
+            snprintf(status->image, STATUS_NAME_LEN, "master in socket %u", master);
+        }
+    }
+    else
+    {
+        image = scheduler_getImage(socket, job);
+        isStarted = (image != NULL);
+    }
+    if(!isStarted)
+    {
+        Socket_SetLeds(socket, SOCKET_LED_FAILED);
+        status->state = STATUS_STATE_FAILED;
+        status->err = TOKEN_ERR_INVALID_INPUT;
+        scheduler_publish(socket);
+        return;
+    }
+    Socket_SetLeds(socket, SOCKET_LED_INPROGRESS);
+    if(job == STATUS_JOB_DUMP || (job == STATUS_JOB_CLONE && m_master[socket] == socket))
+    {
+        m_gang[socket] = ++m_gangId;
+    }
+    else if(job == STATUS_JOB_CLONE)
+    {
+        Program_StartClone(&m_jobs[socket], socket, image);
+        m_gang[socket] = scheduler_joinGang(socket);
+    }
+    else if(job == STATUS_JOB_VERIFY)
+    {
+        m_gang[socket] = ++m_gangId;
+        Program_StartVerify(&m_jobs[socket], socket, image);
+    }
+    else
+    {
+        Program_Start(&m_jobs[socket], socket, image);
+        m_gang[socket] = scheduler_joinGang(socket);
+    }
+    m_isActive[socket] = true;
+    m_lastReport[socket] = Timer_GetTick();
+    status->state = STATUS_STATE_RUNNING;
+    status->bytesTotal = (image != NULL) ? image->len : m_dumps[socket].len;
+    scheduler_publish(socket);
+}
+
+/*******************************************************************************
+ * @brief scheduler_getImage
+ *
+ * Library image for the token in socket, chosen by its part and the fixture
+ * strap. The library and the personalization map are loaded for the first
+ * token, or again while they are unusable; updates after that are staged and
+ * swapped in. Jobs hold their own reference so a replaced image lives until
+ * the last of them finishes.
+ *
+ * @param  > uint8_t : socket
+ *         > STATUS_Job_t : job the image is for
+ *
+ * @return IMAGE_t* : image, NULL if none applies or it could not be loaded
+ ******************************************************************************/
+static IMAGE_t* scheduler_getImage(uint8_t socket, STATUS_Job_t job)
+{
+    if(!m_isLoaded)
+    {
+        m_isLoaded = Library_Load() && Personalize_Load(PERSONALIZE_MAP_PATH);
+        Event_WatchFile(PERSONALIZE_MAP_PATH);
+    }
+    Token_SelectSocket(socket);
+    const TOKEN_Device_t* device = TokenDevice_Identify();
+    const char* name = NULL;
+    IMAGE_t* image = !m_isLoaded ? NULL : Library_GetImage(device, &name);
+    if(image == NULL)
+    {
+        printf("socket %u: no image in the library for this token\n", socket);
+    }
+    else
+    {
+        printf("socket %u: %s token with %s\n", socket, (job == STATUS_JOB_VERIFY) ? "verifying" : "programming", name);
+        snprintf(m_status[socket].image, STATUS_NAME_LEN, "%s", name);
+    }
+    return image;
+}
+
+/*******************************************************************************
+ * @brief scheduler_joinGang
+ *
+ * Gang for the job just started in socket. Tokens inserted within
+ * SCHEDULER_GANG_WINDOW of the gang's first token join it if every member
+ * can gang with them (Program_CanGang): the same image, from the start, with
+ * the same plan. A token resumed from its journal, upgraded by delta or laid
+ * out differently starts a new gang and runs alone. A clone's image is its
+ * own, so only its targets share a gang.
+ *
+ * @param  > uint8_t : socket, its job started but not yet active
+ *
+ * @return uint32_t : gang id
+ ******************************************************************************/
+static uint32_t scheduler_joinGang(uint8_t socket)
+{
+    bool isOpen = false;
+    for(uint8_t member = 0; member < SOCKET_COUNT; member++)
+    {
+        if(!m_isActive[member] || m_gang[member] != m_gangId || scheduler_isMaster(member))
+        {
+            continue;
+        }
+        if(!(m_status[member].job == STATUS_JOB_PROGRAM || m_status[member].job == STATUS_JOB_CLONE)
+            || !Program_CanGang(&m_jobs[socket], &m_jobs[member]))
+        {
+            isOpen = false;
+            break;
+        }
+        isOpen = true;
+    }
+    if(!isOpen || (SCHEDULER_GANG_WINDOW == 0) || Timer_TimeoutExpired(m_gangStart, SCHEDULER_GANG_WINDOW))
+    {
+        m_gangId++;
+        m_gangStart = Timer_GetTick();
+    }
+    return m_gangId;
+}
+
+/*******************************************************************************
+ * @brief scheduler_serviceGang
+ *
+ * Poll every member of gang, then issue commands to those at the gang's
+ * rearmost position. Members that are ahead wait for the rest to catch up, so
+ * the gang stays in lockstep: erase and page program go out once with every
+ * ready member's chip select asserted, while status polls and verify reads
+ * fan out per token. Only members fitted with the same part share a broadcast.
+ *
+ * @param  > uint32_t : gang
+ *         > bool* : per-socket flags, set for each member serviced
+ *
+ * @return None
+ ******************************************************************************/
+static void scheduler_serviceGang(uint32_t gang, bool* isServed)
+{
+    bool isReady[SOCKET_COUNT] = {false};
+    uint32_t rearmost = UINT32_MAX;
+    for(uint8_t socket = 0; socket < SOCKET_COUNT; socket++)
+    {
+        if(!m_isActive[socket] || m_gang[socket] != gang)
+        {
+            continue;
+        }
+        isServed[socket] = true;
+        Token_SelectSocket(socket);
+        isReady[socket] = Program_Poll(&m_jobs[socket]);
+        if(!Program_IsDone(&m_jobs[socket]))
+        {
+            rearmost = MIN(rearmost, Program_GetPosition(&m_jobs[socket]));
+        }
+    }
+
+    PROGRAM_Job_t* broadcast[SOCKET_COUNT];
+    uint8_t broadcastCount = 0;
+    for(uint8_t socket = 0; socket < SOCKET_COUNT; socket++)
+    {
+        if(!isReady[socket] || Program_GetPosition(&m_jobs[socket]) != rearmost)
+        {
+            continue;
+        }
+        if(Program_IsBroadcastable(&m_jobs[socket])
+            && (broadcastCount == 0 || m_jobs[socket].device == broadcast[0]->device))
+        {
+            broadcast[broadcastCount++] = &m_jobs[socket];
+        }
+        else
+        {
+            Token_SelectSocket(socket);
+            Program_Step(&m_jobs[socket]);
+        }
+    }
+    if(broadcastCount > 1)
+    {
+        Program_StepBroadcast(broadcast, broadcastCount);
+    }
+    else if(broadcastCount == 1)
+    {
+        Token_SelectSocket(broadcast[0]->socket);
+        Program_Step(broadcast[0]);
+    }
+
+    for(uint8_t socket = 0; socket < SOCKET_COUNT; socket++)
+    {
+        if(!m_isActive[socket] || m_gang[socket] != gang)
+        {
+            continue;
+        }
+        if(Program_IsDone(&m_jobs[socket]))
+        {
+            scheduler_finish(socket);
+            continue;
+        }
+        if(m_jobs[socket].bytesDone != m_status[socket].bytesDone ||
+           scheduler_getPhase(&m_jobs[socket]) != m_status[socket].phase)
+        {
+            scheduler_publish(socket);
+        }
+        if(Timer_TimeoutExpired(m_lastReport[socket], SCHEDULER_REPORT_PERIOD))
+        {
+            scheduler_report(socket);
+            m_lastReport[socket] = Timer_GetTick();
+        }
+    }
+}
+
+/*******************************************************************************
+ * @brief scheduler_serviceDump
+ *
+ * Read the next transfer of socket's dump, unless its writer has every
+ * buffer, and publish and report its progress like a programming job's
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return None
+ ******************************************************************************/
+static void scheduler_serviceDump(uint8_t socket)
+{
+    Token_SelectSocket(socket);
+    Dump_Step(&m_dumps[socket]);
+    if(Dump_IsDone(&m_dumps[socket]))
+    {
+        scheduler_finish(socket);
+        return;
+    }
+    if(m_dumps[socket].address != m_status[socket].bytesDone)
+    {
+        scheduler_publish(socket);
+    }
+    if(Timer_TimeoutExpired(m_lastReport[socket], SCHEDULER_REPORT_PERIOD))
+    {
+        scheduler_report(socket);
+        m_lastReport[socket] = Timer_GetTick();
+    }
+}
+
+/*******************************************************************************
+ * @brief scheduler_serviceClone
+ *
+ * Read the next transfer of the master in socket and publish and report its
+ * progress. The read may run at most a ring ahead of the sector the rearmost
+ * of its targets is on; the targets still need that sector's data.
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return None
+ ******************************************************************************/
+static void scheduler_serviceClone(uint8_t socket)
+{
+    CLONE_Job_t* clone = &m_clones[socket];
+    uint32_t limit = clone->image->len;
+    for(uint8_t target = 0; target < SOCKET_COUNT; target++)
+    {
+        const PROGRAM_Job_t* job = &m_jobs[target];
+        if(m_isActive[target] && target != socket && m_status[target].job == STATUS_JOB_CLONE
+            && m_master[target] == socket && !Program_IsDone(job))
+        {
+            limit = MIN(limit, job->sector * job->blockLen + clone->image->window);
+        }
+    }
+    Token_SelectSocket(socket);
+    Clone_Step(clone, limit);
+    if(Clone_IsDone(clone))
+    {
+        scheduler_finish(socket);
+        return;
+    }
+    if(clone->address != m_status[socket].bytesDone)
+    {
+        scheduler_publish(socket);
+    }
+    if(Timer_TimeoutExpired(m_lastReport[socket], SCHEDULER_REPORT_PERIOD))
+    {
+        scheduler_report(socket);
+        m_lastReport[socket] = Timer_GetTick();
+    }
+}
+
+/*******************************************************************************
+ * @brief scheduler_isMaster
+ *
+ * Determine if socket is reading a clone's master
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return bool
+ ******************************************************************************/
+static bool scheduler_isMaster(uint8_t socket)
+{
+    return m_isActive[socket] && (m_status[socket].job == STATUS_JOB_CLONE) && (m_master[socket] == socket);
+}
+
+/*******************************************************************************
+ * @brief scheduler_report
+ *
+ * Print progress of socket's job, as last published
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return None
+ ******************************************************************************/
+static void scheduler_report(uint8_t socket)
+{
+    const STATUS_Socket_t* status = &m_status[socket];
+    printf("socket %u: %3u%% %u/%u KB %u KB/s\n", socket,
+        (status->bytesTotal > 0) ? (uint32_t) ((uint64_t) status->bytesDone * 100 / status->bytesTotal) : 0,
+        status->bytesDone / 1024, status->bytesTotal / 1024, status->bytesPerSec / 1024);
+}
+
+/*******************************************************************************
+ * @brief scheduler_finish
+ *
+ * Job in socket finished. Show result and free the socket.
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return None
+ ******************************************************************************/
+static void scheduler_finish(uint8_t socket)
+{
+    STATUS_Socket_t* status = &m_status[socket];
+    const PROGRAM_Job_t* job = &m_jobs[socket];
+    TOKEN_ErrCode_t err = job->err;
+    uint32_t startTick = job->startTick;
+    uint32_t address = job->address;
+    const char* action = job->isVerifyOnly ? "verify" : (job->isDigestVerified ? "clone" : "write and verify");
+    const char* stopped = job->isVerifyOnly ? "verify" : (job->isDigestVerified ? "clone" : "programming");
+    const char* kept = job->isDigestVerified ? "" : " Progress kept for resume";
+    if(status->job == STATUS_JOB_DUMP)
+    {
+        err = m_dumps[socket].err;
+        startTick = m_dumps[socket].startTick;
+        address = m_dumps[socket].address;
+        action = "dump";
+        stopped = "dump";
+        kept = "";
+    }
+    else if(scheduler_isMaster(socket))
+    {
+        err = m_clones[socket].err;
+        startTick = m_clones[socket].startTick;
+        address = m_clones[socket].address;
+        action = "read";
+        stopped = "clone";
+        kept = "";
+    }
+    uint32_t elapsed = Timer_GetTick() - startTick;
+    if(err == TOKEN_ERR_OK)
+    {
+        Socket_SetLeds(socket, SOCKET_LED_PASSED);
+        printf("socket %u: passed token %s in %u ms\n", socket, action, elapsed);
+        status->state = STATUS_STATE_PASSED;
+    }
+    else if(err == TOKEN_ERR_ABORTED)
+    {
+        Socket_SetLeds(socket, SOCKET_LED_FAILED);
+        printf("socket %u: token removed, %s aborted.%s\n", socket, stopped, kept);
+        status->state = STATUS_STATE_ABORTED;
+    }
+    else
+    {
+        Socket_SetLeds(socket, SOCKET_LED_FAILED);
+        printf("socket %u: failed token %s at 0x%08X, err = %d\n", socket, action, address, err);
+        status->state = STATUS_STATE_FAILED;
+    }
+    status->err = err;
+    scheduler_publish(socket);
+    m_isActive[socket] = false;
+}
+
+/*******************************************************************************
+ * @brief scheduler_publish
+ *
+ * Publish socket's status with the progress of its job, if one is in flight
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return None
+ ******************************************************************************/
+static void scheduler_publish(uint8_t socket)
+{
+    STATUS_Socket_t* status = &m_status[socket];
+    status->isInserted = Token_IsSocketInserted(socket);
+    if(m_isActive[socket] && status->job == STATUS_JOB_DUMP)
+    {
+        const DUMP_Job_t* dump = &m_dumps[socket];
+        status->phase = Dump_IsDone(dump) ? STATUS_PHASE_NONE : STATUS_PHASE_READ;
+        status->bytesDone = dump->address;
+        status->elapsedMs = Timer_GetTick() - dump->startTick;
+        status->bytesPerSec = (status->elapsedMs > 0) ?
+            (uint32_t) ((uint64_t) dump->address * TIMER_1SEC / status->elapsedMs) : 0;
+    }
+    else if(scheduler_isMaster(socket))
+    {
+        const CLONE_Job_t* clone = &m_clones[socket];
+        status->phase = Clone_IsDone(clone) ? STATUS_PHASE_NONE : STATUS_PHASE_READ;
+        status->bytesDone = clone->address;
+        status->elapsedMs = Timer_GetTick() - clone->startTick;
+        status->bytesPerSec = (status->elapsedMs > 0) ?
+            (uint32_t) ((uint64_t) clone->address * TIMER_1SEC / status->elapsedMs) : 0;
+    }
+    else if(m_isActive[socket])
+    {
+        PROGRAM_Job_t* job = &m_jobs[socket];
+        status->phase = scheduler_getPhase(job);
+        status->bytesDone = job->bytesDone;
+        status->elapsedMs = Timer_GetTick() - job->startTick;
+        status->bytesPerSec = (status->elapsedMs > 0) ?
+            (uint32_t) ((uint64_t) job->bytesDone * TIMER_1SEC / status->elapsedMs) : 0;
+        status->retries = job->retryCount;
+    }
+    Status_PublishSocket(socket, status);
+}
+
+/*******************************************************************************
+ * @brief scheduler_getPhase
+ *
+ * What job is doing, as published
+ *
+ * @param  > const PROGRAM_Job_t* : job
+ *
+ * @return STATUS_Phase_t
+ ******************************************************************************/
+static STATUS_Phase_t scheduler_getPhase(const PROGRAM_Job_t* job)
+{
+    switch(job->state)
+    {
+        case PROGRAM_STATE_ERASE_ALL:
+        case PROGRAM_STATE_ERASE_SECTOR:
+            return STATUS_PHASE_ERASE;
+        case PROGRAM_STATE_READ_BLOCK:
+            return STATUS_PHASE_READ;
+        case PROGRAM_STATE_WRITE:
+            return STATUS_PHASE_WRITE;
+        case PROGRAM_STATE_VERIFY:
+        case PROGRAM_STATE_CHECK_SECTOR:
+            return STATUS_PHASE_VERIFY;
+        default:
+            return STATUS_PHASE_NONE;
+    }
+}
+
+// EOF
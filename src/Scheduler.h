@@ -0,0 +1,72 @@
+/*******************************************************************************
+ *  @file Scheduler.h
+ *
+ *  @brief Socket scheduler. Drives one programming job per socket on the shared
+ *         SPI bus, issuing commands to whichever tokens are ready while the
+ *         others are busy programming or erasing.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define SCHEDULER_REPORT_PERIOD     TIMER_1SEC
+#define SCHEDULER_GANG_WINDOW       TIMER_2SEC  // tokens inserted this close together program as a gang, 0 disables
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+// Start programming the token just inserted in socket
+void Scheduler_Start(uint8_t socket);
+
+// Check the token in socket against its library image without writing it
+void Scheduler_Verify(uint8_t socket);
+
+// Read the token in socket back to a file in DUMP_PATH, zstd compressed if
+// isCompressed, with its sector digests alongside
+void Scheduler_Dump(uint8_t socket, bool isCompressed);
+
+// Copy the token in socket onto the tokens in targets (a bit per socket),
+// programming them while the master is still being read
+void Scheduler_Clone(uint8_t socket, uint32_t targets);
+
+// Stop the job in socket (token removed). Its journal is kept for resume.
+void Scheduler_Stop(uint8_t socket);
+
+// A file the library uses changed. The next library is staged in the
+// background while jobs keep starting with the current one.
+void Scheduler_ImageUpdated(void);
+
+// The staged library is ready (EVENT_LIBRARY_STAGED). Jobs started from now on
+// use it; jobs in flight finish with the image they started with.
+void Scheduler_LibraryStaged(void);
+
+// Determine if socket has a job in flight
+bool Scheduler_IsSocketBusy(uint8_t socket);
+
+// Determine if any socket has a job in flight
+bool Scheduler_IsBusy(void);
+
+// One round-robin pass over all sockets with a job in flight. Each socket gets
+// at most one command; busy sockets cost a single status poll. Gangs issue
+// their erase and page program commands once, broadcast to every member.
+void Scheduler_Service(void);
+
+#endif /* _SCHEDULER_H_ */
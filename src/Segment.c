@@ -0,0 +1,528 @@
+/*******************************************************************************
+ *  @file Segment.c
+ *
+ *  @brief Multi-segment image formats. Intel HEX and Motorola S-record text
+ *  is decoded record by record with every checksum checked; ELF contributes
+ *  its PT_LOAD segments at their load (physical) addresses. Adjacent records
+ *  are merged as they're read so a HEX file's thousands of 16-byte records
+ *  come out as a handful of segments.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Module Includes
+#include "Segment.h"
+
+// Utility Includes
+
+// Driver Includes
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define SEGMENT_RECORD_MAX      260     // decoded bytes of one text record
+
+#define SEGMENT_IHEX_DATA       0x00
+#define SEGMENT_IHEX_EOF        0x01
+#define SEGMENT_IHEX_SEGMENT    0x02    // extended segment address, base = value << 4
+#define SEGMENT_IHEX_START      0x03    // start segment address, ignored
+#define SEGMENT_IHEX_LINEAR     0x04    // extended linear address, base = value << 16
+#define SEGMENT_IHEX_LINEAR_START 0x05  // start linear address, ignored
+
+#define SEGMENT_ELF_CLASS       4       // e_ident[EI_CLASS]: 1 = 32-bit, 2 = 64-bit
+#define SEGMENT_ELF_DATA        5       // e_ident[EI_DATA]: 1 = little-endian, 2 = big-endian
+#define SEGMENT_ELF_PT_LOAD     1
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Parse Intel HEX or S-record text
+static bool segment_parseText(const uint8_t* file, uint32_t len, SEGMENT_List_t* list);
+
+// Decode one record's hex digits and check its checksum
+static bool segment_decodeRecord(const uint8_t* text, uint32_t textLen, bool isIhex, uint8_t* record, uint32_t* recordLen);
+
+// Apply one decoded Intel HEX record
+static bool segment_applyIhex(SEGMENT_List_t* list, const uint8_t* record, uint32_t* base, bool* isEnd);
+
+// Apply one decoded S-record
+static bool segment_applySrec(SEGMENT_List_t* list, char type, const uint8_t* record, uint32_t recordLen, bool* isEnd);
+
+// Parse an ELF file's PT_LOAD segments
+static bool segment_parseElf(const uint8_t* file, uint32_t len, SEGMENT_List_t* list);
+
+// Integer field of an ELF file
+static uint64_t segment_getField(const uint8_t* buf, uint32_t len, bool isBigEndian);
+
+// Value of a hex digit, -1 if not one
+static int segment_getNibble(uint8_t c);
+
+// Add len bytes of data at address, merging with the last segment if it continues it
+static bool segment_add(SEGMENT_List_t* list, uint64_t address, const uint8_t* data, uint32_t len);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Segment_GetFormat
+ *
+ * Format of file. Text formats are only claimed if the first record decodes
+ * with a good checksum, so a flat binary that happens to start with ':' or
+ * 'S' is still a flat binary.
+ *
+ * @param  > const uint8_t* : file
+ *         > uint32_t : length of file
+ *
+ * @return SEGMENT_Format_t : NONE if it's none of these
+ ******************************************************************************/
+SEGMENT_Format_t Segment_GetFormat(const uint8_t* file, uint32_t len)
+{
+    if(len >= 4 && (file[0] | (file[1] << 8) | (file[2] << 16) | ((uint32_t) file[3] << 24)) == SEGMENT_ELF_MAGIC)
+    {
+        return SEGMENT_FORMAT_ELF;
+    }
+    uint32_t lineLen = 0;
+    while(lineLen < len && file[lineLen] != '\n' && file[lineLen] != '\r')
+    {
+        lineLen++;
+    }
+    uint8_t record[SEGMENT_RECORD_MAX];
+    uint32_t recordLen = 0;
+    if(lineLen > 1 && file[0] == ':' && segment_decodeRecord(file + 1, lineLen - 1, true, record, &recordLen))
+    {
+        return SEGMENT_FORMAT_IHEX;
+    }
+    if(lineLen > 2 && file[0] == 'S' && file[1] >= '0' && file[1] <= '9'
+        && segment_decodeRecord(file + 2, lineLen - 2, false, record, &recordLen))
+    {
+        return SEGMENT_FORMAT_SREC;
+    }
+    return SEGMENT_FORMAT_NONE;
+}
+
+/*******************************************************************************
+ * @brief Segment_Parse
+ *
+ * Parse file into its segments
+ *
+ * @param  > const uint8_t* : file
+ *         > uint32_t : length of file
+ *         > SEGMENT_List_t* : list to populate; free with Segment_Free even on
+ *           failure
+ *
+ * @return bool : false if the file is malformed or holds no data
+ ******************************************************************************/
+bool Segment_Parse(const uint8_t* file, uint32_t len, SEGMENT_List_t* list)
+{
+    memset(list, 0, sizeof(SEGMENT_List_t));
+    list->format = Segment_GetFormat(file, len);
+    bool isOk = false;
+    if(list->format == SEGMENT_FORMAT_ELF)
+    {
+        isOk = segment_parseElf(file, len, list);
+    }
+    else if(list->format != SEGMENT_FORMAT_NONE)
+    {
+        isOk = segment_parseText(file, len, list);
+    }
+    return isOk && list->count > 0;
+}
+
+/*******************************************************************************
+ * @brief Segment_Free
+ *
+ * Release memory held by list
+ *
+ * @param  > SEGMENT_List_t* : list
+ *
+ * @return None
+ ******************************************************************************/
+void Segment_Free(SEGMENT_List_t* list)
+{
+    free(list->segments);
+    free(list->bytes);
+    memset(list, 0, sizeof(SEGMENT_List_t));
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief segment_parseText
+ *
+ * Parse Intel HEX or S-record text, one record per line, LF or CRLF. Blank
+ * lines are skipped; anything after the end record is ignored.
+ *
+ * @param  > const uint8_t* : file
+ *         > uint32_t : length of file
+ *         > SEGMENT_List_t* : list, format set
+ *
+ * @return bool : false on a bad record
+ ******************************************************************************/
+static bool segment_parseText(const uint8_t* file, uint32_t len, SEGMENT_List_t* list)
+{
+    // Decoded data is never more than half the text
+    list->bytes = malloc(len / 2 + 1);
+    if(list->bytes == NULL)
+    {
+        return false;
+    }
+    uint32_t base = 0;
+    bool isEnd = false;
+    uint32_t pos = 0;
+    uint32_t line = 0;
+    while(pos < len && !isEnd)
+    {
+        uint32_t lineLen = 0;
+        while(pos + lineLen < len && file[pos + lineLen] != '\n')
+        {
+            lineLen++;
+        }
+        const uint8_t* text = file + pos;
+        pos += lineLen + 1;
+        line++;
+        if(lineLen > 0 && text[lineLen - 1] == '\r')
+        {
+            lineLen--;
+        }
+        if(lineLen == 0)
+        {
+            continue;
+        }
+
+        uint8_t record[SEGMENT_RECORD_MAX];
+        uint32_t recordLen = 0;
+        bool isOk;
+        if(list->format == SEGMENT_FORMAT_IHEX)
+        {
+            isOk = (text[0] == ':') && segment_decodeRecord(text + 1, lineLen - 1, true, record, &recordLen)
+                && segment_applyIhex(list, record, &base, &isEnd);
+        }
+        else
+        {
+            isOk = (lineLen > 2) && (text[0] == 'S') && segment_decodeRecord(text + 2, lineLen - 2, false, record, &recordLen)
+                && segment_applySrec(list, (char) text[1], record, recordLen, &isEnd);
+        }
+        if(!isOk)
+        {
+            printf("Error, bad record on line %u of segment image\n", line);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief segment_decodeRecord
+ *
+ * Decode one record's hex digits. Both formats lead with a byte count and end
+ * with a checksum over every byte: Intel HEX's sums to 0x00, S-record's to
+ * 0xFF. The count is checked against the digits present.
+ *
+ * @param  > const uint8_t* : text after the record mark (':' or "Sn")
+ *         > uint32_t : length of text
+ *         > bool : Intel HEX, else S-record
+ *         > uint8_t* : record buffer of SEGMENT_RECORD_MAX
+ *         > uint32_t* : decoded length
+ *
+ * @return bool : false if malformed or the checksum is wrong
+ ******************************************************************************/
+static bool segment_decodeRecord(const uint8_t* text, uint32_t textLen, bool isIhex, uint8_t* record, uint32_t* recordLen)
+{
+    if(textLen < 4 || (textLen % 2) != 0 || textLen / 2 > SEGMENT_RECORD_MAX)
+    {
+        return false;
+    }
+    uint8_t sum = 0;
+    for(uint32_t i = 0; i < textLen / 2; i++)
+    {
+        int high = segment_getNibble(text[2 * i]);
+        int low = segment_getNibble(text[2 * i + 1]);
+        if(high < 0 || low < 0)
+        {
+            return false;
+        }
+        record[i] = (uint8_t) ((high << 4) | low);
+        sum += record[i];
+    }
+    *recordLen = textLen / 2;
+    if(isIhex)
+    {
+        // count, address (2), type, data, checksum
+        return (sum == 0x00) && (*recordLen == (uint32_t) record[0] + 5);
+    }
+    // count covers address, data and checksum
+    return (sum == 0xFF) && (*recordLen == (uint32_t) record[0] + 1);
+}
+
+/*******************************************************************************
+ * @brief segment_applyIhex
+ *
+ * Apply one decoded Intel HEX record. Start address records are ignored.
+ *
+ * @param  > SEGMENT_List_t* : list
+ *         > const uint8_t* : record
+ *         > uint32_t* : current base address
+ *         > bool* : set on the end of file record
+ *
+ * @return bool : false on an unknown or malformed record
+ ******************************************************************************/
+static bool segment_applyIhex(SEGMENT_List_t* list, const uint8_t* record, uint32_t* base, bool* isEnd)
+{
+    uint32_t count = record[0];
+    uint32_t offset = ((uint32_t) record[1] << 8) | record[2];
+    uint8_t type = record[3];
+    const uint8_t* data = record + 4;
+    switch(type)
+    {
+        case SEGMENT_IHEX_DATA:
+            return segment_add(list, (uint64_t) *base + offset, data, count);
+        case SEGMENT_IHEX_EOF:
+            *isEnd = true;
+            return true;
+        case SEGMENT_IHEX_SEGMENT:
+        case SEGMENT_IHEX_LINEAR:
+            if(count != 2)
+            {
+                return false;
+            }
+            *base = (((uint32_t) data[0] << 8) | data[1]) << ((type == SEGMENT_IHEX_LINEAR) ? 16 : 4);
+            return true;
+        case SEGMENT_IHEX_START:
+        case SEGMENT_IHEX_LINEAR_START:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*******************************************************************************
+ * @brief segment_applySrec
+ *
+ * Apply one decoded S-record. S1/S2/S3 carry data at 16/24/32-bit addresses;
+ * S7/S8/S9 end the file; header and count records are ignored.
+ *
+ * @param  > SEGMENT_List_t* : list
+ *         > char : record type digit
+ *         > const uint8_t* : record
+ *         > uint32_t : record length
+ *         > bool* : set on a termination record
+ *
+ * @return bool : false on an unknown or malformed record
+ ******************************************************************************/
+static bool segment_applySrec(SEGMENT_List_t* list, char type, const uint8_t* record, uint32_t recordLen, bool* isEnd)
+{
+    uint32_t addressLen = 0;
+    switch(type)
+    {
+        case '1':
+            addressLen = 2;
+            break;
+        case '2':
+            addressLen = 3;
+            break;
+        case '3':
+            addressLen = 4;
+            break;
+        case '7':
+        case '8':
+        case '9':
+            *isEnd = true;
+            return true;
+        case '0':
+        case '5':
+        case '6':
+            return true;
+        default:
+            return false;
+    }
+    // count, address, data, checksum
+    if(recordLen < addressLen + 2)
+    {
+        return false;
+    }
+    uint32_t address = 0;
+    for(uint32_t i = 0; i < addressLen; i++)
+    {
+        address = (address << 8) | record[1 + i];
+    }
+    return segment_add(list, address, record + 1 + addressLen, recordLen - addressLen - 2);
+}
+
+/*******************************************************************************
+ * @brief segment_parseElf
+ *
+ * Parse an ELF file's PT_LOAD segments, 32 or 64-bit, either byte order. Each
+ * goes to its physical (load) address; only the bytes in the file count, a
+ * segment's zero-initialized tail is the target's business.
+ *
+ * @param  > const uint8_t* : file
+ *         > uint32_t : length of file
+ *         > SEGMENT_List_t* : list
+ *
+ * @return bool : false if malformed
+ ******************************************************************************/
+static bool segment_parseElf(const uint8_t* file, uint32_t len, SEGMENT_List_t* list)
+{
+    if(len < 64 || (file[SEGMENT_ELF_CLASS] != 1 && file[SEGMENT_ELF_CLASS] != 2)
+        || (file[SEGMENT_ELF_DATA] != 1 && file[SEGMENT_ELF_DATA] != 2))
+    {
+        return false;
+    }
+    bool is64 = (file[SEGMENT_ELF_CLASS] == 2);
+    bool isBig = (file[SEGMENT_ELF_DATA] == 2);
+    uint64_t phOff = is64 ? segment_getField(file + 32, 8, isBig) : segment_getField(file + 28, 4, isBig);
+    uint32_t phSize = (uint32_t) segment_getField(file + (is64 ? 54 : 42), 2, isBig);
+    uint32_t phCount = (uint32_t) segment_getField(file + (is64 ? 56 : 44), 2, isBig);
+    if(phSize < (is64 ? 56u : 32u) || phOff > len || (uint64_t) phSize * phCount > len - phOff)
+    {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < phCount; i++)
+    {
+        const uint8_t* ph = file + phOff + (uint64_t) i * phSize;
+        uint32_t type = (uint32_t) segment_getField(ph, 4, isBig);
+        uint64_t offset = is64 ? segment_getField(ph + 8, 8, isBig) : segment_getField(ph + 4, 4, isBig);
+        uint64_t address = is64 ? segment_getField(ph + 24, 8, isBig) : segment_getField(ph + 12, 4, isBig);
+        uint64_t fileSize = is64 ? segment_getField(ph + 32, 8, isBig) : segment_getField(ph + 16, 4, isBig);
+        if(type != SEGMENT_ELF_PT_LOAD || fileSize == 0)
+        {
+            continue;
+        }
+        if(offset > len || fileSize > len - offset || !segment_add(list, address, file + offset, (uint32_t) fileSize))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief segment_getField
+ *
+ * Integer field of an ELF file
+ *
+ * @param  > const uint8_t* : field
+ *         > uint32_t : field length, up to 8
+ *         > bool : big-endian
+ *
+ * @return uint64_t
+ ******************************************************************************/
+static uint64_t segment_getField(const uint8_t* buf, uint32_t len, bool isBigEndian)
+{
+    uint64_t value = 0;
+    for(uint32_t i = 0; i < len; i++)
+    {
+        value |= (uint64_t) buf[isBigEndian ? (len - 1 - i) : i] << (8 * i);
+    }
+    return value;
+}
+
+/*******************************************************************************
+ * @brief segment_getNibble
+ *
+ * Value of a hex digit
+ *
+ * @param  > uint8_t : character
+ *
+ * @return int : 0 - 15, -1 if not a hex digit
+ ******************************************************************************/
+static int segment_getNibble(uint8_t c)
+{
+    if(c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if(c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    if(c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/*******************************************************************************
+ * @brief segment_add
+ *
+ * Add len bytes of data at address. Text records are copied into the list's
+ * decoded bytes; a record continuing the last segment in both address and
+ * bytes just extends it.
+ *
+ * @param  > SEGMENT_List_t* : list
+ *         > uint64_t : token address
+ *         > const uint8_t* : data, copied if list decodes text
+ *         > uint32_t : length of data
+ *
+ * @return bool : false if beyond 32-bit addressing or out of memory
+ ******************************************************************************/
+static bool segment_add(SEGMENT_List_t* list, uint64_t address, const uint8_t* data, uint32_t len)
+{
+    if(len == 0)
+    {
+        return true;
+    }
+    if(address + len > 0x100000000ULL)
+    {
+        return false;
+    }
+    if(list->bytes != NULL)
+    {
+        memcpy(list->bytes + list->bytesLen, data, len);
+        data = list->bytes + list->bytesLen;
+        list->bytesLen += len;
+    }
+
+    SEGMENT_t* last = (list->count > 0) ? &list->segments[list->count - 1] : NULL;
+    if(last != NULL && (uint64_t) last->address + last->len == address && last->data + last->len == data)
+    {
+        last->len += len;
+    }
+    else
+    {
+        if((list->count & (list->count - 1)) == 0)
+        {
+            SEGMENT_t* segments = realloc(list->segments, (list->count ? list->count * 2 : 1) * sizeof(SEGMENT_t));
+            if(segments == NULL)
+            {
+                return false;
+            }
+            list->segments = segments;
+        }
+        list->segments[list->count].address = (uint32_t) address;
+        list->segments[list->count].len = len;
+        list->segments[list->count].data = data;
+        list->count++;
+    }
+    if(address + len > list->end)
+    {
+        list->end = (uint32_t) MIN(address + len, 0xFFFFFFFFULL);
+    }
+    return true;
+}
+
+// EOF
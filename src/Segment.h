@@ -0,0 +1,72 @@
+/*******************************************************************************
+ *  @file Segment.h
+ *
+ *  @brief Multi-segment image formats: Intel HEX, Motorola S-record and ELF.
+ *         Each places data at absolute token addresses, so the build no
+ *         longer has to pad images out to a flat binary.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _SEGMENT_H_
+#define _SEGMENT_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define SEGMENT_ELF_MAGIC       0x464C457F  // "\x7F" "ELF", little-endian
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+typedef enum
+{
+    SEGMENT_FORMAT_NONE,    // not a segment format, e.g. a flat binary
+    SEGMENT_FORMAT_IHEX,
+    SEGMENT_FORMAT_SREC,
+    SEGMENT_FORMAT_ELF,
+    SEGMENT_FORMAT_COUNT
+} SEGMENT_Format_t;
+
+// len bytes of data at token address
+typedef struct
+{
+    uint32_t address;
+    uint32_t len;
+    const uint8_t* data;
+} SEGMENT_t;
+
+typedef struct
+{
+    SEGMENT_Format_t format;
+    SEGMENT_t* segments;    // in file order; later ones win where they overlap
+    uint32_t count;
+    uint32_t end;           // highest address + 1
+    uint8_t* bytes;         // decoded text records
+    uint32_t bytesLen;
+} SEGMENT_List_t;
+
+// Format of file, NONE if it's none of these
+SEGMENT_Format_t Segment_GetFormat(const uint8_t* file, uint32_t len);
+
+// Parse file into its segments. ELF segments point into file, which must
+// outlive list. False if the file is malformed.
+bool Segment_Parse(const uint8_t* file, uint32_t len, SEGMENT_List_t* list);
+
+// Release memory held by list
+void Segment_Free(SEGMENT_List_t* list);
+
+#endif /* _SEGMENT_H_ */
@@ -0,0 +1,123 @@
+/*******************************************************************************
+ *  @file Socket.c
+ *
+ *  @brief Per-socket fixture I/O (chip select, LOFO and status LEDs). See
+ *         SOCKET_* tables in TypeDefs.h for the pin assignments.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <wiringPi.h>
+
+// Module Includes
+#include "Socket.h"
+
+// Utility Includes
+
+// Driver Includes
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+static const int m_csPins[SOCKET_COUNT] = SOCKET_CS_PINS;
+static const int m_lofoPins[SOCKET_COUNT] = SOCKET_LOFO_PINS;
+static const int m_ledTokenPins[SOCKET_COUNT] = SOCKET_LED_TOKEN_PINS;
+static const int m_ledInProgressPins[SOCKET_COUNT] = SOCKET_LED_INPROGRESS_PINS;
+static const int m_ledFailPins[SOCKET_COUNT] = SOCKET_LED_FAIL_PINS;
+static const int m_ledSuccessPins[SOCKET_COUNT] = SOCKET_LED_SUCCESS_PINS;
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Socket_Init
+ *
+ * Configure every socket's pins. Chip selects are driven high (deselected) so
+ * no two tokens ever share the bus.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+void Socket_Init(void)
+{
+    for(uint8_t socket = 0; socket < SOCKET_COUNT; socket++)
+    {
+        pinMode(m_csPins[socket], OUTPUT);
+        digitalWrite(m_csPins[socket], 1);
+        pinMode(m_lofoPins[socket], INPUT);
+        pinMode(m_ledTokenPins[socket], OUTPUT);
+        pinMode(m_ledInProgressPins[socket], OUTPUT);
+        pinMode(m_ledFailPins[socket], OUTPUT);
+        pinMode(m_ledSuccessPins[socket], OUTPUT);
+        Socket_SetLeds(socket, SOCKET_LED_IDLE);
+        Socket_SetTokenLed(socket, false);
+    }
+}
+
+/*******************************************************************************
+ * @brief Socket_SetLeds
+ *
+ * Show job state on a socket's in-progress/pass/fail LEDs
+ *
+ * @param  > uint8_t : socket
+ *         > SOCKET_Led_t : state to show
+ *
+ * @return None
+ ******************************************************************************/
+void Socket_SetLeds(uint8_t socket, SOCKET_Led_t state)
+{
+    if(socket < SOCKET_COUNT)
+    {
+        digitalWrite(m_ledInProgressPins[socket], state == SOCKET_LED_INPROGRESS);
+        digitalWrite(m_ledSuccessPins[socket], state == SOCKET_LED_PASSED);
+        digitalWrite(m_ledFailPins[socket], state == SOCKET_LED_FAILED);
+    }
+}
+
+/*******************************************************************************
+ * @brief Socket_SetTokenLed
+ *
+ * Show whether a token is seated in socket
+ *
+ * @param  > uint8_t : socket
+ *         > bool : true if inserted
+ *
+ * @return None
+ ******************************************************************************/
+void Socket_SetTokenLed(uint8_t socket, bool isInserted)
+{
+    if(socket < SOCKET_COUNT)
+    {
+        digitalWrite(m_ledTokenPins[socket], isInserted);
+    }
+}
+
+/*******************************************************************************
+ * @brief Socket_GetLofoPin
+ *
+ * Get LOFO pin of socket
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return int : BCM pin number
+ ******************************************************************************/
+int Socket_GetLofoPin(uint8_t socket)
+{
+    return m_lofoPins[socket];
+}
+
+// EOF
@@ -0,0 +1,49 @@
+/*******************************************************************************
+ *  @file Socket.h
+ *
+ *  @brief Per-socket fixture I/O (chip select, LOFO and status LEDs). See
+ *         SOCKET_* tables in TypeDefs.h for the pin assignments.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _SOCKET_H_
+#define _SOCKET_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+typedef enum
+{
+    SOCKET_LED_IDLE,
+    SOCKET_LED_INPROGRESS,
+    SOCKET_LED_PASSED,
+    SOCKET_LED_FAILED,
+    SOCKET_LED_COUNT
+} SOCKET_Led_t;
+
+// Configure every socket's pins. Chip selects are driven high (deselected)
+// so no two tokens ever share the bus. Call once @ startup.
+void Socket_Init(void);
+
+// Show job state on a socket's in-progress/pass/fail LEDs
+void Socket_SetLeds(uint8_t socket, SOCKET_Led_t state);
+
+// Show whether a token is seated in socket
+void Socket_SetTokenLed(uint8_t socket, bool isInserted);
+
+// Get LOFO pin of socket
+int Socket_GetLofoPin(uint8_t socket);
+
+#endif /* _SOCKET_H_ */
@@ -0,0 +1,269 @@
+/*******************************************************************************
+ *  @file Status.c
+ *
+ *  @brief Programmer status snapshot, a seqlock. The writer makes the
+ *  sequence odd, updates the snapshot and makes it even again; a reader
+ *  copies the snapshot and retries if the sequence was odd or moved while it
+ *  copied. Publishing is a copy and two stores, so the programming loop can
+ *  publish every page, and readers on other threads never hold it up.
+ *
+ *  The block lives in the shared memory object STATUS_SHM_NAME, so monitors
+ *  in other processes (tokenStatus.py) map it read only and poll it with the
+ *  same retry: no syscalls, no locks, nothing the programmer can wait on.
+ *  Layout, all little endian 32 bit words:
+ *
+ *      magic, version, header length, socket length, socket count,
+ *      sequence, selected[STATUS_NAME_LEN], sockets[socket count]
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Module Includes
+#include "Status.h"
+
+// Utility Includes
+
+// Driver Includes
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+static const char* const m_jobNames[STATUS_JOB_COUNT] = { "none", "program", "verify", "dump", "clone" };
+static const char* const m_stateNames[STATUS_STATE_COUNT] = { "idle", "running", "passed", "failed", "aborted" };
+static const char* const m_phaseNames[STATUS_PHASE_COUNT] = { "none", "erase", "read", "write", "verify" };
+
+
+/*******************************************************************************
+ * Data Types Declarations
+ ******************************************************************************/
+
+typedef struct
+{
+    uint32_t magic;             // STATUS_MAGIC
+    uint32_t version;           // STATUS_VERSION
+    uint32_t headerLen;         // offset of status
+    uint32_t socketLen;         // sizeof(STATUS_Socket_t)
+    uint32_t socketCount;
+    atomic_uint sequence;       // odd while a publish is in progress
+    STATUS_t status;
+} STATUS_Block_t;
+
+static STATUS_Block_t m_local;                  // until (or unless) the shared block is mapped
+static STATUS_Block_t* m_block = &m_local;
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Open a write: readers retry until status_endWrite
+static void status_beginWrite(void);
+
+// Close a write
+static void status_endWrite(void);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief Status_Init
+ *
+ * Create (or take over) the shared memory object STATUS_SHM_NAME and publish
+ * into it from now on. Anything already published is carried over. The
+ * header is written last, so a monitor never trusts a half made block.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+void Status_Init(void)
+{
+    int fd = shm_open(STATUS_SHM_NAME, O_RDWR | O_CREAT, 0644);
+    if(fd < 0)
+    {
+        perror("Unable to open status block, status kept in process");
+        return;
+    }
+    if(ftruncate(fd, sizeof(STATUS_Block_t)) != 0)
+    {
+        perror("Unable to size status block, status kept in process");
+        close(fd);
+        return;
+    }
+    STATUS_Block_t* block = mmap(NULL, sizeof(STATUS_Block_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(block == MAP_FAILED)
+    {
+        perror("Unable to map status block, status kept in process");
+        return;
+    }
+    block->magic = 0;
+    atomic_store_explicit(&block->sequence, 0, memory_order_relaxed);
+    block->status = m_local.status;
+    block->version = STATUS_VERSION;
+    block->headerLen = offsetof(STATUS_Block_t, status);
+    block->socketLen = sizeof(STATUS_Socket_t);
+    block->socketCount = SOCKET_COUNT;
+    atomic_thread_fence(memory_order_release);
+    block->magic = STATUS_MAGIC;
+    m_block = block;
+}
+
+/*******************************************************************************
+ * @brief Status_PublishSocket
+ *
+ * Publish socket's status. Main thread only.
+ *
+ * @param  > uint8_t : socket
+ *         > const STATUS_Socket_t* : status
+ *
+ * @return None
+ ******************************************************************************/
+void Status_PublishSocket(uint8_t socket, const STATUS_Socket_t* status)
+{
+    if(socket >= SOCKET_COUNT)
+    {
+        return;
+    }
+    status_beginWrite();
+    m_block->status.sockets[socket] = *status;
+    status_endWrite();
+}
+
+/*******************************************************************************
+ * @brief Status_PublishSelected
+ *
+ * Publish the control command image. Main thread only.
+ *
+ * @param  > const char* : manifest name, NULL or "" for per token
+ *
+ * @return None
+ ******************************************************************************/
+void Status_PublishSelected(const char* name)
+{
+    status_beginWrite();
+    snprintf(m_block->status.selected, STATUS_NAME_LEN, "%s", (name != NULL) ? name : "");
+    status_endWrite();
+}
+
+/*******************************************************************************
+ * @brief Status_Read
+ *
+ * Consistent copy of the latest status. Spins only while a publish is in
+ * progress, which is a few hundred nanoseconds.
+ *
+ * @param  > STATUS_t* : copy to populate
+ *
+ * @return None
+ ******************************************************************************/
+void Status_Read(STATUS_t* status)
+{
+    unsigned int start = 0;
+    do
+    {
+        start = atomic_load_explicit(&m_block->sequence, memory_order_acquire);
+        memcpy(status, &m_block->status, sizeof(STATUS_t));
+        atomic_thread_fence(memory_order_acquire);
+    } while((start & 1) || start != atomic_load_explicit(&m_block->sequence, memory_order_relaxed));
+}
+
+/*******************************************************************************
+ * @brief Status_GetJobName
+ *
+ * Printable job name
+ *
+ * @param  > STATUS_Job_t : job
+ *
+ * @return const char*
+ ******************************************************************************/
+const char* Status_GetJobName(STATUS_Job_t job)
+{
+    return (job < STATUS_JOB_COUNT) ? m_jobNames[job] : "unknown";
+}
+
+/*******************************************************************************
+ * @brief Status_GetStateName
+ *
+ * Printable state name
+ *
+ * @param  > STATUS_State_t : state
+ *
+ * @return const char*
+ ******************************************************************************/
+const char* Status_GetStateName(STATUS_State_t state)
+{
+    return (state < STATUS_STATE_COUNT) ? m_stateNames[state] : "unknown";
+}
+
+/*******************************************************************************
+ * @brief Status_GetPhaseName
+ *
+ * Printable phase name
+ *
+ * @param  > STATUS_Phase_t : phase
+ *
+ * @return const char*
+ ******************************************************************************/
+const char* Status_GetPhaseName(STATUS_Phase_t phase)
+{
+    return (phase < STATUS_PHASE_COUNT) ? m_phaseNames[phase] : "unknown";
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief status_beginWrite
+ *
+ * Make the sequence odd. The fence keeps the snapshot writes after it.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+static void status_beginWrite(void)
+{
+    unsigned int sequence = atomic_load_explicit(&m_block->sequence, memory_order_relaxed);
+    atomic_store_explicit(&m_block->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+/*******************************************************************************
+ * @brief status_endWrite
+ *
+ * Make the sequence even again, releasing the snapshot writes
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+static void status_endWrite(void)
+{
+    unsigned int sequence = atomic_load_explicit(&m_block->sequence, memory_order_relaxed);
+    atomic_store_explicit(&m_block->sequence, sequence + 1, memory_order_release);
+}
+
+// EOF
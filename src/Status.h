@@ -0,0 +1,112 @@
+/*******************************************************************************
+ *  @file Status.h
+ *
+ *  @brief Programmer status snapshot in shared memory. The main thread
+ *         publishes each socket's state as it changes; any thread or process
+ *         reads a consistent copy without ever making the publisher wait
+ *         (seqlock).
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _STATUS_H_
+#define _STATUS_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define STATUS_NAME_LEN         32
+#define STATUS_SHM_NAME         "/tok.status"   // shared memory object, /dev/shm/tok.status
+#define STATUS_MAGIC            0x54534B54      // "TKST"
+#define STATUS_VERSION          1
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+typedef enum
+{
+    STATUS_JOB_NONE,
+    STATUS_JOB_PROGRAM,
+    STATUS_JOB_VERIFY,
+    STATUS_JOB_DUMP,
+    STATUS_JOB_CLONE,       // master being read, or a target programmed from it
+    STATUS_JOB_COUNT
+} STATUS_Job_t;
+
+typedef enum
+{
+    STATUS_STATE_IDLE,
+    STATUS_STATE_RUNNING,
+    STATUS_STATE_PASSED,
+    STATUS_STATE_FAILED,
+    STATUS_STATE_ABORTED,
+    STATUS_STATE_COUNT
+} STATUS_State_t;
+
+// What a running job is doing right now
+typedef enum
+{
+    STATUS_PHASE_NONE,
+    STATUS_PHASE_ERASE,
+    STATUS_PHASE_READ,
+    STATUS_PHASE_WRITE,
+    STATUS_PHASE_VERIFY,
+    STATUS_PHASE_COUNT
+} STATUS_Phase_t;
+
+// One socket as last published. Every field is 32 bits so the layout readers
+// in other processes and languages see has no padding.
+typedef struct
+{
+    uint32_t jobCount;      // jobs started in the socket, tells a new job from the last
+    uint32_t job;           // STATUS_Job_t
+    uint32_t state;         // STATUS_State_t
+    uint32_t phase;         // STATUS_Phase_t
+    uint32_t isInserted;
+    int32_t err;            // TOKEN_ErrCode_t of a failed job
+    uint32_t bytesDone;
+    uint32_t bytesTotal;
+    uint32_t elapsedMs;
+    uint32_t bytesPerSec;
+    uint32_t retries;       // page rewrites so far in this job
+    char image[STATUS_NAME_LEN];    // library image, a dump's file name, or a clone's master
+} STATUS_Socket_t;
+
+typedef struct
+{
+    char selected[STATUS_NAME_LEN];     // control command image, "" = per token
+    STATUS_Socket_t sockets[SOCKET_COUNT];
+} STATUS_t;
+
+// Open the shared memory status block STATUS_SHM_NAME. Call once @ startup
+// before anything is published. Status stays in process if it can't be made.
+void Status_Init(void);
+
+// Publish socket's status. Main thread only; never waits on readers.
+void Status_PublishSocket(uint8_t socket, const STATUS_Socket_t* status);
+
+// Publish the control command image, NULL or "" for per token. Main thread only.
+void Status_PublishSelected(const char* name);
+
+// Consistent copy of the latest status. Any thread.
+void Status_Read(STATUS_t* status);
+
+// Printable names
+const char* Status_GetJobName(STATUS_Job_t job);
+const char* Status_GetStateName(STATUS_State_t state);
+const char* Status_GetPhaseName(STATUS_Phase_t phase);
+
+#endif /* _STATUS_H_ */
@@ -15,8 +15,8 @@
 
 // System Includes
 #include <wiringPi.h>
-#include <semaphore.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include "TypeDefs.h"
 #include <stdio.h>
 
@@ -38,10 +38,11 @@
 
 #define TOKEN_READY_BIT                         0x01
 #define TOKEN_WREN_BIT                          0x02
+#define TOKEN_SLEEP_SLICE                       TIMER_10MS
+#define TOKEN_STATUS_STREAM_LEN                 16  // status bytes per transfer while streaming; completion is seen within this many
+#define TOKEN_STATUS_STREAM_BLOCKS              64  // transfers per select (~0.5 ms at 17 MHz) before re-checking timeout and abort
 
-sem_t g_tokenSem;
-bool m_isInserted = false;
-bool m_isStatusChanged = false;
+static atomic_bool m_isInserted[SOCKET_COUNT];
 pthread_t debounceThread;
 
 
@@ -82,8 +83,6 @@ void Token_Init(void)
 {    
     SPI_Init();    
     pthread_create(&debounceThread, NULL, Debounce_Main, NULL);
-    sem_init(&g_tokenSem, 1, 1);
-    Timer_Sleep(TIMER_1SEC); // recognize if token is inserted @ startup
 }
 
 
@@ -100,22 +99,118 @@ void Token_Init(void)
 TOKEN_ErrCode_t Token_WriteEnable(void)
 {
     TOKEN_ErrCode_t err = TOKEN_ERR_TIMEOUT;
-    if(Token_WaitUntilReady())
+    if(SPI_IsBroadcast() || Token_WaitUntilReady())
     {
         uint8_t opCode = (uint8_t) TOKEN_OPCODE_WRITE_ENABLE;
-        err = (TOKEN_ErrCode_t) SPI_Write(&opCode, 1);
+        err = Token_FromSpiErr(SPI_Write(&opCode, 1));
     }
-    else
+    else if(!Token_IsAborted())
     {
         printf("Error, timeout trying to write enable\n");
     }
+    if(Token_IsAborted())
+    {
+        err = TOKEN_ERR_ABORTED;
+    }
     return err;
 }
 
+/*******************************************************************************
+ * @brief Token_FromSpiErr
+ *
+ * Token error for an SPI transfer's result. The enums are numbered apart, so
+ * each code is mapped by name: a transfer cut short by removal is ABORTED, a
+ * read refused while broadcasting INVALID_INPUT, and anything else that went
+ * wrong on the bus a TIMEOUT.
+ *
+ * @param  > SPI_ErrCode_t : err
+ *
+ * @return TOKEN_ErrCode_t
+ *
+ ******************************************************************************/
+TOKEN_ErrCode_t Token_FromSpiErr(SPI_ErrCode_t err)
+{
+    switch(err)
+    {
+        case SPI_ERR_OK:
+            return TOKEN_ERR_OK;
+        case SPI_ERR_INVALID_INPUT:
+            return TOKEN_ERR_INVALID_INPUT;
+        case SPI_ERR_ABORTED:
+            return TOKEN_ERR_ABORTED;
+        default:
+            return TOKEN_ERR_TIMEOUT;
+    }
+}
+
+/*******************************************************************************
+ * @brief Token_SelectSocket
+ *
+ * Select the socket all following Token/TokenFlash calls address
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return None
+ *
+ ******************************************************************************/
+void Token_SelectSocket(uint8_t socket)
+{
+    SPI_SetBroadcast(0);
+    SPI_SetDevice(socket);
+}
+
+/*******************************************************************************
+ * @brief Token_SelectSockets
+ *
+ * Broadcast following write-only Token/TokenFlash calls (WREN, program, erase)
+ * to every socket in mask. Callers must know all of them are ready; status
+ * cannot be polled while broadcasting. Token_SelectSocket ends it.
+ *
+ * @param  > uint32_t : socket mask (bit n = socket n)
+ *
+ * @return None
+ *
+ ******************************************************************************/
+void Token_SelectSockets(uint32_t mask)
+{
+    SPI_SetBroadcast(mask);
+}
+
+/*******************************************************************************
+ * @brief Token_IsBroadcast
+ *
+ * Determine if following Token/TokenFlash calls go to every socket selected by
+ * Token_SelectSockets
+ *
+ * @param  > None
+ *
+ * @return bool
+ *
+ ******************************************************************************/
+bool Token_IsBroadcast(void)
+{
+    return SPI_IsBroadcast();
+}
+
+/*******************************************************************************
+ * @brief Token_GetSocket
+ *
+ * Get the socket all following Token/TokenFlash calls address
+ *
+ * @param  > None
+ *
+ * @return uint8_t : socket
+ *
+ ******************************************************************************/
+uint8_t Token_GetSocket(void)
+{
+    return SPI_GetDevice();
+}
+
 /*******************************************************************************
  * @brief Token_IsInserted
  *
- * Polling function to determine if the Token is inserted.
+ * Polling function to determine if the Token in the selected socket is inserted.
  *
  * @param  > None
  *
@@ -124,7 +219,78 @@ TOKEN_ErrCode_t Token_WriteEnable(void)
  ******************************************************************************/
 bool Token_IsInserted(void)
 {
-    return m_isInserted;
+    return Token_IsSocketInserted(SPI_GetDevice());
+}
+
+/*******************************************************************************
+ * @brief Token_IsSocketInserted
+ *
+ * Polling function to determine if the Token in socket is inserted.
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return bool : true if Token is inserted + debounce time, false otherwise
+ *
+ ******************************************************************************/
+bool Token_IsSocketInserted(uint8_t socket)
+{
+    return (socket < SOCKET_COUNT) && atomic_load(&m_isInserted[socket]);
+}
+
+/*******************************************************************************
+ * @brief Token_SetInserted
+ *
+ * Latch debounced insertion state of socket. Called by the debounce thread.
+ *
+ * @param  > uint8_t : socket
+ *         > bool : true if Token is inserted
+ *
+ * @return None
+ *
+ ******************************************************************************/
+void Token_SetInserted(uint8_t socket, bool isInserted)
+{
+    if(socket < SOCKET_COUNT)
+    {
+        atomic_store(&m_isInserted[socket], isInserted);
+        SPI_Abort(socket, !isInserted);
+    }
+}
+
+/*******************************************************************************
+ * @brief Token_IsAborted
+ *
+ * Determine if the current job has been aborted (token removed)
+ *
+ * @param  > None
+ *
+ * @return bool : true if aborted
+ *
+ ******************************************************************************/
+bool Token_IsAborted(void)
+{
+    return SPI_IsAborted();
+}
+
+/*******************************************************************************
+ * @brief Token_Sleep
+ *
+ * Sleep for mSec, waking early if the job is aborted
+ *
+ * @param  > uint32_t : mSec to sleep
+ *
+ * @return bool : true if full time elapsed, false if aborted
+ *
+ ******************************************************************************/
+bool Token_Sleep(uint32_t mSec)
+{
+    while(mSec > 0 && !Token_IsAborted())
+    {
+        uint32_t slice = MIN(mSec, TOKEN_SLEEP_SLICE);
+        Timer_Sleep(slice);
+        mSec -= slice;
+    }
+    return !Token_IsAborted();
 }
 
 /*******************************************************************************
@@ -147,26 +313,52 @@ bool Token_WaitUntilReady(void)
  * @brief Token_WaitUntilReady_time
  *
  * Waits until the Token is ready for another write/erase operation, or until
- * a timeout was hit.
+ * a timeout was hit. A token that is already ready costs one status read;
+ * otherwise the status register is streamed under a single chip select, so
+ * the end of a write/erase is seen within TOKEN_STATUS_STREAM_LEN bytes
+ * instead of one select and opcode per sample. A status read that failed is
+ * never taken for ready, and an aborted token is never ready.
  *
- * @param  > None
+ * @param  > uint32_t : timeout
  *
- * @return bool : true if Token is ready, false if timeout reached
+ * @return bool : true if Token is ready, false if timeout reached, the status
+ *                could not be read or the token was aborted
  *
  ******************************************************************************/
 bool Token_WaitUntilReady_time(uint32_t time)
 {
-    bool ready = true;
+    bool ready = token_isReady();
     uint32_t startTime = Timer_GetTick();
-    while(!token_isReady())
+    while(!ready && !Token_IsAborted())
     {
-        if(Timer_TimeoutExpired(startTime, time) || !Token_IsInserted())
+        SPI_ErrCode_t err = SPI_PollUntilClear(TOKEN_OPCODE_READ_SR, TOKEN_READY_BIT,
+            TOKEN_STATUS_STREAM_LEN, TOKEN_STATUS_STREAM_BLOCKS, &ready);
+        if(!ready && (err != SPI_ERR_OK || Timer_TimeoutExpired(startTime, time)))
         {
-            ready = false;
             break;
         }
     }
-    return ready;
+    return ready && !Token_IsAborted();
+}
+
+/*******************************************************************************
+ * @brief Token_IsBusy
+ *
+ * Single status poll, does not wait. Lets a caller service other sockets while
+ * this one finishes a write/erase. One select streams TOKEN_STATUS_STREAM_LEN
+ * status bytes, so a caller spinning on this sees completion within that many
+ * bytes for a fraction of the selects of a byte-per-poll loop.
+ *
+ * @param  > None
+ *
+ * @return bool : true while a write/erase is in progress
+ *
+ ******************************************************************************/
+bool Token_IsBusy(void)
+{
+    bool ready = false;
+    SPI_PollUntilClear(TOKEN_OPCODE_READ_SR, TOKEN_READY_BIT, TOKEN_STATUS_STREAM_LEN, 1, &ready);
+    return !ready;
 }
 
 /*******************************************************************************
@@ -186,7 +378,7 @@ TOKEN_ErrCode_t Token_WriteStatusRegister(uint8_t sr)
     {
         uint8_t opCode = TOKEN_OPCODE_WRITE_SR;
         uint8_t instr[2] = {opCode, sr};
-        err = (TOKEN_ErrCode_t) SPI_Write(instr, sizeof(instr));
+        err = Token_FromSpiErr(SPI_Write(instr, sizeof(instr)));
     }
     return err;
 }
@@ -233,7 +425,7 @@ TOKEN_t Token_GetDeviceType(void)
         }
         else
         {
-            printf("eeprom token. Invalid for programmer application!!\n");
+            printf("eeprom token\n");
             tokenType = TOKEN_EEPROM;
         }
     }
@@ -268,7 +460,8 @@ static void token_writeDisable(void)
 /*******************************************************************************
  * @brief token_isReady
  *
- * Determines if Status Register suggests that the Token is ready to write/erase
+ * Determines if Status Register suggests that the Token is ready to write/erase.
+ * A failed read (e.g. the bus was released by an abort) is not ready.
  *
  * @param  > None
  *
@@ -277,7 +470,9 @@ static void token_writeDisable(void)
  ******************************************************************************/
 static bool token_isReady(void)
 {
-    return !(Token_ReadStatusRegister() & TOKEN_READY_BIT);
+    bool ready = false;
+    SPI_PollUntilClear(TOKEN_OPCODE_READ_SR, TOKEN_READY_BIT, 1, 1, &ready);
+    return ready;
 }
 
 /*******************************************************************************
@@ -19,6 +19,7 @@
 // System Includes
 #include "TypeDefs.h"
 #include "Timer.h"
+#include "spi.h"
 
 // Module Includes
 
@@ -60,6 +61,9 @@ typedef enum
     TOKEN_ERR_OK = 0,
     TOKEN_ERR_TIMEOUT,
     TOKEN_ERR_INVALID_INPUT,
+    TOKEN_ERR_ABORTED,
+    TOKEN_ERR_PROGRAM_FAILED,   // device flagged the last page program as failed
+    TOKEN_ERR_ERASE_FAILED,     // device flagged the last erase as failed
     TOKEN_ERR_COUNT
 } TOKEN_ErrCode_t;
 
@@ -76,7 +80,27 @@ typedef enum
     TOKEN_OPCODE_FLASH_SECTOR_ERASE     = 0xD8,
     TOKEN_OPCODE_FLASH_CHIP_ERASE       = 0xC7,
     TOKEN_OPCODE_FLASH_DEEP_POWER_DOWN  = 0xB9,
-    TOKEN_OPCODE_FLASH_READ_E_SIGNATURE = 0xAB
+    TOKEN_OPCODE_FLASH_READ_E_SIGNATURE = 0xAB,
+    TOKEN_OPCODE_FLASH_READ_UNIQUE_ID   = 0x4B,
+    TOKEN_OPCODE_FLASH_READ_JEDEC_ID    = 0x9F,
+    TOKEN_OPCODE_FLASH_ERASE_SUSPEND    = 0x75,
+    TOKEN_OPCODE_FLASH_ERASE_RESUME     = 0x7A,
+    TOKEN_OPCODE_FLASH_ENTER_4BYTE_MODE = 0xB7,
+    TOKEN_OPCODE_READ_4BYTE             = 0x13,
+    TOKEN_OPCODE_FLASH_FAST_READ_4BYTE  = 0x0C,
+    TOKEN_OPCODE_WRITE_4BYTE            = 0x12,
+    TOKEN_OPCODE_FLASH_SECTOR_ERASE_4BYTE = 0xDC,
+    TOKEN_OPCODE_FLASH_QUAD_WRITE       = 0x32,
+    TOKEN_OPCODE_FLASH_QUAD_READ        = 0x6B,
+    TOKEN_OPCODE_FLASH_READ_SR2         = 0x35,
+    TOKEN_OPCODE_FLASH_WRITE_SR2        = 0x31,
+    TOKEN_OPCODE_FLASH_AAI_WRITE        = 0xAD,
+    TOKEN_OPCODE_FLASH_SST_ENABLE_WRITE_SR = 0x50,     // SST EWSR; same byte as Micron's CLFSR, never switch on it
+    TOKEN_OPCODE_FLASH_READ_SECURITY_REG = 0x2B,
+    TOKEN_OPCODE_FLASH_READ_FLAG_SR     = 0x70,
+    TOKEN_OPCODE_FLASH_MICRON_CLEAR_FLAG_SR = 0x50,    // Micron CLFSR; same byte as SST's EWSR
+    TOKEN_OPCODE_FLASH_SUBSECTOR_ERASE  = 0x20,
+    TOKEN_OPCODE_FLASH_SUBSECTOR_ERASE_4BYTE = 0x21
 } TOKEN_Opcode_t; // EEPROM Commands are 8 bit, Flash are 16 bit
 
 // Initialize Token SPI port. Call once @ project startup
@@ -85,22 +109,56 @@ void Token_Init(void);
 // Enable Writing. Must be called before any write/erase operation
 TOKEN_ErrCode_t Token_WriteEnable(void);
 
+// Token error for an SPI transfer's result. The two enums don't line up.
+TOKEN_ErrCode_t Token_FromSpiErr(SPI_ErrCode_t err);
+
 // Callback for Token Insertion
 void Token_LofoISR(bool isInserted);
 
 // Callback for Token Insertion
 void Token_Callback(void);
 
-// Polling function to determine if the Token is inserted.
+// Select the socket all following Token/TokenFlash calls address
+void Token_SelectSocket(uint8_t socket);
+
+// Get the socket all following Token/TokenFlash calls address
+uint8_t Token_GetSocket(void);
+
+// Broadcast following write-only Token/TokenFlash calls (WREN, program,
+// erase) to every socket in mask. Callers must know all of them are ready;
+// status cannot be polled while broadcasting. Token_SelectSocket ends it.
+void Token_SelectSockets(uint32_t mask);
+
+// Whether Token_SelectSockets is broadcasting to several sockets
+bool Token_IsBroadcast(void);
+
+// Polling function to determine if the Token in the selected socket is inserted.
 bool Token_IsInserted(void);
 
+// Polling function to determine if the Token in socket is inserted.
+bool Token_IsSocketInserted(uint8_t socket);
+
+// Latch debounced insertion state of socket. Called by the debounce thread.
+// Removal aborts any job in flight on that socket; insertion re-arms it.
+void Token_SetInserted(uint8_t socket, bool isInserted);
+
+// Determine if the current job has been aborted (token removed)
+bool Token_IsAborted(void);
+
+// Sleep for mSec, waking early if the job is aborted. False if aborted.
+bool Token_Sleep(uint32_t mSec);
+
 // Waits until the Token is ready for another write/erase operation, or until
 // a timeout was hit.
 bool Token_WaitUntilReady(void);
 
-// Waits until token is ready with a desired timeout.
+// Waits until token is ready with a desired timeout. False on timeout, a
+// failed status read or abort.
 bool Token_WaitUntilReady_time(uint32_t time);
 
+// Single status poll, does not wait. True while a write/erase is in progress.
+bool Token_IsBusy(void);
+
 // Writes new status register
 TOKEN_ErrCode_t Token_WriteStatusRegister(uint8_t sr);
 
@@ -113,10 +171,4 @@ TOKEN_t Token_GetDeviceType(void);
 // ISR to handle debounce
 void Token_DebounceCallback(void);
 
-// Determine if token was just inserted/removed
-bool Token_GetIsStateChanged(void);
-
-// Set if token was just inserted/removed
-void Token_SetIsStateChanged(bool isJustChanged);
-
 #endif /* _TOKEN_H_  */
@@ -0,0 +1,166 @@
+/*******************************************************************************
+ *  @file TokenDevice.c
+ *
+ *  @brief Descriptors of the flash parts fitted to tokens, keyed by JEDEC ID,
+ *  and of the EEPROM parts, which have no ID and are set per product
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <string.h>
+
+// Module Includes
+#include "TokenDevice.h"
+#include "TokenFlash.h"
+#include "Token.h"
+#include "TokenEeprom.h"
+
+// Utility Includes
+
+// Driver Includes
+#include "Timer.h"
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define TOKEN_DEVICE_SUSPEND_4BYTE  (TOKEN_DEVICE_FLAG_ERASE_SUSPEND | TOKEN_DEVICE_FLAG_4BYTE_OPCODES)
+
+// Parts we source, with datasheet max timings { page program, sector (64 KB)
+// erase, chip erase, chip erase holdoff, erase suspends }. None of the suspend
+// parts' datasheets bound the suspends per erase, so they share our own cap.
+// EEPROMs have no JEDEC ID and are picked by name. The generic entry (original
+// M25P-style token) must stay last.
+static const TOKEN_Device_t m_devices[] =
+{
+    { 0xEF4017, "Winbond W25Q64JV",     0x0800000, 3, 256, TOKEN_DEVICE_FLAG_ERASE_SUSPEND | TOKEN_DEVICE_FLAG_4K_ERASE, TOKEN_DRIVER_QUAD,    { TIMER_3MS, 2*TIMER_1SEC, 100*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0xEF4018, "Winbond W25Q128JV",    0x1000000, 3, 256, TOKEN_DEVICE_FLAG_ERASE_SUSPEND | TOKEN_DEVICE_FLAG_4K_ERASE, TOKEN_DRIVER_QUAD,    { TIMER_3MS, 2*TIMER_1SEC, 200*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0xEF4019, "Winbond W25Q256JV",    0x2000000, 4, 256, TOKEN_DEVICE_SUSPEND_4BYTE | TOKEN_DEVICE_FLAG_4K_ERASE, TOKEN_DRIVER_GENERIC, { TIMER_3MS, 2*TIMER_1SEC, 400*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0xEF4020, "Winbond W25Q512JV",    0x4000000, 4, 256, TOKEN_DEVICE_SUSPEND_4BYTE | TOKEN_DEVICE_FLAG_4K_ERASE, TOKEN_DRIVER_GENERIC, { TIMER_3MS, 2*TIMER_1SEC, 800*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0xEF4021, "Winbond W25Q01JV",     0x8000000, 4, 256, TOKEN_DEVICE_SUSPEND_4BYTE | TOKEN_DEVICE_FLAG_4K_ERASE, TOKEN_DRIVER_GENERIC, { TIMER_3MS, 2*TIMER_1SEC, 1600*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0xC22017, "Macronix MX25L6433F",  0x0800000, 3, 256, TOKEN_DEVICE_FLAG_ERASE_SUSPEND | TOKEN_DEVICE_FLAG_FAIL_SCUR | TOKEN_DEVICE_FLAG_4K_ERASE, TOKEN_DRIVER_GENERIC, { TIMER_3MS, 2*TIMER_1SEC, 80*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0xC22019, "Macronix MX25L25645G", 0x2000000, 4, 256, TOKEN_DEVICE_SUSPEND_4BYTE | TOKEN_DEVICE_FLAG_FAIL_SCUR | TOKEN_DEVICE_FLAG_4K_ERASE, TOKEN_DRIVER_GENERIC, { TIMER_3MS, 2*TIMER_1SEC, 300*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0x20BA17, "Micron N25Q064A",      0x0800000, 3, 256, TOKEN_DEVICE_FLAG_ERASE_SUSPEND | TOKEN_DEVICE_FLAG_FAIL_FSR | TOKEN_DEVICE_FLAG_4K_ERASE, TOKEN_DRIVER_GENERIC, { TIMER_5MS, 3*TIMER_1SEC, 250*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0x20BA19, "Micron N25Q256A",      0x2000000, 4, 256, TOKEN_DEVICE_FLAG_ERASE_SUSPEND | TOKEN_DEVICE_FLAG_4BYTE_MODE | TOKEN_DEVICE_FLAG_FAIL_FSR | TOKEN_DEVICE_FLAG_4K_ERASE, TOKEN_DRIVER_GENERIC, { TIMER_5MS, 3*TIMER_1SEC, 480*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0x20BA21, "Micron MT25QL01G",     0x8000000, 4, 256, TOKEN_DEVICE_SUSPEND_4BYTE | TOKEN_DEVICE_FLAG_FAIL_FSR | TOKEN_DEVICE_FLAG_4K_ERASE, TOKEN_DRIVER_GENERIC, { TIMER_3MS, TIMER_1SEC, 1840*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0x010219, "Infineon S25FL256S",   0x2000000, 4, 512, TOKEN_DEVICE_SUSPEND_4BYTE,      TOKEN_DRIVER_GENERIC, { TIMER_3MS, 3*TIMER_1SEC, 330*TIMER_1SEC, 0, TOKEN_FLASH_ERASE_SUSPEND_MAX } },
+    { 0xBF2541, "SST SST25VF016B",      0x0200000, 3, 256, TOKEN_DEVICE_FLAG_4K_ERASE,      TOKEN_DRIVER_SST_AAI, { TIMER_5MS, TIMER_25MS, TIMER_50MS, 0, 0 } },
+    { 0xBF254A, "SST SST25VF032B",      0x0400000, 3, 256, TOKEN_DEVICE_FLAG_4K_ERASE,      TOKEN_DRIVER_SST_AAI, { TIMER_5MS, TIMER_25MS, TIMER_50MS, 0, 0 } },
+    { 0x202017, "Micron M25P64",        0x0800000, 3, 256, 0,                               TOKEN_DRIVER_GENERIC, { TOKEN_FLASH_PAGE_PROGRAM_TIME, TOKEN_FLASH_ERASE_SECTOR_TIME, TOKEN_FLASH_ERASE_ALL_TIME, TOKEN_FLASH_ERASE_ALL_HOLDOFF, 0 } },
+    { 0,        "Microchip 25LC640A",   0x0002000, 2, 32,  TOKEN_DEVICE_FLAG_NO_ERASE,      TOKEN_DRIVER_EEPROM,  { TOKEN_EEPROM_WRITE_CYCLE_TIME, 0, 0, 0, 0 } },
+    { 0,        "Microchip 25LC256",    0x0008000, 2, 64,  TOKEN_DEVICE_FLAG_NO_ERASE,      TOKEN_DRIVER_EEPROM,  { TOKEN_EEPROM_WRITE_CYCLE_TIME, 0, 0, 0, 0 } },
+    { 0,        "ST M95256",            0x0008000, 2, 64,  TOKEN_DEVICE_FLAG_NO_ERASE,      TOKEN_DRIVER_EEPROM,  { TOKEN_EEPROM_WRITE_CYCLE_TIME, 0, 0, 0, 0 } },
+    { 0,        "Microchip 25LC512",    0x0010000, 2, 128, TOKEN_DEVICE_FLAG_NO_ERASE,      TOKEN_DRIVER_EEPROM,  { TOKEN_EEPROM_WRITE_CYCLE_TIME, 0, 0, 0, 0 } },
+    { 0,        "Microchip 25LC1024",   0x0020000, 3, 256, TOKEN_DEVICE_FLAG_NO_ERASE,      TOKEN_DRIVER_EEPROM,  { TOKEN_EEPROM_WRITE_CYCLE_TIME, 0, 0, 0, 0 } },
+    { 0,        "generic",              TOKEN_FLASH_MEM_SIZE, 3, TOKEN_FLASH_PAGE_LEN, 0,   TOKEN_DRIVER_GENERIC, { TOKEN_FLASH_PAGE_PROGRAM_TIME, TOKEN_FLASH_ERASE_SECTOR_TIME, TOKEN_FLASH_ERASE_ALL_TIME, TOKEN_FLASH_ERASE_ALL_HOLDOFF, 0 } },
+};
+
+#define TOKEN_DEVICE_COUNT      (sizeof(m_devices) / sizeof(m_devices[0]))
+#define TOKEN_DEVICE_GENERIC    (&m_devices[TOKEN_DEVICE_COUNT - 1])
+
+static const TOKEN_Device_t* m_socketDevice[SOCKET_COUNT];
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief TokenDevice_Identify
+ *
+ * Read the JEDEC ID of the token in the selected socket and look up its
+ * descriptor. Unknown parts get the generic descriptor, which assumes nothing
+ * beyond the commands every token has always supported, unless they don't
+ * answer RES either: that is an EEPROM token (see Token_GetDeviceType) and it
+ * gets TOKEN_DEVICE_EEPROM_PART. The part's driver then prepares it (4-byte
+ * mode, unlock, quad enable).
+ *
+ * @param  > None
+ *
+ * @return const TOKEN_Device_t* : descriptor, never NULL
+ ******************************************************************************/
+const TOKEN_Device_t* TokenDevice_Identify(void)
+{
+    uint32_t jedecId = 0;
+    uint32_t size = 0;
+    const TOKEN_Device_t* device = TOKEN_DEVICE_GENERIC;
+    if(TokenFlash_ReadJedecId(&jedecId) == TOKEN_ERR_OK)
+    {
+        for(uint32_t i = 0; i < TOKEN_DEVICE_COUNT - 1; i++)
+        {
+            if(m_devices[i].jedecId == jedecId)
+            {
+                device = &m_devices[i];
+                break;
+            }
+        }
+    }
+    else if(TokenFlash_GetDeviceSize(&size) == TOKEN_ERR_OK && size == 0)
+    {
+        for(uint32_t i = 0; i < TOKEN_DEVICE_COUNT - 1; i++)
+        {
+            if(strcmp(m_devices[i].name, TOKEN_DEVICE_EEPROM_PART) == 0)
+            {
+                device = &m_devices[i];
+                break;
+            }
+        }
+    }
+    if(device->size < 0x100000)
+    {
+        printf("socket %u: JEDEC ID %06X, %s, %u KB\n", Token_GetSocket(), jedecId, device->name, device->size >> 10);
+    }
+    else
+    {
+        printf("socket %u: JEDEC ID %06X, %s, %u MB\n", Token_GetSocket(), jedecId, device->name, device->size >> 20);
+    }
+    m_socketDevice[Token_GetSocket()] = device;
+    if(TokenFlash_PrepareDevice() != TOKEN_ERR_OK)
+    {
+        printf("socket %u: failed to prepare %s\n", Token_GetSocket(), device->name);
+    }
+    return device;
+}
+
+/*******************************************************************************
+ * @brief TokenDevice_Get
+ *
+ * Descriptor found by the last TokenDevice_Identify on the selected socket
+ *
+ * @param  > None
+ *
+ * @return const TOKEN_Device_t* : descriptor, generic if never identified
+ ******************************************************************************/
+const TOKEN_Device_t* TokenDevice_Get(void)
+{
+    const TOKEN_Device_t* device = m_socketDevice[Token_GetSocket()];
+    return (device != NULL) ? device : TOKEN_DEVICE_GENERIC;
+}
+
+/*******************************************************************************
+ * @brief TokenDevice_Has
+ *
+ * Determine if device has all of flags
+ *
+ * @param  > const TOKEN_Device_t* : device
+ *         > uint32_t : TOKEN_DEVICE_FLAG_* to test
+ *
+ * @return bool
+ ******************************************************************************/
+bool TokenDevice_Has(const TOKEN_Device_t* device, uint32_t flags)
+{
+    return (device->flags & flags) == flags;
+}
+
+// EOF
@@ -0,0 +1,89 @@
+/*******************************************************************************
+ *  @file TokenDevice.h
+ *
+ *  @brief Descriptors of the flash parts fitted to tokens, keyed by JEDEC ID,
+ *  and of the EEPROM parts, which have no ID and are set per product
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _TOKEN_DEVICE_H_
+#define _TOKEN_DEVICE_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define TOKEN_DEVICE_FLAG_ERASE_SUSPEND  0x01    // page program allowed while a sector erase is suspended (0x75/0x7A)
+#define TOKEN_DEVICE_FLAG_4BYTE_OPCODES  0x02    // dedicated 4-byte address read/program/erase (0x13/0x0C/0x12/0xDC)
+#define TOKEN_DEVICE_FLAG_4BYTE_MODE     0x04    // 4-byte addressing only after entering 4-byte mode (0xB7)
+#define TOKEN_DEVICE_FLAG_FAIL_SCUR      0x08    // program/erase fail bits in the security register (0x2B), cleared by the next command
+#define TOKEN_DEVICE_FLAG_FAIL_FSR       0x10    // program/erase fail bits in the flag status register (0x70), sticky until 0x50
+#define TOKEN_DEVICE_FLAG_NO_ERASE       0x20    // bytes are written in place (EEPROM); never erase
+#define TOKEN_DEVICE_FLAG_4K_ERASE       0x40    // uniform 4 KB subsector erase (0x20, 0x21 with 4-byte opcodes)
+
+// EEPROM fitted to this product's EEPROM tokens. They answer neither JEDEC ID
+// nor RES, so the part can't be read off the token.
+#define TOKEN_DEVICE_EEPROM_PART         "Microchip 25LC256"
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+// Program/erase/read routines in TokenFlash.c
+typedef enum
+{
+    TOKEN_DRIVER_GENERIC,   // 0x02 page program, 0xD8 sector erase, 0x03 read
+    TOKEN_DRIVER_QUAD,      // 0x32 quad page program, 0x6B quad read; generic unless the bus is quad capable
+    TOKEN_DRIVER_SST_AAI,   // 0xAD auto address increment word program, status register unlocked at identify
+    TOKEN_DRIVER_EEPROM,    // 0x02 page write with ~5 ms write cycle, no erase, 0x03 read
+    TOKEN_DRIVER_COUNT
+} TOKEN_Driver_t;
+
+// Worst case (datasheet max) times in ms, and the erase suspend limit
+typedef struct
+{
+    uint32_t pageProgram;
+    uint32_t sectorErase;
+    uint32_t chipErase;
+    uint32_t chipEraseHoldoff;  // don't trust WIP until chip erase has run this long
+    uint32_t eraseSuspendMax;   // suspends one sector erase may take, 0 if it can't be suspended
+} TOKEN_Timing_t;
+
+typedef struct
+{
+    uint32_t jedecId;       // manufacturer << 16 | memory type << 8 | capacity, 0 = unknown part
+    const char* name;
+    uint32_t size;          // bytes
+    uint8_t addressLen;     // 3, or 4 for parts beyond TOKEN_FLASH_3BYTE_LIMIT; EEPROMs 1 to 3
+    uint32_t pageLen;       // program buffer, at most TOKEN_FLASH_MAX_PAGE_LEN
+    uint32_t flags;         // TOKEN_DEVICE_FLAG_*
+    TOKEN_Driver_t driver;
+    TOKEN_Timing_t timing;
+} TOKEN_Device_t;
+
+// Read the JEDEC ID of the token in the selected socket and look up its
+// descriptor. Tokens without one that don't answer RES either are EEPROM
+// tokens and get TOKEN_DEVICE_EEPROM_PART; other unknown parts get the generic
+// descriptor. The part's driver is then given the chance to prepare it
+// (4-byte mode, unlock, quad enable).
+const TOKEN_Device_t* TokenDevice_Identify(void);
+
+// Descriptor found by the last TokenDevice_Identify on the selected socket
+const TOKEN_Device_t* TokenDevice_Get(void);
+
+// Determine if device has all of flags
+bool TokenDevice_Has(const TOKEN_Device_t* device, uint32_t flags);
+
+#endif /* _TOKEN_DEVICE_H_ */
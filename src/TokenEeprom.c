@@ -0,0 +1,179 @@
+/*******************************************************************************
+ *  @file TokenEeprom.c
+ *
+ *  @brief Utils For EEPROM Tokens. 25xx-style SPI EEPROMs share the flash
+ *  WREN/RDSR/READ/WRITE opcodes but write bytes in place, so there is no erase,
+ *  pages are 16 to 256 bytes and every page write is followed by a ~5 ms
+ *  self-timed write cycle with WIP set.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#include "TypeDefs.h"
+
+// Module Includes
+#include "TokenEeprom.h"
+#include "Token.h"
+
+// Utility Includes
+
+// Driver Includes
+#include "spi.h"
+#include "Timer.h"
+#include "TokenDevice.h"
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define TOKEN_EEPROM_A8_BIT             0x08 // 512-byte parts carry address bit 8 in the opcode
+#define TOKEN_EEPROM_SR_PROTECT_BITS    0x8C // WPEN, BP1, BP0
+
+
+/*******************************************************************************
+ * Data Types Declarations
+ ******************************************************************************/
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Get instruction for opCode at address, sized for the part's address length
+static uint32_t tokenEeprom_getInstruction(uint8_t* instruction, uint32_t address, TOKEN_Opcode_t opCode);
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief TokenEeprom_Prepare
+ *
+ * Clear block protection (BP1:BP0) and WPEN left in the nonvolatile status
+ * register, which would otherwise silently drop page writes
+ *
+ * @param  > None
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenEeprom_Prepare(void)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_TIMEOUT;
+    if(Token_WaitUntilReady())
+    {
+        err = TOKEN_ERR_OK;
+        if(Token_ReadStatusRegister() & TOKEN_EEPROM_SR_PROTECT_BITS)
+        {
+            err = Token_WriteStatusRegister(0x00);
+        }
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief TokenEeprom_StartWritePage
+ *
+ * Start writing len bytes to address. The bytes must not cross a page; the
+ * part wraps within the page if they do. Returns without waiting for the write
+ * cycle so the caller can service other sockets meanwhile.
+ *
+ * @param  > uint32_t : address
+ *         > uint8_t* : buf
+ *         > uint32_t : len
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenEeprom_StartWritePage(uint32_t address, uint8_t* buf, uint32_t len)
+{
+    TOKEN_ErrCode_t err = Token_WriteEnable();
+    if(err == TOKEN_ERR_OK)
+    {
+        uint8_t instruction[TOKEN_EEPROM_INSTRUCTION_SIZE];
+        uint32_t instructionLen = tokenEeprom_getInstruction(instruction, address, TOKEN_OPCODE_WRITE);
+        err = Token_FromSpiErr(SPI_Write2(instruction, instructionLen, buf, len));
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief TokenEeprom_EraseSector
+ *
+ * EEPROMs write bytes in place; nothing to erase
+ *
+ * @param  > uint32_t : address
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenEeprom_EraseSector(uint32_t address)
+{
+    (void) address;
+
+    return TOKEN_ERR_OK;
+}
+
+/*******************************************************************************
+ * @brief TokenEeprom_Read
+ *
+ * Read len bytes from address. Waits out any write cycle in progress.
+ *
+ * @param  > uint32_t : address
+ *         > uint8_t* : buf
+ *         > uint32_t : len
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenEeprom_Read(uint32_t address, uint8_t* buf, uint32_t len)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_TIMEOUT;
+    if(Token_WaitUntilReady())
+    {
+        uint8_t instruction[TOKEN_EEPROM_INSTRUCTION_SIZE];
+        uint32_t instructionLen = tokenEeprom_getInstruction(instruction, address, TOKEN_OPCODE_READ);
+        err = Token_FromSpiErr(SPI_WriteRead(instruction, instructionLen, buf, len));
+    }
+    return err;
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief tokenEeprom_getInstruction
+ *
+ * Get instruction for opCode at address. Parts up to 512 bytes take one
+ * address byte with bit 8 in the opcode, up to 64 KB two, larger parts three.
+ *
+ * @param  > uint8_t* : instruction, TOKEN_EEPROM_INSTRUCTION_SIZE bytes
+ *         > uint32_t : address
+ *         > TOKEN_Opcode_t : opCode
+ *
+ * @return uint32_t : instruction length
+ ******************************************************************************/
+static uint32_t tokenEeprom_getInstruction(uint8_t* instruction, uint32_t address, TOKEN_Opcode_t opCode)
+{
+    uint32_t addressLen = TokenDevice_Get()->addressLen;
+    instruction[0] = (uint8_t) (opCode & 0xFF);
+    if((addressLen == 1) && (address & 0x100))
+    {
+        instruction[0] |= TOKEN_EEPROM_A8_BIT;
+    }
+    for(uint32_t i = 0; i < addressLen; i++)
+    {
+        instruction[1 + i] = (uint8_t) ((address >> (8 * (addressLen - 1 - i))) & 0xFF);
+    }
+    return 1 + addressLen;
+}
+
+// EOF
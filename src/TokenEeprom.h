@@ -0,0 +1,48 @@
+/*******************************************************************************
+ *  @file TokenEeprom.h
+ *
+ *  @brief Utils For EEPROM Tokens
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+#ifndef _TOKEN_EEPROM_H_
+#define _TOKEN_EEPROM_H_
+
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "TypeDefs.h"
+#include "Token.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+
+#define TOKEN_EEPROM_INSTRUCTION_SIZE   4       // opcode + up to 3 address bytes
+#define TOKEN_EEPROM_WRITE_CYCLE_TIME   TIMER_10MS // tWC is 5 ms max; a tick either side of it
+
+
+/*******************************************************************************
+ * Public Declarations
+ ******************************************************************************/
+
+// Clear block protection left in the status register. Called on identify.
+TOKEN_ErrCode_t TokenEeprom_Prepare(void);
+
+// Start writing len bytes (within one page) to address. Returns once the data
+// is on the bus; poll Token_IsBusy for the end of the write cycle.
+TOKEN_ErrCode_t TokenEeprom_StartWritePage(uint32_t address, uint8_t* buf, uint32_t len);
+
+// EEPROMs write bytes in place; nothing to erase
+TOKEN_ErrCode_t TokenEeprom_EraseSector(uint32_t address);
+
+// Read len bytes from address
+TOKEN_ErrCode_t TokenEeprom_Read(uint32_t address, uint8_t* buf, uint32_t len);
+
+#endif /* _TOKEN_EEPROM_H_ */
@@ -27,18 +27,38 @@
 // Driver Includes
 #include "spi.h"
 #include "Timer.h"
+#include "TokenDevice.h"
+#include "TokenEeprom.h"
+#include <wiringPi.h>
 
 /*******************************************************************************
  * Constants Declarations
  ******************************************************************************/
 
-#define TOKEN_FLASH_INSTRUCTION_SIZE    4
+#define TOKEN_FLASH_INSTRUCTION_SIZE    5 // opcode + up to 4 address bytes
 #define TOKEN_FLASH_WRITE_AND_VERIFY_RETRY_COUNT 5
+#define TOKEN_FLASH_UNIQUE_ID_DUMMY_LEN 1 // 4 dummy bytes follow 0x4B, 3 are sent as the address
+#define TOKEN_FLASH_JEDEC_ID_LEN        3
+#define TOKEN_FLASH_QUAD_READ_DUMMY_LEN 1 // 8 dummy clocks follow the 0x6B address
+#define TOKEN_FLASH_SR2_QUAD_ENABLE     0x02
+#define TOKEN_FLASH_AAI_WORD_TIME_US    10 // SST tBP; waited out blind while broadcasting
+#define TOKEN_FLASH_SCUR_P_FAIL         0x20 // security register, last program failed
+#define TOKEN_FLASH_SCUR_E_FAIL         0x40 // security register, last erase failed
+#define TOKEN_FLASH_FSR_P_FAIL          0x10 // flag status register, program failed since last clear
+#define TOKEN_FLASH_FSR_E_FAIL          0x20 // flag status register, erase failed since last clear
 
 /*******************************************************************************
  * Data Types Declarations
  ******************************************************************************/
 
+typedef struct
+{
+    TOKEN_ErrCode_t (*prepare)(void);
+    TOKEN_ErrCode_t (*writePage)(uint32_t address, uint8_t* buf, uint32_t bufLen);
+    TOKEN_ErrCode_t (*eraseSector)(uint32_t address);
+    TOKEN_ErrCode_t (*read)(uint32_t address, uint8_t* buf, uint32_t len);
+} TOKEN_FLASH_Driver_t;
+
 
 /*******************************************************************************
  * Private Function Prototypes
@@ -48,8 +68,8 @@
 static TOKEN_ErrCode_t tokenFlash_eraseSector(uint32_t address);
 
 // Get the formatted instruction w/ opcode and address. This transaction must be
-// sent MSB/MSb first where Opcode is the MSB of the 4 byte transaction
-static void tokenFlash_getInstruction(uint8_t* instruction, uint32_t address, TOKEN_Opcode_t opCode);
+// sent MSB/MSb first where Opcode is the first byte of the transaction
+static uint32_t tokenFlash_getInstruction(uint8_t* instruction, uint32_t address, TOKEN_Opcode_t opCode);
 
 // Write bufLen bytes from buf to given address of Flash Token
 static TOKEN_ErrCode_t tokenFlash_writePage(uint32_t address, uint8_t* buf, uint32_t bufLen);
@@ -57,6 +77,41 @@ static TOKEN_ErrCode_t tokenFlash_writePage(uint32_t address, uint8_t* buf, uint
 // Determines if address is valid in memory
 static bool tokenFlash_isValidAddress(uint32_t address);
 
+// Driver of the part in the selected socket
+static const TOKEN_FLASH_Driver_t* tokenFlash_getDriver(void);
+
+// Generic prepare: enter 4-byte mode on parts that need it
+static TOKEN_ErrCode_t tokenFlash_prepare(void);
+
+// Read len bytes from address with 0x03
+static TOKEN_ErrCode_t tokenFlash_read(uint32_t address, uint8_t* buf, uint32_t len);
+
+// Quad prepare: set QE in status register 2 if the bus can use it
+static TOKEN_ErrCode_t tokenFlash_prepareQuad(void);
+
+// Write bufLen bytes with 0x32 quad page program, generic if the bus can't
+static TOKEN_ErrCode_t tokenFlash_writePageQuad(uint32_t address, uint8_t* buf, uint32_t bufLen);
+
+// Read len bytes with 0x6B quad output read, generic if the bus can't
+static TOKEN_ErrCode_t tokenFlash_readQuad(uint32_t address, uint8_t* buf, uint32_t len);
+
+// SST prepare: clear the block protection SST parts power up with
+static TOKEN_ErrCode_t tokenFlash_prepareSst(void);
+
+// Write bufLen bytes with SST auto address increment word program
+static TOKEN_ErrCode_t tokenFlash_writePageAai(uint32_t address, uint8_t* buf, uint32_t bufLen);
+
+// Wait out one SST byte/word program
+static bool tokenFlash_waitAai(void);
+
+static const TOKEN_FLASH_Driver_t m_drivers[TOKEN_DRIVER_COUNT] =
+{
+    [TOKEN_DRIVER_GENERIC] = { tokenFlash_prepare,     tokenFlash_writePage,     tokenFlash_eraseSector, tokenFlash_read },
+    [TOKEN_DRIVER_QUAD]    = { tokenFlash_prepareQuad, tokenFlash_writePageQuad, tokenFlash_eraseSector, tokenFlash_readQuad },
+    [TOKEN_DRIVER_SST_AAI] = { tokenFlash_prepareSst,  tokenFlash_writePageAai,  tokenFlash_eraseSector, tokenFlash_read },
+    [TOKEN_DRIVER_EEPROM]  = { TokenEeprom_Prepare,    TokenEeprom_StartWritePage, TokenEeprom_EraseSector, TokenEeprom_Read },
+};
+
 
 /*******************************************************************************
  * Public Function Implementation
@@ -83,7 +138,12 @@ TOKEN_ErrCode_t TokenFlash_Erase(uint32_t address, uint32_t len)
         uint32_t end = address + len;
         while(address < end && err == TOKEN_ERR_OK)
         {
-            err = tokenFlash_eraseSector(address);
+            if(Token_IsAborted())
+            {
+                err = TOKEN_ERR_ABORTED;
+                break;
+            }
+            err = tokenFlash_getDriver()->eraseSector(address);
             address += TOKEN_FLASH_SECTOR_LEN;
         }
     }
@@ -102,9 +162,11 @@ TOKEN_ErrCode_t TokenFlash_Erase(uint32_t address, uint32_t len)
 TOKEN_ErrCode_t TokenFlash_EraseAll(void)
 {
     TOKEN_ErrCode_t err = Token_WriteEnable();
-    uint8_t opCode = TOKEN_OPCODE_FLASH_CHIP_ERASE;
-    err = (TOKEN_ErrCode_t) SPI_Write(&opCode, sizeof(uint8_t));
-    Timer_Sleep(10000);
+    if(err == TOKEN_ERR_OK)
+    {
+        uint8_t opCode = TOKEN_OPCODE_FLASH_CHIP_ERASE;
+        err = Token_FromSpiErr(SPI_Write(&opCode, sizeof(uint8_t)));
+    }
     return err;
 }
 
@@ -120,15 +182,19 @@ TOKEN_ErrCode_t TokenFlash_EraseAll(void)
 TOKEN_ErrCode_t TokenFlash_EraseAllBlocking(void)
 {
     TOKEN_ErrCode_t err = TokenFlash_EraseAll();
+    if (err == TOKEN_ERR_OK && !Token_Sleep(TokenDevice_Get()->timing.chipEraseHoldoff))
+    {
+        err = TOKEN_ERR_ABORTED;
+    }
     if (err == TOKEN_ERR_OK)
     {
-        if (Token_WaitUntilReady_time(TOKEN_FLASH_ERASE_ALL_TIME))
+        if (Token_WaitUntilReady_time(TokenFlash_GetEraseAllTime()))
         {
             err = TOKEN_ERR_OK;
         }
         else
         {
-            err = TOKEN_ERR_TIMEOUT;
+            err = Token_IsAborted() ? TOKEN_ERR_ABORTED : TOKEN_ERR_TIMEOUT;
         }
     }
     return err;
@@ -139,7 +205,7 @@ TOKEN_ErrCode_t TokenFlash_EraseAllBlocking(void)
  *
  * Write to Token. Can only program (write) 0s. Thus, for data to be valid,
  * caller should erase this section first.
- * Write granularity = Page (TOKEN_FLASH_PAGE_LEN)
+ * Write granularity = Page (TokenDevice_Get()->pageLen)
  * Erase granularity = Sector (TOKEN_FLASH_SECTOR_LEN)
  *
  * @param  > uint32_t : address to start writing to
@@ -154,12 +220,19 @@ TOKEN_ErrCode_t TokenFlash_Write(uint32_t startAddress, uint8_t* buf, uint32_t l
     uint32_t address = startAddress;
     uint32_t startTime = Timer_GetTick();
     TOKEN_ErrCode_t err = TOKEN_ERR_INVALID_INPUT;
+    const TOKEN_FLASH_Driver_t* driver = tokenFlash_getDriver();
+    uint32_t pageLen = TokenDevice_Get()->pageLen;
 
     if(tokenFlash_isValidAddress(startAddress + len - 1) && (buf != NULL))
     {
         err = TOKEN_ERR_OK;
         while(len != 0 && err == TOKEN_ERR_OK)
         {
+            if(Token_IsAborted())
+            {
+                err = TOKEN_ERR_ABORTED;
+                break;
+            }
             if(Timer_TimeoutExpired(startTime, TOKEN_TIMEOUT_LARGE))
             {
                 err = TOKEN_ERR_TIMEOUT;
@@ -167,8 +240,8 @@ TOKEN_ErrCode_t TokenFlash_Write(uint32_t startAddress, uint8_t* buf, uint32_t l
             }
 
             // min(remainder in page, remainder in buffer)
-            writeLen = MIN(TOKEN_FLASH_PAGE_LEN - (address % TOKEN_FLASH_PAGE_LEN), len);
-            err = tokenFlash_writePage(address, buf, writeLen);
+            writeLen = MIN(pageLen - (address % pageLen), len);
+            err = driver->writePage(address, buf, writeLen);
             len -= writeLen;
             buf += writeLen;
             address += writeLen;
@@ -203,6 +276,12 @@ TOKEN_ErrCode_t TokenFlash_WriteAndVerify(uint32_t startAddress, uint8_t* buf, u
         {
             err = TokenFlash_Write(currentAddr, currentBuf, size);
             TokenFlash_Read(currentAddr, readBuf, size);
+            if(Token_IsAborted())
+            {
+                // token pulled, retrying cannot succeed
+                err = TOKEN_ERR_ABORTED;
+                break;
+            }
             if(err == TOKEN_ERR_OK && (memcmp(currentBuf, readBuf, size) == 0))
             {
                 currentAddr += size;
@@ -231,6 +310,10 @@ TOKEN_ErrCode_t TokenFlash_WriteAndVerify(uint32_t startAddress, uint8_t* buf, u
     {
         printf("passed write & verify from 0x%08X to 0x%08X\n", startAddress, startAddress + startLen);
     }
+    else if(err == TOKEN_ERR_ABORTED)
+    {
+        printf("aborted write & verify at 0x%08X\n", currentAddr);
+    }
     else
     {
         printf("failed write & verify from 0x%08X to 0x%08X w/ errCode = %d\n", startAddress, startAddress + len, err);
@@ -254,21 +337,117 @@ TOKEN_ErrCode_t TokenFlash_Read(uint32_t address, uint8_t* buf, uint32_t len)
     TOKEN_ErrCode_t err = TOKEN_ERR_INVALID_INPUT;
     if(tokenFlash_isValidAddress(address + len - 1) && (buf != NULL))
     {
-        err = TOKEN_ERR_OK;
-        if(Token_WaitUntilReady())
+        err = tokenFlash_getDriver()->read(address, buf, len);
+        if(Token_IsAborted())
         {
-            uint8_t instruction[TOKEN_FLASH_INSTRUCTION_SIZE];
-            tokenFlash_getInstruction(instruction, address, TOKEN_OPCODE_READ);
-            err = (TOKEN_ErrCode_t) SPI_WriteRead(instruction, TOKEN_FLASH_INSTRUCTION_SIZE, buf, len);
+            err = TOKEN_ERR_ABORTED;
         }
-        else
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief TokenFlash_StartWritePage
+ *
+ * Start programming len bytes (within one of the part's pages) at address.
+ * Returns once the command is on the bus; poll Token_IsBusy for completion.
+ *
+ * @param  > uint32_t : address to start writing to
+ *         > uint8_t* : buffer to write from
+ *         > uint32_t : length to write, must not cross a page boundary
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenFlash_StartWritePage(uint32_t address, uint8_t* buf, uint32_t len)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_INVALID_INPUT;
+    uint32_t pageLen = TokenDevice_Get()->pageLen;
+    if(tokenFlash_isValidAddress(address + len - 1) && (buf != NULL) && (len > 0)
+        && ((address % pageLen) + len <= pageLen))
+    {
+        err = tokenFlash_getDriver()->writePage(address, buf, len);
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief TokenFlash_StartEraseSector
+ *
+ * Start erasing the sector containing address. Returns once the command is on
+ * the bus; poll Token_IsBusy for completion.
+ *
+ * @param  > uint32_t : address within sector
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenFlash_StartEraseSector(uint32_t address)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_INVALID_INPUT;
+    if(tokenFlash_isValidAddress(address))
+    {
+        err = tokenFlash_getDriver()->eraseSector(address);
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief TokenFlash_StartEraseSubsector
+ *
+ * Start erasing the 4K subsector containing address. Returns once the command
+ * is on the bus; poll Token_IsBusy for completion. Device must support it.
+ *
+ * @param  > uint32_t : address within subsector
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenFlash_StartEraseSubsector(uint32_t address)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_INVALID_INPUT;
+    if(tokenFlash_isValidAddress(address) && TokenDevice_Has(TokenDevice_Get(), TOKEN_DEVICE_FLAG_4K_ERASE))
+    {
+        err = Token_WriteEnable();
+        if(err == TOKEN_ERR_OK)
         {
-            err = TOKEN_ERR_TIMEOUT;
+            uint8_t instruction[TOKEN_FLASH_INSTRUCTION_SIZE];
+            uint32_t instructionLen = tokenFlash_getInstruction(instruction, address, TOKEN_OPCODE_FLASH_SUBSECTOR_ERASE);
+            err = Token_FromSpiErr(SPI_Write(instruction, instructionLen));
         }
     }
     return err;
 }
 
+/*******************************************************************************
+ * @brief TokenFlash_SuspendErase
+ *
+ * Suspend the sector erase in progress. Once the token reports ready, pages
+ * outside that sector may be programmed or read. Device must support it.
+ *
+ * @param  > None
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenFlash_SuspendErase(void)
+{
+    uint8_t opCode = TOKEN_OPCODE_FLASH_ERASE_SUSPEND;
+    return Token_FromSpiErr(SPI_Write(&opCode, sizeof(uint8_t)));
+}
+
+/*******************************************************************************
+ * @brief TokenFlash_ResumeErase
+ *
+ * Resume a suspended sector erase. Parts ignore it if nothing is suspended, so
+ * it is harmless if the erase finished before it could be suspended.
+ *
+ * @param  > None
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenFlash_ResumeErase(void)
+{
+    uint8_t opCode = TOKEN_OPCODE_FLASH_ERASE_RESUME;
+    return Token_FromSpiErr(SPI_Write(&opCode, sizeof(uint8_t)));
+}
+
 /*******************************************************************************
  * @brief TokenFlash_ProtectRegion
  *
@@ -314,6 +493,57 @@ TOKEN_FlashProtect_t TokenFlash_GetProtectedRegion(void)
     return region;
 }
 
+/*******************************************************************************
+ * @brief TokenFlash_GetEraseAllTime
+ *
+ * Chip erase timeout for the part in the selected socket
+ *
+ * @param  > None
+ *
+ * @return uint32_t : timeout (ms)
+ ******************************************************************************/
+uint32_t TokenFlash_GetEraseAllTime(void)
+{
+    return TokenDevice_Get()->timing.chipErase;
+}
+
+/*******************************************************************************
+ * @brief TokenFlash_PrepareDevice
+ *
+ * Let the driver of the part in the selected socket prepare it for programming
+ * (4-byte mode, unlock, quad enable). Called on identify.
+ *
+ * @param  > None
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenFlash_PrepareDevice(void)
+{
+    return tokenFlash_getDriver()->prepare();
+}
+
+/*******************************************************************************
+ * @brief TokenFlash_Enter4ByteMode
+ *
+ * Switch the token to 4-byte addressing (0xB7) for parts without dedicated
+ * 4-byte opcodes. Some parts only accept it with the write enable latch set.
+ * Lasts until power is removed.
+ *
+ * @param  > None
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenFlash_Enter4ByteMode(void)
+{
+    TOKEN_ErrCode_t err = Token_WriteEnable();
+    if(err == TOKEN_ERR_OK)
+    {
+        uint8_t opCode = TOKEN_OPCODE_FLASH_ENTER_4BYTE_MODE;
+        err = Token_FromSpiErr(SPI_Write(&opCode, sizeof(uint8_t)));
+    }
+    return err;
+}
+
 /*******************************************************************************
  * @brief TokenFlash_GetDeviceSize
  *
@@ -330,8 +560,8 @@ TOKEN_ErrCode_t TokenFlash_GetDeviceSize(uint32_t* size)
     {
         uint8_t signature = 0;
         uint8_t instruction[TOKEN_FLASH_INSTRUCTION_SIZE];
-        tokenFlash_getInstruction(instruction, 0, TOKEN_OPCODE_FLASH_READ_E_SIGNATURE);
-        err = (TOKEN_ErrCode_t) SPI_WriteRead(instruction, TOKEN_FLASH_INSTRUCTION_SIZE, &signature, sizeof(uint8_t));
+        uint32_t instructionLen = tokenFlash_getInstruction(instruction, 0, TOKEN_OPCODE_FLASH_READ_E_SIGNATURE);
+        err = Token_FromSpiErr(SPI_WriteRead(instruction, instructionLen, &signature, sizeof(uint8_t)));
         if(signature != 0)
         {
             signature &= 0x0F;
@@ -344,6 +574,123 @@ TOKEN_ErrCode_t TokenFlash_GetDeviceSize(uint32_t* size)
     return err;
 }
 
+/*******************************************************************************
+ * @brief TokenFlash_ReadUniqueId
+ *
+ * Read the factory-programmed 64-bit unique ID (0x4B)
+ *
+ * @param  > uint8_t* : buffer of TOKEN_FLASH_UNIQUE_ID_LEN bytes
+ *
+ * @return bool: true if a unique ID was read, false if unsupported/timeout
+ ******************************************************************************/
+bool TokenFlash_ReadUniqueId(uint8_t* id)
+{
+    bool isValid = false;
+    if(Token_WaitUntilReady())
+    {
+        uint8_t instruction[TOKEN_FLASH_INSTRUCTION_SIZE + TOKEN_FLASH_UNIQUE_ID_DUMMY_LEN] = {0};
+        uint32_t instructionLen = tokenFlash_getInstruction(instruction, 0, TOKEN_OPCODE_FLASH_READ_UNIQUE_ID);
+        if(SPI_WriteRead(instruction, instructionLen + TOKEN_FLASH_UNIQUE_ID_DUMMY_LEN, id, TOKEN_FLASH_UNIQUE_ID_LEN) == SPI_ERR_OK)
+        {
+            uint8_t allOr = 0x00;
+            uint8_t allAnd = 0xFF;
+            for(uint32_t i = 0; i < TOKEN_FLASH_UNIQUE_ID_LEN; i++)
+            {
+                allOr |= id[i];
+                allAnd &= id[i];
+            }
+            isValid = (allOr != 0x00) && (allAnd != 0xFF);
+        }
+    }
+    return isValid;
+}
+
+
+/*******************************************************************************
+ * @brief TokenFlash_ReadJedecId
+ *
+ * Read the 3-byte JEDEC ID (0x9F)
+ *
+ * @param  > uint32_t* : manufacturer << 16 | memory type << 8 | capacity
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenFlash_ReadJedecId(uint32_t* id)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_TIMEOUT;
+    if(Token_WaitUntilReady())
+    {
+        uint8_t opCode = TOKEN_OPCODE_FLASH_READ_JEDEC_ID;
+        uint8_t jedec[TOKEN_FLASH_JEDEC_ID_LEN] = {0};
+        err = Token_FromSpiErr(SPI_WriteRead(&opCode, sizeof(uint8_t), jedec, sizeof(jedec)));
+        *id = ((uint32_t) jedec[0] << 16) | ((uint32_t) jedec[1] << 8) | jedec[2];
+        if(err == TOKEN_ERR_OK && (*id == 0x000000 || *id == 0xFFFFFF))
+        {
+            err = TOKEN_ERR_INVALID_INPUT;
+        }
+    }
+    return err;
+}
+
+
+/*******************************************************************************
+ * @brief TokenFlash_HasFailFlags
+ *
+ * Whether the part in the selected socket reports program/erase failure in a
+ * status register, so a clean completion can stand in for a readback
+ *
+ * @param  > None
+ *
+ * @return bool
+ ******************************************************************************/
+bool TokenFlash_HasFailFlags(void)
+{
+    return TokenDevice_Has(TokenDevice_Get(), TOKEN_DEVICE_FLAG_FAIL_SCUR) ||
+           TokenDevice_Has(TokenDevice_Get(), TOKEN_DEVICE_FLAG_FAIL_FSR);
+}
+
+/*******************************************************************************
+ * @brief TokenFlash_CheckFailFlags
+ *
+ * Read the program/erase fail bits of the part in the selected socket. Call
+ * once the token reports ready after a page program or erase. Macronix parts
+ * keep them in the security register (0x2B) and clear them on the next
+ * command; Micron parts keep them in the flag status register (0x70) until
+ * cleared (0x50), which is done here when one is found set. Parts without
+ * fail flags cost nothing and always pass.
+ *
+ * @param  > None
+ *
+ * @return TOKEN_ErrCode_t : TOKEN_ERR_PROGRAM_FAILED or TOKEN_ERR_ERASE_FAILED
+ *         if flagged
+ ******************************************************************************/
+TOKEN_ErrCode_t TokenFlash_CheckFailFlags(void)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_OK;
+    const TOKEN_Device_t* device = TokenDevice_Get();
+    bool isFsr = TokenDevice_Has(device, TOKEN_DEVICE_FLAG_FAIL_FSR);
+    if(isFsr || TokenDevice_Has(device, TOKEN_DEVICE_FLAG_FAIL_SCUR))
+    {
+        uint8_t opCode = isFsr ? TOKEN_OPCODE_FLASH_READ_FLAG_SR : TOKEN_OPCODE_FLASH_READ_SECURITY_REG;
+        uint8_t flags = 0;
+        err = Token_FromSpiErr(SPI_WriteRead(&opCode, sizeof(uint8_t), &flags, sizeof(uint8_t)));
+        if(err == TOKEN_ERR_OK && (flags & (isFsr ? TOKEN_FLASH_FSR_P_FAIL : TOKEN_FLASH_SCUR_P_FAIL)))
+        {
+            err = TOKEN_ERR_PROGRAM_FAILED;
+        }
+        else if(err == TOKEN_ERR_OK && (flags & (isFsr ? TOKEN_FLASH_FSR_E_FAIL : TOKEN_FLASH_SCUR_E_FAIL)))
+        {
+            err = TOKEN_ERR_ERASE_FAILED;
+        }
+        if(isFsr && (err == TOKEN_ERR_PROGRAM_FAILED || err == TOKEN_ERR_ERASE_FAILED))
+        {
+            opCode = TOKEN_OPCODE_FLASH_MICRON_CLEAR_FLAG_SR;
+            SPI_Write(&opCode, sizeof(uint8_t));
+        }
+    }
+    return err;
+}
+
 
 /*******************************************************************************
  * Private Function Implementation
@@ -364,8 +711,8 @@ static TOKEN_ErrCode_t tokenFlash_eraseSector(uint32_t address)
     if(err == TOKEN_ERR_OK)
     {
         uint8_t instruction[TOKEN_FLASH_INSTRUCTION_SIZE];
-        tokenFlash_getInstruction(instruction, address, TOKEN_OPCODE_FLASH_SECTOR_ERASE);
-        err = (TOKEN_ErrCode_t) SPI_Write(instruction, sizeof(uint32_t));
+        uint32_t instructionLen = tokenFlash_getInstruction(instruction, address, TOKEN_OPCODE_FLASH_SECTOR_ERASE);
+        err = Token_FromSpiErr(SPI_Write(instruction, instructionLen));
     }
     return err;
 }
@@ -374,20 +721,50 @@ static TOKEN_ErrCode_t tokenFlash_eraseSector(uint32_t address)
  * @brief tokenFlash_getInstruction
  *
  * Get the formatted instruction w/ opcode and address. This transaction must be
- * sent MSB/MSb first where Opcode is the MSB of the 4 byte transaction
+ * sent MSB/MSb first where Opcode is the first byte of the transaction.
+ * Parts with 4-byte addressing get a 4-byte address: read, program and erase
+ * switch to their dedicated 4-byte opcodes where the part has them, otherwise
+ * the part was put in 4-byte mode when it was identified. RES always takes 3
+ * dummy bytes.
  *
- * @param  > uint8_t* : instruction
+ * @param  > uint8_t* : instruction, TOKEN_FLASH_INSTRUCTION_SIZE bytes
  *         > uint32_t : address
  *         > TOKEN_Opcode_t : opcode
  *
- * @return None
+ * @return uint32_t : instruction length
  ******************************************************************************/
-static void tokenFlash_getInstruction(uint8_t* instruction, uint32_t address, TOKEN_Opcode_t opCode)
+static uint32_t tokenFlash_getInstruction(uint8_t* instruction, uint32_t address, TOKEN_Opcode_t opCode)
 {
+    const TOKEN_Device_t* device = TokenDevice_Get();
+    uint32_t addressLen = 3;
+    if((device->addressLen == 4) && (opCode != TOKEN_OPCODE_FLASH_READ_E_SIGNATURE))
+    {
+        TOKEN_Opcode_t opCode4 = TOKEN_OPCODE_NONE;
+        switch(opCode)
+        {
+            case TOKEN_OPCODE_READ:                 opCode4 = TOKEN_OPCODE_READ_4BYTE;              break;
+            case TOKEN_OPCODE_FLASH_FAST_READ:      opCode4 = TOKEN_OPCODE_FLASH_FAST_READ_4BYTE;   break;
+            case TOKEN_OPCODE_WRITE:                opCode4 = TOKEN_OPCODE_WRITE_4BYTE;             break;
+            case TOKEN_OPCODE_FLASH_SECTOR_ERASE:   opCode4 = TOKEN_OPCODE_FLASH_SECTOR_ERASE_4BYTE; break;
+            case TOKEN_OPCODE_FLASH_SUBSECTOR_ERASE: opCode4 = TOKEN_OPCODE_FLASH_SUBSECTOR_ERASE_4BYTE; break;
+            default:                                                                                break;
+        }
+        if(TokenDevice_Has(device, TOKEN_DEVICE_FLAG_4BYTE_OPCODES) && (opCode4 != TOKEN_OPCODE_NONE))
+        {
+            opCode = opCode4;
+            addressLen = 4;
+        }
+        else if(TokenDevice_Has(device, TOKEN_DEVICE_FLAG_4BYTE_MODE))
+        {
+            addressLen = 4;
+        }
+    }
     instruction[0] = (uint8_t) (opCode & 0xFF);
-    instruction[1] = (uint8_t) (address >> 16) & 0xFF;
-    instruction[2] = (uint8_t) (address >> 8) & 0xFF;
-    instruction[3] = (uint8_t) (address & 0xFF);
+    for(uint32_t i = 0; i < addressLen; i++)
+    {
+        instruction[1 + i] = (uint8_t) ((address >> (8 * (addressLen - 1 - i))) & 0xFF);
+    }
+    return 1 + addressLen;
 }
 
 /*******************************************************************************
@@ -407,8 +784,8 @@ static TOKEN_ErrCode_t tokenFlash_writePage(uint32_t address, uint8_t* buf, uint
     if(err == TOKEN_ERR_OK)
     {
         uint8_t instruction[TOKEN_FLASH_INSTRUCTION_SIZE];
-        tokenFlash_getInstruction(instruction, address, TOKEN_OPCODE_WRITE);
-        err = (TOKEN_ErrCode_t) SPI_Write2(instruction, sizeof(instruction), buf, bufLen);
+        uint32_t instructionLen = tokenFlash_getInstruction(instruction, address, TOKEN_OPCODE_WRITE);
+        err = Token_FromSpiErr(SPI_Write2(instruction, instructionLen, buf, bufLen));
     }
     return err;
 }
@@ -424,8 +801,256 @@ static TOKEN_ErrCode_t tokenFlash_writePage(uint32_t address, uint8_t* buf, uint
  ******************************************************************************/
 static bool tokenFlash_isValidAddress(uint32_t address)
 {
-    return address < TOKEN_FLASH_MEM_SIZE;
+    return address < TokenDevice_Get()->size;
+}
+
+
+/*******************************************************************************
+ * @brief tokenFlash_getDriver
+ *
+ * Driver of the part in the selected socket
+ *
+ * @param  > None
+ *
+ * @return const TOKEN_FLASH_Driver_t*
+ ******************************************************************************/
+static const TOKEN_FLASH_Driver_t* tokenFlash_getDriver(void)
+{
+    return &m_drivers[TokenDevice_Get()->driver];
+}
+
+/*******************************************************************************
+ * @brief tokenFlash_prepare
+ *
+ * Generic prepare: enter 4-byte mode on parts that need it
+ *
+ * @param  > None
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t tokenFlash_prepare(void)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_OK;
+    if(TokenDevice_Has(TokenDevice_Get(), TOKEN_DEVICE_FLAG_4BYTE_MODE))
+    {
+        err = TokenFlash_Enter4ByteMode();
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief tokenFlash_read
+ *
+ * Read len bytes from address with 0x03
+ *
+ * @param  > uint32_t : address to start reading from
+ *         > uint8_t* : buffer to read into
+ *         > uint32_t : length to read
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t tokenFlash_read(uint32_t address, uint8_t* buf, uint32_t len)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_TIMEOUT;
+    if(Token_WaitUntilReady())
+    {
+        uint8_t instruction[TOKEN_FLASH_INSTRUCTION_SIZE];
+        uint32_t instructionLen = tokenFlash_getInstruction(instruction, address, TOKEN_OPCODE_READ);
+        err = Token_FromSpiErr(SPI_WriteRead(instruction, instructionLen, buf, len));
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief tokenFlash_prepareQuad
+ *
+ * Quad prepare: set QE in status register 2 (Winbond layout) if the bus can
+ * clock 4 lines. Without it the quad driver runs the generic routines.
+ *
+ * @param  > None
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t tokenFlash_prepareQuad(void)
+{
+    TOKEN_ErrCode_t err = tokenFlash_prepare();
+    if(err == TOKEN_ERR_OK && SPI_IsQuad() && Token_WaitUntilReady())
+    {
+        uint8_t opCode = TOKEN_OPCODE_FLASH_READ_SR2;
+        uint8_t sr2 = 0;
+        err = Token_FromSpiErr(SPI_WriteRead(&opCode, sizeof(uint8_t), &sr2, sizeof(uint8_t)));
+        if(err == TOKEN_ERR_OK && !(sr2 & TOKEN_FLASH_SR2_QUAD_ENABLE))
+        {
+            err = Token_WriteEnable();
+            if(err == TOKEN_ERR_OK)
+            {
+                uint8_t instruction[] = { TOKEN_OPCODE_FLASH_WRITE_SR2, (uint8_t) (sr2 | TOKEN_FLASH_SR2_QUAD_ENABLE) };
+                err = Token_FromSpiErr(SPI_Write(instruction, sizeof(instruction)));
+            }
+        }
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief tokenFlash_writePageQuad
+ *
+ * Write bufLen bytes with 0x32 quad page program: opcode and address on 1 line,
+ * data on 4. Falls back to the generic page program if the bus can't, or for
+ * 4-byte addresses.
+ *
+ * @param  > uint32_t : address to start writing
+ *         > uint8_t* : buffer to write
+ *         > uint32_t : length to write
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t tokenFlash_writePageQuad(uint32_t address, uint8_t* buf, uint32_t bufLen)
+{
+    if(!SPI_IsQuad() || TokenDevice_Get()->addressLen != 3)
+    {
+        return tokenFlash_writePage(address, buf, bufLen);
+    }
+    TOKEN_ErrCode_t err = Token_WriteEnable();
+    if(err == TOKEN_ERR_OK)
+    {
+        uint8_t instruction[TOKEN_FLASH_INSTRUCTION_SIZE];
+        uint32_t instructionLen = tokenFlash_getInstruction(instruction, address, TOKEN_OPCODE_FLASH_QUAD_WRITE);
+        err = Token_FromSpiErr(SPI_WriteQuad(instruction, instructionLen, buf, bufLen));
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief tokenFlash_readQuad
+ *
+ * Read len bytes with 0x6B quad output read. Falls back to the generic read if
+ * the bus can't, or for 4-byte addresses.
+ *
+ * @param  > uint32_t : address to start reading from
+ *         > uint8_t* : buffer to read into
+ *         > uint32_t : length to read
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t tokenFlash_readQuad(uint32_t address, uint8_t* buf, uint32_t len)
+{
+    if(!SPI_IsQuad() || TokenDevice_Get()->addressLen != 3)
+    {
+        return tokenFlash_read(address, buf, len);
+    }
+    TOKEN_ErrCode_t err = TOKEN_ERR_TIMEOUT;
+    if(Token_WaitUntilReady())
+    {
+        uint8_t instruction[TOKEN_FLASH_INSTRUCTION_SIZE + TOKEN_FLASH_QUAD_READ_DUMMY_LEN] = {0};
+        uint32_t instructionLen = tokenFlash_getInstruction(instruction, address, TOKEN_OPCODE_FLASH_QUAD_READ);
+        err = Token_FromSpiErr(SPI_ReadQuad(instruction, instructionLen + TOKEN_FLASH_QUAD_READ_DUMMY_LEN, buf, len));
+    }
+    return err;
 }
 
+/*******************************************************************************
+ * @brief tokenFlash_prepareSst
+ *
+ * SST prepare: SST parts power up with every block write protected. Clear the
+ * protection bits (EWSR then WRSR 0x00).
+ *
+ * @param  > None
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t tokenFlash_prepareSst(void)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_TIMEOUT;
+    if(Token_WaitUntilReady())
+    {
+        uint8_t opCode = TOKEN_OPCODE_FLASH_SST_ENABLE_WRITE_SR;
+        err = Token_FromSpiErr(SPI_Write(&opCode, sizeof(uint8_t)));
+        if(err == TOKEN_ERR_OK)
+        {
+            uint8_t instruction[] = { TOKEN_OPCODE_WRITE_SR, 0x00 };
+            err = Token_FromSpiErr(SPI_Write(instruction, sizeof(instruction)));
+        }
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief tokenFlash_writePageAai
+ *
+ * Write bufLen bytes with SST auto address increment programming. SST parts
+ * have no page program: the first word carries the address, every following
+ * 0xAD carries just the next 2 bytes, and WRDI ends the sequence. An odd
+ * leading or trailing byte goes out as a single byte program. Each word is
+ * waited out here, so the part is ready when this returns.
+ *
+ * @param  > uint32_t : address to start writing
+ *         > uint8_t* : buffer to write
+ *         > uint32_t : length to write
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t tokenFlash_writePageAai(uint32_t address, uint8_t* buf, uint32_t bufLen)
+{
+    TOKEN_ErrCode_t err = TOKEN_ERR_OK;
+    uint8_t instruction[TOKEN_FLASH_INSTRUCTION_SIZE];
+    uint32_t instructionLen = 0;
+    if(address & 1)
+    {
+        err = tokenFlash_writePage(address, buf, 1);
+        err = (err == TOKEN_ERR_OK && !tokenFlash_waitAai()) ? TOKEN_ERR_TIMEOUT : err;
+        address++;
+        buf++;
+        bufLen--;
+    }
+    if(err == TOKEN_ERR_OK && bufLen >= 2)
+    {
+        err = Token_WriteEnable();
+        for(uint32_t i = 0; (i + 1 < bufLen) && (err == TOKEN_ERR_OK); i += 2)
+        {
+            if(i == 0)
+            {
+                instructionLen = tokenFlash_getInstruction(instruction, address, TOKEN_OPCODE_FLASH_AAI_WRITE);
+            }
+            else
+            {
+                instruction[0] = TOKEN_OPCODE_FLASH_AAI_WRITE;
+                instructionLen = 1;
+            }
+            err = Token_FromSpiErr(SPI_Write2(instruction, instructionLen, buf + i, 2));
+            err = (err == TOKEN_ERR_OK && !tokenFlash_waitAai()) ? TOKEN_ERR_TIMEOUT : err;
+        }
+        uint8_t opCode = TOKEN_OPCODE_WRITE_DISABLE;
+        SPI_Write(&opCode, sizeof(uint8_t));
+        address += bufLen & ~1u;
+        buf += bufLen & ~1u;
+        bufLen &= 1;
+    }
+    if(err == TOKEN_ERR_OK && bufLen == 1)
+    {
+        err = tokenFlash_writePage(address, buf, 1);
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief tokenFlash_waitAai
+ *
+ * Wait out one SST byte/word program. Status can't be read while
+ * broadcasting, so the datasheet time is waited instead.
+ *
+ * @param  > None
+ *
+ * @return bool : true if the part is ready
+ ******************************************************************************/
+static bool tokenFlash_waitAai(void)
+{
+    if(SPI_IsBroadcast())
+    {
+        delayMicroseconds(TOKEN_FLASH_AAI_WORD_TIME_US);
+        return true;
+    }
+    return Token_WaitUntilReady();
+}
 
 // EOF
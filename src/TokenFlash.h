@@ -24,13 +24,23 @@
  * Macros
  ******************************************************************************/
 
-#define TOKEN_FLASH_PAGE_LEN     0x100
+#define TOKEN_FLASH_PAGE_LEN     0x100      // generic token; TokenDevice_Get()->pageLen for the fitted part
+#define TOKEN_FLASH_MAX_PAGE_LEN 0x200
 #define TOKEN_FLASH_SECTOR_LEN   0x10000
-#define TOKEN_FLASH_MEM_SIZE     0x800000
+#define TOKEN_FLASH_SUBSECTOR_LEN 0x1000     // parts with TOKEN_DEVICE_FLAG_4K_ERASE
+#define TOKEN_FLASH_MEM_SIZE     0x800000   // generic token; TokenDevice_Get()->size for the fitted part
+#define TOKEN_FLASH_MAX_MEM_SIZE 0x8000000  // largest part we source (128 MB)
+#define TOKEN_FLASH_SECTOR_COUNT (TOKEN_FLASH_MAX_MEM_SIZE / TOKEN_FLASH_SECTOR_LEN)
+#define TOKEN_FLASH_3BYTE_LIMIT  0x1000000  // parts beyond this need 4-byte addresses
+#define TOKEN_FLASH_UNIQUE_ID_LEN 8
 
 // From Datasheet Table 8: AC Characteristics
 #define TOKEN_FLASH_ERASE_ALL_TIME (161*TIMER_1SEC) // Datasheet says 20 seconds for bulk erase for 8Mb; 64Mb will take 8x longer, so 160 seconds.
 #define TOKEN_FLASH_ERASE_SECTOR_TIME (3*TIMER_1SEC)
+#define TOKEN_FLASH_ERASE_ALL_HOLDOFF (10*TIMER_1SEC) // don't trust WIP until chip erase has run this long
+#define TOKEN_FLASH_PAGE_PROGRAM_TIME TIMER_5MS
+#define TOKEN_FLASH_ERASE_SUSPEND_TIME TIMER_1MS // tSUS is tens of us; a tick is the finest we can time
+#define TOKEN_FLASH_ERASE_SUSPEND_MAX 16 // each resume restarts part of the erase pulse; caps the time suspends add to an erase
 
 
 /*******************************************************************************
@@ -70,6 +80,25 @@ TOKEN_ErrCode_t TokenFlash_Write(uint32_t startAddress, uint8_t* buf, uint32_t l
 // Read from Token
 TOKEN_ErrCode_t TokenFlash_Read(uint32_t address, uint8_t* buf, uint32_t len);
 
+// Start programming len bytes (within one of the part's pages) at address.
+// Returns once the command is on the bus; poll Token_IsBusy for completion.
+TOKEN_ErrCode_t TokenFlash_StartWritePage(uint32_t address, uint8_t* buf, uint32_t len);
+
+// Start erasing the sector containing address. Returns once the command is on
+// the bus; poll Token_IsBusy for completion.
+TOKEN_ErrCode_t TokenFlash_StartEraseSector(uint32_t address);
+
+// Start erasing the 4K subsector containing address. Returns once the command
+// is on the bus; poll Token_IsBusy for completion. Device must support it.
+TOKEN_ErrCode_t TokenFlash_StartEraseSubsector(uint32_t address);
+
+// Suspend the sector erase in progress. Once the token reports ready, pages
+// outside that sector may be programmed or read. Device must support it.
+TOKEN_ErrCode_t TokenFlash_SuspendErase(void);
+
+// Resume a suspended sector erase. Harmless if the erase already finished.
+TOKEN_ErrCode_t TokenFlash_ResumeErase(void);
+
 // Write to Token and verify result
 TOKEN_ErrCode_t TokenFlash_WriteAndVerify(uint32_t startAddress, uint8_t* buf, uint32_t len);
 
@@ -83,7 +112,32 @@ TOKEN_ErrCode_t TokenFlash_ProtectRegion(TOKEN_FlashProtect_t region);
 // memory will be protected.
 TOKEN_FlashProtect_t TokenFlash_GetProtectedRegion(void);
 
+// Chip erase timeout for the part in the selected socket
+uint32_t TokenFlash_GetEraseAllTime(void);
+
+// Let the driver of the part in the selected socket prepare it for
+// programming (4-byte mode, unlock, quad enable). Called on identify.
+TOKEN_ErrCode_t TokenFlash_PrepareDevice(void);
+
+// Switch the token to 4-byte addressing (0xB7) for parts without dedicated
+// 4-byte opcodes. Lasts until power is removed.
+TOKEN_ErrCode_t TokenFlash_Enter4ByteMode(void);
+
 // Get Token Device Size
 TOKEN_ErrCode_t TokenFlash_GetDeviceSize(uint32_t* size);
 
+// Read the factory-programmed 64-bit unique ID (0x4B). False if the part does
+// not implement it (reads back all 0x00 or all 0xFF).
+bool TokenFlash_ReadUniqueId(uint8_t* id);
+
+// Read the 3-byte JEDEC ID (0x9F): manufacturer << 16 | type << 8 | capacity
+TOKEN_ErrCode_t TokenFlash_ReadJedecId(uint32_t* id);
+
+// Whether the part in the selected socket flags failed programs and erases
+bool TokenFlash_HasFailFlags(void);
+
+// Read (and clear, where sticky) the program/erase fail flags once the token
+// is ready. TOKEN_ERR_OK on parts without them.
+TOKEN_ErrCode_t TokenFlash_CheckFailFlags(void);
+
 #endif /* _TOKEN_FLASH_H_  */
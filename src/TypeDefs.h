@@ -10,9 +10,30 @@
 #define LED_FAIL 	     20
 #define LED_SUCCESS 	 21
 
+// Sockets sharing the SPI bus, each w/ its own chip select, LOFO and LEDs.
+// Socket 0 is the original fixture; add a column to every table per socket.
+#define SOCKET_COUNT                1
+#define SOCKET_CS_PINS              { SPI_CS_PIN }
+#define SOCKET_LOFO_PINS            { LOFO }
+#define SOCKET_LED_TOKEN_PINS       { LED_TOKEN }
+#define SOCKET_LED_INPROGRESS_PINS  { LED_INPROGRESS }
+#define SOCKET_LED_FAIL_PINS        { LED_FAIL }
+#define SOCKET_LED_SUCCESS_PINS     { LED_SUCCESS }
+
+// Fixture strap choosing the library image, bit 0 first. A jumper to ground
+// sets the bit.
+#define LIBRARY_STRAP_PINS          { 23, 24 }
+
 #define MIN(a,b)    ((a < b) ? a : b)
 
 #define FILE_PATH        "/home/pi/Documents/CODE/spiToken/src/Pluto_FULL_TOKEN.bin"
+#define JOURNAL_PATH     "/home/pi/Documents/CODE/spiToken/src/journal"
+#define DELTA_PATH       "/home/pi/Documents/CODE/spiToken/src/versions"
+#define LIBRARY_PATH     "/home/pi/Documents/CODE/spiToken/src/library"
+#define PERSONALIZE_MAP_PATH   "/home/pi/Documents/CODE/spiToken/src/personalize.map"
+#define PERSONALIZE_STATE_PATH "/home/pi/Documents/CODE/spiToken/src/personalize.state"
+#define CONTROL_PATH     "/home/pi/Documents/CODE/spiToken/src/tok.sock"
+#define DUMP_PATH        "/home/pi/Documents/CODE/spiToken/src/dumps"
 
 #define TEST_TOKEN_RW_SIZE      256
 #define TOK_F_WRITE             ((WriteAndVerifyHook) TokenFlash_Write)
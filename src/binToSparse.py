@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+
+# Convert a raw token image (.bin) into the sparse container tok reads:
+# runs of a repeated byte or 32-bit word become fill chunks, everything else
+# stays raw, and --hole ranges become don't-care chunks that tok never erases,
+# programs or verifies. Erase works a 64K sector at a time, so a hole must
+# start and end on a sector boundary (or end with the image); a sector that
+# also holds data is erased whole and can't keep any of its bytes.
+#
+#   python3 binToSparse.py Pluto_FULL_TOKEN.bin Pluto_FULL_TOKEN.tksp --hole 0x2F0000:0x300000
+
+import sys
+import argparse
+import struct
+
+SPARSE_MAGIC = b'TKSP'
+SPARSE_VERSION = 1
+SPARSE_HEADER_LEN = 16
+
+CHUNK_RAW = 1
+CHUNK_FILL = 2
+CHUNK_HOLE = 3
+
+SCAN_LEN = 256      # fills are found a page at a time
+SECTOR_LEN = 0x10000    # erase unit, the smallest range a hole can keep
+
+def parseHole(text):
+    start, end = text.split(':')
+    start = int(start, 0)
+    end = int(end, 0)
+    if end <= start:
+        raise argparse.ArgumentTypeError('hole %s is empty' % text)
+    return (start, end)
+
+# Fill word if block is one 32-bit word repeated, else None
+def fillWord(block):
+    if len(block) == 0 or len(block) % 4 != 0:
+        return None
+    word = block[:4]
+    if block != word * (len(block) // 4):
+        return None
+    return struct.unpack('<I', word)[0]
+
+# Append a chunk, merging it into the previous one where they continue each other
+def addChunk(chunks, kind, data, fill=0):
+    if chunks and chunks[-1][0] == kind and kind != CHUNK_FILL:
+        chunks[-1][1].extend(data)
+    elif chunks and chunks[-1][0] == CHUNK_FILL and kind == CHUNK_FILL and chunks[-1][2] == fill:
+        chunks[-1][1].extend(data)
+    else:
+        chunks.append([kind, bytearray(data), fill])
+
+# Split image into chunks. Holes take precedence over whatever the .bin holds.
+def makeChunks(image, holes):
+    bounds = sorted(set([0, len(image)] + [min(max(x, 0), len(image)) for hole in holes for x in hole]))
+    chunks = []
+    for start, end in zip(bounds, bounds[1:]):
+        if any(hole[0] <= start and end <= hole[1] for hole in holes):
+            addChunk(chunks, CHUNK_HOLE, image[start:end])
+            continue
+        address = start
+        while address < end:
+            blockEnd = min((address // SCAN_LEN + 1) * SCAN_LEN, end)
+            block = image[address:blockEnd]
+            fill = fillWord(block)
+            if fill is None:
+                addChunk(chunks, CHUNK_RAW, block)
+            else:
+                addChunk(chunks, CHUNK_FILL, block, fill)
+            address = blockEnd
+    return chunks
+
+def writeSparse(path, image, chunks):
+    with open(path, 'wb') as f:
+        f.write(SPARSE_MAGIC + struct.pack('<HHII', SPARSE_VERSION, SPARSE_HEADER_LEN, len(image), len(chunks)))
+        for kind, data, fill in chunks:
+            f.write(struct.pack('<HHII', kind, 0, len(data), fill))
+            if kind == CHUNK_RAW:
+                f.write(data)
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert a raw token image to a sparse container')
+    parser.add_argument('bin', help='raw image')
+    parser.add_argument('out', help='sparse container to write')
+    parser.add_argument('--hole', type=parseHole, action='append', default=[],
+                        help='START:END range of whole 64K sectors tok must leave untouched (repeatable)')
+    args = parser.parse_args()
+
+    with open(args.bin, 'rb') as f:
+        image = f.read()
+    for start, end in args.hole:
+        if start % SECTOR_LEN != 0 or (end % SECTOR_LEN != 0 and end < len(image)):
+            parser.error('hole 0x%X:0x%X is not whole 64K erase sectors, its sectors would be erased' % (start, end))
+    chunks = makeChunks(image, args.hole)
+    writeSparse(args.out, image, chunks)
+
+    totals = {CHUNK_RAW: 0, CHUNK_FILL: 0, CHUNK_HOLE: 0}
+    blank = 0
+    for kind, data, fill in chunks:
+        totals[kind] += len(data)
+        if kind == CHUNK_FILL and fill == 0xFFFFFFFF:
+            blank += len(data)
+    print('%s: %d bytes, %d chunks: %d raw, %d fill (%d blank), %d hole' % (args.out, len(image), len(chunks),
+          totals[CHUNK_RAW], totals[CHUNK_FILL], blank, totals[CHUNK_HOLE]))
+    sys.exit(0)
+
+if __name__=="__main__":
+    main()
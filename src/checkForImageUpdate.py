@@ -6,6 +6,7 @@ import time
 import datetime
 from pathlib import Path
 import shutil
+import hashlib
 
 PLUTO_BIN = 'Pluto.bin.TOKEN_FULL'
 PLUTO_PATH_REMOTE = '/home/pi/Desktop/'
@@ -13,6 +14,14 @@ PLUTO_PATH_LOCAL = '/home/pi/token/'
 
 CHECK_NETWORK_EVERY_X_SECONDS = 1
 
+# Sync unit: one token flash sector, the unit the programmer rewrites. Images
+# are flat flash contents, so blocks are compared at fixed offsets.
+BLOCK_LEN = 0x10000
+# Block digests published next to an image on the share (--index)
+INDEX_SUFFIX = '.blocks'
+# Changed blocks handed to the programmer for delta planning
+DELTA_SUFFIX = '.delta'
+
 class FileWatcher(object):
     running = True
     refresh_delay_secs = CHECK_NETWORK_EVERY_X_SECONDS
@@ -49,18 +58,146 @@ class FileWatcher(object):
             except: 
                 print('Unhandled error: %s' % sys.exc_info()[0])
 
-# Copy the file from the network to the local computer.
-def copyFile(filename, src, dst):
+# Digest of one block
+def blockDigest(block):
+    return hashlib.blake2b(block, digest_size=16).digest()
+
+# Digest of every block of the file at path
+def blockDigests(path):
+    digests = []
+    with open(path, 'rb') as f:
+        while True:
+            block = f.read(BLOCK_LEN)
+            if not block:
+                break
+            digests.append(blockDigest(block))
+    return digests
+
+# Publish the block digests of the file at path, run on the build share after
+# each release. With them a sync reads only the changed blocks over the network.
+def writeIndex(path):
+    stat = os.stat(path)
+    digests = blockDigests(path)
+    tmp = path + INDEX_SUFFIX + '.tmp'
+    with open(tmp, 'w') as f:
+        f.write('%d %d\n' % (stat.st_size, int(stat.st_mtime)))
+        for digest in digests:
+            f.write(digest.hex() + '\n')
+    os.replace(tmp, path + INDEX_SUFFIX)
+
+# Block digests published for the file at path, None if missing or stale
+def readIndex(path, stat):
+    try:
+        with open(path + INDEX_SUFFIX) as f:
+            size, mtime = (int(x) for x in f.readline().split())
+            if size != stat.st_size or mtime != int(stat.st_mtime):
+                return None
+            return [bytes.fromhex(line.strip()) for line in f]
+    except (OSError, ValueError):
+        return None
+
+# Copy length bytes at offset from one file to the other, in the kernel
+def copyRange(fdIn, fdOut, offset, length):
+    while length > 0:
+        copied = os.copy_file_range(fdIn, fdOut, length, offset, offset)
+        if copied <= 0:
+            raise OSError('short copy')
+        offset += copied
+        length -= copied
+
+# Write path atomically: temp file, fsync, rename
+def writeAtomic(path, text):
+    tmp = path + '.tmp'
+    with open(tmp, 'w') as f:
+        f.write(text)
+        f.flush()
+        os.fsync(f.fileno())
+    os.replace(tmp, path)
+
+# Bring the local copy of a file up to date with the network, block by block.
+# Blocks whose digests match the local copy are copied locally; only the rest
+# come over the network (all of them are read to compare if the share has no
+# index). The new copy is built in a temp file and renamed over the old one,
+# so the programmer never sees a half written image. The changed blocks go to
+# DELTA_SUFFIX first, for the programmer to plan upgrades from the old version
+# without hashing the unchanged sectors again.
+def syncFile(filename, src, dst):
+    remote = src + filename
+    local = dst + filename
+    tmp = dst + '.' + filename + '.tmp'
     try:
         now = datetime.datetime.now()
-        print(now, "Copying file", src+filename, "to", dst+filename)
-        shutil.copy2(src+filename, dst)
+        remoteStat = os.stat(remote)
+        try:
+            localStat = os.stat(local)
+            localDigests = blockDigests(local)
+        except FileNotFoundError:
+            localStat = None
+            localDigests = []
+        remoteDigests = readIndex(remote, remoteStat)
+        blockCount = (remoteStat.st_size + BLOCK_LEN - 1) // BLOCK_LEN
+        changed = []
+        fetched = 0
+        fdIn = os.open(remote, os.O_RDONLY)
+        fdOld = os.open(local, os.O_RDONLY) if localStat else -1
+        fdOut = os.open(tmp, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644)
+        try:
+            for block in range(blockCount):
+                offset = block * BLOCK_LEN
+                length = min(BLOCK_LEN, remoteStat.st_size - offset)
+                isLocal = block < len(localDigests)
+                if remoteDigests is not None and isLocal and block < len(remoteDigests) \
+                        and remoteDigests[block] == localDigests[block]:
+                    copyRange(fdOld, fdOut, offset, length)
+                    continue
+                data = os.pread(fdIn, length, offset)
+                if len(data) != length:
+                    raise OSError('short read')
+                fetched += length
+                if not isLocal or blockDigest(data) != localDigests[block]:
+                    changed.append(block)
+                os.pwrite(fdOut, data, offset)
+            os.fsync(fdOut)
+        finally:
+            os.close(fdIn)
+            os.close(fdOut)
+            if fdOld >= 0:
+                os.close(fdOld)
+
+        if localStat and not changed and remoteStat.st_size == localStat.st_size:
+            os.remove(tmp)
+            print(now, "No blocks changed in", remote)
+            return
+        shutil.copystat(remote, tmp)
+        if localStat:
+            tmpStat = os.stat(tmp)
+            writeAtomic(local + DELTA_SUFFIX,
+                        'block %d\nfrom %d %d\nto %d %d\nchanged %s\n'
+                        % (BLOCK_LEN, localStat.st_size, localStat.st_mtime_ns, tmpStat.st_size,
+                           tmpStat.st_mtime_ns, ' '.join(str(block) for block in changed)))
+        # The programmer daemon watches the file and stages the new image itself
+        os.replace(tmp, local)
+        dirFd = os.open(dst, os.O_RDONLY)
+        os.fsync(dirFd)
+        os.close(dirFd)
+        print(now, "Synced", remote, "to", local + ":", len(changed), "of", blockCount, "blocks changed,",
+              fetched // 1024, "KB read from the network")
     except:
-        print("Failed to copy file")
+        print("Failed to sync file: %s" % sys.exc_info()[1])
+        try:
+            os.remove(tmp)
+        except OSError:
+            pass
+        return
 
 
 def main():
-    
+
+    # On the build share: publish the block digests of a new release
+    if len(sys.argv) == 3 and sys.argv[1] == '--index':
+        writeIndex(sys.argv[2])
+        sys.exit(0)
+
     time.sleep(5)
     now = datetime.datetime.now()
 
@@ -71,7 +208,7 @@ def main():
 
     try:
         print(now, " Running file watcher")
-        fileWatcher = FileWatcher(PLUTO_PATH_REMOTE + PLUTO_BIN, copyFile, filename=PLUTO_BIN, src=PLUTO_PATH_REMOTE, dst=PLUTO_PATH_LOCAL)
+        fileWatcher = FileWatcher(PLUTO_PATH_REMOTE + PLUTO_BIN, syncFile, filename=PLUTO_BIN, src=PLUTO_PATH_REMOTE, dst=PLUTO_PATH_LOCAL)
         fileWatcher.watch()
     except:
         print("Failed file watch; exception thrown.")
@@ -1,31 +1,23 @@
 #include <stdio.h>
 #include "Timer.h"
 #include "Token.h"
-#include <pthread.h>
-#include <semaphore.h>
 #include <wiringPi.h>
 #include "TypeDefs.h"
 #include "test.h"
 #include "TokenFlash.h"
-
-#define STARTUP()       digitalWrite(LED_INPROGRESS, 0); digitalWrite(LED_SUCCESS, 0); digitalWrite(LED_FAIL, 0); digitalWrite(LED_TOKEN, 0)
-#define INPROGRESS()    digitalWrite(LED_INPROGRESS, 1); digitalWrite(LED_SUCCESS, 0); digitalWrite(LED_FAIL, 0)
-#define PASSED()        digitalWrite(LED_INPROGRESS, 0); digitalWrite(LED_SUCCESS, 1); digitalWrite(LED_FAIL, 0)
-#define FAILED()        digitalWrite(LED_INPROGRESS, 0); digitalWrite(LED_SUCCESS, 0); digitalWrite(LED_FAIL, 1)
-
-extern sem_t g_tokenSem;
-extern bool m_isStatusChanged;
-extern bool m_isInserted;
-static FILE* fp;
-static uint8_t tmpBuf[256] = {0};
-
-// Program the flash token
-static void programToken(void);
+#include "Event.h"
+#include "Socket.h"
+#include "Scheduler.h"
+#include "Library.h"
+#include "Control.h"
+#include "Status.h"
 
 /*******************************************************************************
  * @brief main
  *
- * Run main
+ * Run main. Sleeps in Event_Wait until the debounce thread, a signal or the
+ * control socket posts an event. While any socket has a job in flight the scheduler is
+ * serviced between (non-blocking) event checks.
  *
  * @param  None
  *
@@ -36,82 +28,51 @@ int main(void)
 {
     wiringPiSetupGpio();
     Timer_Init();
-    pinMode(SPI_CS_PIN, OUTPUT);
-    pinMode(LED_TOKEN, OUTPUT);
-    pinMode(LED_INPROGRESS, OUTPUT);
-    pinMode(LED_FAIL, OUTPUT);
-    pinMode(LED_SUCCESS, OUTPUT);
-    pinMode(LOFO, INPUT);
-    STARTUP();
+    Socket_Init();
+    Library_Init();
+    Event_Init();
+    Status_Init();
+    Control_Init();
     Token_Init();
-    while(1)
-    {
-        if(m_isStatusChanged)
-        {
-            if(m_isInserted)
-            {
-                sem_wait(&g_tokenSem);
-                m_isStatusChanged = false;
-                sem_post(&g_tokenSem);
-                programToken();
-            }
-        }
-    }
-    return 0;
-}
-
-/*******************************************************************************
- * @brief programToken
- *
- * Program the flash token
- *
- * @param  None
- *
- * @return int
- *
- ******************************************************************************/
-static void programToken(void)
-{
-    printf("Entering program token\n");
-    fp = fopen(FILE_PATH, "r+");
-    uint16_t size = 0;
-    uint32_t addr = 0;
-    INPROGRESS();
-    TokenFlash_EraseAllBlocking();
-
- //   TokenFlash_Erase(0, TOKEN_FLASH_SECTOR_LEN);
- //   Timer_Sleep(TOKEN_FLASH_ERASE_SECTOR_TIME);
-    bool passed = false;
-    bool eraseSector = false;
-    uint32_t lastSector = 0;
-    uint32_t currentSector = 0;
-    TOKEN_ErrCode_t err = TOKEN_ERR_OK;
-    do
+    bool running = true;
+    while(running)
     {
-        size = (uint16_t) fread(tmpBuf, 1, sizeof(tmpBuf), fp);
-        if(size != 0)
+        uint8_t socket = 0;
+        switch(Event_Wait(Scheduler_IsBusy() ? 0 : EVENT_WAIT_FOREVER, &socket))
         {
-            lastSector = (addr - 1) / TOKEN_FLASH_SECTOR_LEN;
-            currentSector = (addr + size) / TOKEN_FLASH_SECTOR_LEN;
-//            if(currentSector > lastSector)
-//            {
-//                TokenFlash_Erase(currentSector*TOKEN_FLASH_SECTOR_LEN, TOKEN_FLASH_SECTOR_LEN);
-//                Timer_Sleep(TOKEN_FLASH_ERASE_SECTOR_TIME);
-//            }
-            err = TokenFlash_WriteAndVerify(addr, tmpBuf, size);
-            if(err != TOKEN_ERR_OK)
-            {
-                printf("failed token write and verify\n");
-                FAILED();
+            case EVENT_TOKEN_INSERTED:
+                if(Token_IsSocketInserted(socket))
+                {
+                    Scheduler_Start(socket);
+                }
+                break;
+            case EVENT_TOKEN_REMOVED:
+                Scheduler_Stop(socket);
+                break;
+            case EVENT_IMAGE_UPDATED:
+                printf("image updated, staging the new library in %s\n", LIBRARY_PATH);
+                Scheduler_ImageUpdated();
+                break;
+            case EVENT_LIBRARY_STAGED:
+                Scheduler_LibraryStaged();
+                break;
+            case EVENT_CONTROL:
+                Control_Service();
+                break;
+            case EVENT_SHUTDOWN:
+                printf("shutting down\n");
+                running = false;
+                break;
+            default:
                 break;
-            }
-            addr += size;            
         }
-    } while(size != 0);
-    if(err == TOKEN_ERR_OK)
+        Scheduler_Service();
+    }
+    for(uint8_t i = 0; i < SOCKET_COUNT; i++)
     {
-        PASSED();
-        printf("passed token write and verify\n");
+        Scheduler_Stop(i);
+        Socket_SetLeds(i, SOCKET_LED_IDLE);
+        Socket_SetTokenLed(i, false);
     }
-    fclose(fp);
+    return 0;
 }
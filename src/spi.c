@@ -18,6 +18,9 @@
 #include <wiringPi.h>
 #include "TypeDefs.h"
 #include <string.h>
+#include <stdatomic.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
 
 // Module Includes
 #include <wiringPiSPI.h>
@@ -39,8 +42,14 @@
 
 #define SPI_BAD_CONNECTION_FD       ((int) -1)
 #define TMP_WRITE_BUF_SIZE          256
+#define SPI_POLL_BLOCK_MAX          64
 
 static uint8_t tmpWriteBuf[TMP_WRITE_BUF_SIZE]; 
+static const int m_csPins[SOCKET_COUNT] = SOCKET_CS_PINS;
+static uint8_t m_device = 0;
+static uint32_t m_broadcastMask = 0;
+static atomic_bool m_isAborted[SOCKET_COUNT];
+static bool m_isQuad = false;
 
 /*******************************************************************************
  * Data Types Declarations
@@ -63,6 +72,12 @@ static SPI_ErrCode_t spi_writeBuf(uint8_t* buf, uint32_t len);
 // Read Buffer from SPI
 static SPI_ErrCode_t spi_readBuf(uint8_t* buf, uint32_t len);
 
+// Determine if the controller behind fd accepts quad transfers
+static bool spi_probeQuad(int fd);
+
+// Transfer cmd on 1 line, then len bytes on 4 lines from tx and/or into rx
+static SPI_ErrCode_t spi_transferQuad(uint8_t* cmd, uint32_t cmdLen, uint8_t* tx, uint8_t* rx, uint32_t len);
+
 
 /*******************************************************************************
  * Public Function Implementation
@@ -81,6 +96,172 @@ static SPI_ErrCode_t spi_readBuf(uint8_t* buf, uint32_t len);
 void SPI_Init(void)
 {
     int fd = wiringPiSPISetup(SPI_CHANNEL, SPI_CLOCK_SPEED_HZ);
+    m_isQuad = spi_probeQuad(fd);
+}
+
+/*******************************************************************************
+ * @brief SPI_IsQuad
+ *
+ * Determine if the bus controller can clock data on 4 lines
+ *
+ * @param   > None
+ *
+ * @return bool: true if quad transfers are available
+ *
+ ******************************************************************************/
+bool SPI_IsQuad(void)
+{
+    return m_isQuad;
+}
+
+/*******************************************************************************
+ * @brief SPI_WriteQuad
+ *
+ * Write cmd on 1 line then buf on 4 lines in one SPI transaction
+ *
+ * @param   > uint8_t*: command (opcode, address) sent on 1 line
+ *          > uint32_t: command length
+ *          > uint8_t*: data sent on 4 lines
+ *          > uint32_t: data length
+ *
+ * @return SPI_ErrCode_t
+ *
+ ******************************************************************************/
+SPI_ErrCode_t SPI_WriteQuad(uint8_t* cmd, uint32_t cmdLen, uint8_t* buf, uint32_t len)
+{
+    SPI_ErrCode_t err = SPI_ERR_INVALID_INPUT;
+    if(m_isQuad && (cmd != NULL) && (cmdLen > 0) && (buf != NULL) && (len > 0))
+    {
+        spi_select();
+        err = spi_transferQuad(cmd, cmdLen, buf, NULL, len);
+        spi_deselect();
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief SPI_ReadQuad
+ *
+ * Write cmd on 1 line then read len bytes into buf on 4 lines in one SPI
+ * transaction
+ *
+ * @param   > uint8_t*: command (opcode, address, dummy) sent on 1 line
+ *          > uint32_t: command length
+ *          > uint8_t*: buffer to read into
+ *          > uint32_t: number of bytes to read
+ *
+ * @return SPI_ErrCode_t
+ *
+ ******************************************************************************/
+SPI_ErrCode_t SPI_ReadQuad(uint8_t* cmd, uint32_t cmdLen, uint8_t* buf, uint32_t len)
+{
+    SPI_ErrCode_t err = SPI_ERR_INVALID_INPUT;
+    if(m_isQuad && (m_broadcastMask == 0) && (cmd != NULL) && (cmdLen > 0) && (buf != NULL) && (len > 0))
+    {
+        spi_select();
+        err = spi_transferQuad(cmd, cmdLen, NULL, buf, len);
+        spi_deselect();
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief SPI_SetDevice
+ *
+ * Select which device (socket) subsequent transfers address
+ *
+ * @param   > uint8_t: device index into SOCKET_CS_PINS
+ *
+ * @return None
+ *
+ ******************************************************************************/
+void SPI_SetDevice(uint8_t device)
+{
+    if(device < SOCKET_COUNT)
+    {
+        m_device = device;
+    }
+}
+
+/*******************************************************************************
+ * @brief SPI_GetDevice
+ *
+ * Get the device subsequent transfers address
+ *
+ * @param   > None
+ *
+ * @return uint8_t: device index
+ *
+ ******************************************************************************/
+uint8_t SPI_GetDevice(void)
+{
+    return m_device;
+}
+
+/*******************************************************************************
+ * @brief SPI_SetBroadcast
+ *
+ * Broadcast subsequent transfers to every device in mask by asserting all
+ * their chip selects at once. Write-only commands only.
+ *
+ * @param   > uint32_t: device mask (bit n = device n), 0 to stop broadcasting
+ *
+ * @return None
+ *
+ ******************************************************************************/
+void SPI_SetBroadcast(uint32_t mask)
+{
+    m_broadcastMask = mask & ((1u << SOCKET_COUNT) - 1);
+}
+
+/*******************************************************************************
+ * @brief SPI_IsBroadcast
+ *
+ * Determine if transfers are currently broadcast
+ *
+ * @param   > None
+ *
+ * @return bool: true if broadcasting
+ *
+ ******************************************************************************/
+bool SPI_IsBroadcast(void)
+{
+    return m_broadcastMask != 0;
+}
+
+/*******************************************************************************
+ * @brief SPI_Abort
+ *
+ * Abort (or re-arm) transfers to device. While aborted every transfer to it
+ * fails fast with SPI_ERR_ABORTED before its next chunk goes out on the bus.
+ *
+ * @param   > uint8_t: device index
+ *          > bool: true to abort, false to allow transfers again
+ *
+ * @return None
+ *
+ ******************************************************************************/
+void SPI_Abort(uint8_t device, bool isAborted)
+{
+    if(device < SOCKET_COUNT)
+    {
+        atomic_store(&m_isAborted[device], isAborted);
+    }
+}
+
+/*******************************************************************************
+ * @brief SPI_IsAborted
+ *
+ * Determine if transfers to the selected device are currently aborted
+ *
+ * @param   > None
+ *
+ * @return bool: true if aborted
+ *
+ ******************************************************************************/
+bool SPI_IsAborted(void)
+{
+    return atomic_load(&m_isAborted[m_device]);
 }
 
 /*******************************************************************************
@@ -306,6 +487,51 @@ SPI_ErrCode_t SPI_Write2Read(uint8_t* bufWrite1,\
 }
 
 
+/*******************************************************************************
+ * @brief SPI_PollUntilClear
+ *
+ * Write opCode, then keep the slave selected and clock out the register it
+ * returns, blockLen bytes per transfer, until a byte has every bit of mask
+ * clear or maxBlocks blocks have been read. Parts that repeat their status
+ * register for as long as CS is held report completion within blockLen bytes
+ * for a single select and opcode.
+ *
+ * @param   > uint8_t: opcode of the register to stream
+ *          > uint8_t: bits that must all read clear
+ *          > uint32_t: bytes per transfer, at most SPI_POLL_BLOCK_MAX
+ *          > uint32_t: transfers before giving up the bus
+ *          > bool*: set true if a byte read clear
+ *
+ * @return SPI_ErrCode_t
+ *
+ ******************************************************************************/
+SPI_ErrCode_t SPI_PollUntilClear(uint8_t opCode, uint8_t mask, uint32_t blockLen, uint32_t maxBlocks, bool* isClear)
+{
+    SPI_ErrCode_t err = SPI_ERR_OK;
+    if((isClear != NULL) && (blockLen > 0) && (blockLen <= SPI_POLL_BLOCK_MAX))
+    {
+        uint8_t block[SPI_POLL_BLOCK_MAX];
+        *isClear = false;
+        spi_select();
+        err = spi_writeBuf(&opCode, sizeof(uint8_t));
+        for(uint32_t count = 0; (err == SPI_ERR_OK) && !*isClear && (count < maxBlocks); count++)
+        {
+            err = spi_readBuf(block, blockLen);
+            for(uint32_t i = 0; (err == SPI_ERR_OK) && !*isClear && (i < blockLen); i++)
+            {
+                *isClear = ((block[i] & mask) == 0);
+            }
+        }
+        spi_deselect();
+    }
+    else
+    {
+        err = SPI_ERR_INVALID_INPUT;
+    }
+    return err;
+}
+
+
 /*******************************************************************************
  * Private Function Implementation
  ******************************************************************************/
@@ -322,7 +548,17 @@ SPI_ErrCode_t SPI_Write2Read(uint8_t* bufWrite1,\
  ******************************************************************************/
 static void spi_select(void)
 {
-    digitalWrite(SPI_CS_PIN, 0);
+    if(m_broadcastMask == 0)
+    {
+        digitalWrite(m_csPins[m_device], 0);
+    }
+    for(uint8_t device = 0; m_broadcastMask != 0 && device < SOCKET_COUNT; device++)
+    {
+        if(m_broadcastMask & (1u << device))
+        {
+            digitalWrite(m_csPins[device], 0);
+        }
+    }
 }
 
 /*******************************************************************************
@@ -337,7 +573,17 @@ static void spi_select(void)
  ******************************************************************************/
 static void spi_deselect(void)
 {
-    digitalWrite(SPI_CS_PIN, 1);
+    if(m_broadcastMask == 0)
+    {
+        digitalWrite(m_csPins[m_device], 1);
+    }
+    for(uint8_t device = 0; m_broadcastMask != 0 && device < SOCKET_COUNT; device++)
+    {
+        if(m_broadcastMask & (1u << device))
+        {
+            digitalWrite(m_csPins[device], 1);
+        }
+    }
 }
 
 /*******************************************************************************
@@ -359,6 +605,11 @@ static SPI_ErrCode_t spi_writeBuf(uint8_t* buf, uint32_t len)
     uint32_t currentLen = 0;
     while(len > 0)
     {
+        if(atomic_load(&m_isAborted[m_device]))
+        {
+            err = SPI_ERR_ABORTED;
+            break;
+        }
 	currentLen = MIN(TMP_WRITE_BUF_SIZE, len);
 	memcpy(tmpWriteBuf, buf + i, currentLen);
 	len -= currentLen;
@@ -386,8 +637,90 @@ static SPI_ErrCode_t spi_writeBuf(uint8_t* buf, uint32_t len)
 static SPI_ErrCode_t spi_readBuf(uint8_t* buf, uint32_t len)
 {
     SPI_ErrCode_t err = SPI_ERR_OK;
-    int fd = wiringPiSPIDataRW(SPI_CHANNEL, buf, (int) len);
-    if(fd == SPI_BAD_CONNECTION_FD)
+    if(atomic_load(&m_isAborted[m_device]))
+    {
+        err = SPI_ERR_ABORTED;
+    }
+    else if(m_broadcastMask != 0)
+    {
+        err = SPI_ERR_INVALID_INPUT;
+    }
+    else if(wiringPiSPIDataRW(SPI_CHANNEL, buf, (int) len) == SPI_BAD_CONNECTION_FD)
+    {
+        err = SPI_ERR_GENERAL;
+    }
+    return err;
+}
+
+/*******************************************************************************
+ * @brief spi_probeQuad
+ *
+ * Determine if the controller behind fd accepts quad transfers. spidev accepts
+ * any mode but silently drops the multi-line bits a controller lacks, so read
+ * the mode back. A quad capable device is left in quad mode: spidev refuses
+ * any transfer with 4-line nbits unless the device mode has the quad bits.
+ * Single-line transfers are unaffected. Otherwise the original mode is restored.
+ *
+ * @param   > int: spidev file descriptor
+ *
+ * @return bool: true if quad transfers are available
+ *
+ ******************************************************************************/
+static bool spi_probeQuad(int fd)
+{
+    bool isQuad = false;
+    uint32_t mode = 0;
+    if(fd >= 0 && ioctl(fd, SPI_IOC_RD_MODE32, &mode) == 0)
+    {
+        uint32_t quadMode = mode | SPI_TX_QUAD | SPI_RX_QUAD;
+        if(ioctl(fd, SPI_IOC_WR_MODE32, &quadMode) == 0 && ioctl(fd, SPI_IOC_RD_MODE32, &quadMode) == 0)
+        {
+            isQuad = (quadMode & (SPI_TX_QUAD | SPI_RX_QUAD)) == (SPI_TX_QUAD | SPI_RX_QUAD);
+        }
+        if(!isQuad)
+        {
+            ioctl(fd, SPI_IOC_WR_MODE32, &mode);
+        }
+    }
+    return isQuad;
+}
+
+/*******************************************************************************
+ * @brief spi_transferQuad
+ *
+ * Transfer cmd on 1 line, then len bytes on 4 lines from tx and/or into rx,
+ * as one spidev message
+ *
+ * @param   > uint8_t*: command sent on 1 line
+ *          > uint32_t: command length
+ *          > uint8_t*: data to send on 4 lines, NULL to read
+ *          > uint8_t*: buffer to read into on 4 lines, NULL to write
+ *          > uint32_t: data length
+ *
+ * @return SPI_ErrCode_t
+ *
+ ******************************************************************************/
+static SPI_ErrCode_t spi_transferQuad(uint8_t* cmd, uint32_t cmdLen, uint8_t* tx, uint8_t* rx, uint32_t len)
+{
+    SPI_ErrCode_t err = SPI_ERR_OK;
+    struct spi_ioc_transfer xfer[2];
+    memset(xfer, 0, sizeof(xfer));
+    xfer[0].tx_buf = (uintptr_t) cmd;
+    xfer[0].len = cmdLen;
+    xfer[0].speed_hz = SPI_CLOCK_SPEED_HZ;
+    xfer[0].bits_per_word = 8;
+    xfer[1].tx_buf = (uintptr_t) tx;
+    xfer[1].rx_buf = (uintptr_t) rx;
+    xfer[1].len = len;
+    xfer[1].speed_hz = SPI_CLOCK_SPEED_HZ;
+    xfer[1].bits_per_word = 8;
+    xfer[1].tx_nbits = (tx != NULL) ? 4 : 0;
+    xfer[1].rx_nbits = (rx != NULL) ? 4 : 0;
+    if(atomic_load(&m_isAborted[m_device]))
+    {
+        err = SPI_ERR_ABORTED;
+    }
+    else if(ioctl(wiringPiSPIGetFd(SPI_CHANNEL), SPI_IOC_MESSAGE(2), xfer) < 0)
     {
         err = SPI_ERR_GENERAL;
     }
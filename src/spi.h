@@ -19,6 +19,7 @@
 
 // System Includes
 #include <stdint.h>
+#include <stdbool.h>
 
 // Module Includes
 
@@ -43,12 +44,48 @@ typedef enum {
     SPI_ERR_GENERAL,
     SPI_ERR_TIMEOUT,
     SPI_ERR_INVALID_INPUT,
+    SPI_ERR_ABORTED,
     SPI_ERR_COUNT
 } SPI_ErrCode_t;
 
 // Initialized the SPI Port
 void SPI_Init(void);
 
+// Select which device (socket) subsequent transfers address. Each device has
+// its own chip select on the shared bus (SOCKET_CS_PINS).
+void SPI_SetDevice(uint8_t device);
+
+// Get the device subsequent transfers address
+uint8_t SPI_GetDevice(void);
+
+// Broadcast subsequent transfers to every device in mask (bit n = device n)
+// by asserting all their chip selects at once. Write-only commands only: reads
+// are refused while broadcasting since several devices would drive MISO.
+// mask = 0 returns to the single device chosen by SPI_SetDevice.
+void SPI_SetBroadcast(uint32_t mask);
+
+// Determine if transfers are currently broadcast
+bool SPI_IsBroadcast(void);
+
+// Abort (or re-arm) transfers to device. While aborted every transfer to it
+// fails fast with SPI_ERR_ABORTED before its next chunk goes out on the bus.
+void SPI_Abort(uint8_t device, bool isAborted);
+
+// Determine if transfers to the selected device are currently aborted
+bool SPI_IsAborted(void);
+
+// Determine if the bus controller can clock data on 4 lines (SPI_TX_QUAD and
+// SPI_RX_QUAD). Probed once by SPI_Init.
+bool SPI_IsQuad(void);
+
+// Write cmd on 1 line then buf on 4 lines in one SPI transaction. Bus must be
+// quad capable.
+SPI_ErrCode_t SPI_WriteQuad(uint8_t* cmd, uint32_t cmdLen, uint8_t* buf, uint32_t len);
+
+// Write cmd on 1 line then read len bytes into buf on 4 lines in one SPI
+// transaction. Bus must be quad capable.
+SPI_ErrCode_t SPI_ReadQuad(uint8_t* cmd, uint32_t cmdLen, uint8_t* buf, uint32_t len);
+
 // Writes len bytes from buf to the SPI slave.
 // In Master mode this will trigger a transaction w/ the connected slave
 // In Slave mode this will simply populate a ring buffer in preparation for the
@@ -77,4 +114,9 @@ SPI_ErrCode_t SPI_Write2Read(uint8_t* bufWrite1, uint32_t lenWrite1, uint8_t* bu
 // Write 3 Buffers in 1 Transaction
 SPI_ErrCode_t SPI_Write3(uint8_t* buf1, uint32_t len1, uint8_t* buf2, uint32_t len2, uint8_t* buf3, uint32_t len3);
 
+// Write opCode, then stream the register it returns under the same select,
+// blockLen bytes at a time, until a byte reads with mask clear or maxBlocks
+// blocks have gone by
+SPI_ErrCode_t SPI_PollUntilClear(uint8_t opCode, uint8_t mask, uint32_t blockLen, uint32_t maxBlocks, bool* isClear);
+
 #endif // __SPI_H__
@@ -1,13 +1,15 @@
 #include <stdio.h>
+#include <string.h>
 #include "Timer.h"
 #include "Debounce.h"
 #include "Token.h"
-#include <pthread.h>
-#include <semaphore.h>
 #include <wiringPi.h>
 #include "TypeDefs.h"
 #include "test.h"
 #include "TokenFlash.h"
+#include "TokenDevice.h"
+#include "Program.h"
+#include "Event.h"
 
 #define TEST_TOKEN_RW_SIZE      256
 #define TOK_F_WRITE             ((WriteAndVerifyHook) TokenFlash_Write)
@@ -15,9 +17,6 @@
 #define TOK_F_READ              ((WriteAndVerifyHook) TokenFlash_Read)
 #define TEST_TOKEN_START_ADDR   0
 
-extern sem_t g_tokenSem;
-extern bool m_isInserted = false;
-
 // Verify token is connected and is of valid type
 static void testToken_GetDeviceTypeTest(void);
 
@@ -42,6 +41,15 @@ static void testToken_flash_eraseChipTest(void);
 // Verify token can protect all region combinations
 static void testToken_flash_protectTest(void);
 
+// Verify quad reads work once init has probed the bus
+static void testToken_flash_quadTest(void);
+
+// Verify batching pages per erase suspend writes a sector faster than suspending for each page
+static void testToken_flash_suspendTest(void);
+
+// Write a sector while the next one erases, suspending the erase every pages
+static uint32_t testToken_flash_suspendWrite(uint32_t pages, uint32_t runTime, uint32_t* suspends);
+
 /*******************************************************************************
  * @brief main
  *
@@ -54,6 +62,7 @@ static void testToken_flash_protectTest(void);
  ******************************************************************************/
 int main(void)
 {
+    Event_Init();
     Token_Init();
     uint32_t startTick = Timer_GetTick();
     uint32_t tick = Timer_GetTick();
@@ -69,6 +78,11 @@ int main(void)
         printf("elapsedTime = %d Read\n", tick - startTick);
         startTick = tick;
 
+        testToken_flash_quadTest();
+        tick = Timer_GetTick();
+        printf("elapsedTime = %d Quad\n", tick - startTick);
+        startTick = tick;
+
         testToken_flash_writeTest();
         tick = Timer_GetTick();
         printf("elapsedTime = %d Write\n", tick - startTick);
@@ -79,6 +93,11 @@ int main(void)
         printf("elapsedTime = %d Erase\n", tick - startTick);
         startTick = tick;
 
+        testToken_flash_suspendTest();
+        tick = Timer_GetTick();
+        printf("elapsedTime = %d Suspend\n", tick - startTick);
+        startTick = tick;
+
         testToken_flash_protectTest();
         tick = Timer_GetTick();
         printf("elapsedTime = %d Protect\n", tick - startTick);
@@ -295,3 +314,162 @@ static void testToken_flash_protectTest(void)
     TokenFlash_ProtectRegion(TOKEN_FLASH_PROTECT_NONE);
 }
 
+/*******************************************************************************
+ * @brief testToken_flash_quadTest
+ *
+ * Verify quad reads work once init has probed the bus: write a page, read it
+ * back through the part's quad read and on a single line, and compare
+ *
+ * @param  None
+ *
+ * @return int
+ *
+ ******************************************************************************/
+static void testToken_flash_quadTest(void)
+{
+    const TOKEN_Device_t* device = TokenDevice_Identify();
+    if(!SPI_IsQuad() || device->driver != TOKEN_DRIVER_QUAD)
+    {
+        printf("quadTest skipped, bus or part is not quad capable\n");
+        return;
+    }
+    uint8_t pattern[TOKEN_FLASH_PAGE_LEN];
+    uint8_t quadBuf[TOKEN_FLASH_PAGE_LEN] = {0};
+    uint8_t singleBuf[TOKEN_FLASH_PAGE_LEN] = {0};
+    for(uint32_t i = 0; i < TOKEN_FLASH_PAGE_LEN; i++)
+    {
+        pattern[i] = (uint8_t) (i * 7 + 1);
+    }
+    uint8_t instruction[] = { TOKEN_OPCODE_READ, 0, 0, 0 };
+    TOKEN_ErrCode_t err = TokenFlash_Erase(TEST_TOKEN_START_ADDR, TOKEN_FLASH_SECTOR_LEN);
+    if(err == TOKEN_ERR_OK)
+    {
+        err = TokenFlash_Write(TEST_TOKEN_START_ADDR, pattern, TOKEN_FLASH_PAGE_LEN);
+    }
+    if(err == TOKEN_ERR_OK)
+    {
+        err = TokenFlash_Read(TEST_TOKEN_START_ADDR, quadBuf, TOKEN_FLASH_PAGE_LEN);
+    }
+    if(err == TOKEN_ERR_OK && Token_WaitUntilReady())
+    {
+        err = Token_FromSpiErr(SPI_WriteRead(instruction, sizeof(instruction), singleBuf, TOKEN_FLASH_PAGE_LEN));
+    }
+    if(err != TOKEN_ERR_OK)
+    {
+        printf("err = %d. testToken_flash_quadTest failed\n", err);
+    }
+    else if(memcmp(quadBuf, pattern, TOKEN_FLASH_PAGE_LEN) != 0 || memcmp(singleBuf, pattern, TOKEN_FLASH_PAGE_LEN) != 0)
+    {
+        printf("testToken_flash_quadTest read back wrong data\n");
+    }
+    else
+    {
+        printf("quadTest passed\n");
+    }
+    TokenFlash_Erase(TEST_TOKEN_START_ADDR, TOKEN_FLASH_SECTOR_LEN);
+}
+
+/*******************************************************************************
+ * @brief testToken_flash_suspendTest
+ *
+ * Verify batching pages per erase suspend writes a sector faster than
+ * suspending for each page. Each resume restarts part of the erase pulse, so
+ * suspending for every page after a short run leaves the erase barely moving.
+ *
+ * @param  None
+ *
+ * @return None
+ *
+ ******************************************************************************/
+static void testToken_flash_suspendTest(void)
+{
+    const TOKEN_Device_t* device = TokenDevice_Identify();
+    if(!TokenDevice_Has(device, TOKEN_DEVICE_FLAG_ERASE_SUSPEND) || device->timing.eraseSuspendMax == 0)
+    {
+        printf("suspendTest skipped, part can't suspend an erase\n");
+        return;
+    }
+    uint32_t pages = TOKEN_FLASH_SECTOR_LEN / device->pageLen;
+    uint32_t batch = (pages + device->timing.eraseSuspendMax - 1) / device->timing.eraseSuspendMax;
+    uint32_t pageSuspends = 0;
+    uint32_t batchSuspends = 0;
+    uint32_t pageTime = testToken_flash_suspendWrite(1, TIMER_1MS, &pageSuspends);
+    uint32_t batchTime = testToken_flash_suspendWrite(batch, PROGRAM_ERASE_RUN_MIN, &batchSuspends);
+    printf("suspend per page: %u ms, %u suspends; per %u pages: %u ms, %u suspends\n",
+        pageTime, pageSuspends, batch, batchTime, batchSuspends);
+    if(pageTime == 0 || batchTime == 0)
+    {
+        printf("testToken_flash_suspendTest failed\n");
+    }
+    else if(batchTime >= pageTime || batchSuspends > device->timing.eraseSuspendMax)
+    {
+        printf("testToken_flash_suspendTest batched suspends were no faster\n");
+    }
+    else
+    {
+        printf("suspendTest passed\n");
+    }
+    TokenFlash_Erase(TEST_TOKEN_START_ADDR, 2 * TOKEN_FLASH_SECTOR_LEN);
+}
+
+/*******************************************************************************
+ * @brief testToken_flash_suspendWrite
+ *
+ * Write the first sector while the second erases in the background. The erase
+ * is let run for runTime, then suspended while pages are written, until the
+ * sector is in; then it is left to finish.
+ *
+ * @param  > uint32_t : pages, written per suspend
+ *         > uint32_t : runTime, the erase runs between suspends
+ *         > uint32_t* : suspends, set to the suspends taken
+ *
+ * @return uint32_t : ms taken to write the sector and finish the erase, 0 on error
+ *
+ ******************************************************************************/
+static uint32_t testToken_flash_suspendWrite(uint32_t pages, uint32_t runTime, uint32_t* suspends)
+{
+    uint32_t pageLen = TokenDevice_Get()->pageLen;
+    uint8_t buf[TOKEN_FLASH_MAX_PAGE_LEN];
+    memset(buf, 0x5A, sizeof(buf));
+    *suspends = 0;
+    TOKEN_ErrCode_t err = TokenFlash_Erase(TEST_TOKEN_START_ADDR, TOKEN_FLASH_SECTOR_LEN);
+    uint32_t startTick = Timer_GetTick();
+    if(err == TOKEN_ERR_OK)
+    {
+        err = TokenFlash_StartEraseSector(TEST_TOKEN_START_ADDR + TOKEN_FLASH_SECTOR_LEN);
+    }
+    uint32_t address = TEST_TOKEN_START_ADDR;
+    while(err == TOKEN_ERR_OK && address < TEST_TOKEN_START_ADDR + TOKEN_FLASH_SECTOR_LEN)
+    {
+        uint32_t runTick = Timer_GetTick();
+        while(Token_IsBusy() && !Timer_TimeoutExpired(runTick, runTime))
+        {
+        }
+        bool isErasing = Token_IsBusy();
+        if(isErasing)
+        {
+            err = TokenFlash_SuspendErase();
+            (*suspends)++;
+        }
+        for(uint32_t i = 0; err == TOKEN_ERR_OK && i < pages && address < TEST_TOKEN_START_ADDR + TOKEN_FLASH_SECTOR_LEN; i++)
+        {
+            err = Token_WaitUntilReady() ? TokenFlash_StartWritePage(address, buf, pageLen) : TOKEN_ERR_TIMEOUT;
+            address += pageLen;
+        }
+        if(err == TOKEN_ERR_OK && isErasing)
+        {
+            err = Token_WaitUntilReady() ? TokenFlash_ResumeErase() : TOKEN_ERR_TIMEOUT;
+        }
+    }
+    if(err == TOKEN_ERR_OK && !Token_WaitUntilReady_time(TokenDevice_Get()->timing.sectorErase))
+    {
+        err = TOKEN_ERR_TIMEOUT;
+    }
+    if(err != TOKEN_ERR_OK)
+    {
+        printf("err = %d. testToken_flash_suspendWrite failed\n", err);
+        return 0;
+    }
+    return Timer_GetTick() - startTick;
+}
+
@@ -0,0 +1,646 @@
+/*******************************************************************************
+ *  @file tokenEngine.c
+ *
+ *  @brief CPython extension running the programming engine in process, for
+ *  tooling that drives tokens itself instead of through tok. Program, verify,
+ *  dump and erase release the GIL for their whole transfer, so other Python
+ *  threads keep running; one operation uses the bus at a time. Images and
+ *  dump buffers are taken through the buffer protocol and never copied.
+ *
+ *      import tokenEngine
+ *      tokenEngine.program(0, 'pluto.bin')       # or any bytes-like image
+ *      tokenEngine.verify(0, memoryview(image))
+ *      data = tokenEngine.dump(0)                # or dump(0, bytearray(n), address)
+ *      tokenEngine.erase(0)
+ *
+ *  Failures raise tokenEngine.Error(err, message), err a TOKEN_ErrCode_t;
+ *  a failed program or verify adds the address it failed at.
+ *  Don't use it while tok runs; both would drive the same bus.
+ *
+ *  @author KSolomon
+ *  @date Oct 2026
+ *  @copyright 2026 Stryker Corporation. All rights reserved.
+ ******************************************************************************/
+
+
+/******************************************************************************
+ * Include Section
+ ******************************************************************************/
+
+// System Includes
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "TypeDefs.h"
+#include <stdio.h>
+#include <signal.h>
+#include <pthread.h>
+#include <wiringPi.h>
+
+// Module Includes
+#include "Program.h"
+#include "Image.h"
+#include "Socket.h"
+#include "Token.h"
+#include "TokenDevice.h"
+#include "TokenFlash.h"
+#include "Event.h"
+#include "Personalize.h"
+#include "Delta.h"
+
+// Utility Includes
+
+// Driver Includes
+#include "Timer.h"
+
+
+/*******************************************************************************
+ * Constants Declarations
+ ******************************************************************************/
+
+#define ENGINE_READ_LEN         TOKEN_FLASH_SUBSECTOR_LEN   // dump transfer, within spidev's default buffer
+
+static const char* const m_errNames[TOKEN_ERR_COUNT] = {
+    "ok", "timeout", "invalid input", "token removed", "program failed", "erase failed"
+};
+
+
+/*******************************************************************************
+ * Data Types Declarations
+ ******************************************************************************/
+
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;     // one operation on the bus at a time
+static bool m_isInitialized = false;
+static bool m_isMapValid = false;       // personalization map loaded and well formed
+static PyObject* m_error = NULL;        // tokenEngine.Error
+static PROGRAM_Job_t m_job;             // large; only used under m_lock
+
+
+/*******************************************************************************
+ * Private Function Prototypes
+ ******************************************************************************/
+
+// Bring the engine up once and load the personalization map. Caller holds m_lock.
+static void engine_init(void);
+
+// Select socket, drop events the engine queued, and identify the token
+static TOKEN_ErrCode_t engine_begin(uint8_t socket);
+
+// Run a program or verify job on image to completion. GIL released.
+static TOKEN_ErrCode_t engine_runJob(uint8_t socket, IMAGE_t* image, bool isVerifyOnly, uint32_t* address);
+
+// Read len bytes from address into buf. GIL released.
+static TOKEN_ErrCode_t engine_read(uint8_t socket, uint32_t address, uint8_t* buf, uint32_t len);
+
+// Erase the whole token. GIL released.
+static TOKEN_ErrCode_t engine_erase(uint8_t socket);
+
+// Shared body of program() and verify()
+static PyObject* engine_job(PyObject* args, bool isVerifyOnly);
+
+// Raise tokenEngine.Error for err, at address if not NULL
+static PyObject* engine_raise(TOKEN_ErrCode_t err, const uint32_t* address);
+
+// Python: program(socket, image)
+static PyObject* tokenEngine_program(PyObject* self, PyObject* args);
+
+// Python: verify(socket, image)
+static PyObject* tokenEngine_verify(PyObject* self, PyObject* args);
+
+// Python: dump(socket, buffer=None, address=0, length=None)
+static PyObject* tokenEngine_dump(PyObject* self, PyObject* args, PyObject* kwargs);
+
+// Python: erase(socket)
+static PyObject* tokenEngine_erase(PyObject* self, PyObject* args);
+
+// Python: device(socket)
+static PyObject* tokenEngine_device(PyObject* self, PyObject* args);
+
+
+/*******************************************************************************
+ * Module Declarations
+ ******************************************************************************/
+
+static PyMethodDef m_methods[] = {
+    { "program", tokenEngine_program, METH_VARARGS,
+      "program(socket, image): erase, write and verify image (a path or bytes-like) onto the token" },
+    { "verify", tokenEngine_verify, METH_VARARGS,
+      "verify(socket, image): compare the token against image (a path or bytes-like)" },
+    { "dump", (PyCFunction) (void (*)(void)) tokenEngine_dump, METH_VARARGS | METH_KEYWORDS,
+      "dump(socket, buffer=None, address=0, length=None): read the token into a writable buffer, "
+      "or into new bytes (the rest of the token by default)" },
+    { "erase", tokenEngine_erase, METH_VARARGS, "erase(socket): erase the whole token" },
+    { "device", tokenEngine_device, METH_VARARGS,
+      "device(socket): (name, size, JEDEC id) of the token's part" },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef m_module = {
+    PyModuleDef_HEAD_INIT, "tokenEngine", "Token programming engine", -1, m_methods,
+    NULL, NULL, NULL, NULL
+};
+
+
+/*******************************************************************************
+ * Public Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief PyInit_tokenEngine
+ *
+ * Create the module. The engine itself is brought up by the first operation.
+ *
+ * @param  > None
+ *
+ * @return PyObject* : module, NULL on failure
+ ******************************************************************************/
+PyMODINIT_FUNC PyInit_tokenEngine(void)
+{
+    PyObject* module = PyModule_Create(&m_module);
+    if(module == NULL)
+    {
+        return NULL;
+    }
+    m_error = PyErr_NewException("tokenEngine.Error", NULL, NULL);
+    if(m_error == NULL || PyModule_AddObjectRef(module, "Error", m_error) < 0
+        || PyModule_AddIntConstant(module, "SOCKET_COUNT", SOCKET_COUNT) < 0)
+    {
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
+
+
+/*******************************************************************************
+ * Private Function Implementation
+ ******************************************************************************/
+
+/*******************************************************************************
+ * @brief engine_init
+ *
+ * Bring the engine up as main.c does. Event_Init routes SIGINT/SIGTERM/SIGHUP
+ * to its queue for tok's main loop; here they are handed back to Python. The
+ * personalization map is loaded once, as the scheduler loads it; a malformed
+ * map blocks program and verify rather than ship tokens with missing fields.
+ *
+ * @param  > None
+ *
+ * @return None
+ ******************************************************************************/
+static void engine_init(void)
+{
+    if(m_isInitialized)
+    {
+        return;
+    }
+    wiringPiSetupGpio();
+    Timer_Init();
+    Socket_Init();
+    Event_Init();
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+    Token_Init();
+    m_isMapValid = Personalize_Load(PERSONALIZE_MAP_PATH);
+    m_isInitialized = true;
+}
+
+/*******************************************************************************
+ * @brief engine_begin
+ *
+ * Select socket and identify its token. Insertion events the debounce thread
+ * queued are dropped; nothing here waits on them, and the queue would fill.
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return TOKEN_ErrCode_t : ABORTED if the socket is empty
+ ******************************************************************************/
+static TOKEN_ErrCode_t engine_begin(uint8_t socket)
+{
+    uint8_t eventSocket = 0;
+    engine_init();
+    while(Event_Wait(0, &eventSocket) != EVENT_NONE)
+    {
+    }
+    if(!Token_IsSocketInserted(socket))
+    {
+        return TOKEN_ERR_ABORTED;
+    }
+    Token_SelectSocket(socket);
+    TokenDevice_Identify();
+    return TOKEN_ERR_OK;
+}
+
+/*******************************************************************************
+ * @brief engine_runJob
+ *
+ * Run a job the way the scheduler runs a lone socket: poll the token, and
+ * issue the next command whenever it is ready. A programmed image's sector
+ * digests are recorded, as the library records its images, so a token
+ * holding it can later be upgraded by delta.
+ *
+ * @param  > uint8_t : socket
+ *         > IMAGE_t* : image
+ *         > bool : compare only
+ *         > uint32_t* : address the job stopped at
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t engine_runJob(uint8_t socket, IMAGE_t* image, bool isVerifyOnly, uint32_t* address)
+{
+    pthread_mutex_lock(&m_lock);
+    TOKEN_ErrCode_t err = engine_begin(socket);
+    if(err == TOKEN_ERR_OK && !m_isMapValid)
+    {
+        printf("Error, personalization map %s is malformed\n", PERSONALIZE_MAP_PATH);
+        err = TOKEN_ERR_INVALID_INPUT;
+        *address = 0;
+    }
+    else if(err == TOKEN_ERR_OK)
+    {
+        if(isVerifyOnly)
+        {
+            Program_StartVerify(&m_job, socket, image);
+        }
+        else
+        {
+            Delta_AddImage(image);
+            Program_Start(&m_job, socket, image);
+        }
+        while(!Program_IsDone(&m_job))
+        {
+            Token_SelectSocket(socket);
+            if(Program_Poll(&m_job))
+            {
+                Program_Step(&m_job);
+            }
+        }
+        err = m_job.err;
+        *address = m_job.address;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return err;
+}
+
+/*******************************************************************************
+ * @brief engine_read
+ *
+ * Read the token in ENGINE_READ_LEN transfers, checking for removal between them
+ *
+ * @param  > uint8_t : socket
+ *         > uint32_t : address
+ *         > uint8_t* : buffer
+ *         > uint32_t : length
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t engine_read(uint8_t socket, uint32_t address, uint8_t* buf, uint32_t len)
+{
+    pthread_mutex_lock(&m_lock);
+    TOKEN_ErrCode_t err = engine_begin(socket);
+    for(uint32_t done = 0; err == TOKEN_ERR_OK && done < len; done += ENGINE_READ_LEN)
+    {
+        err = TokenFlash_Read(address + done, buf + done, MIN(ENGINE_READ_LEN, len - done));
+    }
+    pthread_mutex_unlock(&m_lock);
+    return err;
+}
+
+/*******************************************************************************
+ * @brief engine_erase
+ *
+ * Erase the whole token. EEPROM tokens have no erase.
+ *
+ * @param  > uint8_t : socket
+ *
+ * @return TOKEN_ErrCode_t
+ ******************************************************************************/
+static TOKEN_ErrCode_t engine_erase(uint8_t socket)
+{
+    pthread_mutex_lock(&m_lock);
+    TOKEN_ErrCode_t err = engine_begin(socket);
+    if(err == TOKEN_ERR_OK)
+    {
+        err = TokenDevice_Has(TokenDevice_Get(), TOKEN_DEVICE_FLAG_NO_ERASE) ?
+            TOKEN_ERR_INVALID_INPUT : TokenFlash_EraseAllBlocking();
+    }
+    pthread_mutex_unlock(&m_lock);
+    return err;
+}
+
+/*******************************************************************************
+ * @brief engine_job
+ *
+ * Parse (socket, image) and run the job. A str image is a path loaded as tok
+ * loads library images; anything else must export a contiguous buffer, which
+ * is programmed in place and held (so it can't be resized) until the job ends.
+ *
+ * @param  > PyObject* : args
+ *         > bool : compare only
+ *
+ * @return PyObject* : None, NULL with an exception set on failure
+ ******************************************************************************/
+static PyObject* engine_job(PyObject* args, bool isVerifyOnly)
+{
+    unsigned char socket = 0;
+    PyObject* source = NULL;
+    if(!PyArg_ParseTuple(args, "bO", &socket, &source))
+    {
+        return NULL;
+    }
+    if(socket >= SOCKET_COUNT)
+    {
+        PyErr_SetString(PyExc_ValueError, "no such socket");
+        return NULL;
+    }
+
+    TOKEN_ErrCode_t err = TOKEN_ERR_OK;
+    uint32_t address = 0;
+    if(PyUnicode_Check(source))
+    {
+        IMAGE_t* image = NULL;
+        const char* path = PyUnicode_AsUTF8(source);
+        if(path == NULL)
+        {
+            return NULL;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        image = Image_Open(path);
+        if(image != NULL && !Image_Wait(image))
+        {
+            Image_Release(image);
+            image = NULL;
+        }
+        if(image != NULL)
+        {
+            err = engine_runJob(socket, image, isVerifyOnly, &address);
+            Image_Release(image);
+        }
+        Py_END_ALLOW_THREADS
+        if(image == NULL)
+        {
+            PyErr_Format(PyExc_OSError, "unable to load image %s", path);
+            return NULL;
+        }
+    }
+    else
+    {
+        Py_buffer view;
+        if(PyObject_GetBuffer(source, &view, PyBUF_SIMPLE) < 0)
+        {
+            return NULL;
+        }
+        if(view.len == 0 || (uint64_t) view.len > UINT32_MAX)
+        {
+            PyBuffer_Release(&view);
+            PyErr_SetString(PyExc_ValueError, "image must be 1 byte to 4 GB");
+            return NULL;
+        }
+        IMAGE_t image = {0};
+        image.data = view.buf;
+        image.len = (uint32_t) view.len;
+        image.refCount = 1;     // ours, so the job's release never frees the caller's buffer
+        Py_BEGIN_ALLOW_THREADS
+        image.digest = Image_Digest(IMAGE_DIGEST_SEED, image.data, image.len);
+        atomic_store(&image.ready, image.len);
+        err = engine_runJob(socket, &image, isVerifyOnly, &address);
+        Py_END_ALLOW_THREADS
+        PyBuffer_Release(&view);
+    }
+    if(err == TOKEN_ERR_ABORTED)
+    {
+        return engine_raise(err, NULL);
+    }
+    return (err == TOKEN_ERR_OK) ? Py_NewRef(Py_None) : engine_raise(err, &address);
+}
+
+/*******************************************************************************
+ * @brief engine_raise
+ *
+ * Raise tokenEngine.Error(err, message), or (err, message, address)
+ *
+ * @param  > TOKEN_ErrCode_t : err
+ *         > const uint32_t* : address it failed at, NULL if none applies
+ *
+ * @return PyObject* : NULL
+ ******************************************************************************/
+static PyObject* engine_raise(TOKEN_ErrCode_t err, const uint32_t* address)
+{
+    const char* message = (err < TOKEN_ERR_COUNT) ? m_errNames[err] : "unknown";
+    PyObject* value = (address != NULL) ? Py_BuildValue("(isI)", (int) err, message, *address) :
+        Py_BuildValue("(is)", (int) err, message);
+    if(value != NULL)
+    {
+        PyErr_SetObject(m_error, value);
+        Py_DECREF(value);
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+ * @brief tokenEngine_program
+ *
+ * program(socket, image). Journaled, personalized from PERSONALIZE_MAP_PATH
+ * and delta programmed like a tok job. Raises tokenEngine.Error if the token
+ * fails or is removed, or the personalization map is malformed.
+ *
+ * @param  > PyObject* : module
+ *         > PyObject* : args
+ *
+ * @return PyObject*
+ ******************************************************************************/
+static PyObject* tokenEngine_program(PyObject* self, PyObject* args)
+{
+    (void) self;
+    return engine_job(args, false);
+}
+
+/*******************************************************************************
+ * @brief tokenEngine_verify
+ *
+ * verify(socket, image). Raises tokenEngine.Error on the first mismatch.
+ *
+ * @param  > PyObject* : module
+ *         > PyObject* : args
+ *
+ * @return PyObject*
+ ******************************************************************************/
+static PyObject* tokenEngine_verify(PyObject* self, PyObject* args)
+{
+    (void) self;
+    return engine_job(args, true);
+}
+
+/*******************************************************************************
+ * @brief tokenEngine_dump
+ *
+ * dump(socket, buffer=None, address=0, length=None). With a buffer, reads
+ * len(buffer) bytes (or length) straight into it and returns None; without,
+ * returns new bytes, by default from address to the end of the token.
+ *
+ * @param  > PyObject* : module
+ *         > PyObject* : args
+ *         > PyObject* : keyword args
+ *
+ * @return PyObject*
+ ******************************************************************************/
+static PyObject* tokenEngine_dump(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    (void) self;
+    static char* keywords[] = { "socket", "buffer", "address", "length", NULL };
+    unsigned char socket = 0;
+    PyObject* target = Py_None;
+    unsigned int address = 0;
+    PyObject* lengthArg = Py_None;
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "b|OIO", keywords, &socket, &target, &address, &lengthArg))
+    {
+        return NULL;
+    }
+    if(socket >= SOCKET_COUNT)
+    {
+        PyErr_SetString(PyExc_ValueError, "no such socket");
+        return NULL;
+    }
+    long long length = -1;
+    if(lengthArg != Py_None)
+    {
+        length = PyLong_AsLongLong(lengthArg);
+        if(length < 0 || length > UINT32_MAX)
+        {
+            if(!PyErr_Occurred())
+            {
+                PyErr_SetString(PyExc_ValueError, "length must be 0 to 4 GB");
+            }
+            return NULL;
+        }
+    }
+
+    TOKEN_ErrCode_t err = TOKEN_ERR_OK;
+    if(target != Py_None)
+    {
+        Py_buffer view;
+        if(PyObject_GetBuffer(target, &view, PyBUF_WRITABLE) < 0)
+        {
+            return NULL;
+        }
+        if(length < 0)
+        {
+            length = view.len;
+        }
+        if(length > view.len)
+        {
+            PyBuffer_Release(&view);
+            PyErr_SetString(PyExc_ValueError, "length is beyond the end of buffer");
+            return NULL;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        err = engine_read(socket, address, view.buf, (uint32_t) length);
+        Py_END_ALLOW_THREADS
+        PyBuffer_Release(&view);
+        return (err == TOKEN_ERR_OK) ? Py_NewRef(Py_None) : engine_raise(err, NULL);
+    }
+
+    if(length < 0)
+    {
+        uint32_t size = 0;
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&m_lock);
+        err = engine_begin(socket);
+        size = TokenDevice_Get()->size;
+        pthread_mutex_unlock(&m_lock);
+        Py_END_ALLOW_THREADS
+        if(err != TOKEN_ERR_OK)
+        {
+            return engine_raise(err, NULL);
+        }
+        length = (address < size) ? size - address : 0;
+    }
+    PyObject* bytes = PyBytes_FromStringAndSize(NULL, (Py_ssize_t) length);
+    if(bytes == NULL)
+    {
+        return NULL;
+    }
+    uint8_t* buf = (uint8_t*) PyBytes_AS_STRING(bytes);     // not shared until returned
+    Py_BEGIN_ALLOW_THREADS
+    err = engine_read(socket, address, buf, (uint32_t) length);
+    Py_END_ALLOW_THREADS
+    if(err != TOKEN_ERR_OK)
+    {
+        Py_DECREF(bytes);
+        return engine_raise(err, NULL);
+    }
+    return bytes;
+}
+
+/*******************************************************************************
+ * @brief tokenEngine_erase
+ *
+ * erase(socket). Raises tokenEngine.Error on EEPROM tokens (invalid input).
+ *
+ * @param  > PyObject* : module
+ *         > PyObject* : args
+ *
+ * @return PyObject*
+ ******************************************************************************/
+static PyObject* tokenEngine_erase(PyObject* self, PyObject* args)
+{
+    (void) self;
+    unsigned char socket = 0;
+    if(!PyArg_ParseTuple(args, "b", &socket))
+    {
+        return NULL;
+    }
+    if(socket >= SOCKET_COUNT)
+    {
+        PyErr_SetString(PyExc_ValueError, "no such socket");
+        return NULL;
+    }
+    TOKEN_ErrCode_t err = TOKEN_ERR_OK;
+    Py_BEGIN_ALLOW_THREADS
+    err = engine_erase(socket);
+    Py_END_ALLOW_THREADS
+    return (err == TOKEN_ERR_OK) ? Py_NewRef(Py_None) : engine_raise(err, NULL);
+}
+
+/*******************************************************************************
+ * @brief tokenEngine_device
+ *
+ * device(socket): (name, size, JEDEC id) of the token's part, identified now
+ *
+ * @param  > PyObject* : module
+ *         > PyObject* : args
+ *
+ * @return PyObject*
+ ******************************************************************************/
+static PyObject* tokenEngine_device(PyObject* self, PyObject* args)
+{
+    (void) self;
+    unsigned char socket = 0;
+    if(!PyArg_ParseTuple(args, "b", &socket))
+    {
+        return NULL;
+    }
+    if(socket >= SOCKET_COUNT)
+    {
+        PyErr_SetString(PyExc_ValueError, "no such socket");
+        return NULL;
+    }
+    TOKEN_ErrCode_t err = TOKEN_ERR_OK;
+    const TOKEN_Device_t* device = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&m_lock);
+    err = engine_begin(socket);
+    device = TokenDevice_Get();
+    pthread_mutex_unlock(&m_lock);
+    Py_END_ALLOW_THREADS
+    if(err != TOKEN_ERR_OK)
+    {
+        return engine_raise(err, NULL);
+    }
+    return Py_BuildValue("(sIk)", device->name, device->size, (unsigned long) device->jedecId);
+}
+
+// EOF
@@ -1,140 +1,116 @@
 #!/usr/bin/env python3
 
-import sys
-import os
-from pathlib import Path
-import time
-import re
-import spidev
-import RPi.GPIO as GPIO
-
-SPI_BUS=0
-SPI_DEVICE=0
-
-PIN_CONFIG=GPIO.BOARD
-
-BLUE_PIN=29
-YELLOW_PIN=37
-RED_PIN=35
-GREEN_PIN=40
-
-LOFO_PIN=12
-
-PLUTO_BIN = 'Pluto_FULL_TOKEN.bin'
-PLUTO_PATH = '/home/pi/token/'
-
-def bytesToHex(Bytes):
-    return ''.join(["0x%02X " % x for x in Bytes]).strip()
-
-class Led():
-    """LED class"""
-    
-    def __init__(self, pin):
-        self.gpio = pin
-        self.state = False
-        GPIO.setup(pin, GPIO.OUT)
-        self.off()
+# Command line client for the programmer daemon (tok) control socket.
+#
+#   tokenFlasher.py status
+#   tokenFlasher.py program|verify|dump SOCKET
+#   tokenFlasher.py dump SOCKET zst     dump compressed, to tok's dumps directory
+#   tokenFlasher.py clone SOCKET [TARGET...]  copy the token in SOCKET onto the
+#                                       targets, by default every other idle token
+#   tokenFlasher.py select [IMAGE]      no IMAGE goes back to per token
+#   tokenFlasher.py watch               stream state and progress until ^C
 
-    def on(self):
-        self.state = True
-        GPIO.output(self.gpio, GPIO.HIGH)
-
-
-    def off(self):
-        self.state = False
-        GPIO.output(self.gpio, GPIO.LOW)
-
-    def isOn(self):
-        return self.state
-
-def isTokenInserted():
-    if GPIO.input(LOFO_PIN) is 0:
-        return True
+import sys
+import json
+import socket
+
+CONTROL_PATH = '/home/pi/Documents/CODE/spiToken/src/tok.sock'
+
+class Programmer(object):
+    """Connection to the programmer's control socket"""
+
+    def __init__(self, path=CONTROL_PATH):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.file = self.sock.makefile('rw')
+        self.nextId = 1
+
+    def close(self):
+        self.file.close()
+        self.sock.close()
+
+    # Send a command and return its answer. Events arriving meanwhile are
+    # passed to onEvent.
+    def request(self, cmd, onEvent=None, **args):
+        args['cmd'] = cmd
+        args['id'] = self.nextId
+        self.nextId += 1
+        self.file.write(json.dumps(args) + '\n')
+        self.file.flush()
+        while True:
+            message = self.read()
+            if message.get('id') == args['id']:
+                return message
+            if 'event' in message and onEvent is not None:
+                onEvent(message)
+
+    # Next message from the programmer
+    def read(self):
+        line = self.file.readline()
+        if not line:
+            raise ConnectionError('programmer closed the connection')
+        return json.loads(line)
+
+def printSocket(status):
+    total = status['total']
+    percent = (status['done'] * 100 // total) if total else 0
+    print('socket %d: %-5s %-7s %-7s %-16s %3d%% %6d KB %6d ms%s' % (status['socket'],
+          'token' if status['token'] else 'empty', status['job'], status['state'], status['image'] or '-',
+          percent, status['done'] // 1024, status['ms'], (' err %d' % status['err']) if status['err'] else ''))
+
+def printEvent(event):
+    if event['event'] == 'state':
+        printSocket(event)
     else:
-        return False
-
-def initAll():
-    GPIO.setmode(PIN_CONFIG) 
-    GPIO.setup(LOFO_PIN, GPIO.IN)
+        total = event['total']
+        print('socket %d: %-6s %3d%% %d/%d KB %d KB/s' % (event['socket'], event['phase'],
+              (event['done'] * 100 // total) if total else 0, event['done'] // 1024, total // 1024, event['rate'] // 1024))
 
-def tokenReadSR(spi):
-    dataOut = [0x01]
-    dataIn  = [0xFF, 0xFE]
-    spi.writebytes(dataIn)
-    spi.readbytes(len(dataIn))
-    return dataIn
-
-def programToken(fp):
-    spi = spidev.SpiDev()
-    spi.open(SPI_BUS, SPI_DEVICE)
-    spi.max_speed_hz = 1000000
-    spi.mode = 0b01
-
-    # Erase token
-    print('sending bytes')
-    SR = tokenReadSR(spi)
-    print("SR read")
-    print("SR is: ", SR)
-
-    # If file exists, open it.
-    # Read in bytes, X at a time.
-    # Program bytes to token.
-    
-    spi.close()
- 
+def usage():
+    print('usage: tokenFlasher.py status | program SOCKET | verify SOCKET | dump SOCKET [zst] | clone SOCKET [TARGET...] | select [IMAGE] | watch')
+    sys.exit(2)
 
 def main():
-
-    initAll()
-
-    blue = Led(BLUE_PIN)
-    red = Led(RED_PIN)
-    yellow = Led(YELLOW_PIN)
-    green = Led(GREEN_PIN)
-
+    if len(sys.argv) < 2:
+        usage()
+    cmd = sys.argv[1]
     try:
-        while True:
-        
-            while isTokenInserted() is False:
-                pass
-
-            blue.on()
-            time.sleep(0.2)
-
-            if isTokenInserted() is True:
-                yellow.on()
-                time.sleep(1)
-                path = PLUTO_PATH + PLUTO_BIN
-                try: 
-                    fp = open(path, "rb")
-                    programToken(fp)
-                    fp.close()
-                    
-                    green.on()     
-                except:
-                    print('File not found:', path)
-                    red.on()
-                
-                yellow.off()
-
-            while isTokenInserted() is True:
-                pass
-
-            red.off()
-            yellow.off()
-            green.off()
-            blue.off()
-            time.sleep(.5)
+        programmer = Programmer()
+    except OSError as e:
+        print('Unable to reach the programmer at %s: %s' % (CONTROL_PATH, e))
+        sys.exit(1)
 
+    try:
+        if cmd == 'status' and len(sys.argv) == 2:
+            reply = programmer.request('status')
+            print('selected image: %s' % (reply['selected'] or 'per token'))
+            for status in reply['sockets']:
+                printSocket(status)
+        elif cmd in ('program', 'verify', 'dump') and len(sys.argv) == 3:
+            reply = programmer.request(cmd, socket=int(sys.argv[2]))
+        elif cmd == 'dump' and len(sys.argv) == 4 and sys.argv[3] == 'zst':
+            reply = programmer.request(cmd, socket=int(sys.argv[2]), compress=True)
+        elif cmd == 'clone' and len(sys.argv) >= 3:
+            reply = programmer.request(cmd, socket=int(sys.argv[2]), targets=[int(target) for target in sys.argv[3:]])
+        elif cmd == 'select' and len(sys.argv) <= 3:
+            reply = programmer.request('select', image=sys.argv[2] if len(sys.argv) == 3 else '')
+        elif cmd == 'watch' and len(sys.argv) == 2:
+            reply = programmer.request('subscribe', onEvent=printEvent)
+            while True:
+                printEvent(programmer.read())
+        else:
+            usage()
     except KeyboardInterrupt:
-        print("Exiting...")
-    
-    red.off()
-    green.off()
-    blue.off()
-
-    GPIO.cleanup()
-
+        reply = {'ok': True}
+    except (OSError, ValueError) as e:
+        print('Error: %s' % e)
+        sys.exit(1)
+    finally:
+        programmer.close()
+
+    if not reply['ok']:
+        print('Error: %s' % reply['error'])
+        sys.exit(1)
     sys.exit(0)
 
 if __name__=="__main__":
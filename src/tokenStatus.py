@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+
+# Reader for the programmer daemon's (tok) shared memory status block. The
+# block is mapped read only and polled: no syscalls per read and nothing the
+# programmer ever waits on, so a UI can refresh it as often as it likes.
+#
+#   tokenStatus.py              refresh a table of the sockets until ^C
+#   tokenStatus.py once         print the sockets once
+#
+# The layout matches Status.c: a header of 32 bit words (magic, version,
+# header length, socket length, socket count, sequence), the selected image,
+# then one record per socket. The sequence is odd while tok is publishing and
+# moves on every publish; a copy taken while it was odd or moved is retried.
+
+import sys
+import time
+import mmap
+import struct
+
+STATUS_PATH = '/dev/shm/tok.status'
+STATUS_MAGIC = 0x54534B54
+STATUS_VERSION = 1
+
+HEADER = struct.Struct('<6I')
+SEQUENCE_OFFSET = 20
+NAME_LEN = 32
+SOCKET = struct.Struct('<5Ii5I%ds' % NAME_LEN)
+
+JOBS = ('none', 'program', 'verify', 'dump', 'clone')
+STATES = ('idle', 'running', 'passed', 'failed', 'aborted')
+PHASES = ('none', 'erase', 'read', 'write', 'verify')
+
+def name(names, index):
+    return names[index] if index < len(names) else 'unknown'
+
+class StatusBlock(object):
+    """tok's status block, mapped read only"""
+
+    def __init__(self, path=STATUS_PATH):
+        with open(path, 'rb') as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, self.headerLen, self.socketLen, self.socketCount, _ = HEADER.unpack_from(self.map)
+        if magic != STATUS_MAGIC or version != STATUS_VERSION:
+            self.map.close()
+            raise ValueError('%s is not a version %d status block' % (path, STATUS_VERSION))
+        if self.socketLen < SOCKET.size or self.headerLen + self.socketLen * self.socketCount + NAME_LEN > len(self.map):
+            self.map.close()
+            raise ValueError('%s has an unexpected layout' % path)
+        self.length = NAME_LEN + self.socketLen * self.socketCount
+
+    def close(self):
+        self.map.close()
+
+    def sequence(self):
+        return struct.unpack_from('<I', self.map, SEQUENCE_OFFSET)[0]
+
+    # Consistent snapshot: {'selected': name, 'sockets': [dict per socket]}
+    def read(self):
+        while True:
+            start = self.sequence()
+            if start & 1:
+                continue
+            raw = self.map[self.headerLen:self.headerLen + self.length]
+            if self.sequence() == start:
+                break
+        sockets = []
+        for socket in range(self.socketCount):
+            (jobCount, job, state, phase, isInserted, err, done, total, ms, rate, retries,
+             image) = SOCKET.unpack_from(raw, NAME_LEN + socket * self.socketLen)
+            sockets.append({'socket': socket, 'token': bool(isInserted), 'job': name(JOBS, job),
+                            'state': name(STATES, state), 'phase': name(PHASES, phase),
+                            'image': image.split(b'\0', 1)[0].decode(errors='replace'), 'done': done,
+                            'total': total, 'ms': ms, 'rate': rate, 'retries': retries, 'err': err,
+                            'jobs': jobCount})
+        return {'selected': raw[:NAME_LEN].split(b'\0', 1)[0].decode(errors='replace'), 'sockets': sockets}
+
+def formatSocket(status):
+    total = status['total']
+    return 'socket %d: %-5s %-7s %-7s %-6s %-16s %3d%% %6d KB %5d KB/s %3d retries%s' % (status['socket'],
+        'token' if status['token'] else 'empty', status['job'], status['state'], status['phase'],
+        status['image'] or '-', (status['done'] * 100 // total) if total else 0, status['done'] // 1024,
+        status['rate'] // 1024, status['retries'], (' err %d' % status['err']) if status['err'] else '')
+
+def main():
+    if len(sys.argv) > 2 or (len(sys.argv) == 2 and sys.argv[1] != 'once'):
+        print('usage: tokenStatus.py [once]')
+        sys.exit(2)
+    try:
+        block = StatusBlock()
+    except (OSError, ValueError) as e:
+        print('Unable to read programmer status: %s' % e)
+        sys.exit(1)
+
+    try:
+        while True:
+            status = block.read()
+            lines = ['selected image: %s' % (status['selected'] or 'per token')]
+            lines += [formatSocket(socket) for socket in status['sockets']]
+            if len(sys.argv) == 2:
+                print('\n'.join(lines))
+                break
+            sys.stdout.write('\033[H\033[J' + '\n'.join(lines) + '\n')
+            sys.stdout.flush()
+            time.sleep(0.1)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        block.close()
+
+if __name__=="__main__":
+    main()